@@ -0,0 +1,103 @@
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include "perf_counters.hpp"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#define BENCH(void_fn)                                                         \
+    std::cout << ">>>> BENCH STARTING: " << #void_fn << std::endl;             \
+    void_fn();
+
+// keeps the compiler from discarding a result that is otherwise unused.
+template <typename T> inline void keep(const T& a_value)
+{
+    asm volatile("" : : "g"(&a_value) : "memory");
+}
+
+// prints one result line: the total time and the time per item.
+inline void report(const char* a_name, std::chrono::nanoseconds a_time,
+                   size_t a_items)
+{
+    std::printf("    %-40s %10.3f ms %10.3f ns/item\n", a_name,
+                a_time.count() / 1e6,
+                a_items ? double(a_time.count()) / a_items : 0.0);
+}
+
+// counters shared by every benchmark, opened once.
+inline perf_counters& bench_counters()
+{
+    static perf_counters l_counters;
+    return l_counters;
+}
+
+// the wall time and hardware event counts of one run.
+struct measurement
+{
+    std::chrono::nanoseconds m_time = std::chrono::nanoseconds::max();
+    // indexed like perf_counters events; -1 where unavailable
+    std::vector<double> m_counters;
+};
+
+// runs a_setup and then a_fn, a_runs times, and returns the fastest time
+// taken by a_fn, with the hardware events counted around it in that run.
+// a_setup is neither timed nor counted.
+template <typename SETUP, typename FN>
+measurement measure_best_of(size_t a_runs, SETUP&& a_setup, FN&& a_fn)
+{
+    using clock = std::chrono::steady_clock;
+
+    perf_counters& l_counters = bench_counters();
+    measurement l_best;
+
+    for(size_t i = 0; i < a_runs; ++i)
+    {
+        a_setup();
+
+        const clock::time_point l_start = clock::now();
+        l_counters.start();
+        a_fn();
+        std::vector<double> l_counts = l_counters.stop();
+        const auto l_time = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(clock::now() - l_start);
+
+        if(l_time < l_best.m_time)
+            l_best = {l_time, std::move(l_counts)};
+    }
+
+    return l_best;
+}
+
+// prints the time line of report(), then every available event per item,
+// and instructions per cycle when both are known.
+inline void report(const char* a_name, const measurement& a_measurement,
+                   size_t a_items)
+{
+    report(a_name, a_measurement.m_time, a_items);
+
+    const std::vector<double>& l_counts = a_measurement.m_counters;
+    bool l_any = false;
+
+    for(size_t i = 0; i < l_counts.size(); ++i)
+    {
+        if(l_counts[i] < 0)
+            continue;
+
+        if(!l_any)
+            std::printf("      per item:");
+
+        std::printf(" %s %.2f", perf_counters::event_name(i),
+                    a_items ? l_counts[i] / a_items : 0.0);
+        l_any = true;
+    }
+
+    if(l_counts.size() > 1 && l_counts[0] > 0 && l_counts[1] >= 0)
+        std::printf("  IPC %.2f", l_counts[1] / l_counts[0]);
+
+    if(l_any)
+        std::printf("\n");
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "bench_utils.hpp"
+
+extern void lambda_bench_main();
+extern void parallel_bench_main();
+extern void flat_bench_main();
+extern void corpus_bench_main();
+extern void lockstep_bench_main();
+extern void speculate_bench_main();
+extern void intern_bench_main();
+extern void epoch_bench_main();
+extern void node_pool_bench_main();
+extern void profile_bench_main();
+extern void library_bench_main();
+extern void specialize_bench_main();
+extern void cse_bench_main();
+extern void eta_bench_main();
+extern void strictness_bench_main();
+
+void bench_main()
+{
+    const perf_counters& l_counters = bench_counters();
+
+    if(!l_counters.any_available())
+        std::cout << "hardware counters unavailable ("
+                  << l_counters.unavailable_reason()
+                  << "); reporting wall time only" << std::endl;
+    else if(!l_counters.unavailable_reason().empty())
+        std::cout << "some hardware counters unavailable ("
+                  << l_counters.unavailable_reason() << ")" << std::endl;
+
+    BENCH(lambda_bench_main);
+    BENCH(parallel_bench_main);
+    BENCH(flat_bench_main);
+    BENCH(corpus_bench_main);
+    BENCH(lockstep_bench_main);
+    BENCH(speculate_bench_main);
+    BENCH(intern_bench_main);
+    BENCH(epoch_bench_main);
+    BENCH(node_pool_bench_main);
+    BENCH(profile_bench_main);
+    BENCH(library_bench_main);
+    BENCH(specialize_bench_main);
+    BENCH(cse_bench_main);
+    BENCH(eta_bench_main);
+    BENCH(strictness_bench_main);
+}
+
+int main()
+{
+    bench_main();
+
+    return 0;
+}
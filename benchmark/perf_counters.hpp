@@ -0,0 +1,160 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// hardware events counted around benchmarks through perf_event_open. Each
+// event is opened on its own, so any the kernel, the cpu or the sandbox
+// does not offer are simply missing from the results. On other systems, or
+// when perf_event_paranoid forbids it, no event is available and only wall
+// time is reported.
+class perf_counters
+{
+  public:
+    static constexpr size_t EVENT_COUNT = 7;
+
+    perf_counters()
+    {
+        for(size_t i = 0; i < EVENT_COUNT; ++i)
+        {
+            m_fds[i] = open_event(i);
+
+            if(m_fds[i] < 0 && m_reason.empty())
+                m_reason = std::string(event_name(i)) + ": " +
+                           std::strerror(errno);
+        }
+    }
+
+    ~perf_counters()
+    {
+#ifdef __linux__
+        for(int l_fd : m_fds)
+            if(l_fd >= 0)
+                close(l_fd);
+#endif
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    static const char* event_name(size_t a_event)
+    {
+        static const char* const l_names[EVENT_COUNT] = {
+            "cycles",   "instructions", "L1d-misses", "LLC-misses",
+            "br-misses", "dTLB-misses",  "page-faults"};
+
+        return l_names[a_event];
+    }
+
+    // zeroes and starts every available counter.
+    void start()
+    {
+#ifdef __linux__
+        for(int l_fd : m_fds)
+            if(l_fd >= 0)
+            {
+                ioctl(l_fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(l_fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+
+    // stops the counters and returns their values, scaled up if the kernel
+    // had to multiplex them. Unavailable events read as -1.
+    std::vector<double> stop()
+    {
+        std::vector<double> l_values(EVENT_COUNT, -1);
+
+#ifdef __linux__
+        for(size_t i = 0; i < EVENT_COUNT; ++i)
+        {
+            if(m_fds[i] < 0)
+                continue;
+
+            ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+            // value, time enabled, time running
+            uint64_t l_read[3] = {0, 0, 0};
+
+            if(read(m_fds[i], l_read, sizeof(l_read)) != sizeof(l_read) ||
+               l_read[2] == 0)
+                continue;
+
+            l_values[i] = double(l_read[0]) * l_read[1] / l_read[2];
+        }
+#endif
+
+        return l_values;
+    }
+
+    bool any_available() const
+    {
+        for(int l_fd : m_fds)
+            if(l_fd >= 0)
+                return true;
+
+        return false;
+    }
+
+    // why the first missing event could not be opened, or empty.
+    const std::string& unavailable_reason() const
+    {
+        return m_reason;
+    }
+
+  private:
+    int open_event(size_t a_event)
+    {
+#ifdef __linux__
+        static const uint32_t l_types[EVENT_COUNT] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+            PERF_TYPE_SOFTWARE};
+        static const uint64_t l_configs[EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_SW_PAGE_FAULTS};
+
+        perf_event_attr l_attr;
+        std::memset(&l_attr, 0, sizeof(l_attr));
+        l_attr.size = sizeof(l_attr);
+        l_attr.type = l_types[a_event];
+        l_attr.config = l_configs[a_event];
+        l_attr.disabled = 1;
+        // threads the benchmark starts are counted too
+        l_attr.inherit = 1;
+        l_attr.exclude_kernel = 1;
+        l_attr.exclude_hv = 1;
+        l_attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        return int(syscall(SYS_perf_event_open, &l_attr, 0, -1, -1, 0));
+#else
+        (void)a_event;
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    int m_fds[EVENT_COUNT];
+    std::string m_reason;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace lambda
+{
+
+// lock-free multi-producer multi-consumer queue of fixed capacity.
+//
+// Each cell carries a sequence number telling producers and consumers whose
+// turn it is, so a push or pop costs one CAS on the shared position plus one
+// release store on the cell (D. Vyukov's bounded MPMC design). Neither
+// operation blocks; callers decide how to wait.
+template <typename T> class bounded_queue
+{
+  public:
+    // a_capacity is rounded up to a power of two (at least 2).
+    explicit bounded_queue(size_t a_capacity)
+    {
+        size_t l_capacity = 2;
+        while(l_capacity < a_capacity)
+            l_capacity *= 2;
+
+        m_cells.reset(new cell[l_capacity]);
+        m_mask = l_capacity - 1;
+
+        for(size_t i = 0; i < l_capacity; ++i)
+            m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+
+        m_enqueue_pos.store(0, std::memory_order_relaxed);
+        m_dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    // moves a_value into the queue. Returns false, leaving a_value
+    // untouched, if the queue is full.
+    bool try_push(T& a_value)
+    {
+        size_t l_pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            cell& l_cell = m_cells[l_pos & m_mask];
+            const size_t l_sequence =
+                l_cell.m_sequence.load(std::memory_order_acquire);
+            const ptrdiff_t l_diff = static_cast<ptrdiff_t>(l_sequence) -
+                                     static_cast<ptrdiff_t>(l_pos);
+
+            if(l_diff == 0)
+            {
+                // the cell is free for this position; try to claim it
+                if(m_enqueue_pos.compare_exchange_weak(
+                       l_pos, l_pos + 1, std::memory_order_relaxed))
+                {
+                    l_cell.m_value = std::move(a_value);
+                    l_cell.m_sequence.store(l_pos + 1,
+                                            std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(l_diff < 0)
+            {
+                // the cell still holds a value from the previous lap
+                return false;
+            }
+            else
+            {
+                // another producer claimed this position
+                l_pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // moves the oldest value into a_value. Returns false if the queue is
+    // empty.
+    bool try_pop(T& a_value)
+    {
+        size_t l_pos = m_dequeue_pos.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            cell& l_cell = m_cells[l_pos & m_mask];
+            const size_t l_sequence =
+                l_cell.m_sequence.load(std::memory_order_acquire);
+            const ptrdiff_t l_diff = static_cast<ptrdiff_t>(l_sequence) -
+                                     static_cast<ptrdiff_t>(l_pos + 1);
+
+            if(l_diff == 0)
+            {
+                if(m_dequeue_pos.compare_exchange_weak(
+                       l_pos, l_pos + 1, std::memory_order_relaxed))
+                {
+                    a_value = std::move(l_cell.m_value);
+                    // hand the cell to the producer of the next lap
+                    l_cell.m_sequence.store(l_pos + m_mask + 1,
+                                            std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(l_diff < 0)
+            {
+                // nothing has been pushed to this position yet
+                return false;
+            }
+            else
+            {
+                l_pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+  private:
+    struct cell
+    {
+        std::atomic<size_t> m_sequence;
+        T m_value;
+    };
+
+    std::unique_ptr<cell[]> m_cells;
+    size_t m_mask;
+    // producers and consumers each get their own cache line
+    alignas(64) std::atomic<size_t> m_enqueue_pos;
+    alignas(64) std::atomic<size_t> m_dequeue_pos;
+};
+
+} // namespace lambda
+
+#endif
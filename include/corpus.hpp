@@ -0,0 +1,70 @@
+#ifndef CORPUS_HPP
+#define CORPUS_HPP
+
+#include "eta.hpp"
+#include "flat.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace lambda
+{
+
+// a set of distinct expressions, stored back to back in the flat layout so
+// that millions of terms cost two large arrays rather than millions of
+// trees. Lookups hash and compare the stored bytes with hash_bytes() and
+// bytes_equal().
+class term_corpus
+{
+  public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    term_corpus();
+
+    // adds a_expr unless an equal expression is already present. Returns the
+    // id of the stored expression equal to a_expr and whether it was added.
+    // Ids count up from 0 in order of addition.
+    std::pair<size_t, bool> insert(const expr& a_expr);
+    std::pair<size_t, bool> insert(const flat_expr& a_flat);
+
+    // id of the stored expression equal to a_flat, or npos.
+    size_t find(const flat_expr& a_flat) const;
+
+    // number of distinct expressions.
+    size_t size() const;
+
+    // a copy of the expression with id a_id.
+    flat_expr at(size_t a_id) const;
+
+  private:
+    struct entry
+    {
+        uint64_t m_hash;
+        size_t m_tag_begin;
+        size_t m_tag_count;
+        size_t m_level_begin;
+        size_t m_level_count;
+    };
+
+    // the slot holding a_flat, or the free slot where it would go.
+    size_t probe(uint64_t a_hash, const flat_expr& a_flat) const;
+    void grow();
+
+    std::vector<node_tag> m_tags;
+    std::vector<uint32_t> m_levels;
+    std::vector<entry> m_entries;
+    // open-addressing index into m_entries; npos marks a free slot
+    std::vector<size_t> m_slots;
+    // reused by insert(const expr&)
+    flat_expr m_scratch;
+};
+
+// returns, for each expression in a_exprs, the index of the first
+// expression in a_exprs equal to it under a_equivalence.
+std::vector<size_t>
+dedup(const std::vector<std::unique_ptr<expr>>& a_exprs,
+      equivalence a_equivalence = equivalence::syntactic);
+
+} // namespace lambda
+
+#endif
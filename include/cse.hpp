@@ -0,0 +1,44 @@
+#ifndef CSE_HPP
+#define CSE_HPP
+
+#include "lambda.hpp"
+
+namespace lambda
+{
+
+// COMMON SUBEXPRESSION ELIMINATION
+// generated programs often hold many copies of the same closed subterm,
+// e.g. a numeral or combinator pasted at every use. eliminate_common_
+// subterms() binds each such subterm once at the root,
+//   E[S, S, S]  →  (λ.E[x, x, x]) S
+// where x is the new binder, for as long as that makes the term smaller.
+// Closed subterms are found wherever they sit: two copies under different
+// numbers of binders are the same subterm, though their levels differ.
+// Candidates are grouped by a structural hash taken over their De Bruijn
+// indices, which do not depend on depth, and compared before being shared.
+//
+// The result is beta-equivalent to the input: its first reduction step
+// substitutes the copies back. What shrinks is the input (to store, send,
+// hash or intern it); an evaluator that shares arguments rather than
+// copying them also saves reducing the copies more than once.
+
+struct cse_stats
+{
+    // bindings added at the root
+    size_t m_bindings = 0;
+    // copies replaced by a variable
+    size_t m_replaced = 0;
+    size_t m_size_before = 0;
+    size_t m_size_after = 0;
+};
+
+// shares the repeated closed subterms of a_expr, whose root is at depth
+// a_depth, under new bindings at its root, the largest first, so that the
+// repeats within a shared subterm are shared in turn. Subterms are only
+// bound if that makes the term smaller.
+cse_stats eliminate_common_subterms(std::unique_ptr<expr>& a_expr,
+                                    size_t a_depth = 0);
+
+} // namespace lambda
+
+#endif
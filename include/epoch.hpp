@@ -0,0 +1,160 @@
+#ifndef EPOCH_HPP
+#define EPOCH_HPP
+
+#include "lambda.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lambda
+{
+
+// epoch-based reclamation of objects shared between threads.
+//
+// Readers pin the current epoch for as long as they hold pointers to shared
+// objects, which writes only the reader's own record: reading a hot shared
+// term costs no reference count updates and no writes to any cache line
+// other threads write. A writer that unlinks an object retires it instead
+// of deleting it; it is deleted once every thread that was pinned when it
+// was retired has unpinned, which is when the global epoch has advanced
+// twice since.
+//
+// Garbage stays bounded as long as no thread stays pinned indefinitely:
+// each participant tries to advance the epoch and delete its own garbage
+// every RETIRE_THRESHOLD retirements.
+class epoch_domain
+{
+  public:
+    epoch_domain();
+    // deletes everything still retired. Every participant must have been
+    // destroyed first.
+    ~epoch_domain();
+
+    epoch_domain(const epoch_domain&) = delete;
+    epoch_domain& operator=(const epoch_domain&) = delete;
+
+    // the global epoch. Only participants with garbage advance it.
+    uint64_t epoch() const;
+
+    // objects retired but not yet deleted.
+    size_t pending() const;
+
+  private:
+    friend class epoch_participant;
+
+    struct retired
+    {
+        void* m_object;
+        void (*m_deleter)(void*);
+        uint64_t m_epoch;
+    };
+
+    struct record;
+
+    // a record no participant is using, registering a new one if needed.
+    record* acquire();
+    // advances the global epoch if every pinned record has seen it.
+    void try_advance();
+    // deletes every entry of a_garbage retired at least two epochs before
+    // a_epoch, keeping the rest. Returns the number deleted.
+    static size_t delete_safe(std::vector<retired>& a_garbage,
+                              uint64_t a_epoch);
+
+    alignas(64) std::atomic<uint64_t> m_epoch;
+    // every record ever registered, newest first. Records are reused, never
+    // unlinked, so the list can be walked without locking.
+    alignas(64) std::atomic<record*> m_records;
+
+    // garbage left behind by participants that were destroyed while it was
+    // still in use
+    mutable std::mutex m_orphans_mutex;
+    std::vector<retired> m_orphans;
+};
+
+class epoch_participant;
+
+// pins the epoch of a participant for its lifetime. Pointers loaded from
+// shared objects stay valid until the guard is destroyed. Guards may nest.
+class epoch_guard
+{
+  public:
+    explicit epoch_guard(epoch_participant& a_participant);
+    ~epoch_guard();
+
+    epoch_guard(const epoch_guard&) = delete;
+    epoch_guard& operator=(const epoch_guard&) = delete;
+
+  private:
+    epoch_participant& m_participant;
+};
+
+// one thread's membership in an epoch_domain. Each thread that reads or
+// retires shared objects needs its own; it must not be used by two threads
+// at once.
+class epoch_participant
+{
+  public:
+    static constexpr size_t RETIRE_THRESHOLD = 64;
+
+    explicit epoch_participant(epoch_domain& a_domain);
+    // hands any garbage that cannot be deleted yet to the domain.
+    ~epoch_participant();
+
+    epoch_participant(const epoch_participant&) = delete;
+    epoch_participant& operator=(const epoch_participant&) = delete;
+
+    // deletes a_object once no thread can still be reading it.
+    template <typename T> void retire(std::unique_ptr<T> a_object)
+    {
+        retire(a_object.release(),
+               [](void* a_pointer) { delete static_cast<T*>(a_pointer); });
+    }
+
+    void retire(void* a_object, void (*a_deleter)(void*));
+
+    // tries to advance the epoch, then deletes whatever of this
+    // participant's garbage has become safe to delete.
+    void collect();
+
+  private:
+    friend class epoch_guard;
+
+    void pin();
+    void unpin();
+
+    epoch_domain& m_domain;
+    epoch_domain::record* m_record;
+    // nesting depth of guards; only this participant's thread touches it
+    size_t m_pins = 0;
+    std::vector<epoch_domain::retired> m_garbage;
+};
+
+// a shared, immutable term that threads read under an epoch_guard and that
+// can be replaced at any time. The replaced term is retired, not deleted,
+// so readers that loaded it keep a valid pointer.
+class shared_term
+{
+  public:
+    explicit shared_term(std::unique_ptr<expr> a_term = nullptr);
+    // deletes the current term. No thread may still be reading it.
+    ~shared_term();
+
+    shared_term(const shared_term&) = delete;
+    shared_term& operator=(const shared_term&) = delete;
+
+    // the current term, valid while a_guard lives.
+    const expr* load(const epoch_guard& a_guard) const;
+
+    // publishes a_term and retires the term it replaces through
+    // a_participant.
+    void store(std::unique_ptr<expr> a_term, epoch_participant& a_participant);
+
+  private:
+    std::atomic<const expr*> m_term;
+};
+
+} // namespace lambda
+
+#endif
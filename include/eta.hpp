@@ -0,0 +1,42 @@
+#ifndef ETA_HPP
+#define ETA_HPP
+
+#include "lambda.hpp"
+#include <cstdint>
+
+namespace lambda
+{
+
+// ETA CANONICALIZATION
+// an eta-redex is an abstraction λ.(M x) whose body applies some M to the
+// variable x it binds, where M does not use x itself. It behaves as M does
+// on every argument, so it contracts to M, with the levels bound inside M
+// moved up one binder. Normal forms that differ only by such wrappers, e.g.
+// λ.(ADD 0) and ADD, are the same function, but equals(), structural_hash()
+// and every table built on them keep them apart. Eta-reducing a term before
+// using it as a key collapses them.
+//
+// Eta-reduction cannot create a beta-redex, so the eta-reduced form of a
+// beta-normal form is its beta-eta-normal form, which is the same for all
+// beta-eta-equivalent terms.
+
+// how terms are compared when used as keys.
+enum class equivalence : uint8_t
+{
+    // equal as written
+    syntactic = 0,
+    // equal once eta-reduced
+    eta = 1,
+};
+
+// contracts every eta-redex in a_expr, whose root is at depth a_depth,
+// including those left by contracting others, in one pass from the leaves
+// up. Returns the number of redexes contracted.
+size_t eta_reduce(std::unique_ptr<expr>& a_expr, size_t a_depth = 0);
+
+// a copy of a_expr, whose root is at depth a_depth, eta-reduced.
+std::unique_ptr<expr> eta_canonical(const expr& a_expr, size_t a_depth = 0);
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef FLAT_HPP
+#define FLAT_HPP
+
+#include "lambda.hpp"
+#include "normalize.hpp"
+#include "serialize.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace lambda
+{
+
+// LEVEL KERNELS
+
+// instruction sets the kernels can use.
+enum class simd_level
+{
+    scalar,
+    avx2,
+    // avx-512 foundation and byte/word instructions
+    avx512,
+};
+
+// the widest instruction set supported by the running cpu.
+simd_level best_simd_level();
+
+const char* to_string(simd_level a_level);
+
+// the kernels below work on packed arrays of variable levels. a_simd selects
+// the implementation; levels the cpu does not support fall back to the best
+// one it does. All implementations give identical results.
+
+// adds a_lift_amount to every level >= a_cutoff. The counterpart of
+// var::lift().
+void lift_levels(uint32_t* a_levels, size_t a_count, uint32_t a_lift_amount,
+                 uint32_t a_cutoff, simd_level a_simd = best_simd_level());
+
+// subtracts one from every level > a_var_index. The counterpart of the
+// decrement substitute() applies to variables bound inside a redex.
+void lower_levels(uint32_t* a_levels, size_t a_count, uint32_t a_var_index,
+                  simd_level a_simd = best_simd_level());
+
+// returns one more than the greatest level below a_limit, or 0 if there is
+// none. For a term whose root sits under a_limit binders, the result is the
+// number of enclosing binders the term actually refers to, so 0 means the
+// term is closed with respect to its context.
+uint32_t level_bound(const uint32_t* a_levels, size_t a_count,
+                     uint32_t a_limit = UINT32_MAX,
+                     simd_level a_simd = best_simd_level());
+
+// TAG KERNELS
+
+// returns the position of the first node_tag::app immediately followed by
+// node_tag::func, or a_count if there is none. In a pre-order tag array an
+// application's lhs directly follows it, so this is the leftmost-outermost
+// beta-redex.
+size_t find_redex(const node_tag* a_tags, size_t a_count,
+                  simd_level a_simd = best_simd_level());
+
+// returns the number of node_tag::func that enclose position a_position of
+// a pre-order tag array, i.e. the binding depth there relative to the root,
+// and sets a_vars to the number of node_tag::var before it.
+size_t enclosing_binders(const node_tag* a_tags, size_t a_position,
+                         size_t& a_vars, simd_level a_simd = best_simd_level());
+
+// BYTE KERNELS
+
+// hash of the bytes [a_bytes, a_bytes + a_count). Every implementation
+// gives the same value for the same bytes.
+uint64_t hash_bytes(const void* a_bytes, size_t a_count,
+                    simd_level a_simd = best_simd_level());
+
+// returns true if the two byte ranges hold the same bytes.
+bool bytes_equal(const void* a_lhs, const void* a_rhs, size_t a_count,
+                 simd_level a_simd = best_simd_level());
+
+// FLAT EXPRESSIONS
+
+// an expression stored as two arrays instead of a tree: the node_tag of
+// every node in pre-order, and the level of every var in the same order.
+// Keeping the levels packed turns whole-term level arithmetic into a single
+// scan that the kernels above vectorize.
+struct flat_expr
+{
+    // ACCESSOR METHODS
+    // number of nodes, the m_size of the equivalent tree
+    size_t size() const;
+    // checks if the expression is equal to another, comparing the arrays
+    // rather than walking a tree
+    bool equals(const flat_expr& a_other) const;
+
+    // MEMBER VARIABLES
+    std::vector<node_tag> m_tags;
+    std::vector<uint32_t> m_levels;
+};
+
+// converts a_expr to the flat layout. Throws std::runtime_error if a level
+// does not fit in 32 bits.
+flat_expr flatten(const expr& a_expr);
+
+// same as above, but replaces the contents of a_flat so that its storage can
+// be reused.
+void flatten(const expr& a_expr, flat_expr& a_flat);
+
+// converts a_flat back to a tree. Throws std::runtime_error if the arrays
+// do not describe exactly one expression.
+std::unique_ptr<expr> unflatten(const flat_expr& a_flat);
+
+// hash of a_flat computed over its arrays with hash_bytes(). Equal flat
+// expressions have equal hashes; the values differ from structural_hash().
+uint64_t flat_hash(const flat_expr& a_flat);
+
+// same effect as expr::lift() on the equivalent tree.
+void lift(flat_expr& a_flat, uint32_t a_lift_amount, uint32_t a_cutoff);
+
+// FLAT REDUCTION
+// the redex is located with find_redex() rather than by walking the tree.
+// Contracting it rewrites the arrays from the redex onwards, applying
+// lower_levels() to the body and lift_levels() to each copy of the argument.
+
+// where a beta-redex sits in a flat_expr. Everything here depends only on
+// the tags before the redex, so expressions whose tags agree up to and
+// including the redex share it.
+struct flat_redex
+{
+    // position of the app tag
+    size_t m_position;
+    // binding depth of the redex, i.e. the level of the variable it binds
+    uint32_t m_var_index;
+    // position in m_levels of the first var inside the redex
+    size_t m_level_begin;
+};
+
+// returns true if a_flat contains no beta-redex.
+bool is_normal(const flat_expr& a_flat);
+
+// locates the leftmost-outermost redex of a_flat, whose root is under
+// a_depth binders, into a_redex. Returns false if a_flat is normal. Throws
+// std::runtime_error if the binding depth of the redex does not fit in 32
+// bits.
+bool find_redex(const flat_expr& a_flat, size_t a_depth, flat_redex& a_redex);
+
+// beta-contracts the redex described by a_redex.
+void contract(flat_expr& a_flat, const flat_redex& a_redex);
+
+// same effect as reduce_one_step() on the equivalent tree: find_redex()
+// followed by contract().
+bool reduce_one_step(flat_expr& a_flat, size_t a_depth = 0);
+
+// same result and stats as normalize() with strategy::normal_order on the
+// equivalent tree.
+normalize_stats normalize(flat_expr& a_flat, const budget& a_budget = {},
+                          size_t a_depth = 0);
+
+} // namespace lambda
+
+#endif
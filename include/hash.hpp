@@ -0,0 +1,55 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include "lambda.hpp"
+#include <cstdint>
+
+namespace lambda
+{
+
+// seeds that keep the three node kinds apart.
+constexpr uint64_t VAR_SEED = 0x9ae16a3b2f90404full;
+constexpr uint64_t FUNC_SEED = 0xc3a5c85c97cb3127ull;
+constexpr uint64_t APP_SEED = 0xb492b66fbe98f273ull;
+
+// scrambles the bits of a_value (the splitmix64 finalizer).
+inline uint64_t hash_mix(uint64_t a_value)
+{
+    a_value ^= a_value >> 30;
+    a_value *= 0xbf58476d1ce4e5b9ull;
+    a_value ^= a_value >> 27;
+    a_value *= 0x94d049bb133111ebull;
+    a_value ^= a_value >> 31;
+    return a_value;
+}
+
+// folds a_value into a_seed. Order-sensitive.
+inline uint64_t hash_combine(uint64_t a_seed, uint64_t a_value)
+{
+    return hash_mix(a_seed + 0x9e3779b97f4a7c15ull + hash_mix(a_value));
+}
+
+// hashes of each node kind given the hashes of its children. Every way of
+// computing structural_hash() must build on these so the results agree.
+inline uint64_t var_hash(size_t a_index)
+{
+    return hash_combine(VAR_SEED, a_index);
+}
+
+inline uint64_t func_hash(uint64_t a_body_hash)
+{
+    return hash_combine(FUNC_SEED, a_body_hash);
+}
+
+inline uint64_t app_hash(uint64_t a_lhs_hash, uint64_t a_rhs_hash)
+{
+    return hash_combine(hash_combine(APP_SEED, a_lhs_hash), a_rhs_hash);
+}
+
+// hash of the structure of a_expr: expressions that are equal() have equal
+// hashes.
+uint64_t structural_hash(const expr& a_expr);
+
+} // namespace lambda
+
+#endif
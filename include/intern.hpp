@@ -0,0 +1,80 @@
+#ifndef INTERN_HPP
+#define INTERN_HPP
+
+#include "lambda.hpp"
+#include "serialize.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace lambda
+{
+
+// an immutable, maximally shared node. Within one intern_table every
+// distinct term exists once, so two interned terms are equal exactly when
+// their pointers are.
+struct interned
+{
+    node_tag m_tag;
+    // the level of a var
+    uint32_t m_index;
+    // the body of a func, or the lhs of an app
+    const interned* m_lhs;
+    // the rhs of an app
+    const interned* m_rhs;
+    // node count of the term as a tree, as expr::m_size
+    size_t m_size;
+    // structural_hash() of the term
+    uint64_t m_hash;
+};
+
+// a hash-cons table that any number of threads may intern into at once.
+//
+// The table is split into shards by hash. Looking up a term that is already
+// present takes no lock: each shard publishes an open-addressing array of
+// atomic slots, and nodes are fully built before they are published. Adding
+// a term locks only its shard. When a shard grows, the old slot array is
+// kept until the table is destroyed, since lookups may still be reading it.
+//
+// Nodes live as long as the table, so an interned pointer stays valid, and
+// may be shared between threads, until then.
+class intern_table
+{
+  public:
+    intern_table();
+    ~intern_table();
+
+    intern_table(const intern_table&) = delete;
+    intern_table& operator=(const intern_table&) = delete;
+
+    // the canonical node for each node kind, given canonical children from
+    // this table.
+    const interned* intern_var(size_t a_index);
+    const interned* intern_func(const interned* a_body);
+    const interned* intern_app(const interned* a_lhs, const interned* a_rhs);
+
+    // the canonical node for a_expr.
+    const interned* intern(const expr& a_expr);
+
+    // number of distinct nodes.
+    size_t size() const;
+
+  private:
+    static constexpr size_t SHARD_BITS = 6;
+    static constexpr size_t SHARD_COUNT = size_t(1) << SHARD_BITS;
+
+    struct slot_array;
+    struct shard;
+
+    const interned* find_or_insert(const interned& a_key);
+
+    std::unique_ptr<shard[]> m_shards;
+};
+
+// a tree equal to a_node. Shared subterms are copied once per occurrence,
+// so the result can be exponentially larger than the table.
+std::unique_ptr<expr> materialize(const interned* a_node);
+
+} // namespace lambda
+
+#endif
@@ -31,6 +31,12 @@ struct expr
     expr(const expr& other) = delete;
     expr& operator=(const expr& other) = delete;
 
+#ifndef LC_NO_NODE_POOL
+    // nodes come from per-thread pools (see node_pool.hpp)
+    static void* operator new(size_t a_bytes);
+    static void operator delete(void* a_pointer, size_t a_bytes);
+#endif
+
     // MEMBER VARIABLES
     size_t m_size;
 };
@@ -110,6 +116,23 @@ std::unique_ptr<expr> a(std::unique_ptr<expr>&& a_lhs,
 // operator for printing expressions to ostreams
 std::ostream& operator<<(std::ostream& a_ostream, const expr& a_expr);
 
+// CLONE OBSERVERS
+// a clone_observer installed on a thread is told of every node clone()
+// creates on that thread, together with the node it copies. Reduction only
+// creates nodes by cloning, so an observer can keep information about nodes
+// in a side table, keyed by node, and carry it through substitute() and
+// reduce_one_step() (see profile.hpp).
+struct clone_observer
+{
+    virtual ~clone_observer() = default;
+
+    virtual void cloned(const expr& a_original, const expr& a_copy) = 0;
+};
+
+// installs a_observer, or none if nullptr, on the calling thread. Returns
+// the observer installed before.
+clone_observer* observe_clones(clone_observer* a_observer);
+
 // REWRITING FUNCTIONS
 
 // replaces all occurrances of the variable with index a_var_index in
@@ -0,0 +1,74 @@
+#ifndef LIBRARY_HPP
+#define LIBRARY_HPP
+
+#include "normalize.hpp"
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace lambda
+{
+
+// a list of helpers for construct_program(), each reduced to normal form
+// once, ahead of the programs that use it.
+//
+// Helpers are written as construct_program() takes them: helper i sits
+// under i binders and refers to helper j < i as variable j. A helper that
+// is itself an application of earlier helpers (e.g. FOUR = (MULT TWO) TWO)
+// would be reduced again by every program built from it. add() instead
+// normalizes the helper against its predecessors, already normal
+// themselves, and stores the closed normal form, lifted back to depth i so
+// that helpers() can be passed to construct_program() in place of the
+// helpers as written. Programs then only substitute normal helpers.
+class helper_library
+{
+  public:
+    helper_library() = default;
+
+    // adds a_helper, written against the helpers already in the library,
+    // and normalizes it in normal order within a_budget. If the budget runs
+    // out (e.g. for a fixed-point combinator, which has no normal form),
+    // the helper is kept as written, which construct_program() still binds
+    // correctly. Returns the stats of the normalization.
+    const normalize_stats& add(const expr& a_helper,
+                               const budget& a_budget = {});
+
+    // number of helpers.
+    size_t size() const;
+
+    // the helpers, in order, as construct_program() takes them.
+    const std::vector<std::unique_ptr<expr>>& helpers() const;
+
+    // whether helper a_index was reduced to normal form.
+    bool is_normalized(size_t a_index) const;
+
+    // the normalization of helper a_index, as add() returned it. Its steps
+    // include the binding of the helpers before it.
+    const normalize_stats& stats(size_t a_index) const;
+
+    // construct_program() over the library's helpers.
+    std::unique_ptr<expr> program(const std::unique_ptr<expr>& a_main_fn) const;
+
+  private:
+    std::vector<std::unique_ptr<expr>> m_helpers;
+    std::vector<normalize_stats> m_stats;
+};
+
+// builds a library from helpers given as construct_program() takes them,
+// normalizing each within a_budget.
+template <typename IT>
+helper_library build_library(IT a_helpers_begin, IT a_helpers_end,
+                             const budget& a_budget = {})
+{
+    helper_library l_library;
+
+    for(IT l_it = a_helpers_begin; l_it != a_helpers_end;
+        l_it = std::next(l_it))
+        l_library.add(**l_it, a_budget);
+
+    return l_library;
+}
+
+} // namespace lambda
+
+#endif
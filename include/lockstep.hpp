@@ -0,0 +1,46 @@
+#ifndef LOCKSTEP_HPP
+#define LOCKSTEP_HPP
+
+#include "flat.hpp"
+#include "normalize.hpp"
+#include <vector>
+
+namespace lambda
+{
+
+// how the steps of a lockstep normalization were found.
+struct lockstep_stats
+{
+    // rounds, each contracting one redex in every unfinished term
+    size_t m_rounds = 0;
+    // steps that reused the redex located in the leading term
+    size_t m_shared_steps = 0;
+    // steps whose term had diverged from the leader and located its own
+    size_t m_divergent_steps = 0;
+};
+
+// a_program applied to each of a_inputs, flattened: one term per input,
+// ready for normalize_lockstep().
+std::vector<flat_expr>
+apply_each(const expr& a_program,
+           const std::vector<std::unique_ptr<expr>>& a_inputs);
+
+// normalizes every term of a_terms in normal order, stepping them together.
+// Each round, the redex of the first unfinished term (the leader) is
+// located once. Every other term whose tags match the leader's up to and
+// including that redex has the same redex, so it only needs a vectorized
+// comparison instead of its own search; the rest fall back to locating
+// their own. Terms that evaluate the same program on different inputs
+// typically agree until the inputs themselves are reached.
+//
+// Results and a_stats (one per term) are those normalize() would produce
+// for each term alone, except that time is measured for the batch as a
+// whole: the time limit applies to every term from the start of the batch.
+lockstep_stats normalize_lockstep(std::vector<flat_expr>& a_terms,
+                                  std::vector<normalize_stats>& a_stats,
+                                  const budget& a_budget = {},
+                                  size_t a_depth = 0);
+
+} // namespace lambda
+
+#endif
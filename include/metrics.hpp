@@ -0,0 +1,112 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "normalize.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace lambda
+{
+
+// LATENCY HISTOGRAMS
+
+// a histogram of durations in nanoseconds with HDR-style log-linear
+// buckets: every power of two is split into SUB_BUCKETS equal buckets, so a
+// value is known to within 1 / SUB_BUCKETS of itself, from 1ns to 2^64ns,
+// in a fixed BUCKET_COUNT counters.
+class latency_histogram
+{
+  public:
+    static constexpr size_t SUB_BUCKET_BITS = 5;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT =
+        (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    // the bucket holding a_value.
+    static size_t bucket_of(uint64_t a_value);
+    // the smallest value in a_bucket.
+    static uint64_t bucket_lower_bound(size_t a_bucket);
+
+    void record(uint64_t a_value, uint64_t a_count = 1);
+    // adds the counts of a_other.
+    void merge(const latency_histogram& a_other);
+
+    // a value that at least a_quantile of the recorded values do not
+    // exceed, to the precision of the buckets. 0 if empty.
+    uint64_t quantile(double a_quantile) const;
+
+    uint64_t count() const;
+    // the sum of the recorded values
+    uint64_t sum() const;
+    uint64_t bucket_count(size_t a_bucket) const;
+
+  private:
+    std::array<uint64_t, BUCKET_COUNT> m_buckets{};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+};
+
+// LIBRARY METRICS
+// normalize() (on trees and flat expressions alike), term_corpus and
+// intern_table record into per-thread counters and histograms. A thread
+// only writes its own, without locking or atomic read-modify-writes;
+// scrape_metrics() sums every thread's into one snapshot. The values are
+// cumulative from process start, as Prometheus expects of counters; the
+// counts of threads that exited are kept.
+
+struct metrics_snapshot
+{
+    // normalizations finished
+    uint64_t m_normalizations = 0;
+    // of those, stopped by a limit of their budget
+    uint64_t m_budget_aborts = 0;
+    // beta-reductions performed by normalizations
+    uint64_t m_steps = 0;
+    // expression nodes allocated from the node pools (0 when built with
+    // LC_NO_NODE_POOL)
+    uint64_t m_nodes_allocated = 0;
+    // lookups of a term in a term_corpus or of a node in an intern_table
+    uint64_t m_cache_lookups = 0;
+    // of those, found already present
+    uint64_t m_cache_hits = 0;
+    // wall-clock time of whole normalizations
+    latency_histogram m_normalize_latency;
+    // time per step of each normalization that took any, i.e. its time
+    // divided by its steps
+    latency_histogram m_step_latency;
+};
+
+// counts a finished normalization on the calling thread.
+void record_normalization(const normalize_stats& a_stats);
+
+// counts a_lookups cache lookups, of which a_hits hit, on the calling
+// thread.
+void record_cache_lookups(uint64_t a_lookups, uint64_t a_hits);
+
+// the metrics of every thread, summed.
+metrics_snapshot scrape_metrics();
+
+// EXPORT
+// metrics in the Prometheus text exposition format: counters as
+// lc_<name>_total, latencies as histograms in seconds, with one bucket per
+// power of two of nanoseconds from 1us up to the largest value recorded.
+
+void write_prometheus(std::ostream& a_ostream,
+                      const metrics_snapshot& a_snapshot);
+
+// scrapes and writes the metrics to a_path, through a temporary file that
+// replaces it, so that readers never see a partial file (as the textfile
+// collector of node_exporter requires). Throws std::runtime_error if the
+// file cannot be written.
+void export_metrics(const std::string& a_path);
+
+// scrapes the metrics and passes their text to a_sink.
+void export_metrics(const std::function<void(std::string_view)>& a_sink);
+
+} // namespace lambda
+
+#endif
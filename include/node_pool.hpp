@@ -0,0 +1,59 @@
+#ifndef NODE_POOL_HPP
+#define NODE_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lambda
+{
+
+// per-thread pools of fixed-size blocks that expression nodes are allocated
+// from, unless LC_NO_NODE_POOL is defined (for the library and everything
+// including lambda.hpp alike).
+//
+// A thread allocates from its own pool without synchronization. Freeing a
+// block on the thread that owns its pool is equally local. Freeing it on
+// any other thread, as when one thread builds terms and another normalizes
+// and destroys them, queues the block on a short per-thread batch that is
+// pushed onto the owning pool's lock-free remote-free list with a single
+// exchange. The owner takes the whole remote list back once its local free
+// list runs dry.
+//
+// When a thread exits, its pool is parked with any blocks still in use and
+// handed to the next thread that needs one. Pools are never destroyed,
+// since blocks may outlive every thread that touched them.
+
+// largest allocation a pool serves; larger ones go to the global allocator.
+constexpr size_t NODE_POOL_BLOCK_SIZE = 32;
+
+// a_bytes from the calling thread's pool.
+void* node_pool_allocate(size_t a_bytes);
+
+// returns a block from node_pool_allocate(a_bytes) to its pool. May be
+// called from any thread.
+void node_pool_free(void* a_pointer, size_t a_bytes);
+
+// pushes the calling thread's batch of frees to the pools they belong to.
+// Happens by itself when the batch fills, when it would mix pools, and when
+// the thread exits.
+void node_pool_flush();
+
+// counts for the calling thread's pool.
+struct node_pool_stats
+{
+    // chunks the pool has taken from the global allocator
+    size_t m_chunks = 0;
+    // blocks freed back by their owner
+    size_t m_local_frees = 0;
+    // blocks other threads freed that the owner has taken back
+    size_t m_reclaimed_remote_frees = 0;
+};
+
+node_pool_stats node_pool_thread_stats();
+
+// blocks allocated from every pool since the program started.
+uint64_t node_pool_allocations();
+
+} // namespace lambda
+
+#endif
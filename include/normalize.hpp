@@ -0,0 +1,80 @@
+#ifndef NORMALIZE_HPP
+#define NORMALIZE_HPP
+
+#include "lambda.hpp"
+#include <chrono>
+#include <cstdint>
+
+namespace lambda
+{
+
+// limits on the work a single normalization may perform. The defaults are
+// unlimited.
+struct budget
+{
+    // maximum number of beta-reductions
+    size_t m_max_steps = SIZE_MAX;
+    // reduction stops once the expression grows beyond this size
+    size_t m_max_size = SIZE_MAX;
+    // maximum wall-clock time spent reducing
+    std::chrono::nanoseconds m_max_time = std::chrono::nanoseconds::max();
+};
+
+// order in which redexes are contracted.
+enum class strategy : uint8_t
+{
+    // leftmost-outermost first, as reduce_one_step(). Finds the normal form
+    // whenever one exists.
+    normal_order = 0,
+    // leftmost-innermost first: both sides of an application are normalized
+    // before it is contracted. May diverge on terms that have a normal form.
+    applicative_order = 1,
+    // normal order, except that an argument that is needed and used more
+    // than once is normalized before it is substituted, as
+    // reduce_one_step_strict(). Finds the same normal forms as normal order.
+    strict_arguments = 2,
+};
+
+// why a normalization stopped.
+enum class normalize_status : uint8_t
+{
+    normal_form = 0,
+    step_limit = 1,
+    size_limit = 2,
+    time_limit = 3,
+};
+
+// the outcome of a normalization.
+struct normalize_stats
+{
+    normalize_status m_status = normalize_status::normal_form;
+    // number of beta-reductions performed
+    size_t m_steps = 0;
+    // largest size the expression reached, including its initial size
+    size_t m_max_size = 0;
+    // wall-clock time spent reducing
+    std::chrono::nanoseconds m_elapsed{0};
+};
+
+// returns true if a_expr contains no beta-redex.
+bool is_normal(const expr& a_expr);
+
+// attempts to find and reduce the leftmost-innermost redex in a_expr.
+// returns true if a reduction was found and performed, false otherwise.
+bool reduce_one_step_applicative(std::unique_ptr<expr>& a_expr,
+                                 size_t a_depth = 0);
+
+// reduces a_expr in place, one step at a time in the order given by
+// a_strategy, until it reaches beta-normal form or a_budget is exhausted,
+// whichever comes first. a_depth is the binding depth of a_expr.
+normalize_stats normalize(std::unique_ptr<expr>& a_expr,
+                          const budget& a_budget = {},
+                          strategy a_strategy = strategy::normal_order,
+                          size_t a_depth = 0);
+
+// returns a printable name for a_status, e.g. "step_limit".
+const char* to_string(normalize_status a_status);
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include "lambda.hpp"
+#include "normalize.hpp"
+#include "work_stealing_pool.hpp"
+#include <cstdint>
+
+namespace lambda
+{
+
+// subtrees smaller than this many nodes are processed sequentially. At
+// roughly 10ns per node this keeps every task well above the cost of a
+// fork.
+constexpr size_t PARALLEL_GRAIN = 1 << 15;
+
+// parallel counterparts of the recursive expr operations. Each splits the
+// work at application nodes whose cached m_size is at least a_grain, runs
+// the two sides through a_pool.fork_join(), and falls back to the
+// sequential operation below a_grain. Expressions smaller than a_grain
+// never touch the pool.
+
+// same result as a_expr.clone().
+std::unique_ptr<expr> parallel_clone(const expr& a_expr,
+                                     work_stealing_pool& a_pool,
+                                     size_t a_grain = PARALLEL_GRAIN);
+
+// same result as a_lhs->equals(a_rhs). Subtrees of different m_size are
+// rejected without being visited, and a mismatch found by one task stops
+// the others early.
+bool parallel_equals(const std::unique_ptr<expr>& a_lhs,
+                     const std::unique_ptr<expr>& a_rhs,
+                     work_stealing_pool& a_pool,
+                     size_t a_grain = PARALLEL_GRAIN);
+
+// same result as structural_hash(a_expr).
+uint64_t parallel_hash(const expr& a_expr, work_stealing_pool& a_pool,
+                       size_t a_grain = PARALLEL_GRAIN);
+
+// same effect as a_expr.lift(a_lift_amount, a_cutoff).
+void parallel_lift(expr& a_expr, size_t a_lift_amount, size_t a_cutoff,
+                   work_stealing_pool& a_pool,
+                   size_t a_grain = PARALLEL_GRAIN);
+
+// spine arguments smaller than this many nodes, taken together, are
+// normalized one after another on the calling task instead of being forked.
+constexpr size_t PARALLEL_NORMALIZE_GRAIN = 64;
+
+// how parallel_normalize() reconciles parallel work with its budget.
+enum class parallel_mode : uint8_t
+{
+    // the result and stats (apart from m_elapsed) are exactly those of
+    // normalize() in normal order, whatever the number of threads and the
+    // order tasks run in. Tasks run with generous limits; their results are
+    // then accepted in the order normal order would have produced them, and
+    // the first one that a limit would have cut short is redone with the
+    // exact limits. Under a finite step or size limit this costs a copy of
+    // every forked argument.
+    deterministic = 0,
+    // tasks draw steps from one shared allowance and stop as soon as it or
+    // the size limit runs out. No copies and no redone work, but once a
+    // limit is reached the result and stats depend on scheduling.
+    fast = 1,
+};
+
+// normalizes a_expr in normal order using a_pool. Once the head of a_expr
+// is a variable, nothing outside its arguments can change any more, so the
+// arguments are normalized as independent tasks, recursively.
+//
+// A time limit is checked by every task; a run that reaches it is not
+// reproducible in either mode.
+normalize_stats parallel_normalize(std::unique_ptr<expr>& a_expr,
+                                   work_stealing_pool& a_pool,
+                                   const budget& a_budget = {},
+                                   parallel_mode a_mode =
+                                       parallel_mode::deterministic,
+                                   size_t a_grain = PARALLEL_NORMALIZE_GRAIN,
+                                   size_t a_depth = 0);
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include "normalize.hpp"
+#include "serialize.hpp"
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace lambda
+{
+
+struct pipeline_options
+{
+    // normalizer threads
+    size_t m_workers = 1;
+    // capacity of each of the two queues between stages
+    size_t m_queue_capacity = 1024;
+    // the parser stays fewer than this many terms ahead of the writer, which
+    // bounds the terms held back behind a slow one
+    size_t m_reorder_window = 4096;
+    term_format m_input = term_format::text;
+    term_format m_output = term_format::text;
+    // applied to every term. Input in the shared format is not expanded
+    // beyond its size limit: a term that would be is skipped and reported as
+    // unreadable
+    budget m_budget;
+    strategy m_strategy = strategy::normal_order;
+};
+
+// one term on its way through the pipeline.
+struct pipeline_item
+{
+    // position of the term in the input, starting at 0
+    size_t m_sequence = 0;
+    // null if the term could not be parsed
+    std::unique_ptr<expr> m_expr;
+    // why the term could not be parsed
+    std::string m_error;
+    normalize_stats m_stats;
+};
+
+// totals over a whole run.
+struct pipeline_stats
+{
+    size_t m_terms = 0;
+    // terms that could not be parsed
+    size_t m_errors = 0;
+    size_t m_steps = 0;
+    std::chrono::nanoseconds m_elapsed{0};
+};
+
+// streams terms from a_in to a_out through three stages connected by
+// bounded lock-free queues:
+//
+//   parser thread → a_options.m_workers normalizer threads → writer
+//
+// A stage with nothing to do spins briefly, then sleeps until another stage
+// makes progress. The writer runs on the calling thread, restores input
+// order and calls a_on_written (if set) for every item after writing it.
+// Blank text input lines are skipped and lines that fail to parse are
+// written as empty lines, so text output stays aligned with the non-blank
+// input lines, and so do shared terms too large to expand. A malformed
+// binary stream stops the parser; the terms read before it are still
+// written, then std::runtime_error is thrown. An
+// exception in a normalizer, such as std::bad_alloc, stops every stage and
+// is rethrown once they have all finished.
+pipeline_stats
+run_pipeline(std::istream& a_in, std::ostream& a_out,
+             const pipeline_options& a_options,
+             const std::function<void(const pipeline_item&)>& a_on_written = {});
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef PROBES_HPP
+#define PROBES_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// static tracepoints in the reduction hot path, for tracing live processes
+// with bpftrace, perf or SystemTap without recompiling.
+//
+// Each probe is a single nop plus a SystemTap SDT note in the
+// .note.stapsdt section describing it, the same layout sys/sdt.h emits
+// (which this header does not need). Tracers find the note, place a
+// breakpoint on the nop while attached and read the arguments from where
+// the note says they are; untraced, the nop is all that runs. All
+// arguments are unsigned 64-bit integers.
+//
+// The provider is "lc". Probes:
+//   beta(depth, argument size)          reduce_one_step() contracts a redex
+//   clone_arg(argument size, lift)      substitute() copies the argument
+//   lift(size, lift amount, cutoff)     substitute() lifts the copy
+//   node_alloc(bytes)                   a node is allocated
+//   node_free(bytes)                    a node is freed
+//   budget_exceeded(status, steps, size)
+//                                       normalize() stops at a limit
+//
+// Defining LC_NO_PROBES, or building for a platform other than Linux on
+// x86-64 or aarch64, compiles the probes out entirely.
+
+#if !defined(LC_NO_PROBES) && defined(__GNUC__) && defined(__linux__) &&   \
+    (defined(__x86_64__) || defined(__aarch64__))
+#define LC_PROBES_ENABLED 1
+#else
+#define LC_PROBES_ENABLED 0
+#endif
+
+#if LC_PROBES_ENABLED
+
+// the nop and its note: location, base, semaphore (none), provider, name
+// and argument descriptions. _.stapsdt.base lets tracers account for the
+// load address, as with sys/sdt.h.
+#define LC_PROBE_ASM(a_name, a_arguments)                                  \
+    "990: nop\n"                                                           \
+    ".pushsection .note.stapsdt,\"\",\"note\"\n"                           \
+    ".balign 4\n"                                                          \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                     \
+    "991: .asciz \"stapsdt\"\n"                                            \
+    "992: .balign 4\n"                                                     \
+    "993: .8byte 990b\n"                                                   \
+    ".8byte _.stapsdt.base\n"                                              \
+    ".8byte 0\n"                                                           \
+    ".asciz \"lc\"\n"                                                      \
+    ".asciz \"" #a_name "\"\n"                                             \
+    ".asciz \"" a_arguments "\"\n"                                         \
+    "994: .balign 4\n"                                                     \
+    ".popsection\n"                                                        \
+    ".ifndef _.stapsdt.base\n"                                             \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n"                                               \
+    ".hidden _.stapsdt.base\n"                                             \
+    "_.stapsdt.base: .space 1\n"                                           \
+    ".size _.stapsdt.base, 1\n"                                            \
+    ".popsection\n"                                                        \
+    ".endif\n"
+
+#define LC_PROBE1(a_name, a_1)                                             \
+    __asm__ __volatile__(LC_PROBE_ASM(a_name, "8@%0")                      \
+                         :                                                 \
+                         : "nor"(static_cast<uint64_t>(a_1)))
+
+#define LC_PROBE2(a_name, a_1, a_2)                                        \
+    __asm__ __volatile__(LC_PROBE_ASM(a_name, "8@%0 8@%1")                 \
+                         :                                                 \
+                         : "nor"(static_cast<uint64_t>(a_1)),              \
+                           "nor"(static_cast<uint64_t>(a_2)))
+
+#define LC_PROBE3(a_name, a_1, a_2, a_3)                                   \
+    __asm__ __volatile__(LC_PROBE_ASM(a_name, "8@%0 8@%1 8@%2")            \
+                         :                                                 \
+                         : "nor"(static_cast<uint64_t>(a_1)),              \
+                           "nor"(static_cast<uint64_t>(a_2)),              \
+                           "nor"(static_cast<uint64_t>(a_3)))
+
+#else
+
+#define LC_PROBE1(a_name, a_1) ((void)0)
+#define LC_PROBE2(a_name, a_1, a_2) ((void)0)
+#define LC_PROBE3(a_name, a_1, a_2, a_3) ((void)0)
+
+#endif
+
+namespace lambda
+{
+
+// a probe as described by its SDT note.
+struct probe_site
+{
+    std::string m_provider;
+    std::string m_name;
+    // where the tracer finds each argument, e.g. "8@%rdi 8@%rsi"
+    std::string m_arguments;
+    // address of the nop, before relocation
+    uint64_t m_address;
+};
+
+// the SDT probes in the 64-bit ELF file at a_path, e.g. "/proc/self/exe"
+// for the running program, in the order of their notes. Throws
+// std::runtime_error if the file cannot be read or is not 64-bit ELF.
+std::vector<probe_site> read_probe_sites(const std::string& a_path);
+
+} // namespace lambda
+
+#endif
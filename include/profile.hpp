@@ -0,0 +1,166 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include "normalize.hpp"
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lambda
+{
+
+// PER-HELPER ATTRIBUTION
+// once a program built by construct_program() has taken its binding steps,
+// its helpers are just copies of their nodes spread through the main
+// function, and nothing tells which helper a redex came from.
+// profile_program() builds the program with every node tagged, in a side
+// table, with the helper it originates from, and normalizes it with
+// reduce_one_step() itself. A clone_observer (see lambda.hpp) tags every
+// clone the reduction makes, so a node copied into a substitution belongs
+// to the helper it was copied from, however many substitutions ago. Each
+// beta step is charged to the helper whose abstraction it contracts, along
+// with the nodes it copies and the time it takes; the binding step of a
+// helper is charged to that helper.
+
+// the cost of the reductions charged to one helper.
+struct helper_profile
+{
+    // beta-reductions that contracted one of the helper's abstractions
+    size_t m_steps = 0;
+    // nodes those reductions copied into substitutions
+    size_t m_copied_nodes = 0;
+    // wall-clock time spent in those reductions, locating the redex
+    // included
+    std::chrono::nanoseconds m_elapsed{0};
+};
+
+// the outcome of profile_program().
+struct program_profile
+{
+    // one entry per helper, in the order they were given
+    std::vector<helper_profile> m_helpers;
+    // reductions of abstractions written in the main function itself
+    helper_profile m_main;
+    // as normalize() would report them for the same program, except that
+    // the time includes the bookkeeping of attribution
+    normalize_stats m_stats;
+};
+
+// normalizes construct_program(a_helpers, a_main_fn) in normal order within
+// a_budget into a_result, attributing every step to a helper. a_result and
+// the steps taken are those of normalize().
+program_profile profile_program(const std::vector<const expr*>& a_helpers,
+                                const expr& a_main_fn,
+                                std::unique_ptr<expr>& a_result,
+                                const budget& a_budget = {});
+
+// same as above, for helpers given as construct_program() takes them.
+template <typename IT>
+program_profile profile_program(IT a_helpers_begin, IT a_helpers_end,
+                                const std::unique_ptr<expr>& a_main_fn,
+                                std::unique_ptr<expr>& a_result,
+                                const budget& a_budget = {})
+{
+    std::vector<const expr*> l_helpers;
+
+    for(IT l_it = a_helpers_begin; l_it != a_helpers_end;
+        l_it = std::next(l_it))
+        l_helpers.push_back((*l_it).get());
+
+    return profile_program(l_helpers, *a_main_fn, a_result, a_budget);
+}
+
+// writes one line per helper that took any step, most expensive first:
+// its index (or "main"), steps, copied nodes and time.
+void print_profile(std::ostream& a_ostream, const program_profile& a_profile);
+
+// FLAME GRAPHS
+// flame_program() and flame_normalize() charge reduction work to the stack
+// of frames that leads from the root of the term to each redex, and
+// write_folded() emits the result in the folded-stack format of standard
+// flame-graph tools ("frame;frame;frame weight", one line per stack).
+
+// what the frames of a stack are.
+enum class flame_frames : uint8_t
+{
+    // the way from the root to the redex: "λ" for every abstraction
+    // entered, "arg" for every application whose argument is entered (the
+    // function side of an application adds no frame), then "redex".
+    path = 0,
+    // the helpers the nodes on the way belong to, as "h0", "h1", ... or
+    // "main", with repeats merged, then the helper whose abstraction the
+    // redex contracts. Only meaningful for flame_program().
+    helper = 1,
+};
+
+// the weight write_folded() gives a stack.
+enum class flame_weight : uint8_t
+{
+    steps = 0,
+    copied_nodes = 1,
+    // in nanoseconds
+    time = 2,
+};
+
+struct flame_options
+{
+    flame_frames m_frames = flame_frames::path;
+    // only every m_sample_period-th step is timed and charged to its stack,
+    // standing for the steps in between. Recording the way to the redex,
+    // naming its frames and reading the clock are what make a step
+    // expensive, so sampling keeps long reductions close to full speed.
+    size_t m_sample_period = 1;
+};
+
+// the work charged to every stack, scaled up by the sample period, so that
+// the totals estimate those of the whole reduction.
+struct flame_graph
+{
+    // cost per stack, keyed by its frames joined with ';'
+    std::map<std::string, helper_profile> m_stacks;
+    // as normalize() reports them for the whole reduction
+    normalize_stats m_stats;
+};
+
+// normalizes a_expr in normal order within a_budget, as normalize() would,
+// charging the work to stacks as a_options says.
+flame_graph flame_normalize(std::unique_ptr<expr>& a_expr,
+                            const flame_options& a_options = {},
+                            const budget& a_budget = {});
+
+// normalizes construct_program(a_helpers, a_main_fn) in normal order within
+// a_budget into a_result, charging the work to stacks as a_options says.
+flame_graph flame_program(const std::vector<const expr*>& a_helpers,
+                          const expr& a_main_fn,
+                          std::unique_ptr<expr>& a_result,
+                          const flame_options& a_options = {},
+                          const budget& a_budget = {});
+
+// same as above, for helpers given as construct_program() takes them.
+template <typename IT>
+flame_graph flame_program(IT a_helpers_begin, IT a_helpers_end,
+                          const std::unique_ptr<expr>& a_main_fn,
+                          std::unique_ptr<expr>& a_result,
+                          const flame_options& a_options = {},
+                          const budget& a_budget = {})
+{
+    std::vector<const expr*> l_helpers;
+
+    for(IT l_it = a_helpers_begin; l_it != a_helpers_end;
+        l_it = std::next(l_it))
+        l_helpers.push_back((*l_it).get());
+
+    return flame_program(l_helpers, *a_main_fn, a_result, a_options,
+                         a_budget);
+}
+
+// writes one folded line per stack of a_graph with a nonzero a_weight.
+void write_folded(std::ostream& a_ostream, const flame_graph& a_graph,
+                  flame_weight a_weight = flame_weight::steps);
+
+} // namespace lambda
+
+#endif
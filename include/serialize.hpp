@@ -0,0 +1,161 @@
+#ifndef SERIALIZE_HPP
+#define SERIALIZE_HPP
+
+#include "lambda.hpp"
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+
+namespace lambda
+{
+
+struct interned;
+class intern_table;
+
+// the interchangeable encodings of an expression.
+enum class term_format : uint8_t
+{
+    // the syntax produced by print()
+    text = 0,
+    // the encoding produced by encode()
+    binary = 1,
+    // the encoding produced by encode_shared()
+    shared = 2,
+};
+
+// TEXT FORMAT
+
+// parses a single expression written in the syntax produced by print(),
+// e.g. "λ.((0 1))". A backslash is accepted in place of "λ". Leading and
+// trailing whitespace is ignored. Throws std::runtime_error on malformed
+// input.
+std::unique_ptr<expr> parse(std::string_view a_text);
+
+// parses one expression starting at a_pos, advancing a_pos past it.
+// Allows several expressions to be read from the same buffer.
+std::unique_ptr<expr> parse(std::string_view a_text, size_t& a_pos);
+
+// BINARY FORMAT
+
+// tags that prefix every node of the binary pre-order encoding.
+enum class node_tag : uint8_t
+{
+    var = 0,
+    func = 1,
+    app = 2,
+};
+
+// appends the binary pre-order encoding of a_expr to a_out. Every node is a
+// node_tag byte; var tags are followed by the level as an LEB128 varint.
+void encode(const expr& a_expr, std::string& a_out);
+
+// decodes one expression starting at a_pos, advancing a_pos past it.
+// Throws std::runtime_error on truncated or malformed input.
+std::unique_ptr<expr> decode(std::string_view a_bytes, size_t& a_pos);
+
+// SHARED BINARY FORMAT
+// the binary encoding with every repeated subterm written once. A subterm
+// that occurs more than once is prefixed with a share tag where it first
+// appears, which numbers it (from 0, in order of appearance), and every
+// later occurrence is a ref tag followed by its number as a varint. The
+// repeats are found by hash-consing the term, so a normal form with huge
+// repeated subtrees is written in the size of its distinct subterms. Plain
+// encode() output is valid input, with nothing shared.
+
+// tags of the shared encoding. var, func and app are as in node_tag.
+enum class shared_tag : uint8_t
+{
+    var = 0,
+    func = 1,
+    app = 2,
+    // a varint follows: the number of an earlier shared subterm
+    ref = 3,
+    // the node that follows is numbered for later refs
+    share = 4,
+};
+
+// appends the shared encoding of a_expr to a_out.
+void encode_shared(const expr& a_expr, std::string& a_out);
+
+// the same for a term already interned, which is encoded without being
+// expanded into a tree.
+void encode_shared(const interned* a_root, std::string& a_out);
+
+// decodes one expression in the shared encoding starting at a_pos,
+// advancing a_pos past it, into a full tree: each ref is a copy. Throws
+// std::runtime_error on truncated or malformed input, or if the tree would
+// exceed a_max_size nodes, which a few bytes of shared encoding can.
+std::unique_ptr<expr> decode_shared(std::string_view a_bytes, size_t& a_pos,
+                                    size_t a_max_size = SIZE_MAX);
+
+// the same, into a_table, keeping what the encoding shares shared.
+const interned* decode_shared(std::string_view a_bytes, size_t& a_pos,
+                              intern_table& a_table);
+
+// the size of the tree the shared encoding starting at a_pos decodes to,
+// saturating at SIZE_MAX, found without building it. Advances a_pos past
+// the encoding; throws as decode_shared() does on bad input.
+size_t shared_size(std::string_view a_bytes, size_t& a_pos);
+
+// STREAMS
+
+// reads successive expressions from a stream: one per non-blank line in the
+// text format, or back to back in the binary formats. The binary formats
+// have no separators, so they are decoded from a buffer that is refilled
+// from the stream whenever a term runs past its end. The buffer holds
+// little more than the largest term, and the first terms are returned
+// before the rest of the stream has arrived.
+class term_reader
+{
+  public:
+    // terms in the shared format are not expanded beyond a_max_size nodes.
+    term_reader(std::istream& a_in, term_format a_format,
+                size_t a_max_size = SIZE_MAX);
+
+    // reads the next expression into a_expr; returns false at end of input.
+    // Throws std::runtime_error on malformed input, or on a shared term that
+    // would exceed the size limit. Offsets in error messages are relative to
+    // the buffer.
+    bool next(std::unique_ptr<expr>& a_expr);
+
+    // whether reading may continue after the error next() last threw: a
+    // malformed text line is consumed, and so is a shared term that is well
+    // formed but too large. A malformed binary stream cannot be
+    // resynchronized.
+    bool resumable() const;
+
+  private:
+    // calls a_decode(buffer, position) to decode the term at m_pos, reading
+    // more of the stream and starting over while the term runs past the
+    // bytes read so far.
+    template <typename DECODE> auto decode_buffered(DECODE&& a_decode);
+
+    // drops the bytes before m_pos and appends more of the stream, at least
+    // as many as are left, so a large term is retried only a logarithmic
+    // number of times. Returns false at end of stream.
+    bool fill();
+
+    std::istream& m_in;
+    term_format m_format;
+    size_t m_max_size;
+    // the unread part of the stream starts at m_pos
+    std::string m_bytes;
+    size_t m_pos;
+    bool m_resumable;
+};
+
+// appends a_expr to a_out in a_format. Text is terminated by a newline.
+void write_term(const expr& a_expr, term_format a_format, std::string& a_out);
+
+// VARINT HELPERS
+
+// appends a_value to a_out as an LEB128 varint.
+void put_varint(std::string& a_out, uint64_t a_value);
+
+// reads an LEB128 varint starting at a_pos, advancing a_pos past it.
+uint64_t get_varint(std::string_view a_bytes, size_t& a_pos);
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "normalize.hpp"
+#include "serialize.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lambda
+{
+
+// PROTOCOL
+//
+// Requests and responses travel over a Unix domain stream socket as frames:
+// a little-endian u32 payload length followed by the payload. All integers
+// in a payload are little-endian u64 unless stated otherwise.
+//
+//   request:  id | format (u8) | max_steps | max_size | max_time_ns | term
+//   response: id | status (u8) | steps | max_size | size | elapsed_ns | term
+//
+// The term runs to the end of the payload, in the request's term_format. A
+// client may send any number of requests without waiting (pipelining);
+// responses are sent as soon as they are ready and may arrive out of order,
+// so they are matched to requests by id.
+
+// outcome of a request. The first values mirror normalize_status.
+enum class response_status : uint8_t
+{
+    normal_form = 0,
+    step_limit = 1,
+    size_limit = 2,
+    time_limit = 3,
+    // the term could not be parsed; the response term holds the error
+    bad_request = 4,
+};
+
+struct request
+{
+    uint64_t m_id = 0;
+    term_format m_format = term_format::text;
+    budget m_budget;
+    std::string m_term;
+};
+
+struct response
+{
+    uint64_t m_id = 0;
+    response_status m_status = response_status::normal_form;
+    size_t m_steps = 0;
+    size_t m_max_size = 0;
+    // size of the returned term
+    size_t m_size = 0;
+    std::chrono::nanoseconds m_elapsed{0};
+    std::string m_term;
+};
+
+// largest payload either side accepts.
+constexpr size_t MAX_FRAME_SIZE = 1u << 30;
+
+// appends a_request / a_response to a_out as a frame. Throws
+// std::runtime_error, leaving a_out as it was, if the payload is larger
+// than MAX_FRAME_SIZE, or a_max_payload for a response.
+void encode_frame(const request& a_request, std::string& a_out);
+void encode_frame(const response& a_response, std::string& a_out,
+                  size_t a_max_payload = MAX_FRAME_SIZE);
+
+// decodes the frame starting at a_pos if it is complete, advancing a_pos
+// past it. Returns false, leaving a_pos untouched, if more bytes are needed.
+// Throws std::runtime_error on malformed frames.
+bool decode_frame(std::string_view a_bytes, size_t& a_pos,
+                  request& a_request);
+bool decode_frame(std::string_view a_bytes, size_t& a_pos,
+                  response& a_response);
+
+// the most a server lets any one request use unless it is given other
+// limits: 10^8 steps, 2^26 nodes and one minute.
+constexpr budget DEFAULT_SERVER_BUDGET = {100000000, size_t(1) << 26,
+                                          std::chrono::seconds(60)};
+
+// each limit of a_budget, lowered to the one in a_limit where that is
+// smaller.
+budget clamp_budget(const budget& a_budget, const budget& a_limit);
+
+// parses, normalizes and re-encodes the term of a_request, within its
+// budget clamped to a_limit. A term in the shared format that would expand
+// beyond the clamped size limit is a bad request.
+response evaluate(const request& a_request, const budget& a_limit = {});
+
+// the frame answering a_request: evaluate()'s response, encoded with a
+// payload of at most a_max_payload bytes. Anything that fails on the way,
+// such as a result too large for a frame or running out of memory, is
+// answered with a bad_request response holding the error instead, so a
+// server task never throws.
+std::string respond(const request& a_request, const budget& a_limit = {},
+                    size_t a_max_payload = MAX_FRAME_SIZE);
+
+// SERVER
+
+// evaluation daemon listening on a Unix domain socket. One thread runs the
+// socket loop; terms are normalized on a worker pool.
+class server
+{
+  public:
+    // binds and listens on a_socket_path, replacing any stale socket file.
+    // Every request is clamped to a_max_budget, so that none can hold a
+    // worker forever. Throws std::runtime_error if the socket cannot be set
+    // up.
+    server(const std::string& a_socket_path, size_t a_worker_count,
+           const budget& a_max_budget = DEFAULT_SERVER_BUDGET);
+    // waits for running requests, which end within the maximum budget, and
+    // removes the socket file.
+    ~server();
+
+    server(const server&) = delete;
+    server& operator=(const server&) = delete;
+
+    // serves connections until stop() is called.
+    void run();
+
+    // asks run() to return. Safe to call from other threads and from signal
+    // handlers.
+    void stop();
+
+  private:
+    struct connection;
+
+    void accept_connections();
+    // returns false once the connection should be dropped.
+    bool service(const std::shared_ptr<connection>& a_connection,
+                 short a_revents);
+    void wake();
+
+    std::string m_socket_path;
+    budget m_max_budget;
+    int m_listen_fd;
+    int m_wake_fds[2];
+    std::atomic<bool> m_stopping;
+    std::vector<std::shared_ptr<connection>> m_connections;
+    thread_pool m_pool;
+};
+
+// CLIENT
+
+// blocking client for server. Requests are buffered by submit() and written
+// in batches, so many requests can be in flight on one connection.
+class client
+{
+  public:
+    // connects to a_socket_path. Throws std::runtime_error on failure.
+    explicit client(const std::string& a_socket_path);
+    ~client();
+
+    client(const client&) = delete;
+    client& operator=(const client&) = delete;
+
+    // queues a_request; it is sent by the next flush() or receive().
+    void submit(const request& a_request);
+
+    // sends every queued request.
+    void flush();
+
+    // sends queued requests, then blocks until the next response arrives.
+    // Throws std::runtime_error if the server closes the connection.
+    response receive();
+
+  private:
+    // reads whatever is available into m_in; returns false on end of stream.
+    bool read_some();
+
+    int m_fd;
+    std::string m_out;
+    std::string m_in;
+};
+
+} // namespace lambda
+
+#endif
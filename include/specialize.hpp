@@ -0,0 +1,71 @@
+#ifndef SPECIALIZE_HPP
+#define SPECIALIZE_HPP
+
+#include "normalize.hpp"
+#include <unordered_map>
+#include <vector>
+
+namespace lambda
+{
+
+// specializations of helpers for arguments known ahead of time.
+//
+// Specializing a helper H for known arguments a0 and a2 of three builds the
+// residual λx.(((H a0) x) a2), with one abstraction per unknown argument in
+// order, and normalizes it, reducing under the abstractions whatever the
+// known arguments make reducible. Calls such as ((ADD THREE) x) then only
+// take the steps that depend on x. Residuals are cached by the hashes of
+// the helper and of the known arguments, so every call site with the same
+// known arguments shares one specialization.
+class specializer
+{
+  public:
+    // residuals are normalized within a_budget; one that runs out of it is
+    // kept unreduced, which is still equivalent to the call.
+    explicit specializer(const budget& a_budget = {});
+
+    specializer(const specializer&) = delete;
+    specializer& operator=(const specializer&) = delete;
+
+    // the residual of a_helper applied to a_arguments, where null entries
+    // are unknown. a_helper and the known arguments are closed terms at
+    // depth 0, and so is the result, which lives as long as the specializer.
+    const expr& specialize(const expr& a_helper,
+                           const std::vector<const expr*>& a_arguments);
+
+    // rewrites every call in a_expr, whose root is at depth a_depth, of the
+    // variable a_helper_level bound outside it (as helpers are in the main
+    // function of construct_program()) and standing for a_helper. A call
+    // whose first arguments, up to the number of leading abstractions of
+    // a_helper, include closed terms becomes the residual for those
+    // arguments, copied in place, applied to the others. Returns the number
+    // of calls rewritten. Throws std::runtime_error if a_helper_level is not
+    // below a_depth.
+    size_t rewrite_calls(std::unique_ptr<expr>& a_expr, size_t a_helper_level,
+                         const expr& a_helper, size_t a_depth);
+
+    // number of distinct specializations built.
+    size_t size() const;
+
+    // specialize() calls answered from the cache.
+    size_t hits() const;
+
+  private:
+    struct entry
+    {
+        std::unique_ptr<expr> m_helper;
+        // null where the argument is unknown
+        std::vector<std::unique_ptr<expr>> m_arguments;
+        std::unique_ptr<expr> m_residual;
+    };
+
+    budget m_budget;
+    // entries by the hash of their helper and arguments
+    std::unordered_map<uint64_t, std::vector<entry>> m_cache;
+    size_t m_size = 0;
+    size_t m_hits = 0;
+};
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SPECULATE_HPP
+#define SPECULATE_HPP
+
+#include "lambda.hpp"
+#include "normalize.hpp"
+#include "thread_pool.hpp"
+
+namespace lambda
+{
+
+// limits on speculative work.
+struct speculation_options
+{
+    // limits on each speculative normalization; a speculation that does
+    // not reach normal form within them is discarded
+    budget m_task_budget;
+    // beta-reductions all speculations together may perform
+    size_t m_max_total_steps = SIZE_MAX;
+    // arguments smaller than this are not worth a task
+    size_t m_min_size = 64;
+};
+
+// what speculation achieved.
+struct speculation_stats
+{
+    // speculations started
+    size_t m_started = 0;
+    // speculations whose normal form replaced the argument
+    size_t m_adopted = 0;
+    // speculations that were thrown away: the argument was consumed,
+    // reduced in place, or had no normal form within the task budget
+    size_t m_discarded = 0;
+    // beta-reductions performed by all speculations
+    size_t m_speculative_steps = 0;
+    // beta-reductions performed by the speculations that were adopted
+    size_t m_adopted_steps = 0;
+};
+
+// normalizes a_expr in normal order like normalize(), while idle workers of
+// a_pool speculatively normalize copies of the arguments on the spine of
+// a_expr. Normal order only reduces an argument once the head needs it, so
+// on a spine such as (x A B C) with a stuck head the arguments are reduced
+// one after another; speculation reduces them in parallel instead.
+//
+// A speculation works on a snapshot of one argument at its own depth. When
+// it reaches normal form and the same argument is still on the spine,
+// unchanged (checked with equals() against the snapshot), the argument is
+// replaced by the result. Otherwise the result is discarded. Replacing an
+// argument by its normal form does not change the normal form of a_expr.
+//
+// a_budget applies to the reductions performed by the calling thread; the
+// returned m_steps counts only those. No speculation is left running when
+// the call returns; while waiting for them the caller runs queued tasks of
+// a_pool, so it may itself be one of a_pool's workers.
+normalize_stats normalize_speculative(std::unique_ptr<expr>& a_expr,
+                                      thread_pool& a_pool,
+                                      const budget& a_budget = {},
+                                      const speculation_options& a_options = {},
+                                      speculation_stats* a_stats = nullptr,
+                                      size_t a_depth = 0);
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef STRICTNESS_HPP
+#define STRICTNESS_HPP
+
+#include "lambda.hpp"
+#include <vector>
+
+namespace lambda
+{
+
+// STRICTNESS AND USAGE ANALYSIS
+// normal order substitutes an argument unreduced, so an argument used n
+// times is reduced n times, once per copy. Reducing it first is only safe
+// if the argument is needed: if it has no normal form, neither has the
+// application, so reducing it first cannot lose a normal form that normal
+// order would find. An occurrence of the bound variable is needed when it
+// is sure to reach the normal form unapplied, i.e. along a path from the
+// body through
+//   - abstractions that are never applied, and
+//   - arguments of applications whose head is a variable that is never
+//     substituted: one bound outside the redex, or by such an abstraction,
+// and the occurrence is not itself applied. Abstractions in the body that
+// the application's further arguments will consume, and redexes within the
+// body, are followed as far as their bodies; their arguments are not.
+//
+// The analysis assumes the variables bound outside the redex stay free, as
+// they do for the leftmost-outermost redex of a term.
+
+// how the variable bound by an abstraction is used in its body.
+struct binder_usage
+{
+    // occurrences of the variable
+    size_t m_uses = 0;
+    // whether the argument is needed, as above
+    bool m_strict = false;
+};
+
+// usage of the variable bound by a_func, whose root is at depth a_depth,
+// when a_func is applied to its argument and then to a_extra_arguments
+// more (SIZE_MAX when unknown).
+binder_usage analyze_binder(const func& a_func, size_t a_depth,
+                            size_t a_extra_arguments = SIZE_MAX);
+
+// usage of every abstraction in a_expr, whose root is at depth a_depth, in
+// pre-order, each analyzed as if its application were the next redex. An
+// abstraction at the head of an application knows its arguments; any other
+// may be applied to any number. Takes time proportional to the sum of the
+// sizes of the abstractions.
+std::vector<binder_usage> analyze_usage(const expr& a_expr,
+                                        size_t a_depth = 0);
+
+// performs one step of normal order reduction, except that the argument of
+// the leftmost-outermost redex is reduced first, by the same rule, while it
+// is strict and used more than once. Each such argument is then substituted
+// in normal form and not reduced again per copy. Returns true if a
+// reduction was performed. Finds the same normal forms as reduce_one_step().
+bool reduce_one_step_strict(std::unique_ptr<expr>& a_expr,
+                            size_t a_depth = 0);
+
+} // namespace lambda
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lambda
+{
+
+// a fixed set of worker threads consuming a shared FIFO of tasks.
+class thread_pool
+{
+  public:
+    // starts a_thread_count workers (at least one).
+    explicit thread_pool(size_t a_thread_count);
+    // waits for queued tasks to finish, then joins the workers.
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // queues a_task for execution on some worker.
+    void submit(std::function<void()> a_task);
+
+    // blocks until the queue is empty and no task is running.
+    void wait_idle();
+
+    // runs the oldest queued task on the calling thread, if there is one.
+    // Returns whether a task was run. A thread waiting for tasks it queued,
+    // including one of the workers, can help with them instead of blocking.
+    bool run_pending_task();
+
+    // number of worker threads.
+    size_t size() const;
+
+  private:
+    void worker_loop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_task_available;
+    std::condition_variable m_idle;
+    size_t m_running;
+    bool m_stopping;
+};
+
+} // namespace lambda
+
+#endif
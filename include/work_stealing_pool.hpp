@@ -0,0 +1,68 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lambda
+{
+
+// fork-join pool for divide-and-conquer work. Every worker owns a deque: it
+// pushes and pops forked tasks at the back, while idle workers steal from
+// the front, where the oldest (and usually largest) tasks sit. A thread
+// waiting for a join keeps executing tasks instead of blocking, so nested
+// fork_join() calls cannot deadlock.
+class work_stealing_pool
+{
+  public:
+    // starts a_thread_count workers (at least one).
+    explicit work_stealing_pool(size_t a_thread_count);
+    ~work_stealing_pool();
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    // runs a_left on the calling thread while offering a_right to idle
+    // workers, and returns once both have finished. If either throws, the
+    // exception is rethrown here after both have finished. May be called
+    // from any thread, including from inside a task.
+    void fork_join(const std::function<void()>& a_left,
+                   const std::function<void()>& a_right);
+
+    // number of worker threads.
+    size_t size() const;
+
+  private:
+    struct task;
+
+    struct task_deque
+    {
+        std::mutex m_mutex;
+        std::deque<task*> m_tasks;
+    };
+
+    // index of the deque owned by the calling thread. Threads outside the
+    // pool share the last deque.
+    size_t home_index() const;
+    // executes one queued task, preferring a_home; false if none was found.
+    bool try_run_one(size_t a_home);
+    void worker_loop(size_t a_index);
+
+    std::vector<std::unique_ptr<task_deque>> m_deques;
+    std::vector<std::thread> m_workers;
+    std::atomic<size_t> m_queued;
+    std::atomic<bool> m_stopping;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_work_available;
+};
+
+} // namespace lambda
+
+#endif
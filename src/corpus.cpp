@@ -0,0 +1,328 @@
+#include "../include/corpus.hpp"
+#include "../include/metrics.hpp"
+
+namespace lambda
+{
+
+term_corpus::term_corpus() : m_slots(16, npos)
+{
+}
+
+std::pair<size_t, bool> term_corpus::insert(const expr& a_expr)
+{
+    flatten(a_expr, m_scratch);
+
+    return insert(m_scratch);
+}
+
+std::pair<size_t, bool> term_corpus::insert(const flat_expr& a_flat)
+{
+    const uint64_t l_hash = flat_hash(a_flat);
+    const size_t l_slot = probe(l_hash, a_flat);
+
+    if(m_slots[l_slot] != npos)
+    {
+        record_cache_lookups(1, 1);
+        return {m_slots[l_slot], false};
+    }
+
+    record_cache_lookups(1, 0);
+
+    const size_t l_id = m_entries.size();
+
+    m_entries.push_back({l_hash, m_tags.size(), a_flat.m_tags.size(),
+                         m_levels.size(), a_flat.m_levels.size()});
+    m_tags.insert(m_tags.end(), a_flat.m_tags.begin(), a_flat.m_tags.end());
+    m_levels.insert(m_levels.end(), a_flat.m_levels.begin(),
+                    a_flat.m_levels.end());
+    m_slots[l_slot] = l_id;
+
+    // keep the load factor at or below one half
+    if(2 * m_entries.size() > m_slots.size())
+        grow();
+
+    return {l_id, true};
+}
+
+size_t term_corpus::find(const flat_expr& a_flat) const
+{
+    const size_t l_id = m_slots[probe(flat_hash(a_flat), a_flat)];
+    record_cache_lookups(1, l_id != npos);
+
+    return l_id;
+}
+
+size_t term_corpus::size() const
+{
+    return m_entries.size();
+}
+
+flat_expr term_corpus::at(size_t a_id) const
+{
+    const entry& l_entry = m_entries.at(a_id);
+
+    flat_expr l_flat;
+    l_flat.m_tags.assign(m_tags.begin() + l_entry.m_tag_begin,
+                         m_tags.begin() + l_entry.m_tag_begin +
+                             l_entry.m_tag_count);
+    l_flat.m_levels.assign(m_levels.begin() + l_entry.m_level_begin,
+                           m_levels.begin() + l_entry.m_level_begin +
+                               l_entry.m_level_count);
+
+    return l_flat;
+}
+
+size_t term_corpus::probe(uint64_t a_hash, const flat_expr& a_flat) const
+{
+    const size_t l_mask = m_slots.size() - 1;
+
+    for(size_t i = a_hash & l_mask;; i = (i + 1) & l_mask)
+    {
+        if(m_slots[i] == npos)
+            return i;
+
+        const entry& l_entry = m_entries[m_slots[i]];
+
+        // the hash and sizes reject nearly every non-match before any
+        // bytes are compared
+        if(l_entry.m_hash == a_hash &&
+           l_entry.m_tag_count == a_flat.m_tags.size() &&
+           l_entry.m_level_count == a_flat.m_levels.size() &&
+           bytes_equal(m_tags.data() + l_entry.m_tag_begin,
+                       a_flat.m_tags.data(), l_entry.m_tag_count) &&
+           bytes_equal(m_levels.data() + l_entry.m_level_begin,
+                       a_flat.m_levels.data(),
+                       l_entry.m_level_count * sizeof(uint32_t)))
+            return i;
+    }
+}
+
+void term_corpus::grow()
+{
+    m_slots.assign(2 * m_slots.size(), npos);
+
+    const size_t l_mask = m_slots.size() - 1;
+
+    for(size_t l_id = 0; l_id < m_entries.size(); ++l_id)
+    {
+        size_t i = m_entries[l_id].m_hash & l_mask;
+
+        while(m_slots[i] != npos)
+            i = (i + 1) & l_mask;
+
+        m_slots[i] = l_id;
+    }
+}
+
+std::vector<size_t>
+dedup(const std::vector<std::unique_ptr<expr>>& a_exprs,
+      equivalence a_equivalence)
+{
+    term_corpus l_corpus;
+    // index in a_exprs of the first occurrence of each corpus id
+    std::vector<size_t> l_first;
+    std::vector<size_t> l_result;
+    l_result.reserve(a_exprs.size());
+
+    for(size_t i = 0; i < a_exprs.size(); ++i)
+    {
+        const auto [l_id, l_added] =
+            a_equivalence == equivalence::eta
+                ? l_corpus.insert(*eta_canonical(*a_exprs[i]))
+                : l_corpus.insert(*a_exprs[i]);
+
+        if(l_added)
+            l_first.push_back(i);
+
+        l_result.push_back(l_first[l_id]);
+    }
+
+    return l_result;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <stdexcept>
+
+using namespace lambda;
+
+void test_term_corpus()
+{
+    // equal expressions share an id
+    {
+        term_corpus l_corpus;
+
+        auto l_first = l_corpus.insert(*f(a(v(0), v(1))));
+        auto l_second = l_corpus.insert(*a(v(0), v(1)));
+        auto l_again = l_corpus.insert(*f(a(v(0), v(1))));
+
+        assert(l_first == std::make_pair(size_t(0), true));
+        assert(l_second == std::make_pair(size_t(1), true));
+        assert(l_again == std::make_pair(size_t(0), false));
+        assert(l_corpus.size() == 2);
+
+        assert(l_corpus.find(flatten(*a(v(0), v(1)))) == 1);
+        assert(l_corpus.find(flatten(*a(v(1), v(0)))) == term_corpus::npos);
+        assert(unflatten(l_corpus.at(0))->equals(f(a(v(0), v(1)))));
+        assert_throws(l_corpus.at(2), std::out_of_range);
+    }
+
+    // lookups survive the index growing
+    {
+        term_corpus l_corpus;
+
+        for(size_t i = 0; i < 5000; ++i)
+            assert(l_corpus.insert(*f(v(i))).first == i);
+
+        for(size_t i = 0; i < 5000; ++i)
+            assert(l_corpus.insert(*f(v(i))) == std::make_pair(i, false));
+
+        assert(l_corpus.size() == 5000);
+    }
+
+    // dedup maps every expression to its first occurrence
+    {
+        std::vector<std::unique_ptr<expr>> l_exprs;
+        l_exprs.push_back(f(v(0)));
+        l_exprs.push_back(a(v(0), v(0)));
+        l_exprs.push_back(f(v(0)));
+        l_exprs.push_back(f(f(v(0))));
+        l_exprs.push_back(a(v(0), v(0)));
+
+        assert(dedup(l_exprs) == std::vector<size_t>({0, 1, 0, 3, 1}));
+        assert(dedup({}).empty());
+    }
+}
+
+void corpus_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_term_corpus);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include "../include/hash.hpp"
+#include <random>
+#include <unordered_map>
+
+using namespace lambda;
+
+// a random expression of about a_nodes nodes under a_depth binders.
+static std::unique_ptr<expr> random_corpus_term(std::mt19937& a_rng,
+                                                size_t a_nodes, size_t a_depth)
+{
+    if(a_nodes <= 1)
+        return v(a_rng() % (a_depth + 1));
+
+    if(a_rng() % 4 == 0)
+        return f(random_corpus_term(a_rng, a_nodes - 1, a_depth + 1));
+
+    const size_t l_lhs_nodes = 1 + a_rng() % (a_nodes - 1);
+
+    return a(random_corpus_term(a_rng, l_lhs_nodes, a_depth),
+             random_corpus_term(a_rng, a_nodes - l_lhs_nodes, a_depth));
+}
+
+void bench_dedup()
+{
+    const size_t l_runs = 3;
+    const size_t l_distinct = 20000;
+    std::mt19937 l_rng(5);
+
+    // every distinct term appears four times, shuffled
+    std::vector<std::unique_ptr<expr>> l_exprs;
+
+    for(size_t i = 0; i < l_distinct; ++i)
+    {
+        auto l_term = random_corpus_term(l_rng, 100 + l_rng() % 400, 0);
+
+        for(size_t j = 0; j < 4; ++j)
+            l_exprs.push_back(l_term->clone());
+    }
+
+    std::shuffle(l_exprs.begin(), l_exprs.end(), l_rng);
+
+    size_t l_nodes = 0;
+
+    for(const auto& l_expr : l_exprs)
+        l_nodes += l_expr->m_size;
+
+    std::cout << "    " << l_exprs.size() << " terms, " << l_nodes
+              << " nodes" << std::endl;
+
+    // the tree baseline: structural_hash() buckets checked with equals()
+    std::vector<size_t> l_tree_result;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [&] { l_tree_result.clear(); },
+        [&]
+        {
+            std::unordered_map<uint64_t, std::vector<size_t>> l_buckets;
+
+            for(size_t i = 0; i < l_exprs.size(); ++i)
+            {
+                auto& l_bucket = l_buckets[structural_hash(*l_exprs[i])];
+                size_t l_first = i;
+
+                for(size_t l_candidate : l_bucket)
+                    if(l_exprs[l_candidate]->equals(l_exprs[i]))
+                    {
+                        l_first = l_candidate;
+                        break;
+                    }
+
+                if(l_first == i)
+                    l_bucket.push_back(i);
+
+                l_tree_result.push_back(l_first);
+            }
+        });
+    report("hash + equals (tree)", l_measured, l_nodes);
+
+    std::vector<size_t> l_flat_result;
+
+    l_measured = measure_best_of(
+        l_runs, [] {}, [&] { l_flat_result = dedup(l_exprs); });
+    report("dedup (flat, including flatten)", l_measured, l_nodes);
+
+    if(l_flat_result != l_tree_result)
+        std::cout << "    MISMATCH between tree and flat results" << std::endl;
+
+    // lookups of terms that are already present, given flat input
+    std::vector<flat_expr> l_flats;
+
+    for(const auto& l_expr : l_exprs)
+        l_flats.push_back(flatten(*l_expr));
+
+    term_corpus l_corpus;
+
+    for(const flat_expr& l_flat : l_flats)
+        l_corpus.insert(l_flat);
+
+    size_t l_found = 0;
+
+    l_measured = measure_best_of(
+        l_runs, [&] { l_found = 0; },
+        [&]
+        {
+            for(const flat_expr& l_flat : l_flats)
+                l_found += l_corpus.find(l_flat) != term_corpus::npos;
+        });
+    keep(l_found);
+    report("term_corpus::find (flat)", l_measured, l_nodes);
+}
+
+void corpus_bench_main()
+{
+    BENCH(bench_dedup);
+}
+
+#endif
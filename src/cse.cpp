@@ -0,0 +1,378 @@
+#include "../include/cse.hpp"
+#include "../include/hash.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace lambda
+{
+
+namespace
+{
+
+// a closed subterm and the depth it sits at.
+struct closed_subterm
+{
+    std::unique_ptr<expr>* m_slot;
+    size_t m_depth;
+    uint64_t m_hash;
+};
+
+} // namespace
+
+// hashes a_expr, whose root is at a_depth, over De Bruijn indices into
+// a_hash, and collects its closed subterms, children first. Returns how many
+// binders above a_expr its variables reach, 0 if it is closed.
+static size_t collect_closed(std::unique_ptr<expr>& a_expr, size_t a_depth,
+                             uint64_t& a_hash,
+                             std::vector<closed_subterm>& a_closed)
+{
+    size_t l_reach;
+
+    if(const var* l_var = dynamic_cast<const var*>(a_expr.get()))
+    {
+        if(l_var->m_index < a_depth)
+        {
+            a_hash = var_hash(a_depth - 1 - l_var->m_index);
+            l_reach = a_depth - l_var->m_index;
+        }
+        else
+        {
+            // bound by nothing, so never part of a closed subterm
+            a_hash = hash_combine(VAR_SEED, l_var->m_index);
+            l_reach = SIZE_MAX;
+        }
+    }
+    else if(func* l_func = dynamic_cast<func*>(a_expr.get()))
+    {
+        uint64_t l_body_hash;
+        l_reach = collect_closed(l_func->m_body, a_depth + 1, l_body_hash,
+                                 a_closed);
+        a_hash = func_hash(l_body_hash);
+
+        if(l_reach > 0)
+            --l_reach;
+    }
+    else if(app* l_app = dynamic_cast<app*>(a_expr.get()))
+    {
+        uint64_t l_lhs_hash;
+        uint64_t l_rhs_hash;
+        l_reach = std::max(
+            collect_closed(l_app->m_lhs, a_depth, l_lhs_hash, a_closed),
+            collect_closed(l_app->m_rhs, a_depth, l_rhs_hash, a_closed));
+        a_hash = app_hash(l_lhs_hash, l_rhs_hash);
+    }
+    else
+        // if we get here, error
+        throw std::runtime_error("cse: invalid expression type");
+
+    if(l_reach == 0)
+        a_closed.push_back({&a_expr, a_depth, a_hash});
+
+    return l_reach;
+}
+
+// whether closed terms a_lhs at a_lhs_depth and a_rhs at a_rhs_depth are the
+// same term moved to different depths.
+static bool same_closed(const expr& a_lhs, size_t a_lhs_depth,
+                        const expr& a_rhs, size_t a_rhs_depth)
+{
+    if(a_lhs.m_size != a_rhs.m_size)
+        return false;
+
+    if(const var* l_var = dynamic_cast<const var*>(&a_lhs))
+    {
+        const var* l_other = dynamic_cast<const var*>(&a_rhs);
+        return l_other &&
+               l_var->m_index - a_lhs_depth == l_other->m_index - a_rhs_depth;
+    }
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_lhs))
+    {
+        const func* l_other = dynamic_cast<const func*>(&a_rhs);
+        return l_other && same_closed(*l_func->m_body, a_lhs_depth,
+                                      *l_other->m_body, a_rhs_depth);
+    }
+
+    const app* l_app = dynamic_cast<const app*>(&a_lhs);
+    const app* l_other = dynamic_cast<const app*>(&a_rhs);
+
+    return l_app && l_other &&
+           same_closed(*l_app->m_lhs, a_lhs_depth, *l_other->m_lhs,
+                       a_rhs_depth) &&
+           same_closed(*l_app->m_rhs, a_lhs_depth, *l_other->m_rhs,
+                       a_rhs_depth);
+}
+
+// moves a closed term a_amount binders up, the inverse of lift(a_amount, 0).
+static void lower(expr& a_expr, size_t a_amount)
+{
+    if(var* l_var = dynamic_cast<var*>(&a_expr))
+        l_var->m_index -= a_amount;
+    else if(func* l_func = dynamic_cast<func*>(&a_expr))
+        lower(*l_func->m_body, a_amount);
+    else if(app* l_app = dynamic_cast<app*>(&a_expr))
+    {
+        lower(*l_app->m_lhs, a_amount);
+        lower(*l_app->m_rhs, a_amount);
+    }
+}
+
+// recomputes the sizes of a_expr and its descendants.
+static void update_sizes(expr& a_expr)
+{
+    if(func* l_func = dynamic_cast<func*>(&a_expr))
+        update_sizes(*l_func->m_body);
+    else if(app* l_app = dynamic_cast<app*>(&a_expr))
+    {
+        update_sizes(*l_app->m_lhs);
+        update_sizes(*l_app->m_rhs);
+    }
+
+    a_expr.update_size();
+}
+
+cse_stats eliminate_common_subterms(std::unique_ptr<expr>& a_expr,
+                                    size_t a_depth)
+{
+    cse_stats l_stats;
+    l_stats.m_size_before = a_expr->m_size;
+
+    while(true)
+    {
+        std::vector<closed_subterm> l_closed;
+        uint64_t l_hash;
+        collect_closed(a_expr, a_depth, l_hash, l_closed);
+
+        // copies of the same subterm, in order of their first occurrence;
+        // the hash only narrows down which classes to compare with
+        std::vector<std::vector<const closed_subterm*>> l_classes;
+        std::unordered_map<uint64_t, std::vector<size_t>> l_by_hash;
+
+        for(const closed_subterm& l_subterm : l_closed)
+        {
+            std::vector<size_t>& l_candidates = l_by_hash[l_subterm.m_hash];
+            bool l_found = false;
+
+            for(size_t l_class : l_candidates)
+            {
+                const closed_subterm* l_first = l_classes[l_class].front();
+
+                if(same_closed(**l_first->m_slot, l_first->m_depth,
+                               **l_subterm.m_slot, l_subterm.m_depth))
+                {
+                    l_classes[l_class].push_back(&l_subterm);
+                    l_found = true;
+                    break;
+                }
+            }
+
+            if(!l_found)
+            {
+                l_candidates.push_back(l_classes.size());
+                l_classes.push_back({&l_subterm});
+            }
+        }
+
+        // the largest subterm that pays for its binding: n copies of size s
+        // become n variables, one copy, an abstraction and an application.
+        // Binding a smaller one first would leave copies of the larger
+        // that refer to the binding, no longer closed, and so unshared.
+        const std::vector<const closed_subterm*>* l_best = nullptr;
+
+        for(const std::vector<const closed_subterm*>& l_class : l_classes)
+        {
+            const size_t l_count = l_class.size();
+            const size_t l_size = (*l_class.front()->m_slot)->m_size;
+
+            if((l_count - 1) * l_size <= l_count + 2)
+                continue;
+
+            if(!l_best || l_size > (*l_best->front()->m_slot)->m_size ||
+               (l_size == (*l_best->front()->m_slot)->m_size &&
+                l_count > l_best->size()))
+                l_best = &l_class;
+        }
+
+        if(!l_best)
+            break;
+
+        const closed_subterm& l_first = *l_best->front();
+        std::unique_ptr<expr> l_shared = (*l_first.m_slot)->clone();
+        lower(*l_shared, l_first.m_depth - a_depth);
+
+        // the new binder takes level a_depth, so the levels bound within
+        // a_expr move one down
+        a_expr->lift(1, a_depth);
+
+        for(const closed_subterm* l_copy : *l_best)
+            *l_copy->m_slot = v(a_depth);
+
+        update_sizes(*a_expr);
+        a_expr = a(f(std::move(a_expr)), std::move(l_shared));
+
+        ++l_stats.m_bindings;
+        l_stats.m_replaced += l_best->size();
+    }
+
+    l_stats.m_size_after = a_expr->m_size;
+
+    return l_stats;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../include/normalize.hpp"
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+void test_eliminate_common_subterms()
+{
+    // SUCC = λn.λs.λz.(s ((n s) z)) under a_depth binders
+    auto l_succ = [](size_t a_depth)
+    {
+        return f(f(f(a(v(a_depth + 1),
+                       a(a(v(a_depth), v(a_depth + 1)), v(a_depth + 2))))));
+    };
+
+    // SUCC (SUCC (SUCC ZERO)): the three copies of SUCC become one
+    {
+        auto l_expr = a(l_succ(0), a(l_succ(0), a(l_succ(0), f(f(v(1))))));
+        auto l_original = l_expr->clone();
+
+        const cse_stats l_stats = eliminate_common_subterms(l_expr);
+
+        assert(l_expr->equals(
+            a(f(a(v(0), a(v(0), a(v(0), f(f(v(2))))))), l_succ(0))));
+        assert(l_stats.m_bindings == 1);
+        assert(l_stats.m_replaced == 3);
+        assert(l_stats.m_size_before == 36);
+        assert(l_stats.m_size_after == l_expr->m_size);
+        assert(l_stats.m_size_after == 21);
+        assert(l_expr->m_size == l_expr->clone()->m_size);
+
+        // the meaning is unchanged
+        normalize(l_original);
+        normalize(l_expr);
+        assert(l_expr->equals(l_original));
+    }
+
+    // copies under different numbers of binders are the same subterm, and
+    // variables bound outside a subterm keep it from being shared
+    {
+        auto l_expr = f(a(a(l_succ(1), a(v(0), l_succ(1))),
+                          f(a(l_succ(2), v(1)))));
+        auto l_original = l_expr->clone();
+
+        const cse_stats l_stats = eliminate_common_subterms(l_expr, 0);
+
+        assert(l_stats.m_bindings == 1);
+        assert(l_stats.m_replaced == 3);
+        assert(l_expr->equals(a(f(f(a(a(v(0), a(v(1), v(0))),
+                                      f(a(v(0), v(2)))))),
+                                l_succ(0))));
+
+        normalize(l_original);
+        normalize(l_expr);
+        assert(l_expr->equals(l_original));
+    }
+
+    // free variables of the whole term are left where they are
+    {
+        auto l_expr = a(a(v(0), l_succ(2)), a(v(1), l_succ(2)));
+        const cse_stats l_stats = eliminate_common_subterms(l_expr, 2);
+
+        assert(l_stats.m_bindings == 1);
+        assert(l_expr->equals(
+            a(f(a(a(v(0), v(2)), a(v(1), v(2)))), l_succ(2))));
+    }
+
+    // copies too small to pay for a binding are kept
+    {
+        auto l_expr = a(f(v(0)), f(v(0)));
+        assert(eliminate_common_subterms(l_expr).m_bindings == 0);
+        assert(l_expr->equals(a(f(v(0)), f(v(0)))));
+    }
+
+    // a shared subterm may itself hold repeats, which get their own
+    // binding
+    {
+        auto l_pair = [&](size_t a_depth)
+        {
+            return f(a(a(v(a_depth), l_succ(a_depth + 1)),
+                       l_succ(a_depth + 1)));
+        };
+
+        auto l_expr = a(a(v(0), l_pair(1)), l_pair(1));
+        auto l_original = l_expr->clone();
+        const cse_stats l_stats = eliminate_common_subterms(l_expr, 1);
+
+        assert(l_stats.m_bindings == 2);
+        assert(l_stats.m_size_after < l_stats.m_size_before);
+
+        budget l_budget;
+        normalize(l_original, l_budget, strategy::normal_order, 1);
+        normalize(l_expr, l_budget, strategy::normal_order, 1);
+        assert(l_expr->equals(l_original));
+    }
+}
+
+void cse_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_eliminate_common_subterms);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+
+using namespace lambda;
+
+void bench_eliminate_common_subterms()
+{
+    const size_t l_runs = 5;
+
+    // church numeral a_n under a_depth binders
+    auto l_numeral = [](size_t a_n, size_t a_depth)
+    {
+        std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(a_depth), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    // a generated program: 256 uses of eight numerals, at varying depths
+    std::unique_ptr<expr> l_input = v(0);
+
+    for(size_t i = 0; i < 256; ++i)
+        l_input = f(a(std::move(l_input), l_numeral(10 + i % 8, 256 - i)));
+
+    std::unique_ptr<expr> l_expr;
+    cse_stats l_stats;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [&] { l_expr = l_input->clone(); },
+        [&] { l_stats = eliminate_common_subterms(l_expr); });
+    report("eliminate_common_subterms", l_measured, l_stats.m_size_before);
+
+    std::cout << "    size " << l_stats.m_size_before << " -> "
+              << l_stats.m_size_after << ", " << l_stats.m_bindings
+              << " bindings" << std::endl;
+}
+
+void cse_bench_main()
+{
+    BENCH(bench_eliminate_common_subterms);
+}
+
+#endif
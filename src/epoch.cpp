@@ -0,0 +1,461 @@
+#include "../include/epoch.hpp"
+
+namespace lambda
+{
+
+// the per-thread state other threads inspect. Each sits on its own cache
+// line, so pinning never writes a line another thread writes.
+struct alignas(64) epoch_domain::record
+{
+    // 0 while unpinned, otherwise 2 * epoch + 1 for the pinned epoch
+    std::atomic<uint64_t> m_state = 0;
+    std::atomic<bool> m_in_use = false;
+    // objects the owner has retired and not yet deleted
+    std::atomic<size_t> m_pending = 0;
+    record* m_next = nullptr;
+};
+
+size_t epoch_domain::delete_safe(std::vector<retired>& a_garbage,
+                                 uint64_t a_epoch)
+{
+    size_t l_kept = 0;
+
+    for(retired& l_retired : a_garbage)
+    {
+        if(l_retired.m_epoch + 2 <= a_epoch)
+            l_retired.m_deleter(l_retired.m_object);
+        else
+            a_garbage[l_kept++] = l_retired;
+    }
+
+    const size_t l_deleted = a_garbage.size() - l_kept;
+    a_garbage.resize(l_kept);
+
+    return l_deleted;
+}
+
+epoch_domain::epoch_domain() : m_epoch(0), m_records(nullptr)
+{
+}
+
+epoch_domain::~epoch_domain()
+{
+    for(retired& l_retired : m_orphans)
+        l_retired.m_deleter(l_retired.m_object);
+
+    for(record* l_record = m_records.load(); l_record;)
+    {
+        record* l_next = l_record->m_next;
+        delete l_record;
+        l_record = l_next;
+    }
+}
+
+uint64_t epoch_domain::epoch() const
+{
+    return m_epoch.load(std::memory_order_acquire);
+}
+
+size_t epoch_domain::pending() const
+{
+    size_t l_result = 0;
+
+    for(record* l_record = m_records.load(std::memory_order_acquire); l_record;
+        l_record = l_record->m_next)
+        l_result += l_record->m_pending.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> l_lock(m_orphans_mutex);
+
+    return l_result + m_orphans.size();
+}
+
+epoch_domain::record* epoch_domain::acquire()
+{
+    for(record* l_record = m_records.load(std::memory_order_acquire); l_record;
+        l_record = l_record->m_next)
+    {
+        bool l_free = false;
+
+        if(l_record->m_in_use.compare_exchange_strong(l_free, true))
+            return l_record;
+    }
+
+    record* l_record = new record;
+    l_record->m_in_use = true;
+    l_record->m_next = m_records.load(std::memory_order_relaxed);
+
+    while(!m_records.compare_exchange_weak(l_record->m_next, l_record,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed))
+        ;
+
+    return l_record;
+}
+
+void epoch_domain::try_advance()
+{
+    uint64_t l_epoch = m_epoch.load();
+
+    // a record pinned to an older epoch may still hold pointers retired
+    // in it
+    for(record* l_record = m_records.load(); l_record;
+        l_record = l_record->m_next)
+    {
+        const uint64_t l_state = l_record->m_state.load();
+
+        if(l_state != 0 && l_state != 2 * l_epoch + 1)
+            return;
+    }
+
+    m_epoch.compare_exchange_strong(l_epoch, l_epoch + 1);
+}
+
+epoch_guard::epoch_guard(epoch_participant& a_participant)
+    : m_participant(a_participant)
+{
+    m_participant.pin();
+}
+
+epoch_guard::~epoch_guard()
+{
+    m_participant.unpin();
+}
+
+epoch_participant::epoch_participant(epoch_domain& a_domain)
+    : m_domain(a_domain), m_record(a_domain.acquire())
+{
+}
+
+epoch_participant::~epoch_participant()
+{
+    if(!m_garbage.empty())
+        collect();
+
+    if(!m_garbage.empty())
+    {
+        std::lock_guard<std::mutex> l_lock(m_domain.m_orphans_mutex);
+        m_domain.m_orphans.insert(m_domain.m_orphans.end(), m_garbage.begin(),
+                                  m_garbage.end());
+    }
+
+    m_record->m_pending.store(0, std::memory_order_relaxed);
+    m_record->m_state.store(0, std::memory_order_release);
+    m_record->m_in_use.store(false, std::memory_order_release);
+}
+
+void epoch_participant::retire(void* a_object, void (*a_deleter)(void*))
+{
+    // tagged with the epoch current once a_object is unreachable: only
+    // threads pinned at or before it can still be reading a_object
+    m_garbage.push_back({a_object, a_deleter, m_domain.epoch()});
+    m_record->m_pending.store(m_garbage.size(), std::memory_order_relaxed);
+
+    if(m_garbage.size() % RETIRE_THRESHOLD == 0)
+        collect();
+}
+
+void epoch_participant::collect()
+{
+    // twice, since garbage becomes safe two epochs after it was retired
+    m_domain.try_advance();
+    m_domain.try_advance();
+
+    const uint64_t l_epoch = m_domain.epoch();
+
+    epoch_domain::delete_safe(m_garbage, l_epoch);
+    m_record->m_pending.store(m_garbage.size(), std::memory_order_relaxed);
+
+    // garbage of participants that are gone, unless another thread is
+    // already seeing to it
+    std::unique_lock<std::mutex> l_lock(m_domain.m_orphans_mutex,
+                                        std::try_to_lock);
+
+    if(l_lock.owns_lock())
+        epoch_domain::delete_safe(m_domain.m_orphans, l_epoch);
+}
+
+void epoch_participant::pin()
+{
+    if(m_pins++ > 0)
+        return;
+
+    // the epoch may advance between reading it and publishing the pin; a
+    // stale pin would not hold back the reclamation it should
+    while(true)
+    {
+        const uint64_t l_epoch = m_domain.m_epoch.load();
+        m_record->m_state.store(2 * l_epoch + 1);
+
+        if(m_domain.m_epoch.load() == l_epoch)
+            return;
+    }
+}
+
+void epoch_participant::unpin()
+{
+    if(--m_pins == 0)
+        m_record->m_state.store(0, std::memory_order_release);
+}
+
+shared_term::shared_term(std::unique_ptr<expr> a_term)
+    : m_term(a_term.release())
+{
+}
+
+shared_term::~shared_term()
+{
+    delete m_term.load(std::memory_order_acquire);
+}
+
+const expr* shared_term::load(const epoch_guard&) const
+{
+    return m_term.load(std::memory_order_acquire);
+}
+
+void shared_term::store(std::unique_ptr<expr> a_term,
+                        epoch_participant& a_participant)
+{
+    const expr* l_old =
+        m_term.exchange(a_term.release(), std::memory_order_acq_rel);
+
+    if(l_old)
+        a_participant.retire(std::unique_ptr<expr>(const_cast<expr*>(l_old)));
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <algorithm>
+#include <thread>
+
+using namespace lambda;
+
+static std::atomic<size_t> g_epoch_deleted = 0;
+
+static void count_deleted(void* a_object)
+{
+    delete static_cast<int*>(a_object);
+    ++g_epoch_deleted;
+}
+
+void test_epoch_reclamation()
+{
+    // nothing is deleted while a thread that could be reading it is pinned
+    {
+        g_epoch_deleted = 0;
+        epoch_domain l_domain;
+        epoch_participant l_reader(l_domain);
+        epoch_participant l_writer(l_domain);
+
+        {
+            epoch_guard l_guard(l_reader);
+
+            l_writer.retire(new int(1), count_deleted);
+
+            for(size_t i = 0; i < 10; ++i)
+                l_writer.collect();
+
+            assert(g_epoch_deleted == 0);
+            assert(l_domain.pending() == 1);
+        }
+
+        l_writer.collect();
+        assert(g_epoch_deleted == 1);
+        assert(l_domain.pending() == 0);
+    }
+
+    // garbage left by a departed participant is deleted eventually
+    {
+        g_epoch_deleted = 0;
+        epoch_domain l_domain;
+        epoch_participant l_reader(l_domain);
+
+        {
+            epoch_guard l_guard(l_reader);
+            epoch_participant l_writer(l_domain);
+            l_writer.retire(new int(2), count_deleted);
+        }
+
+        assert(g_epoch_deleted == 0);
+        assert(l_domain.pending() == 1);
+
+        l_reader.collect();
+        assert(g_epoch_deleted == 1);
+    }
+
+    // a hot shared root read by 64 threads while it is being replaced
+    {
+        epoch_domain l_domain;
+        shared_term l_root(a(v(0), v(0)));
+        const size_t l_reader_count = 64;
+        const size_t l_replacements = 2000;
+        std::atomic<bool> l_done = false;
+        std::atomic<size_t> l_torn = 0;
+        size_t l_max_pending = 0;
+        std::vector<std::thread> l_threads;
+
+        for(size_t t = 0; t < l_reader_count; ++t)
+            l_threads.emplace_back(
+                [&]
+                {
+                    epoch_participant l_participant(l_domain);
+
+                    while(!l_done.load())
+                    {
+                        epoch_guard l_guard(l_participant);
+                        const app& l_term =
+                            static_cast<const app&>(*l_root.load(l_guard));
+
+                        // a deleted term would not keep both sides equal
+                        if(!l_term.m_lhs->equals(l_term.m_rhs))
+                            ++l_torn;
+                    }
+                });
+
+        epoch_participant l_writer(l_domain);
+
+        for(size_t i = 1; i <= l_replacements; ++i)
+        {
+            l_root.store(a(v(i), v(i)), l_writer);
+            l_max_pending = std::max(l_max_pending, l_domain.pending());
+
+            if(i % 64 == 0)
+                std::this_thread::yield();
+        }
+
+        l_done = true;
+
+        for(std::thread& l_thread : l_threads)
+            l_thread.join();
+
+        assert(l_torn == 0);
+        // garbage is deleted as the writer goes, not all at the end
+        assert(l_max_pending < l_replacements);
+
+        l_writer.collect();
+        assert(l_domain.pending() == 0);
+    }
+
+    // readers alone never write the shared epoch
+    {
+        epoch_domain l_domain;
+        shared_term l_root(f(v(0)));
+        const uint64_t l_epoch = l_domain.epoch();
+        std::vector<std::thread> l_threads;
+
+        for(size_t t = 0; t < 64; ++t)
+            l_threads.emplace_back(
+                [&]
+                {
+                    epoch_participant l_participant(l_domain);
+
+                    for(size_t i = 0; i < 1000; ++i)
+                    {
+                        epoch_guard l_guard(l_participant);
+                        assert(l_root.load(l_guard)->m_size == 2);
+                    }
+                });
+
+        for(std::thread& l_thread : l_threads)
+            l_thread.join();
+
+        assert(l_domain.epoch() == l_epoch);
+        assert(l_domain.pending() == 0);
+    }
+}
+
+void epoch_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_epoch_reclamation);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include <string>
+#include <thread>
+
+using namespace lambda;
+
+void bench_hot_root()
+{
+    const size_t l_runs = 3;
+    const size_t l_reads_per_thread = 200000;
+
+    // every thread repeatedly reads the size of one shared helper
+    auto l_helper = f(f(a(v(0), v(1))));
+    const std::shared_ptr<const expr> l_counted(l_helper->clone());
+    shared_term l_shared(l_helper->clone());
+
+    for(size_t l_thread_count : {1, 4, 16, 64})
+    {
+        auto l_run = [&](auto&& a_read)
+        {
+            return measure_best_of(
+                l_runs, [] {},
+                [&]
+                {
+                    std::vector<std::thread> l_threads;
+
+                    for(size_t t = 0; t < l_thread_count; ++t)
+                        l_threads.emplace_back(a_read);
+
+                    for(std::thread& l_thread : l_threads)
+                        l_thread.join();
+                });
+        };
+
+        // a copy of the shared_ptr per read, as a reference-counted cache
+        // would hand out
+        measurement l_measured = l_run(
+            [&]
+            {
+                size_t l_sum = 0;
+
+                for(size_t i = 0; i < l_reads_per_thread; ++i)
+                {
+                    std::shared_ptr<const expr> l_copy = l_counted;
+                    l_sum += l_copy->m_size;
+                }
+
+                keep(l_sum);
+            });
+
+        std::string l_name =
+            "shared_ptr copy, " + std::to_string(l_thread_count) + " threads";
+        report(l_name.c_str(), l_measured, l_thread_count * l_reads_per_thread);
+
+        epoch_domain l_domain;
+
+        l_measured = l_run(
+            [&]
+            {
+                epoch_participant l_participant(l_domain);
+                size_t l_sum = 0;
+
+                for(size_t i = 0; i < l_reads_per_thread; ++i)
+                {
+                    epoch_guard l_guard(l_participant);
+                    l_sum += l_shared.load(l_guard)->m_size;
+                }
+
+                keep(l_sum);
+            });
+
+        l_name = "epoch pin, " + std::to_string(l_thread_count) + " threads";
+        report(l_name.c_str(), l_measured, l_thread_count * l_reads_per_thread);
+    }
+}
+
+void epoch_bench_main()
+{
+    BENCH(bench_hot_root);
+}
+
+#endif
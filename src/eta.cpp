@@ -0,0 +1,265 @@
+#include "../include/eta.hpp"
+#include <stdexcept>
+
+namespace lambda
+{
+
+// whether a_expr contains the variable with level a_level.
+static bool uses(const expr& a_expr, size_t a_level)
+{
+    if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+        return l_var->m_index == a_level;
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return uses(*l_func->m_body, a_level);
+
+    const app* l_app = dynamic_cast<const app*>(&a_expr);
+
+    return l_app &&
+           (uses(*l_app->m_lhs, a_level) || uses(*l_app->m_rhs, a_level));
+}
+
+// moves a_expr, which does not use level a_level, up one binder: the levels
+// above a_level, bound inside a_expr, drop by one.
+static void lower_above(expr& a_expr, size_t a_level)
+{
+    if(var* l_var = dynamic_cast<var*>(&a_expr))
+    {
+        if(l_var->m_index > a_level)
+            --l_var->m_index;
+    }
+    else if(func* l_func = dynamic_cast<func*>(&a_expr))
+        lower_above(*l_func->m_body, a_level);
+    else if(app* l_app = dynamic_cast<app*>(&a_expr))
+    {
+        lower_above(*l_app->m_lhs, a_level);
+        lower_above(*l_app->m_rhs, a_level);
+    }
+}
+
+size_t eta_reduce(std::unique_ptr<expr>& a_expr, size_t a_depth)
+{
+    if(dynamic_cast<const var*>(a_expr.get()))
+        return 0;
+
+    if(func* l_func = dynamic_cast<func*>(a_expr.get()))
+    {
+        // the body first, so that a contraction there can expose this one
+        const size_t l_count = eta_reduce(l_func->m_body, a_depth + 1);
+
+        app* l_body = dynamic_cast<app*>(l_func->m_body.get());
+        const var* l_arg =
+            l_body ? dynamic_cast<const var*>(l_body->m_rhs.get()) : nullptr;
+
+        if(!l_arg || l_arg->m_index != a_depth ||
+           uses(*l_body->m_lhs, a_depth))
+        {
+            a_expr->update_size();
+            return l_count;
+        }
+
+        // λ.(M x) → M; the sizes within M are unchanged
+        std::unique_ptr<expr> l_result = std::move(l_body->m_lhs);
+        lower_above(*l_result, a_depth);
+        a_expr = std::move(l_result);
+
+        return l_count + 1;
+    }
+
+    if(app* l_app = dynamic_cast<app*>(a_expr.get()))
+    {
+        const size_t l_count = eta_reduce(l_app->m_lhs, a_depth) +
+                               eta_reduce(l_app->m_rhs, a_depth);
+        a_expr->update_size();
+
+        return l_count;
+    }
+
+    // if we get here, error
+    throw std::runtime_error("eta_reduce: invalid expression type");
+}
+
+std::unique_ptr<expr> eta_canonical(const expr& a_expr, size_t a_depth)
+{
+    std::unique_ptr<expr> l_result = a_expr.clone();
+    eta_reduce(l_result, a_depth);
+
+    return l_result;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../include/corpus.hpp"
+#include "../include/normalize.hpp"
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+void test_eta_reduce()
+{
+    // λ.(M x) → M, under a binder so that M can be free: λ.((0 1)) at depth
+    // 1 is the variable 0
+    {
+        auto l_expr = f(a(v(0), v(1)));
+        assert(eta_reduce(l_expr, 1) == 1);
+        assert(l_expr->equals(v(0)));
+        assert(l_expr->m_size == 1);
+    }
+
+    // not a redex: M uses the binder, or the argument is another variable
+    {
+        auto l_uses = f(a(v(0), v(0)));
+        assert(eta_reduce(l_uses) == 0);
+        assert(l_uses->equals(f(a(v(0), v(0)))));
+
+        auto l_other = f(a(v(0), v(0)));
+        assert(eta_reduce(l_other, 1) == 0);
+        assert(l_other->equals(f(a(v(0), v(0)))));
+
+        auto l_identity = f(v(0));
+        assert(eta_reduce(l_identity) == 0);
+        assert(l_identity->equals(f(v(0))));
+    }
+
+    // levels bound inside M move up one binder, and sizes are kept
+    {
+        // λ.((0 λ.2) 1) at depth 1 → (0 λ.1)
+        auto l_expr = f(a(a(v(0), f(v(2))), v(1)));
+        assert(eta_reduce(l_expr, 1) == 1);
+        assert(l_expr->equals(a(v(0), f(v(1)))));
+        assert(l_expr->m_size == 4);
+    }
+
+    // a contraction exposes the one around it: λ.λ.((0 1) 2) at depth 1
+    {
+        auto l_expr = f(f(a(a(v(0), v(1)), v(2))));
+        assert(eta_reduce(l_expr, 1) == 2);
+        assert(l_expr->equals(v(0)));
+    }
+
+    // redexes are found anywhere, and the sizes above them are updated:
+    // ONE = λ.λ.(0 1) is the identity once eta-reduced
+    {
+        auto l_expr = a(f(v(0)), f(f(a(v(0), v(1)))));
+        assert(eta_reduce(l_expr) == 1);
+        assert(l_expr->equals(a(f(v(0)), f(v(0)))));
+        assert(l_expr->m_size == 5);
+    }
+
+    // eta_canonical() leaves its input alone, and keeps beta-normal forms
+    // normal
+    {
+        const auto l_expr = f(f(a(v(1), f(a(a(v(0), v(1)), v(2))))));
+        const auto l_canonical = eta_canonical(*l_expr);
+
+        assert(l_expr->equals(f(f(a(v(1), f(a(a(v(0), v(1)), v(2))))))));
+        assert(l_canonical->equals(f(f(a(v(1), a(v(0), v(1)))))));
+        assert(is_normal(*l_canonical));
+    }
+
+    // dedup can compare eta-reduced forms
+    {
+        std::vector<std::unique_ptr<expr>> l_exprs;
+        // ONE, the identity, and ONE with its outer binder eta-expanded
+        l_exprs.push_back(f(f(a(v(0), v(1)))));
+        l_exprs.push_back(f(v(0)));
+        l_exprs.push_back(f(a(f(f(a(v(1), v(2)))), v(0))));
+        l_exprs.push_back(f(f(v(0))));
+
+        assert(dedup(l_exprs) == std::vector<size_t>({0, 1, 2, 3}));
+        assert(dedup(l_exprs, equivalence::eta) ==
+               std::vector<size_t>({0, 0, 0, 3}));
+    }
+
+    // invalid
+    {
+        std::unique_ptr<expr> l_null;
+        assert_throws(eta_reduce(l_null), std::runtime_error);
+    }
+}
+
+void eta_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_eta_reduce);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include "../include/corpus.hpp"
+
+using namespace lambda;
+
+void bench_eta_dedup()
+{
+    const size_t l_runs = 5;
+    const size_t l_numerals = 200;
+    const size_t l_wrappers = 8;
+
+    // church numerals, each as written and eta-expanded up to l_wrappers
+    // times, as different producers might return them
+    std::vector<std::unique_ptr<expr>> l_exprs;
+
+    for(size_t n = 0; n < l_numerals; ++n)
+    {
+        std::unique_ptr<expr> l_body = v(1);
+
+        for(size_t i = 0; i < n; ++i)
+            l_body = a(v(0), std::move(l_body));
+
+        std::unique_ptr<expr> l_term = f(f(std::move(l_body)));
+
+        for(size_t i = 0; i <= l_wrappers; ++i)
+        {
+            l_exprs.push_back(l_term->clone());
+
+            // λ.(T 0), with T one binder deeper
+            l_term->lift(1, 0);
+            l_term = f(a(std::move(l_term), v(0)));
+        }
+    }
+
+    size_t l_nodes = 0;
+
+    for(const auto& l_expr : l_exprs)
+        l_nodes += l_expr->m_size;
+
+    // number of distinct keys in a dedup result
+    auto l_distinct = [](const std::vector<size_t>& a_result)
+    {
+        size_t l_count = 0;
+
+        for(size_t i = 0; i < a_result.size(); ++i)
+            l_count += a_result[i] == i;
+
+        return l_count;
+    };
+
+    std::vector<size_t> l_result;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [] {}, [&] { l_result = dedup(l_exprs); });
+    report("dedup (syntactic)", l_measured, l_nodes);
+    std::cout << "    " << l_exprs.size() << " terms, "
+              << l_distinct(l_result) << " distinct" << std::endl;
+
+    l_measured = measure_best_of(
+        l_runs, [] {},
+        [&] { l_result = dedup(l_exprs, equivalence::eta); });
+    report("dedup (eta)", l_measured, l_nodes);
+    std::cout << "    " << l_exprs.size() << " terms, "
+              << l_distinct(l_result) << " distinct" << std::endl;
+}
+
+void eta_bench_main()
+{
+    BENCH(bench_eta_dedup);
+}
+
+#endif
@@ -0,0 +1,1809 @@
+#include "../include/flat.hpp"
+#include "../include/hash.hpp"
+#include "../include/metrics.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LC_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace lambda
+{
+
+// SCALAR KERNELS
+
+static void lift_levels_scalar(uint32_t* a_levels, size_t a_count,
+                               uint32_t a_lift_amount, uint32_t a_cutoff)
+{
+    for(size_t i = 0; i < a_count; ++i)
+        if(a_levels[i] >= a_cutoff)
+            a_levels[i] += a_lift_amount;
+}
+
+static void lower_levels_scalar(uint32_t* a_levels, size_t a_count,
+                                uint32_t a_var_index)
+{
+    for(size_t i = 0; i < a_count; ++i)
+        if(a_levels[i] > a_var_index)
+            --a_levels[i];
+}
+
+static uint32_t level_bound_scalar(const uint32_t* a_levels, size_t a_count,
+                                   uint32_t a_limit)
+{
+    uint32_t l_bound = 0;
+
+    for(size_t i = 0; i < a_count; ++i)
+        if(a_levels[i] < a_limit && a_levels[i] >= l_bound)
+            l_bound = a_levels[i] + 1;
+
+    return l_bound;
+}
+
+static size_t find_redex_scalar(const node_tag* a_tags, size_t a_count)
+{
+    for(size_t i = 0; i + 1 < a_count; ++i)
+        if(a_tags[i] == node_tag::app && a_tags[i + 1] == node_tag::func)
+            return i;
+
+    return a_count;
+}
+
+// the pending count, the number of subtrees still to read, rises by one at
+// an app, stays at a func and falls by one at a var: the tag minus one. A
+// func encloses a later position as long as the count has not fallen below
+// its own in between, so walking backwards while keeping the lowest count
+// seen decides every func without a stack. Counts are relative to the one
+// at the position; a_pending and a_lowest carry them in from tags after
+// a_count, which the vectorized kernels have already handled.
+static size_t enclosing_binders_scalar(const node_tag* a_tags, size_t a_count,
+                                       ptrdiff_t a_pending, ptrdiff_t a_lowest,
+                                       size_t& a_vars)
+{
+    size_t l_binders = 0;
+
+    for(size_t i = a_count; i-- > 0;)
+    {
+        const node_tag l_tag = a_tags[i];
+
+        a_pending -= static_cast<ptrdiff_t>(l_tag) - 1;
+
+        if(l_tag == node_tag::func && a_pending <= a_lowest)
+            ++l_binders;
+
+        a_vars += l_tag == node_tag::var;
+        a_lowest = std::min(a_lowest, a_pending);
+    }
+
+    return l_binders;
+}
+
+// BYTE KERNELS
+// hash_bytes() consumes 64-byte stripes as eight 64-bit lanes, in the
+// manner of xxh3: every lane adds the product of the two halves of its word
+// xored with a key, plus the raw word of its neighbour. Keys change with
+// every stripe so that reordering stripes changes the hash. A final partial
+// stripe is zero-padded, and the length is mixed in at the end.
+
+constexpr size_t HASH_STRIPE = 64;
+constexpr uint64_t HASH_KEYS[8] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull,
+    0x1f67b3b7a4a44072ull, 0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull,
+    0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull};
+constexpr uint64_t HASH_KEY_STEP = 0x9e3779b97f4a7c15ull;
+
+static void hash_stripe_scalar(uint64_t* a_acc, const unsigned char* a_stripe,
+                               uint64_t a_stripe_index)
+{
+    uint64_t l_words[8];
+    std::memcpy(l_words, a_stripe, HASH_STRIPE);
+
+    for(size_t i = 0; i < 8; ++i)
+    {
+        const uint64_t l_keyed =
+            l_words[i] ^ (HASH_KEYS[i] + a_stripe_index * HASH_KEY_STEP);
+
+        a_acc[i] += (l_keyed & 0xffffffffull) * (l_keyed >> 32);
+        a_acc[i] += l_words[i ^ 1];
+    }
+}
+
+// hashes the partial stripe left after the full ones and folds the lanes.
+static uint64_t hash_finish(uint64_t* a_acc, const unsigned char* a_bytes,
+                            size_t a_count)
+{
+    const size_t l_full = a_count / HASH_STRIPE;
+
+    if(a_count % HASH_STRIPE)
+    {
+        unsigned char l_padded[HASH_STRIPE] = {};
+        std::memcpy(l_padded, a_bytes + l_full * HASH_STRIPE,
+                    a_count % HASH_STRIPE);
+        hash_stripe_scalar(a_acc, l_padded, l_full);
+    }
+
+    uint64_t l_hash = hash_mix(a_count);
+
+    for(size_t i = 0; i < 8; ++i)
+        l_hash = hash_combine(l_hash, a_acc[i]);
+
+    return l_hash;
+}
+
+static uint64_t hash_bytes_scalar(const unsigned char* a_bytes, size_t a_count)
+{
+    uint64_t l_acc[8];
+    std::memcpy(l_acc, HASH_KEYS, sizeof(l_acc));
+
+    for(size_t j = 0; j < a_count / HASH_STRIPE; ++j)
+        hash_stripe_scalar(l_acc, a_bytes + j * HASH_STRIPE, j);
+
+    return hash_finish(l_acc, a_bytes, a_count);
+}
+
+static bool bytes_equal_scalar(const unsigned char* a_lhs,
+                               const unsigned char* a_rhs, size_t a_count)
+{
+    return std::memcmp(a_lhs, a_rhs, a_count) == 0;
+}
+
+#ifdef LC_X86_KERNELS
+
+// AVX2 KERNELS
+// avx2 has no unsigned 32-bit comparison, so x >= c is computed as
+// max(x, c) == x. The tail that does not fill a vector is left to the
+// scalar kernels.
+
+__attribute__((target("avx2"))) static void
+lift_levels_avx2(uint32_t* a_levels, size_t a_count, uint32_t a_lift_amount,
+                 uint32_t a_cutoff)
+{
+    const __m256i l_amount = _mm256_set1_epi32(a_lift_amount);
+    const __m256i l_cutoff = _mm256_set1_epi32(a_cutoff);
+
+    size_t i = 0;
+
+    for(; i + 8 <= a_count; i += 8)
+    {
+        __m256i* l_ptr = reinterpret_cast<__m256i*>(a_levels + i);
+        __m256i l_levels = _mm256_loadu_si256(l_ptr);
+        __m256i l_lift = _mm256_cmpeq_epi32(
+            _mm256_max_epu32(l_levels, l_cutoff), l_levels);
+
+        l_levels = _mm256_add_epi32(l_levels,
+                                    _mm256_and_si256(l_lift, l_amount));
+        _mm256_storeu_si256(l_ptr, l_levels);
+    }
+
+    lift_levels_scalar(a_levels + i, a_count - i, a_lift_amount, a_cutoff);
+}
+
+__attribute__((target("avx2"))) static void
+lower_levels_avx2(uint32_t* a_levels, size_t a_count, uint32_t a_var_index)
+{
+    // no level can exceed the largest one
+    if(a_var_index == UINT32_MAX)
+        return;
+
+    const __m256i l_threshold = _mm256_set1_epi32(a_var_index + 1);
+
+    size_t i = 0;
+
+    for(; i + 8 <= a_count; i += 8)
+    {
+        __m256i* l_ptr = reinterpret_cast<__m256i*>(a_levels + i);
+        __m256i l_levels = _mm256_loadu_si256(l_ptr);
+        // all ones (-1) where the level must be lowered
+        __m256i l_lower = _mm256_cmpeq_epi32(
+            _mm256_max_epu32(l_levels, l_threshold), l_levels);
+
+        _mm256_storeu_si256(l_ptr, _mm256_add_epi32(l_levels, l_lower));
+    }
+
+    lower_levels_scalar(a_levels + i, a_count - i, a_var_index);
+}
+
+__attribute__((target("avx2"))) static uint32_t
+level_bound_avx2(const uint32_t* a_levels, size_t a_count, uint32_t a_limit)
+{
+    const __m256i l_limit = _mm256_set1_epi32(a_limit);
+    const __m256i l_one = _mm256_set1_epi32(1);
+    __m256i l_bound = _mm256_setzero_si256();
+
+    size_t i = 0;
+
+    for(; i + 8 <= a_count; i += 8)
+    {
+        __m256i l_levels = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(a_levels + i));
+        __m256i l_at_or_above = _mm256_cmpeq_epi32(
+            _mm256_max_epu32(l_levels, l_limit), l_levels);
+        // level + 1 cannot wrap, since it only counts when below the limit
+        __m256i l_candidate = _mm256_andnot_si256(
+            l_at_or_above, _mm256_add_epi32(l_levels, l_one));
+
+        l_bound = _mm256_max_epu32(l_bound, l_candidate);
+    }
+
+    alignas(32) uint32_t l_lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l_lanes), l_bound);
+
+    uint32_t l_result = level_bound_scalar(a_levels + i, a_count - i, a_limit);
+
+    for(uint32_t l_lane : l_lanes)
+        if(l_lane > l_result)
+            l_result = l_lane;
+
+    return l_result;
+}
+
+// AVX-512 KERNELS
+// avx-512 compares unsigned values directly and masks the tail, so no
+// scalar loop is needed.
+
+__attribute__((target("avx512f"))) static void
+lift_levels_avx512(uint32_t* a_levels, size_t a_count, uint32_t a_lift_amount,
+                   uint32_t a_cutoff)
+{
+    const __m512i l_amount = _mm512_set1_epi32(a_lift_amount);
+    const __m512i l_cutoff = _mm512_set1_epi32(a_cutoff);
+
+    for(size_t i = 0; i < a_count; i += 16)
+    {
+        const size_t l_remaining = a_count - i;
+        const __mmask16 l_lanes =
+            l_remaining >= 16 ? 0xffff : (1u << l_remaining) - 1;
+
+        __m512i l_levels = _mm512_maskz_loadu_epi32(l_lanes, a_levels + i);
+        __mmask16 l_lift =
+            _mm512_mask_cmpge_epu32_mask(l_lanes, l_levels, l_cutoff);
+
+        l_levels = _mm512_mask_add_epi32(l_levels, l_lift, l_levels, l_amount);
+        _mm512_mask_storeu_epi32(a_levels + i, l_lanes, l_levels);
+    }
+}
+
+__attribute__((target("avx512f"))) static void
+lower_levels_avx512(uint32_t* a_levels, size_t a_count, uint32_t a_var_index)
+{
+    const __m512i l_var_index = _mm512_set1_epi32(a_var_index);
+    const __m512i l_one = _mm512_set1_epi32(1);
+
+    for(size_t i = 0; i < a_count; i += 16)
+    {
+        const size_t l_remaining = a_count - i;
+        const __mmask16 l_lanes =
+            l_remaining >= 16 ? 0xffff : (1u << l_remaining) - 1;
+
+        __m512i l_levels = _mm512_maskz_loadu_epi32(l_lanes, a_levels + i);
+        __mmask16 l_lower =
+            _mm512_mask_cmpgt_epu32_mask(l_lanes, l_levels, l_var_index);
+
+        l_levels = _mm512_mask_sub_epi32(l_levels, l_lower, l_levels, l_one);
+        _mm512_mask_storeu_epi32(a_levels + i, l_lanes, l_levels);
+    }
+}
+
+__attribute__((target("avx512f"))) static uint32_t
+level_bound_avx512(const uint32_t* a_levels, size_t a_count, uint32_t a_limit)
+{
+    const __m512i l_limit = _mm512_set1_epi32(a_limit);
+    const __m512i l_one = _mm512_set1_epi32(1);
+    __m512i l_bound = _mm512_setzero_si512();
+
+    for(size_t i = 0; i < a_count; i += 16)
+    {
+        const size_t l_remaining = a_count - i;
+        const __mmask16 l_lanes =
+            l_remaining >= 16 ? 0xffff : (1u << l_remaining) - 1;
+
+        __m512i l_levels = _mm512_maskz_loadu_epi32(l_lanes, a_levels + i);
+        __mmask16 l_below =
+            _mm512_mask_cmplt_epu32_mask(l_lanes, l_levels, l_limit);
+
+        l_bound = _mm512_mask_max_epu32(l_bound, l_below, l_bound,
+                                        _mm512_add_epi32(l_levels, l_one));
+    }
+
+    // the zero-masked forms: GCC 12 builds the unmasked ones, the casts and
+    // the reductions on an undefined vector, which -Wall reports as
+    // uninitialized (GCC bug 105593)
+    const __m256i l_half =
+        _mm256_max_epu32(_mm512_maskz_extracti64x4_epi64(0xf, l_bound, 0),
+                         _mm512_maskz_extracti64x4_epi64(0xf, l_bound, 1));
+
+    uint32_t l_lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(l_lanes), l_half);
+
+    return *std::max_element(l_lanes, l_lanes + 8);
+}
+
+// TAG KERNELS
+// a redex is a position where the tags compare equal to app and the tags
+// one byte further compare equal to func, so two overlapping loads and two
+// byte comparisons test a whole vector of positions at once.
+
+__attribute__((target("avx2"))) static size_t
+find_redex_avx2(const node_tag* a_tags, size_t a_count)
+{
+    const char* l_bytes = reinterpret_cast<const char*>(a_tags);
+    const __m256i l_app = _mm256_set1_epi8(static_cast<char>(node_tag::app));
+    const __m256i l_func = _mm256_set1_epi8(static_cast<char>(node_tag::func));
+
+    size_t i = 0;
+
+    for(; i + 33 <= a_count; i += 32)
+    {
+        __m256i l_here = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(l_bytes + i));
+        __m256i l_next = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(l_bytes + i + 1));
+        uint32_t l_found = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(l_here, l_app),
+                             _mm256_cmpeq_epi8(l_next, l_func)));
+
+        if(l_found)
+            return i + __builtin_ctz(l_found);
+    }
+
+    return i + find_redex_scalar(a_tags + i, a_count - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static size_t
+find_redex_avx512(const node_tag* a_tags, size_t a_count)
+{
+    const char* l_bytes = reinterpret_cast<const char*>(a_tags);
+    const __m512i l_app = _mm512_set1_epi8(static_cast<char>(node_tag::app));
+    const __m512i l_func = _mm512_set1_epi8(static_cast<char>(node_tag::func));
+
+    // the last tag cannot start a redex
+    for(size_t i = 0; i + 1 < a_count; i += 64)
+    {
+        const size_t l_remaining = a_count - 1 - i;
+        const __mmask64 l_lanes =
+            l_remaining >= 64 ? ~0ull : (1ull << l_remaining) - 1;
+
+        __m512i l_here = _mm512_maskz_loadu_epi8(l_lanes, l_bytes + i);
+        __m512i l_next = _mm512_maskz_loadu_epi8(l_lanes, l_bytes + i + 1);
+        __mmask64 l_found =
+            _mm512_mask_cmpeq_epi8_mask(
+                _mm512_mask_cmpeq_epi8_mask(l_lanes, l_here, l_app), l_next,
+                l_func);
+
+        if(l_found)
+            return i + __builtin_ctzll(l_found);
+    }
+
+    return a_count;
+}
+
+// enclosing_binders() takes a block of tags at a time from the back. The
+// pending count before each tag is a suffix sum of the tags minus one, and
+// the lowest count after each tag within the block a suffix minimum, both
+// built in log2 of the block size shifts. Only a compare against the
+// lowest count after the block depends on the blocks before, so blocks do
+// not wait on each other. Within a block the counts stay within the block
+// size of the one at its end, so that lowest count is clamped just below
+// that range to fit 32 bits.
+
+// shifts the lanes of a_lanes a_shift places down, filling the top ones
+// from a_fill. The permutes and blends need their indices as constants.
+template <int SHIFT>
+__attribute__((target("avx2"))) static __m256i shift_lanes_avx2(__m256i a_lanes,
+                                                                 __m256i a_fill)
+{
+    const __m256i l_index = _mm256_setr_epi32(
+        std::min(SHIFT, 7), std::min(SHIFT + 1, 7), std::min(SHIFT + 2, 7),
+        std::min(SHIFT + 3, 7), std::min(SHIFT + 4, 7), std::min(SHIFT + 5, 7),
+        std::min(SHIFT + 6, 7), 7);
+
+    return _mm256_blend_epi32(_mm256_permutevar8x32_epi32(a_lanes, l_index),
+                              a_fill, (0xff << (8 - SHIFT)) & 0xff);
+}
+
+__attribute__((target("avx2"))) static size_t
+enclosing_binders_avx2(const node_tag* a_tags, size_t a_count, size_t& a_vars)
+{
+    const __m256i l_zero = _mm256_setzero_si256();
+    const __m256i l_func = _mm256_set1_epi32(static_cast<int>(node_tag::func));
+    const __m256i l_none = _mm256_set1_epi32(INT32_MAX);
+
+    ptrdiff_t l_pending = 0;
+    ptrdiff_t l_lowest = 0;
+    size_t l_binders = 0;
+    size_t l_end = a_count;
+
+    for(; l_end >= 8; l_end -= 8)
+    {
+        __m256i l_tags = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(a_tags + l_end - 8)));
+
+        // the counts before each tag, relative to the one at l_end
+        __m256i l_sum = _mm256_sub_epi32(l_tags, l_func);
+        l_sum = _mm256_add_epi32(l_sum, shift_lanes_avx2<1>(l_sum, l_zero));
+        l_sum = _mm256_add_epi32(l_sum, shift_lanes_avx2<2>(l_sum, l_zero));
+        l_sum = _mm256_add_epi32(l_sum, shift_lanes_avx2<4>(l_sum, l_zero));
+        const __m256i l_counts = _mm256_sub_epi32(l_zero, l_sum);
+
+        // the lowest count after each tag within the block
+        __m256i l_low = shift_lanes_avx2<1>(l_counts, l_none);
+        l_low = _mm256_min_epi32(l_low, shift_lanes_avx2<1>(l_low, l_none));
+        l_low = _mm256_min_epi32(l_low, shift_lanes_avx2<2>(l_low, l_none));
+        l_low = _mm256_min_epi32(l_low, shift_lanes_avx2<4>(l_low, l_none));
+
+        const __m256i l_after = _mm256_set1_epi32(static_cast<int32_t>(
+            std::max<ptrdiff_t>(l_lowest - l_pending, -9)));
+        const __m256i l_enclosing = _mm256_andnot_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(l_counts, l_low),
+                            _mm256_cmpgt_epi32(l_counts, l_after)),
+            _mm256_cmpeq_epi32(l_tags, l_func));
+
+        l_binders += __builtin_popcount(
+            _mm256_movemask_ps(_mm256_castsi256_ps(l_enclosing)));
+        a_vars += __builtin_popcount(_mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(l_tags, l_zero))));
+
+        const ptrdiff_t l_first = _mm256_cvtsi256_si32(l_counts);
+
+        l_lowest = std::min(
+            l_lowest,
+            l_pending + std::min<ptrdiff_t>(l_first,
+                                            _mm256_cvtsi256_si32(l_low)));
+        l_pending += l_first;
+    }
+
+    return l_binders + enclosing_binders_scalar(a_tags, l_end, l_pending,
+                                                l_lowest, a_vars);
+}
+
+// the zero-masked forms for the same reason as in level_bound_avx512().
+__attribute__((target("avx512f"))) static size_t
+enclosing_binders_avx512(const node_tag* a_tags, size_t a_count,
+                         size_t& a_vars)
+{
+    const __m512i l_zero = _mm512_setzero_si512();
+    const __m512i l_func = _mm512_set1_epi32(static_cast<int>(node_tag::func));
+    const __m512i l_none = _mm512_set1_epi32(INT32_MAX);
+
+    ptrdiff_t l_pending = 0;
+    ptrdiff_t l_lowest = 0;
+    size_t l_binders = 0;
+    size_t l_end = a_count;
+
+    for(; l_end >= 16; l_end -= 16)
+    {
+        __m512i l_tags = _mm512_maskz_cvtepu8_epi32(
+            0xffff, _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(a_tags + l_end - 16)));
+
+        // the counts before each tag, relative to the one at l_end
+        __m512i l_sum = _mm512_sub_epi32(l_tags, l_func);
+        l_sum = _mm512_add_epi32(
+            l_sum, _mm512_maskz_alignr_epi32(0xffff, l_zero, l_sum, 1));
+        l_sum = _mm512_add_epi32(
+            l_sum, _mm512_maskz_alignr_epi32(0xffff, l_zero, l_sum, 2));
+        l_sum = _mm512_add_epi32(
+            l_sum, _mm512_maskz_alignr_epi32(0xffff, l_zero, l_sum, 4));
+        l_sum = _mm512_add_epi32(
+            l_sum, _mm512_maskz_alignr_epi32(0xffff, l_zero, l_sum, 8));
+        const __m512i l_counts = _mm512_sub_epi32(l_zero, l_sum);
+
+        // the lowest count after each tag within the block
+        __m512i l_low = _mm512_maskz_alignr_epi32(0xffff, l_none, l_counts, 1);
+        l_low = _mm512_maskz_min_epi32(
+            0xffff, l_low,
+            _mm512_maskz_alignr_epi32(0xffff, l_none, l_low, 1));
+        l_low = _mm512_maskz_min_epi32(
+            0xffff, l_low,
+            _mm512_maskz_alignr_epi32(0xffff, l_none, l_low, 2));
+        l_low = _mm512_maskz_min_epi32(
+            0xffff, l_low,
+            _mm512_maskz_alignr_epi32(0xffff, l_none, l_low, 4));
+        l_low = _mm512_maskz_min_epi32(
+            0xffff, l_low,
+            _mm512_maskz_alignr_epi32(0xffff, l_none, l_low, 8));
+
+        const __m512i l_after = _mm512_set1_epi32(static_cast<int32_t>(
+            std::max<ptrdiff_t>(l_lowest - l_pending, -17)));
+        const __mmask16 l_enclosing = _mm512_mask_cmple_epi32_mask(
+            _mm512_mask_cmple_epi32_mask(
+                _mm512_cmpeq_epi32_mask(l_tags, l_func), l_counts, l_low),
+            l_counts, l_after);
+
+        l_binders += __builtin_popcount(l_enclosing);
+        a_vars += __builtin_popcount(_mm512_cmpeq_epi32_mask(l_tags, l_zero));
+
+        const ptrdiff_t l_first = _mm512_cvtsi512_si32(l_counts);
+
+        l_lowest = std::min(
+            l_lowest,
+            l_pending + std::min<ptrdiff_t>(l_first,
+                                            _mm512_cvtsi512_si32(l_low)));
+        l_pending += l_first;
+    }
+
+    return l_binders + enclosing_binders_scalar(a_tags, l_end, l_pending,
+                                                l_lowest, a_vars);
+}
+
+// BYTE KERNELS
+// both hash implementations keep the eight lanes in registers and hand the
+// partial stripe to hash_finish(), so all three agree bit for bit.
+
+__attribute__((target("avx2"))) static uint64_t
+hash_bytes_avx2(const unsigned char* a_bytes, size_t a_count)
+{
+    const __m256i l_step = _mm256_set1_epi64x(HASH_KEY_STEP);
+    __m256i l_acc[2];
+    __m256i l_keys[2];
+
+    for(size_t h = 0; h < 2; ++h)
+    {
+        l_acc[h] = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(HASH_KEYS + 4 * h));
+        l_keys[h] = l_acc[h];
+    }
+
+    for(size_t j = 0; j < a_count / HASH_STRIPE; ++j)
+    {
+        for(size_t h = 0; h < 2; ++h)
+        {
+            const unsigned char* l_ptr = a_bytes + j * HASH_STRIPE + 32 * h;
+            __m256i l_words =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(l_ptr));
+            __m256i l_keyed = _mm256_xor_si256(l_words, l_keys[h]);
+
+            l_acc[h] = _mm256_add_epi64(
+                l_acc[h],
+                _mm256_mul_epu32(l_keyed, _mm256_srli_epi64(l_keyed, 32)));
+            // swaps neighbouring 64-bit words
+            l_acc[h] = _mm256_add_epi64(
+                l_acc[h], _mm256_shuffle_epi32(l_words, 0x4e));
+            l_keys[h] = _mm256_add_epi64(l_keys[h], l_step);
+        }
+    }
+
+    uint64_t l_lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(l_lanes), l_acc[0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(l_lanes + 4), l_acc[1]);
+
+    return hash_finish(l_lanes, a_bytes, a_count);
+}
+
+__attribute__((target("avx2"))) static bool
+bytes_equal_avx2(const unsigned char* a_lhs, const unsigned char* a_rhs,
+                 size_t a_count)
+{
+    size_t i = 0;
+
+    for(; i + 32 <= a_count; i += 32)
+    {
+        __m256i l_lhs =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_lhs + i));
+        __m256i l_rhs =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_rhs + i));
+
+        if(_mm256_movemask_epi8(_mm256_cmpeq_epi8(l_lhs, l_rhs)) != -1)
+            return false;
+    }
+
+    return bytes_equal_scalar(a_lhs + i, a_rhs + i, a_count - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static uint64_t
+hash_bytes_avx512(const unsigned char* a_bytes, size_t a_count)
+{
+    const __m512i l_step = _mm512_set1_epi64(HASH_KEY_STEP);
+    __m512i l_acc = _mm512_loadu_si512(HASH_KEYS);
+    __m512i l_keys = l_acc;
+
+    for(size_t j = 0; j < a_count / HASH_STRIPE; ++j)
+    {
+        __m512i l_words = _mm512_loadu_si512(a_bytes + j * HASH_STRIPE);
+        __m512i l_keyed = _mm512_xor_si512(l_words, l_keys);
+
+        // zero-masked for the same reason as in level_bound_avx512()
+        l_acc = _mm512_add_epi64(
+            l_acc,
+            _mm512_maskz_mul_epu32(0xff, l_keyed,
+                                   _mm512_maskz_srli_epi64(0xff, l_keyed, 32)));
+        l_acc = _mm512_add_epi64(
+            l_acc, _mm512_maskz_shuffle_epi32(0xffff, l_words, _MM_PERM_BADC));
+        l_keys = _mm512_add_epi64(l_keys, l_step);
+    }
+
+    uint64_t l_lanes[8];
+    _mm512_storeu_si512(l_lanes, l_acc);
+
+    return hash_finish(l_lanes, a_bytes, a_count);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static bool
+bytes_equal_avx512(const unsigned char* a_lhs, const unsigned char* a_rhs,
+                   size_t a_count)
+{
+    for(size_t i = 0; i < a_count; i += 64)
+    {
+        const size_t l_remaining = a_count - i;
+        const __mmask64 l_lanes =
+            l_remaining >= 64 ? ~0ull : (1ull << l_remaining) - 1;
+
+        __m512i l_lhs = _mm512_maskz_loadu_epi8(l_lanes, a_lhs + i);
+        __m512i l_rhs = _mm512_maskz_loadu_epi8(l_lanes, a_rhs + i);
+
+        if(_mm512_mask_cmpneq_epi8_mask(l_lanes, l_lhs, l_rhs))
+            return false;
+    }
+
+    return true;
+}
+
+#endif
+
+// DISPATCH
+
+simd_level best_simd_level()
+{
+#ifdef LC_X86_KERNELS
+    static const simd_level l_best =
+        __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            ? simd_level::avx512
+        : __builtin_cpu_supports("avx2") ? simd_level::avx2
+                                         : simd_level::scalar;
+    return l_best;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+const char* to_string(simd_level a_level)
+{
+    switch(a_level)
+    {
+        case simd_level::scalar:
+            return "scalar";
+        case simd_level::avx2:
+            return "avx2";
+        case simd_level::avx512:
+            return "avx512";
+    }
+
+    return "unknown";
+}
+
+// clamps a requested level to what the cpu supports.
+static simd_level usable(simd_level a_simd)
+{
+    const simd_level l_best = best_simd_level();
+    return a_simd > l_best ? l_best : a_simd;
+}
+
+void lift_levels(uint32_t* a_levels, size_t a_count, uint32_t a_lift_amount,
+                 uint32_t a_cutoff, simd_level a_simd)
+{
+    // nothing would change
+    if(a_lift_amount == 0)
+        return;
+
+#ifdef LC_X86_KERNELS
+    switch(usable(a_simd))
+    {
+        case simd_level::avx512:
+            return lift_levels_avx512(a_levels, a_count, a_lift_amount,
+                                      a_cutoff);
+        case simd_level::avx2:
+            return lift_levels_avx2(a_levels, a_count, a_lift_amount,
+                                    a_cutoff);
+        case simd_level::scalar:
+            break;
+    }
+#endif
+
+    lift_levels_scalar(a_levels, a_count, a_lift_amount, a_cutoff);
+}
+
+void lower_levels(uint32_t* a_levels, size_t a_count, uint32_t a_var_index,
+                  simd_level a_simd)
+{
+#ifdef LC_X86_KERNELS
+    switch(usable(a_simd))
+    {
+        case simd_level::avx512:
+            return lower_levels_avx512(a_levels, a_count, a_var_index);
+        case simd_level::avx2:
+            return lower_levels_avx2(a_levels, a_count, a_var_index);
+        case simd_level::scalar:
+            break;
+    }
+#endif
+
+    lower_levels_scalar(a_levels, a_count, a_var_index);
+}
+
+uint32_t level_bound(const uint32_t* a_levels, size_t a_count,
+                     uint32_t a_limit, simd_level a_simd)
+{
+#ifdef LC_X86_KERNELS
+    switch(usable(a_simd))
+    {
+        case simd_level::avx512:
+            return level_bound_avx512(a_levels, a_count, a_limit);
+        case simd_level::avx2:
+            return level_bound_avx2(a_levels, a_count, a_limit);
+        case simd_level::scalar:
+            break;
+    }
+#endif
+
+    return level_bound_scalar(a_levels, a_count, a_limit);
+}
+
+size_t find_redex(const node_tag* a_tags, size_t a_count, simd_level a_simd)
+{
+#ifdef LC_X86_KERNELS
+    switch(usable(a_simd))
+    {
+        case simd_level::avx512:
+            return find_redex_avx512(a_tags, a_count);
+        case simd_level::avx2:
+            return find_redex_avx2(a_tags, a_count);
+        case simd_level::scalar:
+            break;
+    }
+#endif
+
+    return find_redex_scalar(a_tags, a_count);
+}
+
+size_t enclosing_binders(const node_tag* a_tags, size_t a_position,
+                         size_t& a_vars, simd_level a_simd)
+{
+    a_vars = 0;
+
+#ifdef LC_X86_KERNELS
+    switch(usable(a_simd))
+    {
+        case simd_level::avx512:
+            return enclosing_binders_avx512(a_tags, a_position, a_vars);
+        case simd_level::avx2:
+            return enclosing_binders_avx2(a_tags, a_position, a_vars);
+        case simd_level::scalar:
+            break;
+    }
+#endif
+
+    return enclosing_binders_scalar(a_tags, a_position, 0, 0, a_vars);
+}
+
+uint64_t hash_bytes(const void* a_bytes, size_t a_count, simd_level a_simd)
+{
+    const unsigned char* l_bytes = static_cast<const unsigned char*>(a_bytes);
+
+#ifdef LC_X86_KERNELS
+    switch(usable(a_simd))
+    {
+        case simd_level::avx512:
+            return hash_bytes_avx512(l_bytes, a_count);
+        case simd_level::avx2:
+            return hash_bytes_avx2(l_bytes, a_count);
+        case simd_level::scalar:
+            break;
+    }
+#endif
+
+    return hash_bytes_scalar(l_bytes, a_count);
+}
+
+bool bytes_equal(const void* a_lhs, const void* a_rhs, size_t a_count,
+                 simd_level a_simd)
+{
+    const unsigned char* l_lhs = static_cast<const unsigned char*>(a_lhs);
+    const unsigned char* l_rhs = static_cast<const unsigned char*>(a_rhs);
+
+#ifdef LC_X86_KERNELS
+    switch(usable(a_simd))
+    {
+        case simd_level::avx512:
+            return bytes_equal_avx512(l_lhs, l_rhs, a_count);
+        case simd_level::avx2:
+            return bytes_equal_avx2(l_lhs, l_rhs, a_count);
+        case simd_level::scalar:
+            break;
+    }
+#endif
+
+    return bytes_equal_scalar(l_lhs, l_rhs, a_count);
+}
+
+// FLAT EXPRESSIONS
+
+size_t flat_expr::size() const
+{
+    return m_tags.size();
+}
+
+bool flat_expr::equals(const flat_expr& a_other) const
+{
+    return m_tags.size() == a_other.m_tags.size() &&
+           m_levels.size() == a_other.m_levels.size() &&
+           bytes_equal(m_tags.data(), a_other.m_tags.data(), m_tags.size()) &&
+           bytes_equal(m_levels.data(), a_other.m_levels.data(),
+                       m_levels.size() * sizeof(uint32_t));
+}
+
+uint64_t flat_hash(const flat_expr& a_flat)
+{
+    return hash_combine(
+        hash_bytes(a_flat.m_tags.data(), a_flat.m_tags.size()),
+        hash_bytes(a_flat.m_levels.data(),
+                   a_flat.m_levels.size() * sizeof(uint32_t)));
+}
+
+static void flatten_into(const expr& a_expr, flat_expr& a_flat)
+{
+    if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+    {
+        if(l_var->m_index > UINT32_MAX)
+            throw std::runtime_error("flatten: level " +
+                                     std::to_string(l_var->m_index) +
+                                     " does not fit in 32 bits");
+
+        a_flat.m_tags.push_back(node_tag::var);
+        a_flat.m_levels.push_back(static_cast<uint32_t>(l_var->m_index));
+        return;
+    }
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+    {
+        a_flat.m_tags.push_back(node_tag::func);
+        flatten_into(*l_func->m_body, a_flat);
+        return;
+    }
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+    {
+        a_flat.m_tags.push_back(node_tag::app);
+        flatten_into(*l_app->m_lhs, a_flat);
+        flatten_into(*l_app->m_rhs, a_flat);
+        return;
+    }
+
+    // if we get here, error
+    throw std::runtime_error("flatten: invalid expression type");
+}
+
+flat_expr flatten(const expr& a_expr)
+{
+    flat_expr l_flat;
+    flatten(a_expr, l_flat);
+
+    return l_flat;
+}
+
+void flatten(const expr& a_expr, flat_expr& a_flat)
+{
+    a_flat.m_tags.clear();
+    a_flat.m_levels.clear();
+    a_flat.m_tags.reserve(a_expr.m_size);
+
+    flatten_into(a_expr, a_flat);
+}
+
+std::unique_ptr<expr> unflatten(const flat_expr& a_flat)
+{
+    // same explicit-stack approach as decode()
+    std::vector<std::pair<node_tag, std::unique_ptr<expr>>> l_stack;
+    size_t l_tag_pos = 0;
+    size_t l_level_pos = 0;
+
+    while(true)
+    {
+        if(l_tag_pos >= a_flat.m_tags.size())
+            throw std::runtime_error("unflatten: truncated tags");
+
+        const node_tag l_tag = a_flat.m_tags[l_tag_pos++];
+
+        if(l_tag == node_tag::func || l_tag == node_tag::app)
+        {
+            l_stack.emplace_back(l_tag, nullptr);
+            continue;
+        }
+
+        if(l_tag != node_tag::var)
+            throw std::runtime_error("unflatten: invalid node tag at " +
+                                     std::to_string(l_tag_pos - 1));
+
+        if(l_level_pos >= a_flat.m_levels.size())
+            throw std::runtime_error("unflatten: missing level");
+
+        std::unique_ptr<expr> l_result = v(a_flat.m_levels[l_level_pos++]);
+
+        while(true)
+        {
+            if(l_stack.empty())
+            {
+                if(l_tag_pos != a_flat.m_tags.size() ||
+                   l_level_pos != a_flat.m_levels.size())
+                    throw std::runtime_error("unflatten: trailing nodes");
+
+                return l_result;
+            }
+
+            auto& [l_pending, l_partial] = l_stack.back();
+
+            if(l_pending == node_tag::app && !l_partial)
+            {
+                l_partial = std::move(l_result);
+                break;
+            }
+
+            if(l_pending == node_tag::func)
+                l_result = f(std::move(l_result));
+            else
+                l_result = a(std::move(l_partial), std::move(l_result));
+
+            l_stack.pop_back();
+        }
+    }
+}
+
+void lift(flat_expr& a_flat, uint32_t a_lift_amount, uint32_t a_cutoff)
+{
+    lift_levels(a_flat.m_levels.data(), a_flat.m_levels.size(), a_lift_amount,
+                a_cutoff);
+}
+
+// FLAT REDUCTION
+
+// returns the position just past the subtree starting at a_pos, counting
+// the vars it contains into a_vars.
+static size_t skip_subtree(const std::vector<node_tag>& a_tags, size_t a_pos,
+                           size_t& a_vars)
+{
+    // number of subtrees still to be read
+    size_t l_pending = 1;
+
+    while(l_pending > 0)
+    {
+        switch(a_tags[a_pos++])
+        {
+            case node_tag::var:
+                --l_pending;
+                ++a_vars;
+                break;
+            case node_tag::app:
+                ++l_pending;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return a_pos;
+}
+
+// tracks the binders enclosing the current position of a pre-order walk.
+// Every open func remembers how many subtrees were pending when it
+// started; once fewer are pending, its body has been read.
+struct binder_tracker
+{
+    // advances past a_tag.
+    void step(node_tag a_tag)
+    {
+        while(!m_open.empty() && m_pending < m_open.back())
+            m_open.pop_back();
+
+        if(a_tag == node_tag::func)
+            m_open.push_back(m_pending);
+        else if(a_tag == node_tag::app)
+            ++m_pending;
+        else
+            --m_pending;
+    }
+
+    // number of funcs enclosing the next node.
+    size_t depth()
+    {
+        while(!m_open.empty() && m_pending < m_open.back())
+            m_open.pop_back();
+
+        return m_open.size();
+    }
+
+    size_t m_pending = 1;
+    std::vector<size_t> m_open;
+};
+
+// replaces the elements [a_begin, a_end) of a_vector with a_replacement.
+template <typename T>
+static void splice(std::vector<T>& a_vector, size_t a_begin, size_t a_end,
+                   const std::vector<T>& a_replacement)
+{
+    const size_t l_overlap = std::min(a_end - a_begin, a_replacement.size());
+
+    std::copy(a_replacement.begin(), a_replacement.begin() + l_overlap,
+              a_vector.begin() + a_begin);
+
+    if(l_overlap < a_end - a_begin)
+        a_vector.erase(a_vector.begin() + a_begin + l_overlap,
+                       a_vector.begin() + a_end);
+    else
+        a_vector.insert(a_vector.begin() + a_end,
+                        a_replacement.begin() + l_overlap,
+                        a_replacement.end());
+}
+
+bool is_normal(const flat_expr& a_flat)
+{
+    return find_redex(a_flat.m_tags.data(), a_flat.m_tags.size()) ==
+           a_flat.m_tags.size();
+}
+
+bool find_redex(const flat_expr& a_flat, size_t a_depth, flat_redex& a_redex)
+{
+    const std::vector<node_tag>& l_tags = a_flat.m_tags;
+    const size_t l_position = find_redex(l_tags.data(), l_tags.size());
+
+    if(l_position == l_tags.size())
+        return false;
+
+    // the binding depth of the redex and the levels that precede it
+    size_t l_level_begin = 0;
+    const size_t l_depth =
+        a_depth + enclosing_binders(l_tags.data(), l_position, l_level_begin);
+
+    if(l_depth > UINT32_MAX)
+        throw std::runtime_error("find_redex: binding depth " +
+                                 std::to_string(l_depth) +
+                                 " does not fit in 32 bits");
+
+    a_redex.m_position = l_position;
+    a_redex.m_var_index = static_cast<uint32_t>(l_depth);
+    a_redex.m_level_begin = l_level_begin;
+
+    return true;
+}
+
+void contract(flat_expr& a_flat, const flat_redex& a_redex)
+{
+    const std::vector<node_tag>& l_tags = a_flat.m_tags;
+    const size_t l_redex = a_redex.m_position;
+    const size_t l_level_begin = a_redex.m_level_begin;
+    const uint32_t l_var_index = a_redex.m_var_index;
+
+    // the redex is app, func, body, argument
+    size_t l_body_vars = 0;
+    size_t l_arg_vars = 0;
+    const size_t l_body_begin = l_redex + 2;
+    const size_t l_arg_begin = skip_subtree(l_tags, l_body_begin, l_body_vars);
+    const size_t l_arg_end = skip_subtree(l_tags, l_arg_begin, l_arg_vars);
+
+    const uint32_t* l_body_levels = a_flat.m_levels.data() + l_level_begin;
+    const uint32_t* l_arg_levels = l_body_levels + l_body_vars;
+
+    // the contractum. Runs of body levels between substitutions are lowered
+    // together, and every copy of the argument is lifted as it is placed.
+    std::vector<node_tag> l_new_tags;
+    std::vector<uint32_t> l_new_levels;
+    l_new_tags.reserve(l_arg_begin - l_body_begin);
+    l_new_levels.reserve(l_body_vars);
+
+    binder_tracker l_body;
+    size_t l_level_pos = 0;
+    size_t l_run_begin = 0;
+
+    for(size_t i = l_body_begin; i < l_arg_begin; ++i)
+    {
+        const node_tag l_tag = l_tags[i];
+        const size_t l_binders = l_body.depth();
+
+        l_body.step(l_tag);
+
+        if(l_tag != node_tag::var || l_body_levels[l_level_pos] != l_var_index)
+        {
+            l_new_tags.push_back(l_tag);
+
+            if(l_tag == node_tag::var)
+                l_new_levels.push_back(l_body_levels[l_level_pos++]);
+
+            continue;
+        }
+
+        ++l_level_pos;
+
+        lower_levels(l_new_levels.data() + l_run_begin,
+                     l_new_levels.size() - l_run_begin, l_var_index);
+
+        const size_t l_copy_begin = l_new_levels.size();
+
+        l_new_tags.insert(l_new_tags.end(), l_tags.begin() + l_arg_begin,
+                          l_tags.begin() + l_arg_end);
+        l_new_levels.insert(l_new_levels.end(), l_arg_levels,
+                            l_arg_levels + l_arg_vars);
+
+        lift_levels(l_new_levels.data() + l_copy_begin, l_arg_vars,
+                    static_cast<uint32_t>(l_binders), l_var_index);
+
+        l_run_begin = l_new_levels.size();
+    }
+
+    lower_levels(l_new_levels.data() + l_run_begin,
+                 l_new_levels.size() - l_run_begin, l_var_index);
+
+    splice(a_flat.m_levels, l_level_begin,
+           l_level_begin + l_body_vars + l_arg_vars, l_new_levels);
+    splice(a_flat.m_tags, l_redex, l_arg_end, l_new_tags);
+}
+
+bool reduce_one_step(flat_expr& a_flat, size_t a_depth)
+{
+    flat_redex l_redex;
+
+    if(!find_redex(a_flat, a_depth, l_redex))
+        return false;
+
+    contract(a_flat, l_redex);
+
+    return true;
+}
+
+normalize_stats normalize(flat_expr& a_flat, const budget& a_budget,
+                          size_t a_depth)
+{
+    using clock = std::chrono::steady_clock;
+
+    const clock::time_point l_start = clock::now();
+    const bool l_timed =
+        a_budget.m_max_time != std::chrono::nanoseconds::max();
+
+    normalize_stats l_stats;
+    l_stats.m_max_size = a_flat.size();
+
+    while(true)
+    {
+        if(a_flat.size() > a_budget.m_max_size)
+        {
+            l_stats.m_status = normalize_status::size_limit;
+            break;
+        }
+
+        if(l_timed && clock::now() - l_start >= a_budget.m_max_time)
+        {
+            l_stats.m_status = is_normal(a_flat) ? normalize_status::normal_form
+                                                 : normalize_status::time_limit;
+            break;
+        }
+
+        if(l_stats.m_steps >= a_budget.m_max_steps)
+        {
+            // only report the limit if another step was actually possible
+            l_stats.m_status = is_normal(a_flat) ? normalize_status::normal_form
+                                                 : normalize_status::step_limit;
+            break;
+        }
+
+        if(!reduce_one_step(a_flat, a_depth))
+        {
+            l_stats.m_status = normalize_status::normal_form;
+            break;
+        }
+
+        ++l_stats.m_steps;
+        l_stats.m_max_size = std::max(l_stats.m_max_size, a_flat.size());
+    }
+
+    l_stats.m_elapsed = clock::now() - l_start;
+    record_normalization(l_stats);
+
+    return l_stats;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <random>
+
+using namespace lambda;
+
+void test_level_kernels()
+{
+    std::mt19937 l_rng(42);
+
+    // levels cluster around a few small values, plus the extremes
+    auto l_random_levels = [&](size_t a_count)
+    {
+        std::vector<uint32_t> l_levels(a_count);
+
+        for(uint32_t& l_level : l_levels)
+        {
+            switch(l_rng() % 8)
+            {
+            case 0:
+                l_level = 0;
+                break;
+            case 1:
+                l_level = UINT32_MAX - 1;
+                break;
+            case 2:
+                l_level = UINT32_MAX;
+                break;
+            default:
+                l_level = l_rng() % 16;
+            }
+        }
+
+        return l_levels;
+    };
+
+    const simd_level l_levels_to_test[] = {simd_level::scalar, simd_level::avx2,
+                                           simd_level::avx512};
+
+    // every size up to a few vectors, so each tail length is covered
+    for(size_t l_count = 0; l_count < 70; ++l_count)
+    {
+        const std::vector<uint32_t> l_input = l_random_levels(l_count);
+
+        for(uint32_t l_threshold : {0u, 1u, 5u, 15u, UINT32_MAX - 1,
+                                    UINT32_MAX})
+        {
+            // reference results
+            std::vector<uint32_t> l_lifted = l_input;
+            std::vector<uint32_t> l_lowered = l_input;
+            uint32_t l_bound = 0;
+
+            for(size_t i = 0; i < l_count; ++i)
+            {
+                if(l_lifted[i] >= l_threshold)
+                    l_lifted[i] += 3;
+                if(l_lowered[i] > l_threshold)
+                    l_lowered[i] -= 1;
+                if(l_input[i] < l_threshold)
+                    l_bound = std::max(l_bound, l_input[i] + 1);
+            }
+
+            for(simd_level l_simd : l_levels_to_test)
+            {
+                std::vector<uint32_t> l_levels = l_input;
+                lift_levels(l_levels.data(), l_count, 3, l_threshold, l_simd);
+                assert(l_levels == l_lifted);
+
+                l_levels = l_input;
+                lower_levels(l_levels.data(), l_count, l_threshold, l_simd);
+                assert(l_levels == l_lowered);
+
+                assert(level_bound(l_input.data(), l_count, l_threshold,
+                                   l_simd) == l_bound);
+            }
+        }
+    }
+}
+
+void test_flatten()
+{
+    // round trip
+    {
+        auto l_expr = f(a(a(v(0), f(v(1))), a(v(3), f(f(v(2))))));
+        flat_expr l_flat = flatten(*l_expr);
+
+        assert(l_flat.size() == l_expr->m_size);
+        assert(l_flat.m_levels == std::vector<uint32_t>({0, 1, 3, 2}));
+        assert(unflatten(l_flat)->equals(l_expr));
+    }
+
+    // lift agrees with the tree
+    {
+        auto l_expr = f(a(a(v(0), f(v(1))), a(v(3), f(f(v(2))))));
+        flat_expr l_flat = flatten(*l_expr);
+
+        l_expr->lift(2, 1);
+        lift(l_flat, 2, 1);
+
+        assert(unflatten(l_flat)->equals(l_expr));
+    }
+
+    // closed terms have a bound of 0 with respect to their context
+    {
+        flat_expr l_closed = flatten(*f(f(a(v(0), v(1)))));
+        flat_expr l_open = flatten(*f(a(v(0), v(1))));
+
+        assert(level_bound(l_closed.m_levels.data(), l_closed.m_levels.size(),
+                           0) == 0);
+        assert(level_bound(l_open.m_levels.data(), l_open.m_levels.size(),
+                           1) == 1);
+        assert(level_bound(l_open.m_levels.data(), l_open.m_levels.size()) ==
+               2);
+    }
+
+    // malformed arrays
+    {
+        flat_expr l_flat;
+        assert_throws(unflatten(l_flat), std::runtime_error);
+
+        l_flat.m_tags = {node_tag::app, node_tag::var};
+        l_flat.m_levels = {0};
+        assert_throws(unflatten(l_flat), std::runtime_error);
+
+        l_flat.m_tags = {node_tag::var, node_tag::var};
+        l_flat.m_levels = {0, 0};
+        assert_throws(unflatten(l_flat), std::runtime_error);
+
+        l_flat.m_tags = {node_tag::var};
+        l_flat.m_levels = {};
+        assert_throws(unflatten(l_flat), std::runtime_error);
+
+        assert_throws(flatten(*v(size_t(UINT32_MAX) + 1)), std::runtime_error);
+    }
+}
+
+void test_byte_kernels()
+{
+    std::mt19937 l_rng(11);
+
+    const simd_level l_levels_to_test[] = {simd_level::scalar, simd_level::avx2,
+                                           simd_level::avx512};
+
+    for(size_t l_count = 0; l_count < 300; ++l_count)
+    {
+        std::vector<unsigned char> l_bytes(l_count);
+
+        for(unsigned char& l_byte : l_bytes)
+            l_byte = l_rng() % 3;
+
+        // every implementation produces the same hash
+        const uint64_t l_hash =
+            hash_bytes(l_bytes.data(), l_count, simd_level::scalar);
+
+        for(simd_level l_simd : l_levels_to_test)
+        {
+            assert(hash_bytes(l_bytes.data(), l_count, l_simd) == l_hash);
+            assert(bytes_equal(l_bytes.data(), l_bytes.data(), l_count,
+                               l_simd));
+        }
+
+        if(l_count == 0)
+            continue;
+
+        // a change anywhere changes the hash and breaks equality
+        std::vector<unsigned char> l_other = l_bytes;
+        l_other[l_rng() % l_count] ^= 1;
+
+        assert(hash_bytes(l_other.data(), l_count) != l_hash);
+
+        for(simd_level l_simd : l_levels_to_test)
+            assert(!bytes_equal(l_bytes.data(), l_other.data(), l_count,
+                                l_simd));
+    }
+
+    // trailing zeros and swapped stripes are told apart
+    {
+        std::vector<unsigned char> l_bytes(128, 0);
+        l_bytes[0] = 1;
+        std::vector<unsigned char> l_swapped(128, 0);
+        l_swapped[64] = 1;
+
+        assert(hash_bytes(l_bytes.data(), 100) !=
+               hash_bytes(l_bytes.data(), 101));
+        assert(hash_bytes(l_bytes.data(), 128) !=
+               hash_bytes(l_swapped.data(), 128));
+    }
+
+    // flat expressions
+    {
+        auto l_expr = f(a(a(v(0), f(v(1))), v(0)));
+        flat_expr l_flat = flatten(*l_expr);
+        flat_expr l_other = flatten(*f(a(a(v(0), f(v(1))), v(1))));
+
+        assert(l_flat.equals(flatten(*l_expr->clone())));
+        assert(flat_hash(l_flat) == flat_hash(flatten(*l_expr->clone())));
+        assert(!l_flat.equals(l_other));
+        assert(flat_hash(l_flat) != flat_hash(l_other));
+        assert(!l_flat.equals(flatten(*f(v(0)))));
+
+        // reusing storage
+        flatten(*v(3), l_other);
+        assert(l_other.equals(flatten(*v(3))));
+    }
+}
+
+void test_find_redex()
+{
+    std::mt19937 l_rng(7);
+
+    const simd_level l_levels_to_test[] = {simd_level::scalar, simd_level::avx2,
+                                           simd_level::avx512};
+
+    for(size_t l_count = 0; l_count < 200; ++l_count)
+    {
+        // mostly apps and vars, so redexes are sparse
+        std::vector<node_tag> l_tags(l_count);
+
+        for(node_tag& l_tag : l_tags)
+            l_tag = l_rng() % 16 == 0 ? node_tag::func
+                    : l_rng() % 2     ? node_tag::app
+                                      : node_tag::var;
+
+        size_t l_expected = l_count;
+
+        for(size_t i = 0; i + 1 < l_count; ++i)
+            if(l_tags[i] == node_tag::app && l_tags[i + 1] == node_tag::func)
+            {
+                l_expected = i;
+                break;
+            }
+
+        for(simd_level l_simd : l_levels_to_test)
+            assert(find_redex(l_tags.data(), l_count, l_simd) == l_expected);
+    }
+
+    // a trailing app cannot start a redex
+    {
+        std::vector<node_tag> l_tags(100, node_tag::var);
+        l_tags.back() = node_tag::app;
+
+        for(simd_level l_simd : l_levels_to_test)
+            assert(find_redex(l_tags.data(), l_tags.size(), l_simd) == 100);
+    }
+}
+
+// a random expression under a_depth binders, with levels that are mostly
+// bound and occasionally free.
+static std::unique_ptr<expr> random_term(std::mt19937& a_rng, size_t a_nodes,
+                                         size_t a_depth)
+{
+    if(a_nodes <= 1)
+        return v(a_rng() % (a_depth + 2));
+
+    if(a_rng() % 3 == 0)
+        return f(random_term(a_rng, a_nodes - 1, a_depth + 1));
+
+    const size_t l_lhs_nodes = 1 + a_rng() % (a_nodes - 1);
+
+    return a(random_term(a_rng, l_lhs_nodes, a_depth),
+             random_term(a_rng, a_nodes - l_lhs_nodes, a_depth));
+}
+
+void test_enclosing_binders()
+{
+    std::mt19937 l_rng(11);
+
+    const simd_level l_levels_to_test[] = {simd_level::scalar, simd_level::avx2,
+                                           simd_level::avx512};
+
+    // every position of random terms, against a walk with a stack of binders
+    for(size_t i = 0; i < 100; ++i)
+    {
+        const flat_expr l_flat = flatten(*random_term(l_rng, 1 + i * 3, 0));
+        const std::vector<node_tag>& l_tags = l_flat.m_tags;
+
+        binder_tracker l_walk;
+        size_t l_expected_vars = 0;
+
+        for(size_t l_position = 0; l_position <= l_tags.size(); ++l_position)
+        {
+            const size_t l_expected = l_walk.depth();
+
+            for(simd_level l_simd : l_levels_to_test)
+            {
+                size_t l_vars = SIZE_MAX;
+                assert(enclosing_binders(l_tags.data(), l_position, l_vars,
+                                         l_simd) == l_expected);
+                assert(l_vars == l_expected_vars);
+            }
+
+            if(l_position < l_tags.size())
+            {
+                l_walk.step(l_tags[l_position]);
+                l_expected_vars += l_tags[l_position] == node_tag::var;
+            }
+        }
+    }
+
+    // deep nesting, where the counts carried between blocks grow
+    {
+        std::unique_ptr<expr> l_expr = v(0);
+
+        for(size_t i = 0; i < 300; ++i)
+            l_expr = i % 3 ? f(std::move(l_expr)) : a(v(1), std::move(l_expr));
+
+        const flat_expr l_flat = flatten(*a(std::move(l_expr), v(2)));
+
+        for(simd_level l_simd : l_levels_to_test)
+        {
+            size_t l_vars = 0;
+            assert(enclosing_binders(l_flat.m_tags.data(), l_flat.size() - 2,
+                                     l_vars, l_simd) == 200);
+            assert(l_vars == 100);
+        }
+    }
+}
+
+void test_flat_reduction()
+{
+    // single steps agree with the tree, including under binders
+    {
+        std::mt19937 l_rng(3);
+
+        for(size_t i = 0; i < 300; ++i)
+        {
+            const size_t l_depth = i % 3;
+            auto l_tree = random_term(l_rng, 5 + i % 40, l_depth);
+            flat_expr l_flat = flatten(*l_tree);
+
+            for(size_t l_step = 0; l_step < 20; ++l_step)
+            {
+                const bool l_reduced = reduce_one_step(l_tree, l_depth);
+
+                assert(reduce_one_step(l_flat, l_depth) == l_reduced);
+                assert(unflatten(l_flat)->equals(l_tree));
+                assert(is_normal(l_flat) == is_normal(*l_tree));
+
+                if(!l_reduced || l_tree->m_size > 2000)
+                    break;
+            }
+        }
+    }
+
+    // S K K a → a
+    {
+        auto K = f(f(v(0)));
+        auto S = f(f(f(a(a(v(0), v(2)), a(v(1), v(2))))));
+        flat_expr l_flat = flatten(*a(a(a(S->clone(), K->clone()),
+                                          K->clone()), v(10)));
+
+        auto l_stats = normalize(l_flat);
+        assert(l_stats.m_status == normalize_status::normal_form);
+        assert(l_stats.m_steps == 5);
+        assert(unflatten(l_flat)->equals(v(10)));
+    }
+
+    // budgets behave as in the tree normalizer
+    {
+        auto l_omega = a(f(a(v(0), v(0))), f(a(v(0), v(0))));
+        flat_expr l_flat = flatten(*l_omega);
+        budget l_budget;
+        l_budget.m_max_steps = 100;
+
+        auto l_stats = normalize(l_flat, l_budget);
+        assert(l_stats.m_status == normalize_status::step_limit);
+        assert(l_stats.m_steps == 100);
+        assert(unflatten(l_flat)->equals(l_omega));
+
+        flat_expr l_growing = flatten(
+            *a(f(a(a(v(0), v(0)), v(0))), f(a(a(v(0), v(0)), v(0)))));
+        l_budget = budget();
+        l_budget.m_max_size = 1000;
+
+        l_stats = normalize(l_growing, l_budget);
+        assert(l_stats.m_status == normalize_status::size_limit);
+        assert(l_growing.size() > 1000);
+        assert(l_stats.m_max_size == l_growing.size());
+    }
+}
+
+void flat_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_level_kernels);
+    TEST(test_flatten);
+    TEST(test_byte_kernels);
+    TEST(test_find_redex);
+    TEST(test_enclosing_binders);
+    TEST(test_flat_reduction);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+
+using namespace lambda;
+
+// a balanced term in normal form with about 3 nodes per leaf and a binder
+// every few levels. Every a_stride-th leaf is replaced by the redex
+// (λ.x) y, so redexes are few and far apart.
+static std::unique_ptr<expr> sparse_redex_term(size_t a_leaves,
+                                               size_t a_stride,
+                                               size_t a_offset = 0,
+                                               size_t a_depth = 0)
+{
+    if(a_leaves == 1)
+    {
+        const size_t l_level = a_depth == 0 ? 0 : a_offset % a_depth;
+
+        if((a_offset + 1) % a_stride == 0)
+            return a(f(v(a_depth)), v(l_level));
+
+        return v(l_level);
+    }
+
+    const bool l_binder = a_leaves % 5 == 0;
+    const size_t l_depth = a_depth + l_binder;
+    const size_t l_half = a_leaves / 2;
+
+    auto l_app =
+        a(sparse_redex_term(l_half, a_stride, a_offset, l_depth),
+          sparse_redex_term(a_leaves - l_half, a_stride, a_offset + l_half,
+                            l_depth));
+
+    return l_binder ? f(std::move(l_app)) : std::move(l_app);
+}
+
+void bench_find_redex()
+{
+    const size_t l_runs = 20;
+    auto l_tree = sparse_redex_term(1 << 20, SIZE_MAX);
+    const flat_expr l_flat = flatten(*l_tree);
+
+    // a full scan of a term in normal form
+    {
+        bool l_normal = false;
+
+        measurement l_measured = measure_best_of(
+            l_runs, [] {}, [&] { l_normal = is_normal(*l_tree); });
+        keep(l_normal);
+        report("is_normal (tree)", l_measured, l_tree->m_size);
+
+        for(simd_level l_simd :
+            {simd_level::scalar, simd_level::avx2, simd_level::avx512})
+        {
+            if(l_simd > best_simd_level())
+                continue;
+
+            size_t l_redex = 0;
+
+            l_measured = measure_best_of(
+                l_runs, [] {},
+                [&]
+                {
+                    l_redex = find_redex(l_flat.m_tags.data(), l_flat.size(),
+                                         l_simd);
+                });
+            keep(l_redex);
+
+            const std::string l_name =
+                std::string("find_redex (") + to_string(l_simd) + ")";
+            report(l_name.c_str(), l_measured, l_flat.size());
+        }
+    }
+
+    // the binding depth at the end of the term, the prefix find_redex()
+    // measures before a redex: a walk with a stack of binders against the
+    // kernels
+    {
+        size_t l_depth = 0;
+
+        measurement l_measured = measure_best_of(
+            l_runs, [] {},
+            [&]
+            {
+                binder_tracker l_walk;
+
+                for(node_tag l_tag : l_flat.m_tags)
+                    l_walk.step(l_tag);
+
+                l_depth = l_walk.depth();
+            });
+        keep(l_depth);
+        report("binder_tracker walk", l_measured, l_flat.size());
+
+        for(simd_level l_simd :
+            {simd_level::scalar, simd_level::avx2, simd_level::avx512})
+        {
+            if(l_simd > best_simd_level())
+                continue;
+
+            size_t l_vars = 0;
+
+            l_measured = measure_best_of(
+                l_runs, [] {},
+                [&]
+                {
+                    l_depth = enclosing_binders(l_flat.m_tags.data(),
+                                                l_flat.size(), l_vars, l_simd);
+                });
+            keep(l_depth);
+
+            const std::string l_name =
+                std::string("enclosing_binders (") + to_string(l_simd) + ")";
+            report(l_name.c_str(), l_measured, l_flat.size());
+        }
+    }
+}
+
+void bench_flat_reduction()
+{
+    const size_t l_runs = 5;
+    // about two million nodes with 16 redexes
+    auto l_source = sparse_redex_term(1 << 20, (1 << 20) / 16);
+
+    std::unique_ptr<expr> l_tree;
+    flat_expr l_flat;
+
+    // one step, with the first redex far from the root
+    {
+        measurement l_measured = measure_best_of(
+            l_runs, [&] { l_tree = l_source->clone(); },
+            [&] { reduce_one_step(l_tree); });
+        report("reduce_one_step (tree)", l_measured, l_source->m_size);
+
+        l_measured = measure_best_of(
+            l_runs, [&] { l_flat = flatten(*l_source); },
+            [&] { reduce_one_step(l_flat); });
+        report("reduce_one_step (flat)", l_measured, l_source->m_size);
+    }
+
+    // normalization, contracting every redex
+    {
+        normalize_stats l_stats;
+
+        measurement l_measured = measure_best_of(
+            l_runs, [&] { l_tree = l_source->clone(); },
+            [&] { l_stats = normalize(l_tree); });
+        report("normalize (tree)", l_measured, l_source->m_size);
+
+        l_measured = measure_best_of(
+            l_runs, [&] { l_flat = flatten(*l_source); },
+            [&] { l_stats = normalize(l_flat); });
+        report("normalize (flat)", l_measured, l_source->m_size);
+
+        if(!unflatten(l_flat)->equals(l_tree))
+            std::cout << "    MISMATCH between tree and flat results"
+                      << std::endl;
+    }
+}
+
+void bench_byte_kernels()
+{
+    const size_t l_runs = 20;
+    std::vector<unsigned char> l_bytes(1 << 24, 1);
+    std::vector<unsigned char> l_copy = l_bytes;
+
+    for(simd_level l_simd :
+        {simd_level::scalar, simd_level::avx2, simd_level::avx512})
+    {
+        if(l_simd > best_simd_level())
+            continue;
+
+        uint64_t l_hash = 0;
+        bool l_equal = false;
+
+        measurement l_measured = measure_best_of(
+            l_runs, [] {},
+            [&]
+            { l_hash = hash_bytes(l_bytes.data(), l_bytes.size(), l_simd); });
+        keep(l_hash);
+
+        std::string l_name =
+            std::string("hash_bytes (") + to_string(l_simd) + ")";
+        report(l_name.c_str(), l_measured, l_bytes.size());
+
+        l_measured = measure_best_of(
+            l_runs, [] {},
+            [&]
+            {
+                l_equal = bytes_equal(l_bytes.data(), l_copy.data(),
+                                      l_bytes.size(), l_simd);
+            });
+        keep(l_equal);
+
+        l_name = std::string("bytes_equal (") + to_string(l_simd) + ")";
+        report(l_name.c_str(), l_measured, l_bytes.size());
+    }
+}
+
+void flat_bench_main()
+{
+    BENCH(bench_byte_kernels);
+    BENCH(bench_find_redex);
+    BENCH(bench_flat_reduction);
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "../include/hash.hpp"
+#include <stdexcept>
+
+namespace lambda
+{
+
+uint64_t structural_hash(const expr& a_expr)
+{
+    if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+        return var_hash(l_var->m_index);
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return func_hash(structural_hash(*l_func->m_body));
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+        return app_hash(structural_hash(*l_app->m_lhs),
+                        structural_hash(*l_app->m_rhs));
+
+    // if we get here, error
+    throw std::runtime_error("structural_hash: invalid expression type");
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+void test_structural_hash()
+{
+    // equal expressions hash equally
+    {
+        auto l_expr = f(a(a(v(0), v(2)), f(v(1))));
+        assert(structural_hash(*l_expr) == structural_hash(*l_expr->clone()));
+    }
+
+    // node kinds, indices and child order all matter
+    {
+        assert(structural_hash(*v(0)) != structural_hash(*v(1)));
+        assert(structural_hash(*v(0)) != structural_hash(*f(v(0))));
+        assert(structural_hash(*a(v(0), v(1))) !=
+               structural_hash(*a(v(1), v(0))));
+        assert(structural_hash(*f(f(v(0)))) != structural_hash(*f(v(0))));
+        assert(structural_hash(*a(f(v(0)), v(0))) !=
+               structural_hash(*f(a(v(0), v(0)))));
+    }
+}
+
+void hash_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_structural_hash);
+}
+
+#endif
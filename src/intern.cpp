@@ -0,0 +1,413 @@
+#include "../include/intern.hpp"
+#include "../include/hash.hpp"
+#include "../include/metrics.hpp"
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace lambda
+{
+
+// an open-addressing array of published nodes; null marks a free slot.
+struct intern_table::slot_array
+{
+    explicit slot_array(size_t a_capacity)
+        : m_mask(a_capacity - 1),
+          m_slots(new std::atomic<const interned*>[a_capacity])
+    {
+        for(size_t i = 0; i < a_capacity; ++i)
+            m_slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    size_t m_mask;
+    std::unique_ptr<std::atomic<const interned*>[]> m_slots;
+};
+
+// shards sit on separate cache lines so that threads adding to different
+// shards do not contend.
+struct alignas(64) intern_table::shard
+{
+    // the slot array lookups read
+    std::atomic<slot_array*> m_current = nullptr;
+    std::atomic<size_t> m_count = 0;
+
+    // everything below is guarded by m_mutex
+    std::mutex m_mutex;
+    // the current slot array and every one it replaced
+    std::vector<std::unique_ptr<slot_array>> m_arrays;
+    // node storage, allocated in chunks so that nodes never move
+    std::vector<std::unique_ptr<interned[]>> m_chunks;
+    size_t m_chunk_used = 0;
+};
+
+static constexpr size_t INITIAL_SHARD_CAPACITY = 64;
+static constexpr size_t NODE_CHUNK_SIZE = 1024;
+
+// whether a_node is the node a_key describes. Children are canonical, so
+// comparing their pointers compares them structurally.
+static bool same_node(const interned& a_node, const interned& a_key)
+{
+    return a_node.m_hash == a_key.m_hash && a_node.m_tag == a_key.m_tag &&
+           a_node.m_index == a_key.m_index && a_node.m_lhs == a_key.m_lhs &&
+           a_node.m_rhs == a_key.m_rhs;
+}
+
+// the node matching a_key among a_slots, or null. If a_free is given, it
+// receives the free slot where a_key would go.
+static const interned* probe(const std::atomic<const interned*>* a_slots,
+                             size_t a_mask, const interned& a_key,
+                             size_t* a_free = nullptr)
+{
+    for(size_t i = a_key.m_hash & a_mask;; i = (i + 1) & a_mask)
+    {
+        const interned* l_node = a_slots[i].load(std::memory_order_acquire);
+
+        if(!l_node)
+        {
+            if(a_free)
+                *a_free = i;
+
+            return nullptr;
+        }
+
+        if(same_node(*l_node, a_key))
+            return l_node;
+    }
+}
+
+intern_table::intern_table() : m_shards(new shard[SHARD_COUNT])
+{
+    for(size_t i = 0; i < SHARD_COUNT; ++i)
+    {
+        shard& l_shard = m_shards[i];
+        l_shard.m_arrays.push_back(
+            std::make_unique<slot_array>(INITIAL_SHARD_CAPACITY));
+        l_shard.m_current = l_shard.m_arrays.back().get();
+    }
+}
+
+intern_table::~intern_table() = default;
+
+const interned* intern_table::intern_var(size_t a_index)
+{
+    if(a_index > UINT32_MAX)
+        throw std::runtime_error("intern_var: level out of range");
+
+    return find_or_insert({node_tag::var, uint32_t(a_index), nullptr, nullptr,
+                           1, var_hash(a_index)});
+}
+
+const interned* intern_table::intern_func(const interned* a_body)
+{
+    return find_or_insert({node_tag::func, 0, a_body, nullptr,
+                           1 + a_body->m_size, func_hash(a_body->m_hash)});
+}
+
+const interned* intern_table::intern_app(const interned* a_lhs,
+                                         const interned* a_rhs)
+{
+    return find_or_insert({node_tag::app, 0, a_lhs, a_rhs,
+                           1 + a_lhs->m_size + a_rhs->m_size,
+                           app_hash(a_lhs->m_hash, a_rhs->m_hash)});
+}
+
+const interned* intern_table::intern(const expr& a_expr)
+{
+    if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+        return intern_var(l_var->m_index);
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return intern_func(intern(*l_func->m_body));
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+    {
+        const interned* l_lhs = intern(*l_app->m_lhs);
+        return intern_app(l_lhs, intern(*l_app->m_rhs));
+    }
+
+    // if we get here, error
+    throw std::runtime_error("intern: invalid expression type");
+}
+
+size_t intern_table::size() const
+{
+    size_t l_result = 0;
+
+    for(size_t i = 0; i < SHARD_COUNT; ++i)
+        l_result += m_shards[i].m_count.load(std::memory_order_relaxed);
+
+    return l_result;
+}
+
+const interned* intern_table::find_or_insert(const interned& a_key)
+{
+    // the high bits pick the shard, the low bits the slot within it
+    shard& l_shard = m_shards[a_key.m_hash >> (64 - SHARD_BITS)];
+
+    // most terms built from shared parts are already present
+    const slot_array* l_published =
+        l_shard.m_current.load(std::memory_order_acquire);
+
+    if(const interned* l_found = probe(l_published->m_slots.get(),
+                                       l_published->m_mask, a_key))
+    {
+        record_cache_lookups(1, 1);
+        return l_found;
+    }
+
+    std::lock_guard<std::mutex> l_lock(l_shard.m_mutex);
+
+    // another thread may have added it, or grown the shard, in the meantime
+    slot_array* l_array = l_shard.m_current.load(std::memory_order_relaxed);
+    size_t l_free;
+
+    if(const interned* l_found =
+           probe(l_array->m_slots.get(), l_array->m_mask, a_key, &l_free))
+    {
+        record_cache_lookups(1, 1);
+        return l_found;
+    }
+
+    record_cache_lookups(1, 0);
+
+    if(l_shard.m_chunks.empty() || l_shard.m_chunk_used == NODE_CHUNK_SIZE)
+    {
+        l_shard.m_chunks.push_back(
+            std::make_unique<interned[]>(NODE_CHUNK_SIZE));
+        l_shard.m_chunk_used = 0;
+    }
+
+    interned* l_node = &l_shard.m_chunks.back()[l_shard.m_chunk_used++];
+    *l_node = a_key;
+
+    // the node is complete before any other thread can see it
+    l_array->m_slots[l_free].store(l_node, std::memory_order_release);
+
+    const size_t l_count =
+        l_shard.m_count.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // keep the load factor at or below one half
+    if(2 * l_count > l_array->m_mask + 1)
+    {
+        auto l_grown = std::make_unique<slot_array>(2 * (l_array->m_mask + 1));
+
+        for(size_t i = 0; i <= l_array->m_mask; ++i)
+        {
+            const interned* l_moved =
+                l_array->m_slots[i].load(std::memory_order_relaxed);
+
+            if(!l_moved)
+                continue;
+
+            size_t j = l_moved->m_hash & l_grown->m_mask;
+
+            while(l_grown->m_slots[j].load(std::memory_order_relaxed))
+                j = (j + 1) & l_grown->m_mask;
+
+            l_grown->m_slots[j].store(l_moved, std::memory_order_relaxed);
+        }
+
+        l_shard.m_current.store(l_grown.get(), std::memory_order_release);
+        l_shard.m_arrays.push_back(std::move(l_grown));
+    }
+
+    return l_node;
+}
+
+std::unique_ptr<expr> materialize(const interned* a_node)
+{
+    switch(a_node->m_tag)
+    {
+        case node_tag::var:
+            return v(a_node->m_index);
+        case node_tag::func:
+            return f(materialize(a_node->m_lhs));
+        case node_tag::app:
+            return a(materialize(a_node->m_lhs), materialize(a_node->m_rhs));
+    }
+
+    // if we get here, error
+    throw std::runtime_error("materialize: invalid node tag");
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <thread>
+
+using namespace lambda;
+
+void test_intern_table()
+{
+    // equal terms share one node
+    {
+        intern_table l_table;
+
+        const interned* l_first = l_table.intern(*f(a(v(0), f(v(0)))));
+        const interned* l_second = l_table.intern(*f(a(v(0), f(v(0)))));
+        const interned* l_other = l_table.intern(*f(a(f(v(0)), v(0))));
+
+        assert(l_first == l_second);
+        assert(l_first != l_other);
+        // v(0), f(v(0)), both apps and both funcs
+        assert(l_table.size() == 6);
+
+        assert(l_first->m_size == 5);
+        assert(l_first->m_hash == structural_hash(*f(a(v(0), f(v(0))))));
+        assert(materialize(l_first)->equals(f(a(v(0), f(v(0))))));
+    }
+
+    // the node factories agree with intern()
+    {
+        intern_table l_table;
+
+        const interned* l_x = l_table.intern_var(3);
+        const interned* l_built =
+            l_table.intern_app(l_table.intern_func(l_x), l_x);
+
+        assert(l_built == l_table.intern(*a(f(v(3)), v(3))));
+        assert(l_built->m_lhs->m_lhs == l_built->m_rhs);
+        assert(l_table.size() == 3);
+    }
+
+    // lookups survive shards growing
+    {
+        intern_table l_table;
+        std::vector<const interned*> l_nodes;
+
+        for(size_t i = 0; i < 20000; ++i)
+            l_nodes.push_back(l_table.intern(*f(v(i))));
+
+        for(size_t i = 0; i < 20000; ++i)
+            assert(l_table.intern(*f(v(i))) == l_nodes[i]);
+
+        assert(l_table.size() == 40000);
+    }
+
+    // threads interning the same terms at once get the same nodes
+    {
+        intern_table l_table;
+        const size_t l_thread_count = 8;
+        const size_t l_term_count = 2000;
+        std::vector<std::vector<const interned*>> l_results(l_thread_count);
+        std::vector<std::thread> l_threads;
+
+        for(size_t t = 0; t < l_thread_count; ++t)
+            l_threads.emplace_back(
+                [&, t]
+                {
+                    for(size_t i = 0; i < l_term_count; ++i)
+                        l_results[t].push_back(
+                            l_table.intern(*a(f(v(i)), v(i % 7))));
+                });
+
+        for(std::thread& l_thread : l_threads)
+            l_thread.join();
+
+        for(size_t t = 1; t < l_thread_count; ++t)
+            assert(l_results[t] == l_results[0]);
+
+        // each term adds its app and func; the vars are v(0) to v(1999)
+        assert(l_table.size() == 3 * l_term_count);
+    }
+}
+
+void intern_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_intern_table);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include <random>
+#include <thread>
+
+using namespace lambda;
+
+// a random expression of about a_nodes nodes under a_depth binders, drawn
+// from few enough shapes that subterms repeat.
+static std::unique_ptr<expr> random_intern_term(std::mt19937& a_rng,
+                                                size_t a_nodes, size_t a_depth)
+{
+    if(a_nodes <= 1)
+        return v(a_rng() % (a_depth + 1));
+
+    if(a_rng() % 4 == 0)
+        return f(random_intern_term(a_rng, a_nodes - 1, a_depth + 1));
+
+    const size_t l_lhs_nodes = 1 + a_rng() % (a_nodes - 1);
+
+    return a(random_intern_term(a_rng, l_lhs_nodes, a_depth),
+             random_intern_term(a_rng, a_nodes - l_lhs_nodes, a_depth));
+}
+
+void bench_intern_threads()
+{
+    const size_t l_runs = 3;
+    const size_t l_terms_per_thread = 2000;
+    std::mt19937 l_rng(11);
+
+    // every thread interns the same terms in its own order, so most calls
+    // find the node another thread already added
+    std::vector<std::unique_ptr<expr>> l_terms;
+    size_t l_nodes = 0;
+
+    for(size_t i = 0; i < l_terms_per_thread; ++i)
+    {
+        l_terms.push_back(random_intern_term(l_rng, 20 + l_rng() % 200, 0));
+        l_nodes += l_terms.back()->m_size;
+    }
+
+    std::cout << "    hardware threads: " << std::thread::hardware_concurrency()
+              << std::endl;
+
+    for(size_t l_thread_count : {1, 2, 4, 8, 16, 32, 64})
+    {
+        std::unique_ptr<intern_table> l_table;
+        std::vector<std::vector<size_t>> l_orders(l_thread_count);
+
+        for(auto& l_order : l_orders)
+        {
+            for(size_t i = 0; i < l_terms.size(); ++i)
+                l_order.push_back(i);
+
+            std::shuffle(l_order.begin(), l_order.end(), l_rng);
+        }
+
+        measurement l_measured = measure_best_of(
+            l_runs, [&] { l_table = std::make_unique<intern_table>(); },
+            [&]
+            {
+                std::vector<std::thread> l_threads;
+
+                for(size_t t = 0; t < l_thread_count; ++t)
+                    l_threads.emplace_back(
+                        [&, t]
+                        {
+                            for(size_t i : l_orders[t])
+                                keep(l_table->intern(*l_terms[i]));
+                        });
+
+                for(std::thread& l_thread : l_threads)
+                    l_thread.join();
+            });
+
+        const std::string l_name =
+            "intern, " + std::to_string(l_thread_count) + " threads";
+        report(l_name.c_str(), l_measured, l_thread_count * l_nodes);
+    }
+}
+
+void intern_bench_main()
+{
+    BENCH(bench_intern_threads);
+}
+
+#endif
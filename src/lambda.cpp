@@ -1,4 +1,5 @@
 #include "../include/lambda.hpp"
+#include "../include/probes.hpp"
 
 namespace lambda
 {
@@ -60,19 +61,45 @@ void app::print(std::ostream& a_ostream) const
 
 // EXPR CLONE METHOD
 
+// the observer of the clones made on this thread, if any
+static thread_local clone_observer* t_clone_observer = nullptr;
+
+clone_observer* observe_clones(clone_observer* a_observer)
+{
+    clone_observer* l_previous = t_clone_observer;
+    t_clone_observer = a_observer;
+
+    return l_previous;
+}
+
 std::unique_ptr<expr> var::clone() const
 {
-    return v(m_index);
+    std::unique_ptr<expr> l_copy = v(m_index);
+
+    if(t_clone_observer)
+        t_clone_observer->cloned(*this, *l_copy);
+
+    return l_copy;
 }
 
 std::unique_ptr<expr> func::clone() const
 {
-    return f(m_body->clone());
+    std::unique_ptr<expr> l_copy = f(m_body->clone());
+
+    if(t_clone_observer)
+        t_clone_observer->cloned(*this, *l_copy);
+
+    return l_copy;
 }
 
 std::unique_ptr<expr> app::clone() const
 {
-    return a(m_lhs->clone(), m_rhs->clone());
+    std::unique_ptr<expr> l_copy = a(m_lhs->clone(), m_rhs->clone());
+
+    if(t_clone_observer)
+        t_clone_observer->cloned(*this, *l_copy);
+
+    return l_copy;
 }
 
 // UPDATE SIZE METHODS
@@ -188,7 +215,9 @@ void substitute(std::unique_ptr<expr>& a_expr, size_t a_lift_amount,
         }
 
         // this var is the one we are substituting, so we must substitute it
+        LC_PROBE2(clone_arg, a_arg->m_size, a_lift_amount);
         a_expr = a_arg->clone();
+        LC_PROBE3(lift, a_expr->m_size, a_lift_amount, a_var_index);
         a_expr->lift(a_lift_amount, a_var_index);
 
         return;
@@ -249,6 +278,7 @@ bool reduce_one_step(std::unique_ptr<expr>& a_expr, size_t a_depth)
         if(func* l_lhs_func = dynamic_cast<func*>(l_app->m_lhs.get()))
         {
             // perform the beta-contraction
+            LC_PROBE2(beta, a_depth, l_app->m_rhs->m_size);
             substitute(l_lhs_func->m_body, 0, a_depth, l_app->m_rhs);
 
             // throw away the lambda binder
@@ -284,6 +314,7 @@ bool reduce_one_step(std::unique_ptr<expr>& a_expr, size_t a_depth)
 #include <iostream>
 #include <limits>
 #include <list>
+#include <vector>
 
 using namespace lambda;
 
@@ -791,6 +822,63 @@ void test_app_clone()
     }
 }
 
+void test_clone_observer()
+{
+    // records every (original, copy) pair it is told of
+    struct recorder : clone_observer
+    {
+        std::vector<std::pair<const expr*, const expr*>> m_pairs;
+
+        void cloned(const expr& a_original, const expr& a_copy) override
+        {
+            m_pairs.emplace_back(&a_original, &a_copy);
+        }
+    };
+
+    // every node of a clone is reported with the node it copies
+    {
+        auto l_expr = a(f(v(0)), v(1));
+        const func* l_func = dynamic_cast<const func*>(
+            dynamic_cast<const app*>(l_expr.get())->m_lhs.get());
+
+        recorder l_recorder;
+        assert(observe_clones(&l_recorder) == nullptr);
+        auto l_copy = l_expr->clone();
+        assert(observe_clones(nullptr) == &l_recorder);
+
+        assert(l_recorder.m_pairs.size() == 4);
+        // a node right after its children, so the root last
+        auto l_reported = [&](const expr* a_original)
+        {
+            for(size_t i = 0; i < l_recorder.m_pairs.size(); ++i)
+                if(l_recorder.m_pairs[i].first == a_original)
+                    return i;
+
+            return l_recorder.m_pairs.size();
+        };
+        assert(l_reported(l_func) == l_reported(l_func->m_body.get()) + 1);
+        assert(l_recorder.m_pairs.back().first == l_expr.get());
+        assert(l_recorder.m_pairs.back().second == l_copy.get());
+    }
+
+    // substitution reports the copies of the argument, and nothing is
+    // reported once the observer is removed
+    {
+        auto l_expr = a(f(a(v(0), v(0))), f(v(0)));
+
+        recorder l_recorder;
+        observe_clones(&l_recorder);
+        assert(reduce_one_step(l_expr));
+        observe_clones(nullptr);
+
+        assert(l_expr->equals(a(f(v(0)), f(v(0)))));
+        assert(l_recorder.m_pairs.size() == 4);
+
+        l_expr->clone();
+        assert(l_recorder.m_pairs.size() == 4);
+    }
+}
+
 void test_var_update_size()
 {
     // basic update - var size is always 1
@@ -3869,6 +3957,7 @@ void lambda_test_main()
     TEST(test_var_clone);
     TEST(test_func_clone);
     TEST(test_app_clone);
+    TEST(test_clone_observer);
 
     TEST(test_var_update_size);
     TEST(test_func_update_size);
@@ -3892,3 +3981,73 @@ void lambda_test_main()
 }
 
 #endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include "../include/normalize.hpp"
+
+using namespace lambda;
+
+// church numeral a_n.
+static std::unique_ptr<expr> bench_numeral(size_t a_n)
+{
+    std::unique_ptr<expr> l_body = v(1);
+
+    for(size_t i = 0; i < a_n; ++i)
+        l_body = a(v(0), std::move(l_body));
+
+    return f(f(std::move(l_body)));
+}
+
+void bench_core_operations()
+{
+    const size_t l_runs = 3;
+
+    // a large term for the tree walks
+    auto l_large = bench_numeral(20000);
+    const size_t l_nodes = l_large->m_size;
+
+    std::unique_ptr<expr> l_copy;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [&] { l_copy.reset(); },
+        [&] { l_copy = l_large->clone(); });
+    report("clone (per node)", l_measured, l_nodes);
+
+    l_measured = measure_best_of(
+        l_runs, [] {}, [&] { l_copy->lift(1, 1); });
+    report("lift (per node)", l_measured, l_nodes);
+
+    // reductions whose cost is substitute(): church exponentiation copies
+    // its argument into every occurrence of the bound variable
+    std::unique_ptr<expr> l_expr;
+    size_t l_steps = 0;
+
+    l_measured = measure_best_of(
+        l_runs, [&] { l_expr = a(bench_numeral(6), bench_numeral(3)); },
+        [&] { l_steps = normalize(l_expr).m_steps; });
+    report("normalize 3^6 (per beta step)", l_measured, l_steps);
+
+    // a redex whose bound variable occurs many times, over a large argument
+    std::unique_ptr<expr> l_body = v(0);
+
+    for(size_t i = 0; i < 64; ++i)
+        l_body = a(std::move(l_body), v(0));
+
+    auto l_duplicate = f(std::move(l_body));
+
+    l_measured = measure_best_of(
+        l_runs,
+        [&] { l_expr = a(l_duplicate->clone(), l_large->clone()); },
+        [&] { keep(reduce_one_step(l_expr)); });
+    report("substitute 65 copies (per node copied)", l_measured,
+           65 * l_nodes);
+}
+
+void lambda_bench_main()
+{
+    BENCH(bench_core_operations);
+}
+
+#endif
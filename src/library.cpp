@@ -0,0 +1,253 @@
+#include "../include/library.hpp"
+#include <stdexcept>
+
+namespace lambda
+{
+
+const normalize_stats& helper_library::add(const expr& a_helper,
+                                           const budget& a_budget)
+{
+    const size_t l_depth = m_helpers.size();
+
+    // the helper as the body of a tower binding its predecessors, whose
+    // normalization substitutes them and reduces what they leave
+    std::unique_ptr<expr> l_program = construct_program(
+        m_helpers.begin(), m_helpers.end(), a_helper.clone());
+
+    const normalize_stats l_stats = normalize(l_program, a_budget);
+
+    if(l_stats.m_status == normalize_status::normal_form)
+    {
+        // closed, and normal at depth 0; its own binders start at l_depth
+        // in the tower
+        l_program->lift(l_depth, 0);
+        m_helpers.push_back(std::move(l_program));
+    }
+    else
+        m_helpers.push_back(a_helper.clone());
+
+    m_stats.push_back(l_stats);
+
+    return m_stats.back();
+}
+
+size_t helper_library::size() const
+{
+    return m_helpers.size();
+}
+
+const std::vector<std::unique_ptr<expr>>& helper_library::helpers() const
+{
+    return m_helpers;
+}
+
+bool helper_library::is_normalized(size_t a_index) const
+{
+    return stats(a_index).m_status == normalize_status::normal_form;
+}
+
+const normalize_stats& helper_library::stats(size_t a_index) const
+{
+    if(a_index >= m_stats.size())
+        throw std::runtime_error("helper_library: helper index out of range");
+
+    return m_stats[a_index];
+}
+
+std::unique_ptr<expr>
+helper_library::program(const std::unique_ptr<expr>& a_main_fn) const
+{
+    return construct_program(m_helpers.begin(), m_helpers.end(), a_main_fn);
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <list>
+
+using namespace lambda;
+
+void test_helper_library()
+{
+    std::list<std::unique_ptr<expr>> l_helpers;
+
+    auto l = [&l_helpers](size_t a_local_index)
+    { return v(l_helpers.size() + a_local_index); };
+    auto g = [](size_t a_global_index) { return v(a_global_index); };
+
+    // Helper 0: TRUE = λ.λ.0
+    const auto TRUE = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(0))));
+
+    // Helper 1: FALSE = λ.λ.1
+    const auto FALSE = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(1))));
+
+    // Helper 2: NOT = λ.((0 FALSE) TRUE)
+    const auto NOT = g(l_helpers.size());
+    l_helpers.emplace_back(
+        f(a(a(l(0)->clone(), FALSE->clone()), TRUE->clone())));
+
+    // Helper 3: NOT_TRUE = NOT TRUE, not normal as written
+    const auto NOT_TRUE = g(l_helpers.size());
+    l_helpers.emplace_back(a(NOT->clone(), TRUE->clone()));
+
+    const helper_library l_library =
+        build_library(l_helpers.begin(), l_helpers.end());
+
+    // every helper is closed and normal, at its own depth
+    {
+        assert(l_library.size() == 4);
+
+        for(size_t i = 0; i < l_library.size(); ++i)
+        {
+            assert(l_library.is_normalized(i));
+            assert(is_normal(*l_library.helpers()[i]));
+        }
+
+        assert(l_library.helpers()[0]->equals(f(f(v(0)))));
+        assert(l_library.helpers()[1]->equals(f(f(v(2)))));
+        assert(l_library.helpers()[2]->equals(
+            f(a(a(v(2), f(f(v(4)))), f(f(v(3)))))));
+        // NOT TRUE is FALSE
+        assert(l_library.helpers()[3]->equals(f(f(v(4)))));
+
+        // binding three helpers, then NOT TRUE in three steps
+        assert(l_library.stats(3).m_steps == 6);
+    }
+
+    // programs reduce to the same result without reducing NOT TRUE again:
+    // only the four binding steps are left
+    {
+        auto l_main = NOT_TRUE->clone();
+
+        auto l_raw =
+            construct_program(l_helpers.begin(), l_helpers.end(), l_main);
+        const normalize_stats l_raw_stats = normalize(l_raw);
+
+        auto l_program = l_library.program(l_main);
+        const normalize_stats l_stats = normalize(l_program);
+
+        assert(l_program->equals(l_raw));
+        assert(l_program->equals(f(f(v(1)))));
+        assert(l_raw_stats.m_steps == 7);
+        assert(l_stats.m_steps == 4);
+    }
+
+    // a helper without a normal form is kept as written, and still binds
+    {
+        helper_library l_partial;
+        l_partial.add(*f(f(v(0))));
+
+        // Helper 1: λ.(0 OMEGA), whose OMEGA never reduces
+        auto l_omega = a(f(a(v(2), v(2))), f(a(v(2), v(2))));
+        auto l_helper = f(a(v(1), std::move(l_omega)));
+
+        budget l_budget;
+        l_budget.m_max_steps = 50;
+        const normalize_stats& l_stats = l_partial.add(*l_helper, l_budget);
+
+        assert(l_stats.m_status == normalize_status::step_limit);
+        assert(!l_partial.is_normalized(1));
+        assert(l_partial.helpers()[1]->equals(l_helper));
+
+        // applied to FALSE, the helper drops OMEGA
+        auto l_program = l_partial.program(a(v(1), f(f(v(3)))));
+        assert(normalize(l_program, l_budget).m_status ==
+               normalize_status::normal_form);
+        assert(l_program->equals(f(v(0))));
+    }
+
+    // out of range
+    assert_throws(l_library.stats(4), std::runtime_error);
+}
+
+void library_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_helper_library);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+
+using namespace lambda;
+
+void bench_helper_library()
+{
+    const size_t l_runs = 5;
+    const size_t l_programs = 100;
+
+    // church numeral a_n as a helper under a_depth binders
+    auto l_numeral = [](size_t a_n, size_t a_depth)
+    {
+        std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(a_depth), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    // THREE, TWO, NINE = (TWO THREE), EIGHTY_ONE = (TWO NINE)
+    std::vector<std::unique_ptr<expr>> l_helpers;
+    l_helpers.push_back(l_numeral(3, 0));
+    l_helpers.push_back(l_numeral(2, 1));
+    l_helpers.push_back(a(v(1), v(0)));
+    l_helpers.push_back(a(v(1), v(2)));
+    const auto l_main = v(3);
+
+    size_t l_steps = 0;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [] {},
+        [&]
+        {
+            l_steps = 0;
+
+            for(size_t i = 0; i < l_programs; ++i)
+            {
+                auto l_program = construct_program(l_helpers.begin(),
+                                                   l_helpers.end(), l_main);
+                l_steps += normalize(l_program).m_steps;
+            }
+        });
+    report("programs from helpers as written", l_measured, l_steps);
+
+    helper_library l_library;
+
+    l_measured = measure_best_of(
+        l_runs, [&] { l_library = helper_library(); },
+        [&]
+        {
+            l_library = build_library(l_helpers.begin(), l_helpers.end());
+        });
+    report("build_library", l_measured, l_helpers.size());
+
+    l_measured = measure_best_of(
+        l_runs, [] {},
+        [&]
+        {
+            l_steps = 0;
+
+            for(size_t i = 0; i < l_programs; ++i)
+            {
+                auto l_program = l_library.program(l_main);
+                l_steps += normalize(l_program).m_steps;
+            }
+        });
+    report("programs from the library", l_measured, l_steps);
+}
+
+void library_bench_main()
+{
+    BENCH(bench_helper_library);
+}
+
+#endif
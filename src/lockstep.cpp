@@ -0,0 +1,370 @@
+#include "../include/lockstep.hpp"
+#include <algorithm>
+
+namespace lambda
+{
+
+std::vector<flat_expr>
+apply_each(const expr& a_program,
+           const std::vector<std::unique_ptr<expr>>& a_inputs)
+{
+    const flat_expr l_program = flatten(a_program);
+    std::vector<flat_expr> l_terms(a_inputs.size());
+    flat_expr l_input;
+
+    for(size_t i = 0; i < a_inputs.size(); ++i)
+    {
+        flatten(*a_inputs[i], l_input);
+
+        // the pre-order of (program input) is the app tag, then the
+        // program, then the input
+        flat_expr& l_term = l_terms[i];
+        l_term.m_tags.reserve(1 + l_program.size() + l_input.size());
+        l_term.m_tags.push_back(node_tag::app);
+        l_term.m_tags.insert(l_term.m_tags.end(), l_program.m_tags.begin(),
+                             l_program.m_tags.end());
+        l_term.m_tags.insert(l_term.m_tags.end(), l_input.m_tags.begin(),
+                             l_input.m_tags.end());
+
+        l_term.m_levels.reserve(l_program.m_levels.size() +
+                                l_input.m_levels.size());
+        l_term.m_levels.insert(l_term.m_levels.end(),
+                               l_program.m_levels.begin(),
+                               l_program.m_levels.end());
+        l_term.m_levels.insert(l_term.m_levels.end(), l_input.m_levels.begin(),
+                               l_input.m_levels.end());
+    }
+
+    return l_terms;
+}
+
+lockstep_stats normalize_lockstep(std::vector<flat_expr>& a_terms,
+                                  std::vector<normalize_stats>& a_stats,
+                                  const budget& a_budget, size_t a_depth)
+{
+    using clock = std::chrono::steady_clock;
+
+    const clock::time_point l_start = clock::now();
+    const bool l_timed =
+        a_budget.m_max_time != std::chrono::nanoseconds::max();
+
+    // per-term state is kept as parallel arrays: the terms themselves, their
+    // stats, and whether they are finished
+    a_stats.assign(a_terms.size(), normalize_stats());
+    std::vector<bool> l_finished(a_terms.size(), false);
+    std::vector<size_t> l_active;
+
+    for(size_t i = 0; i < a_terms.size(); ++i)
+    {
+        a_stats[i].m_max_size = a_terms[i].size();
+        l_active.push_back(i);
+    }
+
+    lockstep_stats l_result;
+
+    while(!l_active.empty())
+    {
+        ++l_result.m_rounds;
+
+        const size_t l_leader = l_active.front();
+        const flat_expr& l_leader_term = a_terms[l_leader];
+
+        flat_redex l_shared;
+        const bool l_have_shared = find_redex(l_leader_term, a_depth, l_shared);
+        const bool l_out_of_time =
+            l_timed && clock::now() - l_start >= a_budget.m_max_time;
+
+        // one step of a term with the same checks, in the same order, as
+        // normalize(). a_redex is the leader's redex if it applies. Returns
+        // whether a redex was contracted.
+        auto l_step = [&](size_t a_term, const flat_redex* a_redex) -> bool
+        {
+            flat_expr& l_term = a_terms[a_term];
+            normalize_stats& l_stats = a_stats[a_term];
+
+            auto l_finish = [&](normalize_status a_status)
+            {
+                l_stats.m_status = a_status;
+                l_stats.m_elapsed = clock::now() - l_start;
+                l_finished[a_term] = true;
+
+                return false;
+            };
+
+            if(l_term.size() > a_budget.m_max_size)
+                return l_finish(normalize_status::size_limit);
+
+            if(l_out_of_time)
+                return l_finish(is_normal(l_term)
+                                    ? normalize_status::normal_form
+                                    : normalize_status::time_limit);
+
+            if(l_stats.m_steps >= a_budget.m_max_steps)
+                return l_finish(is_normal(l_term)
+                                    ? normalize_status::normal_form
+                                    : normalize_status::step_limit);
+
+            flat_redex l_redex;
+
+            if(a_redex)
+                l_redex = *a_redex;
+            else if(!find_redex(l_term, a_depth, l_redex))
+                return l_finish(normalize_status::normal_form);
+
+            contract(l_term, l_redex);
+
+            ++l_stats.m_steps;
+            l_stats.m_max_size = std::max(l_stats.m_max_size, l_term.size());
+
+            return true;
+        };
+
+        // the leader goes last, since contracting it changes the tags the
+        // others are compared against
+        for(size_t i = 1; i < l_active.size(); ++i)
+        {
+            const flat_expr& l_term = a_terms[l_active[i]];
+            bool l_shares = false;
+
+            if(l_have_shared)
+            {
+                const size_t l_compared = l_shared.m_position + 2;
+
+                l_shares = l_term.size() >= l_compared &&
+                           bytes_equal(l_term.m_tags.data(),
+                                       l_leader_term.m_tags.data(),
+                                       l_compared);
+            }
+
+            // only steps that contract count, not a term found finished
+            if(!l_step(l_active[i], l_shares ? &l_shared : nullptr))
+                continue;
+
+            if(l_shares)
+                ++l_result.m_shared_steps;
+            else
+                ++l_result.m_divergent_steps;
+        }
+
+        l_step(l_leader, l_have_shared ? &l_shared : nullptr);
+
+        l_active.erase(std::remove_if(l_active.begin(), l_active.end(),
+                                      [&](size_t a_term)
+                                      { return l_finished[a_term]; }),
+                       l_active.end());
+    }
+
+    return l_result;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+void test_normalize_lockstep()
+{
+    // church numeral n: λf.λx.f (f ... x), built under a_depth binders
+    auto l_church = [](size_t a_n, size_t a_depth)
+    {
+        std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(a_depth), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    // the program applies an input n times to the identity: λn.((n λ.0) I)
+    auto l_program = f(a(a(v(0), f(v(1))), f(v(1))));
+
+    std::vector<std::unique_ptr<expr>> l_inputs;
+
+    for(size_t i = 0; i < 6; ++i)
+        l_inputs.push_back(l_church(i % 3 + 2, 0));
+
+    // a free variable and a diverging input
+    l_inputs.push_back(v(7));
+    l_inputs.push_back(a(f(a(v(0), v(0))), f(a(v(0), v(0)))));
+
+    budget l_budget;
+    l_budget.m_max_steps = 50;
+
+    // every term ends exactly as if normalized alone
+    {
+        std::vector<flat_expr> l_terms = apply_each(*l_program, l_inputs);
+        std::vector<normalize_stats> l_stats;
+
+        lockstep_stats l_lockstep =
+            normalize_lockstep(l_terms, l_stats, l_budget);
+
+        assert(l_terms.size() == l_inputs.size());
+        assert(l_stats.size() == l_inputs.size());
+
+        for(size_t i = 0; i < l_inputs.size(); ++i)
+        {
+            auto l_expected = a(l_program->clone(), l_inputs[i]->clone());
+            auto l_expected_stats = normalize(l_expected, l_budget);
+
+            assert(unflatten(l_terms[i])->equals(l_expected));
+            assert(l_stats[i].m_status == l_expected_stats.m_status);
+            assert(l_stats[i].m_steps == l_expected_stats.m_steps);
+            assert(l_stats[i].m_max_size == l_expected_stats.m_max_size);
+        }
+
+        // the church inputs agree on their first steps
+        assert(l_lockstep.m_shared_steps > 0);
+        assert(l_lockstep.m_divergent_steps > 0);
+        assert(l_lockstep.m_rounds == 50 + 1);
+        assert(l_stats.back().m_status == normalize_status::step_limit);
+    }
+
+    // a follower that is already normal takes no step, shared or not
+    {
+        std::vector<std::unique_ptr<expr>> l_inputs;
+        l_inputs.push_back(a(f(a(v(0), v(0))), f(a(v(0), v(0)))));
+        l_inputs.push_back(v(0));
+
+        std::vector<flat_expr> l_terms;
+
+        for(const auto& l_input : l_inputs)
+            l_terms.push_back(flatten(*l_input));
+
+        budget l_budget;
+        l_budget.m_max_steps = 3;
+
+        std::vector<normalize_stats> l_stats;
+        lockstep_stats l_lockstep =
+            normalize_lockstep(l_terms, l_stats, l_budget);
+
+        assert(l_stats[1].m_status == normalize_status::normal_form);
+        assert(l_stats[1].m_steps == 0);
+        assert(l_lockstep.m_shared_steps == 0);
+        assert(l_lockstep.m_divergent_steps == 0);
+    }
+
+    // an empty batch
+    {
+        std::vector<flat_expr> l_terms;
+        std::vector<normalize_stats> l_stats;
+        lockstep_stats l_lockstep = normalize_lockstep(l_terms, l_stats);
+        assert(l_lockstep.m_rounds == 0);
+        assert(l_stats.empty());
+    }
+}
+
+void lockstep_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_normalize_lockstep);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include <random>
+
+using namespace lambda;
+
+void bench_normalize_lockstep()
+{
+    const size_t l_runs = 3;
+    const size_t l_inputs_count = 256;
+    const size_t l_iterations = 100;
+    const size_t l_fields = 8;
+
+    // λx.((c H) I), where c is the church numeral l_iterations and
+    // H = λr.λs.((s (x I)) r). The result is a list of l_iterations copies of
+    // the input's fields, built left to right, so later redexes sit behind
+    // an ever longer normal prefix.
+    std::unique_ptr<expr> l_body = v(2);
+
+    for(size_t i = 0; i < l_iterations; ++i)
+        l_body = a(v(1), std::move(l_body));
+
+    auto l_numeral = f(f(std::move(l_body)));
+    auto l_cons = f(f(a(a(v(2), a(v(0), f(v(3)))), v(1))));
+    auto l_program =
+        f(a(a(std::move(l_numeral), std::move(l_cons)), f(v(1))));
+
+    // the inputs are tuples λs.(s y1 ... yn) of free variables: the same
+    // shape, and therefore the same control flow, with different contents
+    std::mt19937 l_rng(9);
+    std::vector<std::unique_ptr<expr>> l_inputs;
+
+    for(size_t i = 0; i < l_inputs_count; ++i)
+    {
+        std::unique_ptr<expr> l_tuple = v(0);
+
+        for(size_t j = 0; j < l_fields; ++j)
+            l_tuple = a(std::move(l_tuple), v(1000 + l_rng() % 1000));
+
+        l_inputs.push_back(f(std::move(l_tuple)));
+    }
+
+    std::vector<std::unique_ptr<expr>> l_trees;
+    std::vector<flat_expr> l_terms;
+    std::vector<normalize_stats> l_stats;
+    size_t l_steps = 0;
+
+    measurement l_measured = measure_best_of(
+        l_runs,
+        [&]
+        {
+            l_trees.clear();
+
+            for(const auto& l_input : l_inputs)
+                l_trees.push_back(a(l_program->clone(), l_input->clone()));
+        },
+        [&]
+        {
+            l_steps = 0;
+
+            for(auto& l_tree : l_trees)
+                l_steps += normalize(l_tree).m_steps;
+        });
+    report("normalize each (tree)", l_measured, l_steps);
+
+    l_measured = measure_best_of(
+        l_runs, [&] { l_terms = apply_each(*l_program, l_inputs); },
+        [&]
+        {
+            l_steps = 0;
+
+            for(flat_expr& l_term : l_terms)
+                l_steps += normalize(l_term).m_steps;
+        });
+    report("normalize each (flat)", l_measured, l_steps);
+
+    lockstep_stats l_lockstep;
+
+    l_measured = measure_best_of(
+        l_runs, [&] { l_terms = apply_each(*l_program, l_inputs); },
+        [&] { l_lockstep = normalize_lockstep(l_terms, l_stats); });
+    report("normalize_lockstep (flat)", l_measured, l_steps);
+
+    std::cout << "    rounds=" << l_lockstep.m_rounds
+              << " shared=" << l_lockstep.m_shared_steps
+              << " divergent=" << l_lockstep.m_divergent_steps << std::endl;
+
+    for(size_t i = 0; i < l_trees.size(); ++i)
+        if(!unflatten(l_terms[i])->equals(l_trees[i]))
+        {
+            std::cout << "    MISMATCH between tree and lockstep results"
+                      << std::endl;
+            break;
+        }
+}
+
+void lockstep_bench_main()
+{
+    BENCH(bench_normalize_lockstep);
+}
+
+#endif
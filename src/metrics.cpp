@@ -0,0 +1,581 @@
+#include "../include/metrics.hpp"
+#include "../include/node_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace lambda
+{
+
+size_t latency_histogram::bucket_of(uint64_t a_value)
+{
+    if(a_value < SUB_BUCKETS)
+        return a_value;
+
+    // the power of two below a_value picks the row, the next
+    // SUB_BUCKET_BITS bits the bucket within it
+    const size_t l_shift = std::bit_width(a_value) - 1 - SUB_BUCKET_BITS;
+
+    return (l_shift + 1) * SUB_BUCKETS + (a_value >> l_shift) - SUB_BUCKETS;
+}
+
+uint64_t latency_histogram::bucket_lower_bound(size_t a_bucket)
+{
+    if(a_bucket < SUB_BUCKETS)
+        return a_bucket;
+
+    const size_t l_shift = a_bucket / SUB_BUCKETS - 1;
+
+    return uint64_t(SUB_BUCKETS + a_bucket % SUB_BUCKETS) << l_shift;
+}
+
+void latency_histogram::record(uint64_t a_value, uint64_t a_count)
+{
+    m_buckets[bucket_of(a_value)] += a_count;
+    m_count += a_count;
+    m_sum += a_value * a_count;
+}
+
+void latency_histogram::merge(const latency_histogram& a_other)
+{
+    for(size_t i = 0; i < BUCKET_COUNT; ++i)
+        m_buckets[i] += a_other.m_buckets[i];
+
+    m_count += a_other.m_count;
+    m_sum += a_other.m_sum;
+}
+
+uint64_t latency_histogram::quantile(double a_quantile) const
+{
+    if(m_count == 0)
+        return 0;
+
+    // the rank of the value sought, from 1
+    const uint64_t l_rank = std::clamp<uint64_t>(
+        uint64_t(std::ceil(a_quantile * m_count)), 1, m_count);
+    uint64_t l_seen = 0;
+
+    for(size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        l_seen += m_buckets[i];
+
+        // the largest value the bucket holds
+        if(l_seen >= l_rank)
+            return i + 1 < BUCKET_COUNT ? bucket_lower_bound(i + 1) - 1
+                                        : UINT64_MAX;
+    }
+
+    return UINT64_MAX;
+}
+
+uint64_t latency_histogram::count() const
+{
+    return m_count;
+}
+
+uint64_t latency_histogram::sum() const
+{
+    return m_sum;
+}
+
+uint64_t latency_histogram::bucket_count(size_t a_bucket) const
+{
+    return m_buckets[a_bucket];
+}
+
+namespace
+{
+
+enum counter : size_t
+{
+    NORMALIZATIONS,
+    BUDGET_ABORTS,
+    STEPS,
+    CACHE_LOOKUPS,
+    CACHE_HITS,
+    COUNTER_COUNT,
+};
+
+// a cell only its thread writes: a load and a store, which on common cpus
+// cost no more than on a plain integer, and still let scrapes read it
+void bump(std::atomic<uint64_t>& a_cell, uint64_t a_amount)
+{
+    a_cell.store(a_cell.load(std::memory_order_relaxed) + a_amount,
+                 std::memory_order_relaxed);
+}
+
+struct thread_histogram
+{
+    std::atomic<uint64_t> m_buckets[latency_histogram::BUCKET_COUNT] = {};
+    std::atomic<uint64_t> m_sum = 0;
+
+    void record(uint64_t a_value)
+    {
+        bump(m_buckets[latency_histogram::bucket_of(a_value)], 1);
+        bump(m_sum, a_value);
+    }
+
+    void add_to(latency_histogram& a_histogram) const
+    {
+        for(size_t i = 0; i < latency_histogram::BUCKET_COUNT; ++i)
+            if(const uint64_t l_count =
+                   m_buckets[i].load(std::memory_order_relaxed))
+                a_histogram.record(latency_histogram::bucket_lower_bound(i),
+                                   l_count);
+    }
+};
+
+struct alignas(64) thread_metrics
+{
+    std::atomic<uint64_t> m_counters[COUNTER_COUNT] = {};
+    thread_histogram m_normalize_latency;
+    thread_histogram m_step_latency;
+};
+
+// the metrics of every thread that ever recorded, and those of exited
+// threads, which new threads take over. Never destroyed, like the records,
+// so that their counts outlive the threads.
+struct metrics_registry
+{
+    std::mutex m_mutex;
+    std::vector<thread_metrics*> m_all;
+    std::vector<thread_metrics*> m_released;
+};
+
+metrics_registry& registry()
+{
+    static metrics_registry* l_registry = new metrics_registry;
+    return *l_registry;
+}
+
+thread_local thread_metrics* t_metrics = nullptr;
+
+// hands the thread's metrics back when the thread exits.
+struct metrics_releaser
+{
+    ~metrics_releaser()
+    {
+        metrics_registry& l_registry = registry();
+        std::lock_guard<std::mutex> l_lock(l_registry.m_mutex);
+        l_registry.m_released.push_back(t_metrics);
+        t_metrics = nullptr;
+    }
+};
+
+thread_local bool t_released = false;
+
+thread_metrics& current_metrics()
+{
+    if(t_metrics)
+        return *t_metrics;
+
+    {
+        metrics_registry& l_registry = registry();
+        std::lock_guard<std::mutex> l_lock(l_registry.m_mutex);
+
+        if(!l_registry.m_released.empty())
+        {
+            t_metrics = l_registry.m_released.back();
+            l_registry.m_released.pop_back();
+        }
+        else
+        {
+            t_metrics = new thread_metrics;
+            l_registry.m_all.push_back(t_metrics);
+        }
+    }
+
+    // recording again during the thread's own exit keeps the new metrics
+    if(!t_released)
+    {
+        t_released = true;
+        thread_local metrics_releaser l_releaser;
+    }
+
+    return *t_metrics;
+}
+
+} // namespace
+
+void record_normalization(const normalize_stats& a_stats)
+{
+    thread_metrics& l_metrics = current_metrics();
+    const uint64_t l_elapsed = a_stats.m_elapsed.count();
+
+    bump(l_metrics.m_counters[NORMALIZATIONS], 1);
+    bump(l_metrics.m_counters[STEPS], a_stats.m_steps);
+
+    if(a_stats.m_status != normalize_status::normal_form)
+        bump(l_metrics.m_counters[BUDGET_ABORTS], 1);
+
+    l_metrics.m_normalize_latency.record(l_elapsed);
+
+    if(a_stats.m_steps > 0)
+        l_metrics.m_step_latency.record(l_elapsed / a_stats.m_steps);
+}
+
+void record_cache_lookups(uint64_t a_lookups, uint64_t a_hits)
+{
+    thread_metrics& l_metrics = current_metrics();
+
+    bump(l_metrics.m_counters[CACHE_LOOKUPS], a_lookups);
+    bump(l_metrics.m_counters[CACHE_HITS], a_hits);
+}
+
+metrics_snapshot scrape_metrics()
+{
+    metrics_snapshot l_snapshot;
+    uint64_t l_counters[COUNTER_COUNT] = {};
+
+    {
+        metrics_registry& l_registry = registry();
+        std::lock_guard<std::mutex> l_lock(l_registry.m_mutex);
+
+        for(const thread_metrics* l_metrics : l_registry.m_all)
+        {
+            for(size_t i = 0; i < COUNTER_COUNT; ++i)
+                l_counters[i] +=
+                    l_metrics->m_counters[i].load(std::memory_order_relaxed);
+
+            l_metrics->m_normalize_latency.add_to(
+                l_snapshot.m_normalize_latency);
+            l_metrics->m_step_latency.add_to(l_snapshot.m_step_latency);
+        }
+    }
+
+    l_snapshot.m_normalizations = l_counters[NORMALIZATIONS];
+    l_snapshot.m_budget_aborts = l_counters[BUDGET_ABORTS];
+    l_snapshot.m_steps = l_counters[STEPS];
+    l_snapshot.m_cache_lookups = l_counters[CACHE_LOOKUPS];
+    l_snapshot.m_cache_hits = l_counters[CACHE_HITS];
+    l_snapshot.m_nodes_allocated = node_pool_allocations();
+
+    return l_snapshot;
+}
+
+static void write_counter(std::ostream& a_ostream, const char* a_name,
+                          const char* a_help, uint64_t a_value)
+{
+    a_ostream << "# HELP lc_" << a_name << "_total " << a_help << '\n'
+              << "# TYPE lc_" << a_name << "_total counter\n"
+              << "lc_" << a_name << "_total " << a_value << '\n';
+}
+
+static void write_histogram(std::ostream& a_ostream, const char* a_name,
+                            const char* a_help,
+                            const latency_histogram& a_histogram)
+{
+    a_ostream << "# HELP lc_" << a_name << "_seconds " << a_help << '\n'
+              << "# TYPE lc_" << a_name << "_seconds histogram\n";
+
+    uint64_t l_cumulative = 0;
+    size_t l_bucket = 0;
+
+    // a bucket per power of two from about 1us to about 1000s, each counting
+    // every value below it; the same bounds in every scrape, as Prometheus
+    // expects. They fall on bucket boundaries, so the counts are exact
+    for(size_t l_bit = 10; l_bit <= 40; ++l_bit)
+    {
+        const uint64_t l_bound = uint64_t(1) << l_bit;
+        const size_t l_end = latency_histogram::bucket_of(l_bound);
+
+        for(; l_bucket < l_end; ++l_bucket)
+            l_cumulative += a_histogram.bucket_count(l_bucket);
+
+        a_ostream << "lc_" << a_name << "_seconds_bucket{le=\""
+                  << l_bound / 1e9 << "\"} " << l_cumulative << '\n';
+    }
+
+    a_ostream << "lc_" << a_name << "_seconds_bucket{le=\"+Inf\"} "
+              << a_histogram.count() << '\n'
+              << "lc_" << a_name << "_seconds_sum " << a_histogram.sum() / 1e9
+              << '\n'
+              << "lc_" << a_name << "_seconds_count " << a_histogram.count()
+              << '\n';
+}
+
+void write_prometheus(std::ostream& a_ostream,
+                      const metrics_snapshot& a_snapshot)
+{
+    const std::ios_base::fmtflags l_flags = a_ostream.flags();
+    const std::streamsize l_precision = a_ostream.precision();
+
+    // enough digits for the bounds to tell apart and the sums to be exact
+    // to the nanosecond over days
+    a_ostream.flags(std::ios_base::fmtflags());
+    a_ostream.precision(15);
+
+    write_counter(a_ostream, "normalizations", "Normalizations finished.",
+                  a_snapshot.m_normalizations);
+    write_counter(a_ostream, "budget_aborts",
+                  "Normalizations stopped by a limit of their budget.",
+                  a_snapshot.m_budget_aborts);
+    write_counter(a_ostream, "steps", "Beta-reductions performed.",
+                  a_snapshot.m_steps);
+    write_counter(a_ostream, "nodes_allocated",
+                  "Expression nodes allocated from the node pools.",
+                  a_snapshot.m_nodes_allocated);
+    write_counter(a_ostream, "cache_lookups",
+                  "Term corpus and intern table lookups.",
+                  a_snapshot.m_cache_lookups);
+    write_counter(a_ostream, "cache_hits",
+                  "Lookups that found the term already present.",
+                  a_snapshot.m_cache_hits);
+    write_histogram(a_ostream, "normalize_duration",
+                    "Wall-clock time of whole normalizations.",
+                    a_snapshot.m_normalize_latency);
+    write_histogram(a_ostream, "step_duration",
+                    "Time per beta-reduction of each normalization.",
+                    a_snapshot.m_step_latency);
+
+    a_ostream.flags(l_flags);
+    a_ostream.precision(l_precision);
+}
+
+void export_metrics(const std::string& a_path)
+{
+    const std::string l_temporary = a_path + ".tmp";
+
+    {
+        std::ofstream l_file(l_temporary, std::ios::trunc);
+        write_prometheus(l_file, scrape_metrics());
+
+        if(!l_file.flush())
+            throw std::runtime_error("export_metrics: cannot write " +
+                                     l_temporary);
+    }
+
+    if(std::rename(l_temporary.c_str(), a_path.c_str()) != 0)
+        throw std::runtime_error("export_metrics: cannot replace " + a_path);
+}
+
+void export_metrics(const std::function<void(std::string_view)>& a_sink)
+{
+    std::ostringstream l_text;
+    write_prometheus(l_text, scrape_metrics());
+    a_sink(l_text.str());
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../include/corpus.hpp"
+#include "../include/flat.hpp"
+#include "../include/intern.hpp"
+#include "../testing/test_utils.hpp"
+#include <thread>
+
+using namespace lambda;
+
+void test_latency_histogram()
+{
+    // small values have a bucket each; above, every power of two is split
+    // into SUB_BUCKETS buckets
+    {
+        for(uint64_t i = 0; i < 32; ++i)
+            assert(latency_histogram::bucket_of(i) == i);
+
+        assert(latency_histogram::bucket_of(32) == 32);
+        assert(latency_histogram::bucket_of(63) == 63);
+        assert(latency_histogram::bucket_of(64) == 64);
+        assert(latency_histogram::bucket_of(65) == 64);
+        assert(latency_histogram::bucket_of(66) == 65);
+        assert(latency_histogram::bucket_of(UINT64_MAX) ==
+               latency_histogram::BUCKET_COUNT - 1);
+    }
+
+    // every bucket starts at its lower bound and ends just before the next
+    {
+        for(size_t b = 0; b < latency_histogram::BUCKET_COUNT; ++b)
+        {
+            const uint64_t l_lower = latency_histogram::bucket_lower_bound(b);
+            assert(latency_histogram::bucket_of(l_lower) == b);
+
+            if(b > 0)
+                assert(latency_histogram::bucket_of(l_lower - 1) == b - 1);
+        }
+    }
+
+    // quantiles are exact below SUB_BUCKETS and within 1/SUB_BUCKETS above
+    {
+        latency_histogram l_histogram;
+        assert(l_histogram.quantile(0.5) == 0);
+
+        for(uint64_t i = 1; i <= 10; ++i)
+            l_histogram.record(i);
+
+        assert(l_histogram.count() == 10);
+        assert(l_histogram.sum() == 55);
+        assert(l_histogram.quantile(0) == 1);
+        assert(l_histogram.quantile(0.5) == 5);
+        assert(l_histogram.quantile(0.9) == 9);
+        assert(l_histogram.quantile(1) == 10);
+
+        l_histogram.record(1000000, 90);
+
+        const uint64_t l_p99 = l_histogram.quantile(0.99);
+        assert(l_p99 >= 1000000 && l_p99 - 1000000 <= 1000000 / 32);
+        assert(l_histogram.quantile(0.1) == 10);
+    }
+
+    // merging adds the counts
+    {
+        latency_histogram l_left;
+        latency_histogram l_right;
+        l_left.record(5, 2);
+        l_right.record(5);
+        l_right.record(100);
+        l_left.merge(l_right);
+
+        assert(l_left.count() == 4);
+        assert(l_left.sum() == 115);
+        assert(l_left.bucket_count(5) == 3);
+        assert(l_left.quantile(1) == 100 + 1);
+    }
+}
+
+void test_scrape_metrics()
+{
+    // normalizations on several threads, one stopped by its budget, are
+    // summed into the snapshot, including those of exited threads
+    {
+        const metrics_snapshot l_before = scrape_metrics();
+
+        auto l_work = []
+        {
+            // S K K a takes 5 steps
+            auto K = f(f(v(0)));
+            auto S = f(f(f(a(a(v(0), v(2)), a(v(1), v(2))))));
+            auto l_expr = a(a(a(S->clone(), K->clone()), K->clone()), v(10));
+            normalize(l_expr);
+
+            // omega stops at its step limit
+            auto l_omega = a(f(a(v(0), v(0))), f(a(v(0), v(0))));
+            budget l_budget;
+            l_budget.m_max_steps = 7;
+            normalize(l_omega, l_budget);
+        };
+
+        std::thread l_first(l_work);
+        std::thread l_second(l_work);
+        l_work();
+        l_first.join();
+        l_second.join();
+
+        // flat normalization is counted as well
+        flat_expr l_flat = flatten(*a(f(v(0)), v(3)));
+        normalize(l_flat);
+
+        const metrics_snapshot l_after = scrape_metrics();
+
+        assert(l_after.m_normalizations - l_before.m_normalizations == 7);
+        assert(l_after.m_budget_aborts - l_before.m_budget_aborts == 3);
+        assert(l_after.m_steps - l_before.m_steps == 3 * (5 + 7) + 1);
+        assert(l_after.m_normalize_latency.count() -
+                   l_before.m_normalize_latency.count() ==
+               7);
+        assert(l_after.m_step_latency.count() -
+                   l_before.m_step_latency.count() ==
+               7);
+#ifndef LC_NO_NODE_POOL
+        assert(l_after.m_nodes_allocated > l_before.m_nodes_allocated);
+#endif
+    }
+
+    // corpus and intern table lookups, with their hits
+    {
+        const metrics_snapshot l_before = scrape_metrics();
+
+        term_corpus l_corpus;
+        l_corpus.insert(*f(v(0)));
+        l_corpus.insert(*f(v(0)));
+        l_corpus.find(flatten(*v(0)));
+
+        intern_table l_table;
+        l_table.intern(*f(v(0)));
+        l_table.intern(*f(v(0)));
+
+        const metrics_snapshot l_after = scrape_metrics();
+
+        // corpus: miss, hit, miss; table: two misses, then two hits
+        assert(l_after.m_cache_lookups - l_before.m_cache_lookups == 7);
+        assert(l_after.m_cache_hits - l_before.m_cache_hits == 3);
+    }
+}
+
+void test_export_metrics()
+{
+    metrics_snapshot l_snapshot;
+    l_snapshot.m_normalizations = 3;
+    l_snapshot.m_budget_aborts = 1;
+    l_snapshot.m_steps = 40;
+    l_snapshot.m_normalize_latency.record(1500);
+    l_snapshot.m_normalize_latency.record(3000, 2);
+
+    std::ostringstream l_text;
+    write_prometheus(l_text, l_snapshot);
+    const std::string l_result = l_text.str();
+
+    auto l_contains = [&](const std::string& a_line)
+    { return l_result.find(a_line + "\n") != std::string::npos; };
+
+    // counters, with their metadata
+    assert(l_contains("# TYPE lc_normalizations_total counter"));
+    assert(l_contains("lc_normalizations_total 3"));
+    assert(l_contains("lc_budget_aborts_total 1"));
+    assert(l_contains("lc_steps_total 40"));
+    assert(l_contains("lc_cache_hits_total 0"));
+
+    // cumulative buckets, with the same bounds whatever was recorded
+    assert(l_contains("# TYPE lc_normalize_duration_seconds histogram"));
+    assert(l_contains("lc_normalize_duration_seconds_bucket{le=\"1.024e-06\"} 0"));
+    assert(l_contains("lc_normalize_duration_seconds_bucket{le=\"2.048e-06\"} 1"));
+    assert(l_contains("lc_normalize_duration_seconds_bucket{le=\"4.096e-06\"} 3"));
+    assert(l_contains("lc_normalize_duration_seconds_bucket{le=\"8.192e-06\"} 3"));
+    assert(l_contains("lc_normalize_duration_seconds_bucket{le=\"1099.511627776\"} 3"));
+    assert(l_contains("lc_step_duration_seconds_bucket{le=\"1.024e-06\"} 0"));
+    assert(l_contains("lc_step_duration_seconds_bucket{le=\"1099.511627776\"} 0"));
+    assert(l_result.find("le=\"2199.023255552\"") == std::string::npos);
+    assert(l_contains("lc_normalize_duration_seconds_bucket{le=\"+Inf\"} 3"));
+    assert(l_contains("lc_normalize_duration_seconds_sum 7.5e-06"));
+    assert(l_contains("lc_normalize_duration_seconds_count 3"));
+    assert(l_contains("lc_step_duration_seconds_count 0"));
+
+    // both exports carry the scraped text
+    {
+        std::string l_received;
+        export_metrics([&](std::string_view a_text) { l_received = a_text; });
+        assert(l_received.find("lc_steps_total ") != std::string::npos);
+
+        const std::string l_path = "/tmp/lc_metrics_test.prom";
+        export_metrics(l_path);
+
+        std::ifstream l_file(l_path);
+        const std::string l_written((std::istreambuf_iterator<char>(l_file)),
+                                    std::istreambuf_iterator<char>());
+        assert(l_written.find("lc_steps_total ") != std::string::npos);
+        std::remove(l_path.c_str());
+    }
+
+    // unwritable paths throw
+    assert_throws(export_metrics("/nonexistent/lc.prom"), std::runtime_error);
+}
+
+void metrics_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_latency_histogram);
+    TEST(test_scrape_metrics);
+    TEST(test_export_metrics);
+}
+
+#endif
@@ -0,0 +1,507 @@
+#include "../include/node_pool.hpp"
+#include "../include/lambda.hpp"
+#include "../include/probes.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace lambda
+{
+
+namespace
+{
+
+constexpr size_t CHUNK_SIZE = size_t(1) << 16;
+// frees a thread queues for another thread's pool before pushing them
+constexpr size_t REMOTE_BATCH_SIZE = 64;
+
+struct free_block
+{
+    free_block* m_next;
+};
+
+struct pool;
+
+// chunks are aligned to their size, so the chunk, and with it the owning
+// pool, of any block is found by masking its address.
+struct alignas(64) chunk_header
+{
+    pool* m_owner;
+};
+
+struct pool
+{
+    // touched only by the owning thread
+    free_block* m_local = nullptr;
+    char* m_bump = nullptr;
+    char* m_bump_end = nullptr;
+    node_pool_stats m_stats;
+    // blocks handed out; written only by the owner, read by any thread
+    std::atomic<uint64_t> m_allocations = 0;
+
+    // pushed to by other threads
+    alignas(64) std::atomic<free_block*> m_remote = nullptr;
+    std::atomic<size_t> m_remote_count = 0;
+};
+
+// pools whose thread exited, waiting for a new owner, and every pool ever
+// created. Never destroyed, so that threads exiting during static
+// destruction can still park theirs.
+struct pool_registry
+{
+    std::mutex m_mutex;
+    std::vector<pool*> m_parked;
+    std::vector<pool*> m_all;
+};
+
+pool_registry& registry()
+{
+    static pool_registry* l_registry = new pool_registry;
+    return *l_registry;
+}
+
+pool* acquire_pool()
+{
+    pool_registry& l_registry = registry();
+    std::lock_guard<std::mutex> l_lock(l_registry.m_mutex);
+
+    if(!l_registry.m_parked.empty())
+    {
+        pool* l_pool = l_registry.m_parked.back();
+        l_registry.m_parked.pop_back();
+        return l_pool;
+    }
+
+    l_registry.m_all.push_back(new pool);
+
+    return l_registry.m_all.back();
+}
+
+// frees bound for one foreign pool, linked through the blocks themselves.
+// Trivially destructible, like t_pool, so both stay usable while the
+// thread's other thread_local objects are destroyed.
+struct remote_batch
+{
+    pool* m_owner;
+    free_block* m_head;
+    free_block* m_tail;
+    size_t m_count;
+};
+
+thread_local pool* t_pool = nullptr;
+thread_local remote_batch t_batch = {nullptr, nullptr, nullptr, 0};
+
+void flush_batch()
+{
+    if(t_batch.m_count == 0)
+        return;
+
+    pool& l_owner = *t_batch.m_owner;
+
+    // the owner takes the whole list at once, so pushes cannot suffer ABA
+    t_batch.m_tail->m_next = l_owner.m_remote.load(std::memory_order_relaxed);
+
+    while(!l_owner.m_remote.compare_exchange_weak(
+        t_batch.m_tail->m_next, t_batch.m_head, std::memory_order_release,
+        std::memory_order_relaxed))
+        ;
+
+    l_owner.m_remote_count.fetch_add(t_batch.m_count,
+                                     std::memory_order_relaxed);
+
+    t_batch = {nullptr, nullptr, nullptr, 0};
+}
+
+// parks the thread's pool when the thread exits.
+struct pool_parker
+{
+    ~pool_parker()
+    {
+        flush_batch();
+
+        pool_registry& l_registry = registry();
+        std::lock_guard<std::mutex> l_lock(l_registry.m_mutex);
+        l_registry.m_parked.push_back(t_pool);
+        t_pool = nullptr;
+    }
+};
+
+thread_local bool t_parked = false;
+
+pool& current_pool()
+{
+    if(t_pool)
+        return *t_pool;
+
+    t_pool = acquire_pool();
+
+    // a thread allocating again after its pool was parked, during its own
+    // exit, keeps the new pool
+    if(!t_parked)
+    {
+        t_parked = true;
+        thread_local pool_parker l_parker;
+    }
+
+    return *t_pool;
+}
+
+} // namespace
+
+void* node_pool_allocate(size_t a_bytes)
+{
+    if(a_bytes > NODE_POOL_BLOCK_SIZE)
+        return ::operator new(a_bytes);
+
+    pool& l_pool = current_pool();
+
+    // the only writer, so no read-modify-write is needed
+    l_pool.m_allocations.store(
+        l_pool.m_allocations.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+
+    if(!l_pool.m_local &&
+       l_pool.m_remote.load(std::memory_order_relaxed) != nullptr)
+    {
+        l_pool.m_local =
+            l_pool.m_remote.exchange(nullptr, std::memory_order_acquire);
+        l_pool.m_stats.m_reclaimed_remote_frees +=
+            l_pool.m_remote_count.exchange(0, std::memory_order_relaxed);
+    }
+
+    if(free_block* l_block = l_pool.m_local)
+    {
+        l_pool.m_local = l_block->m_next;
+        return l_block;
+    }
+
+    if(l_pool.m_bump == l_pool.m_bump_end)
+    {
+        void* l_chunk = std::aligned_alloc(CHUNK_SIZE, CHUNK_SIZE);
+
+        if(!l_chunk)
+            throw std::bad_alloc();
+
+        static_cast<chunk_header*>(l_chunk)->m_owner = &l_pool;
+        l_pool.m_bump = static_cast<char*>(l_chunk) + sizeof(chunk_header);
+        l_pool.m_bump_end = static_cast<char*>(l_chunk) + CHUNK_SIZE;
+        ++l_pool.m_stats.m_chunks;
+    }
+
+    void* l_block = l_pool.m_bump;
+    l_pool.m_bump += NODE_POOL_BLOCK_SIZE;
+
+    return l_block;
+}
+
+void node_pool_free(void* a_pointer, size_t a_bytes)
+{
+    if(a_bytes > NODE_POOL_BLOCK_SIZE)
+        return ::operator delete(a_pointer);
+
+    free_block* l_block = static_cast<free_block*>(a_pointer);
+    pool* l_owner =
+        reinterpret_cast<chunk_header*>(reinterpret_cast<uintptr_t>(a_pointer) &
+                                        ~(CHUNK_SIZE - 1))
+            ->m_owner;
+
+    // a thread that only frees still needs its batch flushed when it exits
+    pool& l_pool = current_pool();
+
+    if(l_owner == &l_pool)
+    {
+        l_block->m_next = l_pool.m_local;
+        l_pool.m_local = l_block;
+        ++l_pool.m_stats.m_local_frees;
+        return;
+    }
+
+    if(t_batch.m_owner != l_owner)
+        flush_batch();
+
+    l_block->m_next = t_batch.m_head;
+    t_batch.m_head = l_block;
+
+    if(t_batch.m_count++ == 0)
+    {
+        t_batch.m_owner = l_owner;
+        t_batch.m_tail = l_block;
+    }
+
+    if(t_batch.m_count == REMOTE_BATCH_SIZE)
+        flush_batch();
+}
+
+void node_pool_flush()
+{
+    flush_batch();
+}
+
+node_pool_stats node_pool_thread_stats()
+{
+    return current_pool().m_stats;
+}
+
+uint64_t node_pool_allocations()
+{
+    pool_registry& l_registry = registry();
+    std::lock_guard<std::mutex> l_lock(l_registry.m_mutex);
+    uint64_t l_result = 0;
+
+    for(const pool* l_pool : l_registry.m_all)
+        l_result += l_pool->m_allocations.load(std::memory_order_relaxed);
+
+    return l_result;
+}
+
+#ifndef LC_NO_NODE_POOL
+
+static_assert(sizeof(var) <= NODE_POOL_BLOCK_SIZE &&
+                  sizeof(func) <= NODE_POOL_BLOCK_SIZE &&
+                  sizeof(app) <= NODE_POOL_BLOCK_SIZE,
+              "every node kind must fit a pool block");
+
+void* expr::operator new(size_t a_bytes)
+{
+    LC_PROBE1(node_alloc, a_bytes);
+    return node_pool_allocate(a_bytes);
+}
+
+void expr::operator delete(void* a_pointer, size_t a_bytes)
+{
+    LC_PROBE1(node_free, a_bytes);
+    node_pool_free(a_pointer, a_bytes);
+}
+
+#endif
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <set>
+#include <thread>
+
+using namespace lambda;
+
+void test_node_pool()
+{
+    // a block freed by its owner is the next one handed out
+    {
+        void* l_first = node_pool_allocate(24);
+        node_pool_free(l_first, 24);
+        assert(node_pool_allocate(24) == l_first);
+        node_pool_free(l_first, 24);
+    }
+
+    // blocks freed by another thread return to their owner
+    {
+        const size_t l_count = 10000;
+
+        std::thread(
+            [&]
+            {
+                std::vector<void*> l_blocks;
+                std::set<void*> l_freed;
+
+                for(size_t i = 0; i < l_count; ++i)
+                    l_blocks.push_back(node_pool_allocate(32));
+
+                l_freed.insert(l_blocks.begin(), l_blocks.end());
+
+                std::thread(
+                    [&]
+                    {
+                        for(void* l_block : l_blocks)
+                            node_pool_free(l_block, 32);
+                    })
+                    .join();
+
+                // the pool may have been parked with free blocks of its own,
+                // which are handed out first. Once they run out, the owner
+                // takes back every block the other thread freed, ahead of
+                // any that other threads returned earlier.
+                const size_t l_reclaimed =
+                    node_pool_thread_stats().m_reclaimed_remote_frees;
+                void* l_next;
+
+                do
+                    l_next = node_pool_allocate(32);
+                while(node_pool_thread_stats().m_reclaimed_remote_frees ==
+                      l_reclaimed);
+
+                assert(node_pool_thread_stats().m_reclaimed_remote_frees >=
+                       l_reclaimed + l_count);
+                assert(l_freed.count(l_next) == 1);
+
+                for(size_t i = 1; i < l_count; ++i)
+                    assert(l_freed.count(node_pool_allocate(32)) == 1);
+            })
+            .join();
+    }
+
+    // larger allocations bypass the pools
+    {
+        void* l_large = node_pool_allocate(NODE_POOL_BLOCK_SIZE + 1);
+        node_pool_free(l_large, NODE_POOL_BLOCK_SIZE + 1);
+    }
+
+    // terms built on one thread and destroyed on another
+    {
+        std::vector<std::unique_ptr<expr>> l_terms;
+
+        std::thread(
+            [&]
+            {
+                for(size_t i = 0; i < 1000; ++i)
+                    l_terms.push_back(f(a(v(i), f(v(0)))));
+            })
+            .join();
+
+        // the producer has exited: its pool is parked with these in use
+        std::thread(
+            [&]
+            {
+                for(size_t i = 0; i < l_terms.size(); ++i)
+                    assert(l_terms[i]->equals(f(a(v(i), f(v(0))))));
+
+                l_terms.clear();
+            })
+            .join();
+    }
+}
+
+void node_pool_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_node_pool);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+using namespace lambda;
+
+// a_items blocks allocated on one thread and freed on another, handed over
+// in batches through a locked queue, as between a parser and a normalizer.
+template <typename ALLOCATE, typename FREE>
+static void producer_consumer(size_t a_items, ALLOCATE&& a_allocate,
+                              FREE&& a_free)
+{
+    const size_t l_batch = 1024;
+    std::mutex l_mutex;
+    std::condition_variable l_ready;
+    std::deque<std::vector<void*>> l_queue;
+    bool l_done = false;
+
+    std::thread l_consumer(
+        [&]
+        {
+            while(true)
+            {
+                std::vector<void*> l_blocks;
+
+                {
+                    std::unique_lock<std::mutex> l_lock(l_mutex);
+                    l_ready.wait(l_lock,
+                                 [&] { return l_done || !l_queue.empty(); });
+
+                    if(l_queue.empty())
+                        return;
+
+                    l_blocks = std::move(l_queue.front());
+                    l_queue.pop_front();
+                }
+
+                for(void* l_block : l_blocks)
+                    a_free(l_block);
+            }
+        });
+
+    for(size_t i = 0; i < a_items; i += l_batch)
+    {
+        std::vector<void*> l_blocks;
+
+        for(size_t j = 0; j < l_batch; ++j)
+            l_blocks.push_back(a_allocate());
+
+        {
+            std::lock_guard<std::mutex> l_lock(l_mutex);
+            l_queue.push_back(std::move(l_blocks));
+        }
+
+        l_ready.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> l_lock(l_mutex);
+        l_done = true;
+    }
+
+    l_ready.notify_one();
+    l_consumer.join();
+}
+
+void bench_node_pool()
+{
+    const size_t l_runs = 3;
+    const size_t l_items = 4000000;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [] {},
+        [&]
+        {
+            producer_consumer(
+                l_items, [] { return ::operator new(NODE_POOL_BLOCK_SIZE); },
+                [](void* a_block) { ::operator delete(a_block); });
+        });
+    report("producer/consumer (global allocator)", l_measured, l_items);
+
+    l_measured = measure_best_of(
+        l_runs, [] {},
+        [&]
+        {
+            producer_consumer(
+                l_items,
+                [] { return node_pool_allocate(NODE_POOL_BLOCK_SIZE); },
+                [](void* a_block)
+                { node_pool_free(a_block, NODE_POOL_BLOCK_SIZE); });
+        });
+    report("producer/consumer (node pools)", l_measured, l_items);
+
+    // building and destroying terms on one thread, through whichever
+    // allocator expr uses in this build
+    auto l_term = f(a(a(v(0), v(0)), f(a(v(1), v(0)))));
+
+    for(size_t i = 0; i < 12; ++i)
+        l_term = a(l_term->clone(), std::move(l_term));
+
+    const size_t l_nodes = l_term->m_size;
+
+    l_measured = measure_best_of(
+        l_runs, [] {},
+        [&]
+        {
+            for(size_t i = 0; i < 20; ++i)
+                keep(l_term->clone());
+        });
+    report("clone + destroy", l_measured, 20 * l_nodes);
+}
+
+void node_pool_bench_main()
+{
+    BENCH(bench_node_pool);
+}
+
+#endif
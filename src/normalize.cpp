@@ -0,0 +1,324 @@
+#include "../include/normalize.hpp"
+#include "../include/metrics.hpp"
+#include "../include/probes.hpp"
+#include "../include/strictness.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace lambda
+{
+
+bool is_normal(const expr& a_expr)
+{
+    if(dynamic_cast<const var*>(&a_expr))
+        return true;
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return is_normal(*l_func->m_body);
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+    {
+        // a func in function position is a redex
+        if(dynamic_cast<const func*>(l_app->m_lhs.get()))
+            return false;
+
+        return is_normal(*l_app->m_lhs) && is_normal(*l_app->m_rhs);
+    }
+
+    // if we get here, error
+    throw std::runtime_error("is_normal: invalid expression type");
+}
+
+bool reduce_one_step_applicative(std::unique_ptr<expr>& a_expr,
+                                 size_t a_depth)
+{
+    if(dynamic_cast<var*>(a_expr.get()))
+    {
+        // variables cannot reduce
+        return false;
+    }
+
+    if(func* l_func = dynamic_cast<func*>(a_expr.get()))
+    {
+        if(reduce_one_step_applicative(l_func->m_body, a_depth + 1))
+        {
+            l_func->update_size();
+
+            return true;
+        }
+
+        return false;
+    }
+
+    if(app* l_app = dynamic_cast<app*>(a_expr.get()))
+    {
+        // innermost first: both sides must be normal before contracting
+        if(reduce_one_step_applicative(l_app->m_lhs, a_depth) ||
+           reduce_one_step_applicative(l_app->m_rhs, a_depth))
+        {
+            l_app->update_size();
+
+            return true;
+        }
+
+        if(func* l_lhs_func = dynamic_cast<func*>(l_app->m_lhs.get()))
+        {
+            substitute(l_lhs_func->m_body, 0, a_depth, l_app->m_rhs);
+            a_expr = std::move(l_lhs_func->m_body);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    // if we get here, error
+    throw std::runtime_error(
+        "reduce_one_step_applicative: invalid expression type");
+}
+
+normalize_stats normalize(std::unique_ptr<expr>& a_expr,
+                          const budget& a_budget, strategy a_strategy,
+                          size_t a_depth)
+{
+    bool (*l_step)(std::unique_ptr<expr>&, size_t) = &reduce_one_step;
+
+    if(a_strategy == strategy::applicative_order)
+        l_step = &reduce_one_step_applicative;
+    else if(a_strategy == strategy::strict_arguments)
+        l_step = &reduce_one_step_strict;
+
+    using clock = std::chrono::steady_clock;
+
+    const clock::time_point l_start = clock::now();
+    const bool l_timed =
+        a_budget.m_max_time != std::chrono::nanoseconds::max();
+
+    normalize_stats l_stats;
+    l_stats.m_max_size = a_expr->m_size;
+
+    while(true)
+    {
+        if(a_expr->m_size > a_budget.m_max_size)
+        {
+            l_stats.m_status = normalize_status::size_limit;
+            break;
+        }
+
+        if(l_timed && clock::now() - l_start >= a_budget.m_max_time)
+        {
+            l_stats.m_status = is_normal(*a_expr)
+                                   ? normalize_status::normal_form
+                                   : normalize_status::time_limit;
+            break;
+        }
+
+        if(l_stats.m_steps >= a_budget.m_max_steps)
+        {
+            // only report the limit if another step was actually possible
+            l_stats.m_status = is_normal(*a_expr)
+                                   ? normalize_status::normal_form
+                                   : normalize_status::step_limit;
+            break;
+        }
+
+        if(!l_step(a_expr, a_depth))
+        {
+            l_stats.m_status = normalize_status::normal_form;
+            break;
+        }
+
+        ++l_stats.m_steps;
+        l_stats.m_max_size = std::max(l_stats.m_max_size, a_expr->m_size);
+    }
+
+    if(l_stats.m_status != normalize_status::normal_form)
+        LC_PROBE3(budget_exceeded, l_stats.m_status, l_stats.m_steps,
+                  a_expr->m_size);
+
+    l_stats.m_elapsed = clock::now() - l_start;
+    record_normalization(l_stats);
+
+    return l_stats;
+}
+
+const char* to_string(normalize_status a_status)
+{
+    switch(a_status)
+    {
+        case normalize_status::normal_form:
+            return "normal_form";
+        case normalize_status::step_limit:
+            return "step_limit";
+        case normalize_status::size_limit:
+            return "size_limit";
+        case normalize_status::time_limit:
+            return "time_limit";
+    }
+
+    return "unknown";
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+void test_reduce_one_step_applicative()
+{
+    // normal forms do not reduce
+    {
+        auto l_expr = f(a(v(0), v(1)));
+        assert(!reduce_one_step_applicative(l_expr));
+    }
+
+    // the argument is reduced before the outer redex
+    {
+        auto l_expr = a(f(a(v(0), v(0))), a(f(v(0)), v(5)));
+        assert(reduce_one_step_applicative(l_expr));
+        assert(l_expr->equals(a(f(a(v(0), v(0))), v(5))));
+        assert(l_expr->m_size == 6);
+        assert(reduce_one_step_applicative(l_expr));
+        assert(l_expr->equals(a(v(5), v(5))));
+        assert(!reduce_one_step_applicative(l_expr));
+    }
+
+    // a redex under a binder is contracted at the binder's depth
+    {
+        auto l_expr = f(a(f(f(v(2))), v(0)));
+        assert(reduce_one_step_applicative(l_expr));
+        auto l_reference = f(a(f(f(v(2))), v(0)));
+        assert(reduce_one_step(l_reference));
+        assert(l_expr->equals(l_reference));
+    }
+}
+
+void test_is_normal()
+{
+    assert(is_normal(*v(0)));
+    assert(is_normal(*f(a(v(0), f(v(1))))));
+    assert(!is_normal(*a(f(v(0)), v(1))));
+    assert(!is_normal(*f(a(v(0), a(f(v(1)), v(0))))));
+}
+
+void test_normalize()
+{
+    // already normal
+    {
+        auto l_expr = f(v(0));
+        auto l_stats = normalize(l_expr);
+        assert(l_stats.m_status == normalize_status::normal_form);
+        assert(l_stats.m_steps == 0);
+        assert(l_stats.m_max_size == 2);
+    }
+
+    // S K K a → a
+    {
+        auto K = f(f(v(0)));
+        auto S = f(f(f(a(a(v(0), v(2)), a(v(1), v(2))))));
+        auto l_expr = a(a(a(S->clone(), K->clone()), K->clone()), v(10));
+        auto l_stats = normalize(l_expr);
+        assert(l_stats.m_status == normalize_status::normal_form);
+        assert(l_expr->equals(v(10)));
+        assert(l_stats.m_steps == 5);
+        assert(l_stats.m_max_size >= l_expr->m_size);
+    }
+
+    // omega hits the step limit and is left as it was
+    {
+        auto l_omega = a(f(a(v(0), v(0))), f(a(v(0), v(0))));
+        auto l_expr = l_omega->clone();
+        budget l_budget;
+        l_budget.m_max_steps = 100;
+        auto l_stats = normalize(l_expr, l_budget);
+        assert(l_stats.m_status == normalize_status::step_limit);
+        assert(l_stats.m_steps == 100);
+        assert(l_expr->equals(l_omega));
+    }
+
+    // reaching normal form on exactly the last allowed step is not a limit
+    {
+        auto l_expr = a(f(v(0)), v(5));
+        budget l_budget;
+        l_budget.m_max_steps = 1;
+        auto l_stats = normalize(l_expr, l_budget);
+        assert(l_stats.m_status == normalize_status::normal_form);
+        assert(l_stats.m_steps == 1);
+    }
+
+    // growing term hits the size limit
+    {
+        auto l_expr = a(f(a(a(v(0), v(0)), v(0))), f(a(a(v(0), v(0)), v(0))));
+        budget l_budget;
+        l_budget.m_max_size = 1000;
+        auto l_stats = normalize(l_expr, l_budget);
+        assert(l_stats.m_status == normalize_status::size_limit);
+        assert(l_expr->m_size > 1000);
+        assert(l_stats.m_max_size == l_expr->m_size);
+    }
+
+    // diverging term hits the time limit
+    {
+        auto l_expr = a(f(a(v(0), v(0))), f(a(v(0), v(0))));
+        budget l_budget;
+        l_budget.m_max_time = std::chrono::milliseconds(10);
+        auto l_stats = normalize(l_expr, l_budget);
+        assert(l_stats.m_status == normalize_status::time_limit);
+        assert(l_stats.m_elapsed >= l_budget.m_max_time);
+    }
+
+    // applicative order reaches the same normal form in fewer steps when
+    // an argument is used several times
+    {
+        // (λ.((0 0) 0)) ((λ.(0)) 5)
+        auto l_term = a(f(a(a(v(0), v(0)), v(0))), a(f(v(0)), v(5)));
+
+        auto l_normal = l_term->clone();
+        auto l_normal_stats = normalize(l_normal);
+
+        auto l_applicative = l_term->clone();
+        auto l_applicative_stats =
+            normalize(l_applicative, {}, strategy::applicative_order);
+
+        assert(l_normal->equals(a(a(v(5), v(5)), v(5))));
+        assert(l_applicative->equals(l_normal));
+        assert(l_normal_stats.m_steps == 4);
+        assert(l_applicative_stats.m_steps == 2);
+    }
+
+    // applicative order diverges where normal order discards the argument
+    {
+        // (λ.λ.1) omega → λ.0 under normal order
+        auto l_omega = a(f(a(v(0), v(0))), f(a(v(0), v(0))));
+        auto l_term = a(f(f(v(1))), l_omega->clone());
+
+        budget l_budget;
+        l_budget.m_max_steps = 50;
+
+        auto l_normal = l_term->clone();
+        assert(normalize(l_normal, l_budget).m_status ==
+               normalize_status::normal_form);
+        assert(l_normal->equals(f(v(0))));
+
+        auto l_applicative = l_term->clone();
+        assert(normalize(l_applicative, l_budget, strategy::applicative_order)
+                   .m_status == normalize_status::step_limit);
+    }
+
+    assert(std::string(to_string(normalize_status::size_limit)) ==
+           "size_limit");
+}
+
+void normalize_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_reduce_one_step_applicative);
+    TEST(test_is_normal);
+    TEST(test_normalize);
+}
+
+#endif
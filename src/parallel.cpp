@@ -0,0 +1,740 @@
+#include "../include/parallel.hpp"
+#include "../include/hash.hpp"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace lambda
+{
+
+std::unique_ptr<expr> parallel_clone(const expr& a_expr,
+                                     work_stealing_pool& a_pool,
+                                     size_t a_grain)
+{
+    if(a_expr.m_size < a_grain)
+        return a_expr.clone();
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return f(parallel_clone(*l_func->m_body, a_pool, a_grain));
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+    {
+        std::unique_ptr<expr> l_lhs;
+        std::unique_ptr<expr> l_rhs;
+
+        a_pool.fork_join(
+            [&] { l_lhs = parallel_clone(*l_app->m_lhs, a_pool, a_grain); },
+            [&] { l_rhs = parallel_clone(*l_app->m_rhs, a_pool, a_grain); });
+
+        return a(std::move(l_lhs), std::move(l_rhs));
+    }
+
+    return a_expr.clone();
+}
+
+static bool equals_task(const std::unique_ptr<expr>& a_lhs,
+                        const std::unique_ptr<expr>& a_rhs,
+                        work_stealing_pool& a_pool, size_t a_grain,
+                        std::atomic<bool>& a_mismatch)
+{
+    // another task already found a difference
+    if(a_mismatch.load(std::memory_order_relaxed))
+        return false;
+
+    if(a_lhs->m_size != a_rhs->m_size)
+        return false;
+
+    if(a_lhs->m_size < a_grain)
+        return a_lhs->equals(a_rhs);
+
+    if(const func* l_func = dynamic_cast<const func*>(a_lhs.get()))
+    {
+        const func* l_other = dynamic_cast<const func*>(a_rhs.get());
+
+        return l_other && equals_task(l_func->m_body, l_other->m_body, a_pool,
+                                      a_grain, a_mismatch);
+    }
+
+    if(const app* l_app = dynamic_cast<const app*>(a_lhs.get()))
+    {
+        const app* l_other = dynamic_cast<const app*>(a_rhs.get());
+
+        if(!l_other)
+            return false;
+
+        bool l_lhs_equal = false;
+        bool l_rhs_equal = false;
+
+        a_pool.fork_join(
+            [&]
+            {
+                l_lhs_equal = equals_task(l_app->m_lhs, l_other->m_lhs, a_pool,
+                                          a_grain, a_mismatch);
+                if(!l_lhs_equal)
+                    a_mismatch.store(true, std::memory_order_relaxed);
+            },
+            [&]
+            {
+                l_rhs_equal = equals_task(l_app->m_rhs, l_other->m_rhs, a_pool,
+                                          a_grain, a_mismatch);
+                if(!l_rhs_equal)
+                    a_mismatch.store(true, std::memory_order_relaxed);
+            });
+
+        return l_lhs_equal && l_rhs_equal;
+    }
+
+    return a_lhs->equals(a_rhs);
+}
+
+bool parallel_equals(const std::unique_ptr<expr>& a_lhs,
+                     const std::unique_ptr<expr>& a_rhs,
+                     work_stealing_pool& a_pool, size_t a_grain)
+{
+    std::atomic<bool> l_mismatch = false;
+
+    return equals_task(a_lhs, a_rhs, a_pool, a_grain, l_mismatch);
+}
+
+uint64_t parallel_hash(const expr& a_expr, work_stealing_pool& a_pool,
+                       size_t a_grain)
+{
+    if(a_expr.m_size < a_grain)
+        return structural_hash(a_expr);
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return func_hash(parallel_hash(*l_func->m_body, a_pool, a_grain));
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+    {
+        uint64_t l_lhs = 0;
+        uint64_t l_rhs = 0;
+
+        a_pool.fork_join(
+            [&] { l_lhs = parallel_hash(*l_app->m_lhs, a_pool, a_grain); },
+            [&] { l_rhs = parallel_hash(*l_app->m_rhs, a_pool, a_grain); });
+
+        return app_hash(l_lhs, l_rhs);
+    }
+
+    return structural_hash(a_expr);
+}
+
+void parallel_lift(expr& a_expr, size_t a_lift_amount, size_t a_cutoff,
+                   work_stealing_pool& a_pool, size_t a_grain)
+{
+    if(a_expr.m_size < a_grain)
+    {
+        a_expr.lift(a_lift_amount, a_cutoff);
+        return;
+    }
+
+    if(func* l_func = dynamic_cast<func*>(&a_expr))
+    {
+        parallel_lift(*l_func->m_body, a_lift_amount, a_cutoff, a_pool,
+                      a_grain);
+        return;
+    }
+
+    if(app* l_app = dynamic_cast<app*>(&a_expr))
+    {
+        a_pool.fork_join(
+            [&]
+            {
+                parallel_lift(*l_app->m_lhs, a_lift_amount, a_cutoff, a_pool,
+                              a_grain);
+            },
+            [&]
+            {
+                parallel_lift(*l_app->m_rhs, a_lift_amount, a_cutoff, a_pool,
+                              a_grain);
+            });
+        return;
+    }
+
+    a_expr.lift(a_lift_amount, a_cutoff);
+}
+
+// state shared by the tasks of one parallel_normalize() call.
+struct normalize_context
+{
+    using clock = std::chrono::steady_clock;
+
+    work_stealing_pool& m_pool;
+    parallel_mode m_mode;
+    size_t m_grain;
+    clock::time_point m_start;
+    std::chrono::nanoseconds m_max_time;
+    bool m_timed;
+    // steps left for all tasks together, in parallel_mode::fast
+    std::atomic<size_t> m_remaining_steps;
+};
+
+// takes one step from the shared allowance; false once it is used up.
+static bool take_shared_step(std::atomic<size_t>& a_remaining)
+{
+    size_t l_remaining = a_remaining.load(std::memory_order_relaxed);
+
+    do
+    {
+        if(l_remaining == 0)
+            return false;
+    } while(!a_remaining.compare_exchange_weak(l_remaining, l_remaining - 1,
+                                               std::memory_order_relaxed));
+
+    return true;
+}
+
+// a_limit less a_used, where SIZE_MAX means unlimited and stays so.
+static size_t limit_left(size_t a_limit, size_t a_used)
+{
+    if(a_limit == SIZE_MAX)
+        return SIZE_MAX;
+
+    return a_limit > a_used ? a_limit - a_used : 0;
+}
+
+// one argument on the spine of a stuck term.
+struct spine_arg
+{
+    std::unique_ptr<expr>* m_slot;
+    size_t m_depth;
+};
+
+// collects the arguments of a_expr, leftmost first, and its spine nodes,
+// root first. Returns whether the head is a var.
+static bool walk_spine(std::unique_ptr<expr>& a_expr, size_t a_depth,
+                       std::vector<spine_arg>& a_args,
+                       std::vector<expr*>& a_nodes)
+{
+    expr* l_node = a_expr.get();
+
+    while(func* l_func = dynamic_cast<func*>(l_node))
+    {
+        a_nodes.push_back(l_func);
+        l_node = l_func->m_body.get();
+        ++a_depth;
+    }
+
+    while(app* l_app = dynamic_cast<app*>(l_node))
+    {
+        a_nodes.push_back(l_app);
+        a_args.push_back({&l_app->m_rhs, a_depth});
+        l_node = l_app->m_lhs.get();
+    }
+
+    std::reverse(a_args.begin(), a_args.end());
+
+    return dynamic_cast<var*>(l_node) != nullptr;
+}
+
+// normalizes a_expr, whose own size may not exceed a_max_size, in at most
+// a_max_steps steps. m_max_size of the result is the largest size a_expr
+// itself reached.
+static normalize_stats normalize_task(std::unique_ptr<expr>& a_expr,
+                                      size_t a_depth, size_t a_max_steps,
+                                      size_t a_max_size,
+                                      normalize_context& a_context)
+{
+    const bool l_fast = a_context.m_mode == parallel_mode::fast;
+
+    normalize_stats l_stats;
+    l_stats.m_max_size = a_expr->m_size;
+
+    std::vector<spine_arg> l_args;
+    std::vector<expr*> l_nodes;
+
+    // the head, with the same checks in the same order as normalize()
+    while(true)
+    {
+        if(a_expr->m_size > a_max_size)
+        {
+            l_stats.m_status = normalize_status::size_limit;
+            return l_stats;
+        }
+
+        if(a_context.m_timed && normalize_context::clock::now() -
+                                        a_context.m_start >=
+                                    a_context.m_max_time)
+        {
+            l_stats.m_status = is_normal(*a_expr)
+                                   ? normalize_status::normal_form
+                                   : normalize_status::time_limit;
+            return l_stats;
+        }
+
+        l_args.clear();
+        l_nodes.clear();
+
+        if(walk_spine(a_expr, a_depth, l_args, l_nodes))
+            break;
+
+        // the head is a func applied to an argument: a redex
+        if(l_stats.m_steps >= a_max_steps ||
+           (l_fast && !take_shared_step(a_context.m_remaining_steps)))
+        {
+            l_stats.m_status = normalize_status::step_limit;
+            return l_stats;
+        }
+
+        reduce_one_step(a_expr, a_depth);
+
+        ++l_stats.m_steps;
+        l_stats.m_max_size = std::max(l_stats.m_max_size, a_expr->m_size);
+    }
+
+    if(l_args.empty())
+        return l_stats;
+
+    std::vector<size_t> l_original_sizes;
+    size_t l_total_size = 0;
+
+    for(const spine_arg& l_arg : l_args)
+    {
+        l_original_sizes.push_back((*l_arg.m_slot)->m_size);
+        l_total_size += l_original_sizes.back();
+    }
+
+    // generous limits for every task: each other argument takes at least
+    // one node, and no argument can take more steps than are left
+    const size_t l_task_steps = limit_left(a_max_steps, l_stats.m_steps);
+    const size_t l_task_size =
+        limit_left(a_max_size, a_expr->m_size - l_total_size +
+                                   l_args.size() - 1);
+
+    // with nothing to fork, every argument is simply normalized in order
+    // with its exact limits below
+    const bool l_forked =
+        l_args.size() > 1 && l_total_size >= a_context.m_grain;
+
+    // the untouched arguments, in case a result has to be redone
+    std::vector<std::unique_ptr<expr>> l_originals;
+
+    if(l_forked && !l_fast &&
+       (a_max_steps != SIZE_MAX || a_max_size != SIZE_MAX))
+        for(const spine_arg& l_arg : l_args)
+            l_originals.push_back((*l_arg.m_slot)->clone());
+
+    std::vector<normalize_stats> l_results(l_args.size());
+
+    auto l_run = [&](size_t i)
+    {
+        l_results[i] =
+            normalize_task(*l_args[i].m_slot, l_args[i].m_depth, l_task_steps,
+                           l_task_size, a_context);
+    };
+
+    // forks halves of [a_begin, a_end) until they are below the grain
+    std::function<void(size_t, size_t)> l_fork = [&](size_t a_begin,
+                                                      size_t a_end)
+    {
+        size_t l_size = 0;
+
+        for(size_t i = a_begin; i < a_end; ++i)
+            l_size += l_original_sizes[i];
+
+        if(a_end - a_begin == 1 || l_size < a_context.m_grain)
+        {
+            for(size_t i = a_begin; i < a_end; ++i)
+                l_run(i);
+
+            return;
+        }
+
+        const size_t l_middle = a_begin + (a_end - a_begin) / 2;
+
+        a_context.m_pool.fork_join([&] { l_fork(a_begin, l_middle); },
+                                   [&] { l_fork(l_middle, a_end); });
+    };
+
+    if(l_forked)
+        l_fork(0, l_args.size());
+
+    // accept the results in normal order. l_size is the size a_expr has
+    // once the arguments before i are normal.
+    size_t l_size = a_expr->m_size;
+    bool l_redo = !l_forked;
+
+    for(size_t i = 0; i < l_args.size(); ++i)
+    {
+        const size_t l_outside = l_size - l_original_sizes[i];
+        const size_t l_exact_steps = limit_left(a_max_steps, l_stats.m_steps);
+        const size_t l_exact_size = limit_left(a_max_size, l_outside);
+
+        normalize_stats l_result = l_forked ? l_results[i] : normalize_stats();
+
+        // a result is what the exact limits would have given unless one of
+        // them would have fired along the way
+        if(!l_redo && !l_fast &&
+           (l_result.m_status == normalize_status::size_limit ||
+            l_result.m_status == normalize_status::step_limit ||
+            l_result.m_steps > l_exact_steps ||
+            l_result.m_max_size > l_exact_size))
+        {
+            l_redo = true;
+
+            for(size_t j = i; j < l_args.size(); ++j)
+                *l_args[j].m_slot = std::move(l_originals[j]);
+        }
+
+        if(l_redo)
+            l_result = normalize_task(*l_args[i].m_slot, l_args[i].m_depth,
+                                      l_exact_steps, l_exact_size, a_context);
+
+        l_stats.m_steps += l_result.m_steps;
+        l_stats.m_max_size =
+            std::max(l_stats.m_max_size, l_outside + l_result.m_max_size);
+        l_size = l_outside + (*l_args[i].m_slot)->m_size;
+
+        if(l_result.m_status != normalize_status::normal_form)
+        {
+            l_stats.m_status = l_result.m_status;
+
+            // in fast mode later arguments may have been reduced too
+            if(!l_fast)
+                break;
+        }
+    }
+
+    for(auto l_it = l_nodes.rbegin(); l_it != l_nodes.rend(); ++l_it)
+        (*l_it)->update_size();
+
+    if(l_fast)
+        l_stats.m_max_size = std::max(l_stats.m_max_size, a_expr->m_size);
+
+    return l_stats;
+}
+
+normalize_stats parallel_normalize(std::unique_ptr<expr>& a_expr,
+                                   work_stealing_pool& a_pool,
+                                   const budget& a_budget, parallel_mode a_mode,
+                                   size_t a_grain, size_t a_depth)
+{
+    normalize_context l_context{a_pool,
+                                a_mode,
+                                a_grain,
+                                normalize_context::clock::now(),
+                                a_budget.m_max_time,
+                                a_budget.m_max_time !=
+                                    std::chrono::nanoseconds::max(),
+                                {a_budget.m_max_steps}};
+
+    normalize_stats l_stats =
+        normalize_task(a_expr, a_depth, a_budget.m_max_steps,
+                       a_budget.m_max_size, l_context);
+
+    l_stats.m_elapsed = normalize_context::clock::now() - l_context.m_start;
+
+    return l_stats;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../include/hash.hpp"
+#include "../testing/test_utils.hpp"
+#include <random>
+
+using namespace lambda;
+
+// a balanced tree of applications over a_leaves variables, with a binder
+// every few levels. Leaf levels vary so that lifting with a cutoff both
+// skips and shifts variables.
+static std::unique_ptr<expr> balanced_term(size_t a_leaves, size_t a_offset = 0)
+{
+    if(a_leaves == 1)
+        return v(a_offset % 11);
+
+    auto l_lhs = balanced_term(a_leaves / 2, a_offset);
+    auto l_rhs = balanced_term(a_leaves - a_leaves / 2, a_offset + a_leaves / 2);
+    auto l_app = a(std::move(l_lhs), std::move(l_rhs));
+
+    if(a_leaves % 5 == 0)
+        return f(std::move(l_app));
+
+    return l_app;
+}
+
+void test_parallel_operations()
+{
+    work_stealing_pool l_pool(4);
+    auto l_term = balanced_term(20000);
+
+    // a small grain forces thousands of forks
+    const size_t l_grain = 64;
+
+    // clone
+    {
+        auto l_clone = parallel_clone(*l_term, l_pool, l_grain);
+        assert(l_clone->equals(l_term));
+        assert(l_clone->m_size == l_term->m_size);
+    }
+
+    // equals, including a difference in one deep leaf
+    {
+        auto l_clone = l_term->clone();
+        assert(parallel_equals(l_term, l_clone, l_pool, l_grain));
+
+        expr* l_node = l_clone.get();
+        while(!dynamic_cast<var*>(l_node))
+        {
+            if(func* l_func = dynamic_cast<func*>(l_node))
+                l_node = l_func->m_body.get();
+            else
+                l_node = dynamic_cast<app*>(l_node)->m_rhs.get();
+        }
+        ++dynamic_cast<var*>(l_node)->m_index;
+
+        assert(!parallel_equals(l_term, l_clone, l_pool, l_grain));
+        assert(!parallel_equals(l_term, l_clone->clone(), l_pool, 1));
+        assert(!parallel_equals(l_term, v(0), l_pool, l_grain));
+    }
+
+    // hash agrees with the sequential hash
+    {
+        assert(parallel_hash(*l_term, l_pool, l_grain) ==
+               structural_hash(*l_term));
+        assert(parallel_hash(*l_term, l_pool, 1) == structural_hash(*l_term));
+    }
+
+    // lift agrees with the sequential lift
+    {
+        auto l_sequential = l_term->clone();
+        l_sequential->lift(3, 5);
+
+        auto l_parallel = l_term->clone();
+        parallel_lift(*l_parallel, 3, 5, l_pool, l_grain);
+
+        assert(l_parallel->equals(l_sequential));
+    }
+
+    // small terms use the sequential path
+    {
+        auto l_small = a(f(v(0)), v(1));
+        assert(parallel_clone(*l_small, l_pool)->equals(l_small));
+        assert(parallel_equals(l_small, l_small->clone(), l_pool));
+        assert(parallel_hash(*l_small, l_pool) == structural_hash(*l_small));
+    }
+}
+
+// a random term of about a_nodes nodes under a_depth binders, with plenty
+// of redexes.
+static std::unique_ptr<expr> random_redex_term(std::mt19937& a_rng,
+                                               size_t a_nodes, size_t a_depth)
+{
+    if(a_nodes <= 1)
+        return v(a_rng() % (a_depth + 2));
+
+    switch(a_rng() % 3)
+    {
+        case 0:
+            return f(random_redex_term(a_rng, a_nodes - 1, a_depth + 1));
+        case 1:
+        {
+            // a redex: a func applied to an argument
+            const size_t l_body = 1 + a_rng() % (a_nodes - 1);
+            return a(f(random_redex_term(a_rng, l_body, a_depth + 1)),
+                     random_redex_term(a_rng, a_nodes - l_body, a_depth));
+        }
+        default:
+        {
+            const size_t l_lhs = 1 + a_rng() % (a_nodes - 1);
+            return a(random_redex_term(a_rng, l_lhs, a_depth),
+                     random_redex_term(a_rng, a_nodes - l_lhs, a_depth));
+        }
+    }
+}
+
+// church numeral a_n, closed.
+static std::unique_ptr<expr> church_numeral(size_t a_n, size_t a_depth)
+{
+    std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+    for(size_t i = 0; i < a_n; ++i)
+        l_body = a(v(a_depth), std::move(l_body));
+
+    return f(f(std::move(l_body)));
+}
+
+void test_parallel_normalize()
+{
+    work_stealing_pool l_one(1);
+    work_stealing_pool l_four(4);
+
+    // a stuck head over independent computations, some of them stuck in
+    // turn: x (3^3) (y (2^4) (2^3)) (3^2) under two binders
+    auto l_power = [](size_t a_base, size_t a_exponent)
+    {
+        return a(church_numeral(a_exponent, 2), church_numeral(a_base, 2));
+    };
+
+    auto l_term = f(f(a(a(a(v(0), l_power(3, 3)),
+                          a(a(v(1), l_power(2, 4)), l_power(2, 3))),
+                        l_power(3, 2))));
+
+    const std::vector<budget> l_budgets = [&]
+    {
+        std::vector<budget> l_result(1);
+
+        for(size_t l_steps : {0, 1, 5, 40, 100, 250})
+        {
+            l_result.emplace_back();
+            l_result.back().m_max_steps = l_steps;
+        }
+
+        for(size_t l_size : {10, 60, 120, 400})
+        {
+            l_result.emplace_back();
+            l_result.back().m_max_size = l_size;
+            l_result.emplace_back();
+            l_result.back().m_max_size = l_size;
+            l_result.back().m_max_steps = 150;
+        }
+
+        return l_result;
+    }();
+
+    // deterministic mode agrees exactly with normalize(), for any number of
+    // threads and any grain
+    auto l_check = [&](const std::unique_ptr<expr>& a_term)
+    {
+        for(const budget& l_budget : l_budgets)
+        {
+            auto l_expected = a_term->clone();
+            const normalize_stats l_expected_stats =
+                normalize(l_expected, l_budget);
+
+            for(work_stealing_pool* l_pool : {&l_one, &l_four})
+                for(size_t l_grain : {size_t(1), PARALLEL_NORMALIZE_GRAIN})
+                {
+                    auto l_actual = a_term->clone();
+                    const normalize_stats l_stats = parallel_normalize(
+                        l_actual, *l_pool, l_budget,
+                        parallel_mode::deterministic, l_grain);
+
+                    assert(l_actual->equals(l_expected));
+                    assert(l_actual->m_size == l_expected->m_size);
+                    assert(l_stats.m_status == l_expected_stats.m_status);
+                    assert(l_stats.m_steps == l_expected_stats.m_steps);
+                    assert(l_stats.m_max_size == l_expected_stats.m_max_size);
+                }
+        }
+    };
+
+    l_check(l_term);
+
+    std::mt19937 l_rng(17);
+
+    for(size_t i = 0; i < 60; ++i)
+        l_check(random_redex_term(l_rng, 5 + l_rng() % 40, 0));
+
+    // fast mode reaches the same normal form when no limit is reached
+    {
+        auto l_expected = l_term->clone();
+        const normalize_stats l_expected_stats = normalize(l_expected);
+
+        auto l_actual = l_term->clone();
+        const normalize_stats l_stats =
+            parallel_normalize(l_actual, l_four, {}, parallel_mode::fast, 1);
+
+        assert(l_actual->equals(l_expected));
+        assert(l_stats.m_status == normalize_status::normal_form);
+        assert(l_stats.m_steps == l_expected_stats.m_steps);
+    }
+
+    // and respects the step limit as a whole
+    {
+        budget l_budget;
+        l_budget.m_max_steps = 40;
+
+        auto l_actual = l_term->clone();
+        const normalize_stats l_stats = parallel_normalize(
+            l_actual, l_four, l_budget, parallel_mode::fast, 1);
+
+        assert(l_stats.m_status == normalize_status::step_limit);
+        assert(l_stats.m_steps == 40);
+    }
+}
+
+void parallel_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_parallel_operations);
+    TEST(test_parallel_normalize);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include <string>
+#include <thread>
+
+using namespace lambda;
+
+void bench_parallel_normalize()
+{
+    const size_t l_runs = 3;
+    const size_t l_arguments = 16;
+
+    // a stuck head over independent numerals raised to a power
+    auto l_church = [](size_t a_n)
+    {
+        std::unique_ptr<expr> l_body = v(1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(0), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    std::unique_ptr<expr> l_program = v(0);
+
+    for(size_t i = 0; i < l_arguments; ++i)
+        l_program =
+            a(std::move(l_program), a(l_church(3), l_church(4 + i % 3)));
+
+    std::unique_ptr<expr> l_expr;
+    size_t l_steps = 0;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [&] { l_expr = l_program->clone(); },
+        [&] { l_steps = normalize(l_expr).m_steps; });
+    report("normalize", l_measured, l_steps);
+
+    const size_t l_threads =
+        std::max<size_t>(1, std::thread::hardware_concurrency());
+    work_stealing_pool l_pool(l_threads);
+
+    // a step limit that is never reached still makes deterministic mode
+    // keep copies of what it forks
+    budget l_generous;
+    l_generous.m_max_steps = 100 * l_steps;
+
+    for(const budget& l_budget : {budget(), l_generous})
+        for(parallel_mode l_mode :
+            {parallel_mode::deterministic, parallel_mode::fast})
+        {
+            l_measured = measure_best_of(
+                l_runs, [&] { l_expr = l_program->clone(); },
+                [&] { parallel_normalize(l_expr, l_pool, l_budget, l_mode); });
+
+            const std::string l_name =
+                std::string("parallel_normalize ") +
+                (l_mode == parallel_mode::fast ? "fast" : "deterministic") +
+                (l_budget.m_max_steps == SIZE_MAX ? "" : " +limit");
+            report(l_name.c_str(), l_measured, l_steps);
+        }
+
+    std::cout << "    threads=" << l_threads << std::endl;
+}
+
+void parallel_bench_main()
+{
+    BENCH(bench_parallel_normalize);
+}
+
+#endif
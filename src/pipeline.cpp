@@ -0,0 +1,599 @@
+#include "../include/pipeline.hpp"
+#include "../include/bounded_queue.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lambda
+{
+
+// output is handed to the stream in pieces of roughly this size.
+static constexpr size_t WRITE_CHUNK = 1 << 16;
+
+namespace
+{
+
+// lets the stages wait for one another. A waiting stage retries briefly,
+// then sleeps until another stage announces a change with notify(), so idle
+// stages leave their cores to the normalizers.
+class stage_signal
+{
+  public:
+    // calls a_try until it returns true.
+    template <typename TRY> void wait(TRY&& a_try)
+    {
+        for(size_t i = 0; i < SPINS; ++i)
+            if(a_try())
+                return;
+
+        std::unique_lock<std::mutex> l_lock(m_mutex);
+        m_sleepers.fetch_add(1);
+        // pairs with the fence in notify(): either a_try sees the change,
+        // or notify() sees this sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        while(!a_try())
+            m_condition.wait(l_lock);
+
+        m_sleepers.fetch_sub(1);
+    }
+
+    // wakes the sleeping stages after a change one of them may wait for.
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if(m_sleepers.load(std::memory_order_relaxed) == 0)
+            return;
+
+        // a sleeper holds the mutex from its last try until it waits
+        {
+            std::lock_guard<std::mutex> l_lock(m_mutex);
+        }
+        m_condition.notify_all();
+    }
+
+  private:
+    static constexpr size_t SPINS = 64;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<size_t> m_sleepers = 0;
+};
+
+} // namespace
+
+pipeline_stats
+run_pipeline(std::istream& a_in, std::ostream& a_out,
+             const pipeline_options& a_options,
+             const std::function<void(const pipeline_item&)>& a_on_written)
+{
+    using clock = std::chrono::steady_clock;
+
+    const clock::time_point l_start = clock::now();
+
+    bounded_queue<pipeline_item> l_parsed(a_options.m_queue_capacity);
+    bounded_queue<pipeline_item> l_normalized(a_options.m_queue_capacity);
+    stage_signal l_signal;
+
+    // set by the parser once l_total holds the final number of terms
+    std::atomic<bool> l_parsing_done = false;
+    std::atomic<size_t> l_total = 0;
+    // number of terms written so far
+    std::atomic<size_t> l_written = 0;
+    // set if the writer or a normalizer fails, so the other stages stop
+    // early
+    std::atomic<bool> l_abort = false;
+    std::exception_ptr l_parser_error;
+    // the first error of a normalizer, such as std::bad_alloc
+    std::exception_ptr l_worker_error;
+    std::mutex l_worker_error_mutex;
+
+    const size_t l_window = std::max<size_t>(a_options.m_reorder_window, 1);
+
+    // pushes a_item, waiting while a_queue is full
+    auto l_push = [&l_abort, &l_signal](bounded_queue<pipeline_item>& a_queue,
+                                        pipeline_item& a_item)
+    {
+        l_signal.wait(
+            [&]
+            {
+                return a_queue.try_push(a_item) ||
+                       l_abort.load(std::memory_order_relaxed);
+            });
+        l_signal.notify();
+    };
+
+    std::thread l_parser(
+        [&]
+        {
+            term_reader l_reader(a_in, a_options.m_input,
+                                 a_options.m_budget.m_max_size);
+            size_t l_sequence = 0;
+
+            try
+            {
+                while(!l_abort.load(std::memory_order_relaxed))
+                {
+                    // stay within the window ahead of the writer
+                    l_signal.wait(
+                        [&]
+                        {
+                            return l_sequence <
+                                       l_written.load(
+                                           std::memory_order_acquire) +
+                                           l_window ||
+                                   l_abort.load(std::memory_order_relaxed);
+                        });
+
+                    pipeline_item l_item;
+                    l_item.m_sequence = l_sequence;
+
+                    try
+                    {
+                        if(!l_reader.next(l_item.m_expr))
+                            break;
+                    }
+                    catch(const std::runtime_error& l_error)
+                    {
+                        // a malformed binary stream cannot be resumed
+                        if(!l_reader.resumable())
+                            throw;
+                        l_item.m_error = l_error.what();
+                    }
+
+                    l_push(l_parsed, l_item);
+                    ++l_sequence;
+                }
+            }
+            catch(...)
+            {
+                l_parser_error = std::current_exception();
+            }
+
+            l_total.store(l_sequence, std::memory_order_relaxed);
+            l_parsing_done.store(true, std::memory_order_release);
+            l_signal.notify();
+        });
+
+    std::vector<std::thread> l_workers;
+
+    // normalizes parsed items until parsing is done or the run is aborted
+    auto l_normalize_items = [&]
+    {
+        pipeline_item l_item;
+
+        while(!l_abort.load(std::memory_order_relaxed))
+        {
+            bool l_popped = false;
+
+            l_signal.wait(
+                [&]
+                {
+                    // read the flag first: if parsing was already done, a
+                    // failed pop means the queue is drained for good
+                    const bool l_done =
+                        l_parsing_done.load(std::memory_order_acquire);
+                    l_popped = l_parsed.try_pop(l_item);
+
+                    return l_popped || l_done ||
+                           l_abort.load(std::memory_order_relaxed);
+                });
+
+            if(!l_popped)
+                return;
+
+            l_signal.notify();
+
+            if(l_item.m_expr)
+                l_item.m_stats = normalize(l_item.m_expr, a_options.m_budget,
+                                           a_options.m_strategy);
+
+            l_push(l_normalized, l_item);
+        }
+    };
+
+    for(size_t i = 0; i < std::max<size_t>(a_options.m_workers, 1); ++i)
+        l_workers.emplace_back(
+            [&]
+            {
+                try
+                {
+                    l_normalize_items();
+                }
+                catch(...)
+                {
+                    // rethrown once every stage has stopped
+                    {
+                        std::lock_guard<std::mutex> l_lock(
+                            l_worker_error_mutex);
+
+                        if(!l_worker_error)
+                            l_worker_error = std::current_exception();
+                    }
+
+                    l_abort = true;
+                    l_signal.notify();
+                }
+            });
+
+    auto l_join = [&]
+    {
+        l_parser.join();
+        for(std::thread& l_worker : l_workers)
+            l_worker.join();
+    };
+
+    pipeline_stats l_stats;
+
+    try
+    {
+        // items that finished ahead of their turn, fewer than l_window
+        std::map<size_t, pipeline_item> l_early;
+        std::string l_buffer;
+        pipeline_item l_item;
+
+        // whether every term has been written
+        auto l_finished = [&]
+        {
+            return l_parsing_done.load(std::memory_order_acquire) &&
+                   l_stats.m_terms == l_total.load(std::memory_order_relaxed);
+        };
+
+        while(!l_finished())
+        {
+            if(!l_normalized.try_pop(l_item))
+            {
+                // nothing to do for now, so hand what we have to the stream
+                if(!l_buffer.empty())
+                {
+                    a_out << l_buffer;
+                    l_buffer.clear();
+                }
+
+                bool l_popped = false;
+
+                l_signal.wait(
+                    [&]
+                    {
+                        l_popped = l_normalized.try_pop(l_item);
+                        return l_popped || l_finished() ||
+                               l_abort.load(std::memory_order_relaxed);
+                    });
+
+                if(!l_popped)
+                    break;
+            }
+
+            l_signal.notify();
+            l_early.emplace(l_item.m_sequence, std::move(l_item));
+
+            for(auto l_it = l_early.find(l_stats.m_terms);
+                l_it != l_early.end(); l_it = l_early.find(l_stats.m_terms))
+            {
+                const pipeline_item& l_next = l_it->second;
+
+                if(l_next.m_expr)
+                {
+                    write_term(*l_next.m_expr, a_options.m_output, l_buffer);
+                    l_stats.m_steps += l_next.m_stats.m_steps;
+                }
+                else
+                {
+                    if(a_options.m_output == term_format::text)
+                        l_buffer += '\n';
+                    ++l_stats.m_errors;
+                }
+
+                if(a_on_written)
+                    a_on_written(l_next);
+
+                ++l_stats.m_terms;
+                l_early.erase(l_it);
+
+                if(l_buffer.size() >= WRITE_CHUNK)
+                {
+                    a_out << l_buffer;
+                    l_buffer.clear();
+                }
+            }
+
+            // let the parser move its window
+            l_written.store(l_stats.m_terms, std::memory_order_release);
+            l_signal.notify();
+        }
+
+        a_out << l_buffer;
+        a_out.flush();
+    }
+    catch(...)
+    {
+        l_abort = true;
+        l_signal.notify();
+        l_join();
+        throw;
+    }
+
+    l_join();
+
+    if(l_worker_error)
+        std::rethrow_exception(l_worker_error);
+
+    if(l_parser_error)
+        std::rethrow_exception(l_parser_error);
+
+    l_stats.m_elapsed = clock::now() - l_start;
+
+    return l_stats;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <sstream>
+
+using namespace lambda;
+
+void test_bounded_queue()
+{
+    // fifo order, capacity and full / empty reporting
+    {
+        bounded_queue<int> l_queue(3);
+        assert(l_queue.capacity() == 4);
+
+        for(int i = 0; i < 4; ++i)
+            assert(l_queue.try_push(i));
+
+        int l_extra = 99;
+        assert(!l_queue.try_push(l_extra));
+        assert(l_extra == 99);
+
+        int l_value = -1;
+        for(int i = 0; i < 4; ++i)
+        {
+            assert(l_queue.try_pop(l_value));
+            assert(l_value == i);
+        }
+        assert(!l_queue.try_pop(l_value));
+    }
+
+    // move-only values, wrapping around several laps
+    {
+        bounded_queue<std::unique_ptr<expr>> l_queue(2);
+
+        for(size_t i = 0; i < 10; ++i)
+        {
+            std::unique_ptr<expr> l_in = v(i);
+            assert(l_queue.try_push(l_in));
+            assert(!l_in);
+
+            std::unique_ptr<expr> l_out;
+            assert(l_queue.try_pop(l_out));
+            assert(l_out->equals(v(i)));
+        }
+    }
+
+    // many producers and consumers
+    {
+        bounded_queue<size_t> l_queue(64);
+        const size_t l_per_producer = 20000;
+        std::atomic<size_t> l_sum = 0;
+        std::atomic<size_t> l_popped = 0;
+
+        std::vector<std::thread> l_threads;
+
+        for(size_t p = 0; p < 4; ++p)
+            l_threads.emplace_back(
+                [&l_queue, p, l_per_producer]
+                {
+                    for(size_t i = 0; i < l_per_producer; ++i)
+                    {
+                        size_t l_value = p * l_per_producer + i;
+                        while(!l_queue.try_push(l_value))
+                            std::this_thread::yield();
+                    }
+                });
+
+        for(size_t c = 0; c < 4; ++c)
+            l_threads.emplace_back(
+                [&]
+                {
+                    size_t l_value;
+                    while(l_popped.load() < 4 * l_per_producer)
+                    {
+                        if(l_queue.try_pop(l_value))
+                        {
+                            l_sum += l_value;
+                            ++l_popped;
+                        }
+                        else
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+
+        for(std::thread& l_thread : l_threads)
+            l_thread.join();
+
+        const size_t l_n = 4 * l_per_producer;
+        assert(l_popped == l_n);
+        assert(l_sum == l_n * (l_n - 1) / 2);
+    }
+}
+
+void test_run_pipeline()
+{
+    // output order matches input order even though terms differ in cost
+    {
+        std::string l_input;
+        std::string l_expected;
+
+        for(size_t i = 0; i < 2000; ++i)
+        {
+            if(i % 3 == 0)
+            {
+                // K i (i + 1) → i
+                l_input += "((λ.(λ.(0)) " + std::to_string(i) + ") " +
+                           std::to_string(i + 1) + ")\n";
+                l_expected += std::to_string(i) + "\n";
+            }
+            else
+            {
+                // (λ.((0 0) 0)) ((λ.(0)) i) → ((i i) i)
+                const std::string l_i = std::to_string(i);
+                l_input += "(λ.(((0 0) 0)) (λ.(0) " + l_i + "))\n";
+                l_expected += "((" + l_i + " " + l_i + ") " + l_i + ")\n";
+            }
+        }
+
+        pipeline_options l_options;
+        l_options.m_workers = 4;
+        l_options.m_queue_capacity = 16;
+
+        std::istringstream l_in(l_input);
+        std::ostringstream l_out;
+        size_t l_next_sequence = 0;
+
+        pipeline_stats l_stats =
+            run_pipeline(l_in, l_out, l_options,
+                         [&l_next_sequence](const pipeline_item& a_item)
+                         {
+                             assert(a_item.m_sequence == l_next_sequence);
+                             ++l_next_sequence;
+                         });
+
+        assert(l_out.str() == l_expected);
+        assert(l_stats.m_terms == 2000);
+        assert(l_next_sequence == 2000);
+        assert(l_stats.m_errors == 0);
+    }
+
+    // bad text lines leave empty output lines; budgets apply per term
+    {
+        pipeline_options l_options;
+        l_options.m_workers = 2;
+        l_options.m_budget.m_max_steps = 5;
+
+        std::istringstream l_in("(λ.(0) 1)\n(2\n(λ.((0 0)) λ.((0 0)))\n");
+        std::ostringstream l_out;
+        std::vector<normalize_status> l_statuses;
+
+        pipeline_stats l_stats = run_pipeline(
+            l_in, l_out, l_options, [&l_statuses](const pipeline_item& a_item)
+            { l_statuses.push_back(a_item.m_stats.m_status); });
+
+        assert(l_out.str() == "1\n\n(λ.((0 0)) λ.((0 0)))\n");
+        assert(l_stats.m_terms == 3);
+        assert(l_stats.m_errors == 1);
+        assert(l_stats.m_steps == 6);
+        assert(l_statuses[2] == normalize_status::step_limit);
+    }
+
+    // binary in, binary out
+    {
+        std::string l_bytes;
+        encode(*a(f(v(0)), v(7)), l_bytes);
+        encode(*f(v(0)), l_bytes);
+
+        pipeline_options l_options;
+        l_options.m_input = term_format::binary;
+        l_options.m_output = term_format::binary;
+
+        std::istringstream l_in(l_bytes);
+        std::ostringstream l_out;
+        run_pipeline(l_in, l_out, l_options);
+
+        const std::string l_result = l_out.str();
+        size_t l_pos = 0;
+        assert(decode(l_result, l_pos)->equals(v(7)));
+        assert(decode(l_result, l_pos)->equals(f(v(0))));
+        assert(l_pos == l_result.size());
+    }
+
+    // a window of one term: the parser waits for the writer after each
+    {
+        std::string l_input;
+        std::string l_expected;
+
+        for(size_t i = 0; i < 200; ++i)
+        {
+            l_input += "(λ.(0) " + std::to_string(i) + ")\n";
+            l_expected += std::to_string(i) + "\n";
+        }
+
+        pipeline_options l_options;
+        l_options.m_workers = 4;
+        l_options.m_queue_capacity = 4;
+        l_options.m_reorder_window = 1;
+
+        std::istringstream l_in(l_input);
+        std::ostringstream l_out;
+        size_t l_written = 0;
+
+        pipeline_stats l_stats =
+            run_pipeline(l_in, l_out, l_options,
+                         [&l_written](const pipeline_item&) { ++l_written; });
+
+        assert(l_out.str() == l_expected);
+        assert(l_stats.m_terms == 200);
+        assert(l_written == 200);
+    }
+
+    // a shared term too large to expand is reported, and the run goes on
+    {
+        std::string l_bytes;
+        encode_shared(*a(f(v(0)), v(4)), l_bytes);
+        encode_shared(*a(f(v(0)), f(v(0))), l_bytes);
+        encode_shared(*v(5), l_bytes);
+
+        pipeline_options l_options;
+        l_options.m_input = term_format::shared;
+        l_options.m_budget.m_max_size = 4;
+
+        std::istringstream l_in(l_bytes);
+        std::ostringstream l_out;
+        std::vector<std::string> l_errors;
+
+        pipeline_stats l_stats = run_pipeline(
+            l_in, l_out, l_options, [&l_errors](const pipeline_item& a_item)
+            { l_errors.push_back(a_item.m_error); });
+
+        assert(l_out.str() == "4\n\n5\n");
+        assert(l_stats.m_terms == 3);
+        assert(l_stats.m_errors == 1);
+        assert(l_errors[0].empty() && l_errors[2].empty());
+        assert(l_errors[1].find("exceeds the size limit") != std::string::npos);
+    }
+
+    // a corrupt binary stream still writes what came before it
+    {
+        std::string l_bytes;
+        encode(*v(3), l_bytes);
+        l_bytes += "\x09";
+
+        pipeline_options l_options;
+        l_options.m_input = term_format::binary;
+
+        std::istringstream l_in(l_bytes);
+        std::ostringstream l_out;
+        assert_throws(run_pipeline(l_in, l_out, l_options), std::runtime_error);
+        assert(l_out.str() == "3\n");
+    }
+}
+
+void pipeline_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_bounded_queue);
+    TEST(test_run_pipeline);
+}
+
+#endif
@@ -0,0 +1,172 @@
+#include "../include/probes.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <elf.h>
+#endif
+
+namespace lambda
+{
+
+std::vector<probe_site> read_probe_sites(const std::string& a_path)
+{
+#ifdef __linux__
+    std::ifstream l_file(a_path, std::ios::binary);
+
+    if(!l_file)
+        throw std::runtime_error("read_probe_sites: cannot open " + a_path);
+
+    const std::string l_bytes((std::istreambuf_iterator<char>(l_file)),
+                              std::istreambuf_iterator<char>());
+
+    // copies the object at a_offset out of the file, checking the bounds
+    auto l_read = [&](auto& a_object, uint64_t a_offset)
+    {
+        if(a_offset > l_bytes.size() ||
+           l_bytes.size() - a_offset < sizeof(a_object))
+            throw std::runtime_error("read_probe_sites: truncated file");
+
+        std::memcpy(&a_object, l_bytes.data() + a_offset, sizeof(a_object));
+    };
+
+    Elf64_Ehdr l_header;
+    l_read(l_header, 0);
+
+    if(std::memcmp(l_header.e_ident, ELFMAG, SELFMAG) != 0 ||
+       l_header.e_ident[EI_CLASS] != ELFCLASS64)
+        throw std::runtime_error("read_probe_sites: not a 64-bit ELF file");
+
+    auto l_section = [&](size_t a_index)
+    {
+        Elf64_Shdr l_section_header;
+        l_read(l_section_header,
+               l_header.e_shoff + a_index * sizeof(Elf64_Shdr));
+
+        return l_section_header;
+    };
+
+    const Elf64_Shdr l_names = l_section(l_header.e_shstrndx);
+    std::vector<probe_site> l_result;
+
+    for(size_t i = 0; i < l_header.e_shnum; ++i)
+    {
+        const Elf64_Shdr l_notes = l_section(i);
+
+        if(l_notes.sh_type != SHT_NOTE ||
+           l_bytes.compare(l_names.sh_offset + l_notes.sh_name,
+                           sizeof(".note.stapsdt"), ".note.stapsdt",
+                           sizeof(".note.stapsdt")) != 0)
+            continue;
+
+        for(uint64_t l_pos = l_notes.sh_offset;
+            l_pos < l_notes.sh_offset + l_notes.sh_size;)
+        {
+            Elf64_Nhdr l_note;
+            l_read(l_note, l_pos);
+
+            const uint64_t l_desc =
+                l_pos + sizeof(l_note) + ((l_note.n_namesz + 3) & ~3u);
+            l_pos = l_desc + ((l_note.n_descsz + 3) & ~3u);
+
+            // version 3 notes: location, base, semaphore, then three
+            // strings
+            if(l_note.n_type != 3 || l_note.n_descsz < 3 * 8 ||
+               l_desc + l_note.n_descsz > l_bytes.size())
+                continue;
+
+            probe_site l_site;
+            l_read(l_site.m_address, l_desc);
+
+            const char* l_string = l_bytes.data() + l_desc + 3 * 8;
+            const char* const l_end = l_bytes.data() + l_desc + l_note.n_descsz;
+
+            for(std::string* l_field :
+                {&l_site.m_provider, &l_site.m_name, &l_site.m_arguments})
+            {
+                const char* l_nul =
+                    static_cast<const char*>(std::memchr(l_string, 0,
+                                                         l_end - l_string));
+
+                if(!l_nul)
+                    throw std::runtime_error(
+                        "read_probe_sites: malformed probe note");
+
+                l_field->assign(l_string, l_nul);
+                l_string = l_nul + 1;
+            }
+
+            l_result.push_back(std::move(l_site));
+        }
+    }
+
+    return l_result;
+#else
+    (void)a_path;
+    throw std::runtime_error("read_probe_sites: only supported on Linux");
+#endif
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <algorithm>
+#include <map>
+
+using namespace lambda;
+
+void test_read_probe_sites()
+{
+#if LC_PROBES_ENABLED
+    // every probe of the library is in this very executable, with as many
+    // arguments as documented
+    {
+        const std::map<std::string, size_t> l_expected = {
+            {"beta", 2},       {"clone_arg", 2}, {"lift", 3},
+            {"node_alloc", 1}, {"node_free", 1}, {"budget_exceeded", 3},
+        };
+
+        std::map<std::string, size_t> l_found;
+
+        for(const probe_site& l_site : read_probe_sites("/proc/self/exe"))
+        {
+            if(l_site.m_provider != "lc")
+                continue;
+
+            assert(l_site.m_address != 0);
+
+            const size_t l_arguments =
+                1 + static_cast<size_t>(std::count(
+                        l_site.m_arguments.begin(), l_site.m_arguments.end(),
+                        ' '));
+
+            // each argument is an unsigned 64-bit value
+            assert(static_cast<size_t>(std::count(l_site.m_arguments.begin(),
+                                                  l_site.m_arguments.end(),
+                                                  '@')) == l_arguments);
+            assert(l_site.m_arguments.rfind("8@", 0) == 0);
+
+            l_found[l_site.m_name] = l_arguments;
+        }
+
+        assert(l_found == l_expected);
+    }
+#endif
+
+    // files that are not ELF, or not there, are rejected
+    assert_throws(read_probe_sites("/proc/self/cmdline"), std::runtime_error);
+    assert_throws(read_probe_sites("/nonexistent/lc"), std::runtime_error);
+}
+
+void probes_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_read_probe_sites);
+}
+
+#endif
@@ -0,0 +1,770 @@
+#include "../include/profile.hpp"
+#include "../include/serialize.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace lambda
+{
+
+// the tag of nodes that come from the main function
+static constexpr uint32_t MAIN_HELPER = UINT32_MAX;
+
+namespace
+{
+
+// the helper every node of the term being reduced comes from, in a side
+// table keyed by node. While installed, a copy made by clone() gets the
+// helper of the node it copies, so the table follows the term through
+// reduce_one_step(). Entries of freed nodes are left behind; since every
+// node the reduction creates is a clone, a reused address is always
+// overwritten before it is looked up.
+class helper_tags : public clone_observer
+{
+  public:
+    // tags the node a_expr alone with a_helper.
+    void tag_node(const expr& a_expr, uint32_t a_helper)
+    {
+        m_helpers[&a_expr] = a_helper;
+    }
+
+    // tags every node of a_expr with a_helper.
+    void tag(const expr& a_expr, uint32_t a_helper)
+    {
+        tag_node(a_expr, a_helper);
+
+        if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+            tag(*l_func->m_body, a_helper);
+        else if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+        {
+            tag(*l_app->m_lhs, a_helper);
+            tag(*l_app->m_rhs, a_helper);
+        }
+    }
+
+    uint32_t helper_of(const expr& a_expr) const
+    {
+        auto l_it = m_helpers.find(&a_expr);
+
+        return l_it == m_helpers.end() ? MAIN_HELPER : l_it->second;
+    }
+
+    void cloned(const expr& a_original, const expr& a_copy) override
+    {
+        m_helpers[&a_copy] = helper_of(a_original);
+        ++m_copied;
+    }
+
+    // nodes cloned since installed
+    size_t m_copied = 0;
+
+  private:
+    std::unordered_map<const expr*, uint32_t> m_helpers;
+};
+
+// installs a clone_observer for its lifetime.
+struct observer_scope
+{
+    explicit observer_scope(clone_observer* a_observer)
+        : m_previous(observe_clones(a_observer))
+    {
+    }
+
+    ~observer_scope()
+    {
+        observe_clones(m_previous);
+    }
+
+    observer_scope(const observer_scope&) = delete;
+    observer_scope& operator=(const observer_scope&) = delete;
+
+    clone_observer* m_previous;
+};
+
+} // namespace
+
+// a node on the way from the root to a redex.
+struct path_entry
+{
+    node_tag m_tag;
+    uint32_t m_helper;
+    // for an app, whether the way continues into its rhs
+    bool m_rhs;
+};
+
+// the abstraction of the redex reduce_one_step() would contract in a_expr,
+// found in the same order, or nullptr if a_expr is normal. If a_path is
+// given, the nodes above the redex are appended to it.
+static const func* find_redex(const expr& a_expr, const helper_tags& a_tags,
+                              std::vector<path_entry>* a_path)
+{
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+    {
+        if(a_path)
+            a_path->push_back(
+                {node_tag::func, a_tags.helper_of(a_expr), false});
+
+        const func* l_redex = find_redex(*l_func->m_body, a_tags, a_path);
+
+        if(!l_redex && a_path)
+            a_path->pop_back();
+
+        return l_redex;
+    }
+
+    const app* l_app = dynamic_cast<const app*>(&a_expr);
+
+    if(!l_app)
+        return nullptr;
+
+    if(const func* l_func = dynamic_cast<const func*>(l_app->m_lhs.get()))
+        return l_func;
+
+    if(a_path)
+        a_path->push_back({node_tag::app, a_tags.helper_of(a_expr), false});
+
+    if(const func* l_redex = find_redex(*l_app->m_lhs, a_tags, a_path))
+        return l_redex;
+
+    if(a_path)
+        a_path->back().m_rhs = true;
+
+    if(const func* l_redex = find_redex(*l_app->m_rhs, a_tags, a_path))
+        return l_redex;
+
+    if(a_path)
+        a_path->pop_back();
+
+    return nullptr;
+}
+
+// construct_program(a_helpers, a_main_fn), with every node tagged in
+// a_tags, the binder of each helper belonging to the helper.
+static std::unique_ptr<expr> tag_program(
+    const std::vector<const expr*>& a_helpers, const expr& a_main_fn,
+    helper_tags& a_tags)
+{
+    std::unique_ptr<expr> l_program = a_main_fn.clone();
+    a_tags.tag(*l_program, MAIN_HELPER);
+
+    for(size_t i = a_helpers.size(); i-- > 0;)
+    {
+        std::unique_ptr<expr> l_helper = a_helpers[i]->clone();
+        a_tags.tag(*l_helper, uint32_t(i));
+
+        std::unique_ptr<expr> l_binder = f(std::move(l_program));
+        a_tags.tag_node(*l_binder, uint32_t(i));
+
+        l_program = a(std::move(l_binder), std::move(l_helper));
+        a_tags.tag_node(*l_program, uint32_t(i));
+    }
+
+    return l_program;
+}
+
+// normalizes a_expr, tagged in a_tags, as normalize() would, filling in
+// a_stats. Every a_sample_period-th step, starting with the first, is timed
+// and a_charge(helper, copied nodes, time, path) is called; the path above
+// the redex is only recorded if a_paths is set. The redex is located before
+// the step, outside the time charged for it.
+template <typename CHARGE>
+static void reduce_sampled(std::unique_ptr<expr>& a_expr, helper_tags& a_tags,
+                           const budget& a_budget, size_t a_sample_period,
+                           bool a_paths, normalize_stats& a_stats,
+                           CHARGE&& a_charge)
+{
+    using clock = std::chrono::steady_clock;
+
+    const clock::time_point l_start = clock::now();
+    const bool l_timed =
+        a_budget.m_max_time != std::chrono::nanoseconds::max();
+
+    std::vector<path_entry> l_path;
+    observer_scope l_observing(&a_tags);
+
+    a_stats.m_max_size = a_expr->m_size;
+
+    // the same checks in the same order as normalize()
+    while(true)
+    {
+        if(a_expr->m_size > a_budget.m_max_size)
+        {
+            a_stats.m_status = normalize_status::size_limit;
+            break;
+        }
+
+        if(l_timed && clock::now() - l_start >= a_budget.m_max_time)
+        {
+            a_stats.m_status = is_normal(*a_expr)
+                                   ? normalize_status::normal_form
+                                   : normalize_status::time_limit;
+            break;
+        }
+
+        if(a_stats.m_steps >= a_budget.m_max_steps)
+        {
+            a_stats.m_status = is_normal(*a_expr)
+                                   ? normalize_status::normal_form
+                                   : normalize_status::step_limit;
+            break;
+        }
+
+        const bool l_sampled = a_stats.m_steps % a_sample_period == 0;
+        uint32_t l_helper = MAIN_HELPER;
+        clock::time_point l_step_start;
+
+        if(l_sampled)
+        {
+            l_path.clear();
+
+            const func* l_redex =
+                find_redex(*a_expr, a_tags, a_paths ? &l_path : nullptr);
+
+            if(l_redex)
+                l_helper = a_tags.helper_of(*l_redex);
+
+            a_tags.m_copied = 0;
+            l_step_start = clock::now();
+        }
+
+        if(!reduce_one_step(a_expr))
+        {
+            a_stats.m_status = normalize_status::normal_form;
+            break;
+        }
+
+        if(l_sampled)
+            a_charge(l_helper, a_tags.m_copied, clock::now() - l_step_start,
+                     l_path);
+
+        ++a_stats.m_steps;
+        a_stats.m_max_size = std::max(a_stats.m_max_size, a_expr->m_size);
+    }
+
+    a_stats.m_elapsed = clock::now() - l_start;
+}
+
+program_profile profile_program(const std::vector<const expr*>& a_helpers,
+                                const expr& a_main_fn,
+                                std::unique_ptr<expr>& a_result,
+                                const budget& a_budget)
+{
+    program_profile l_profile;
+    l_profile.m_helpers.resize(a_helpers.size());
+
+    helper_tags l_tags;
+    a_result = tag_program(a_helpers, a_main_fn, l_tags);
+
+    reduce_sampled(a_result, l_tags, a_budget, 1, false, l_profile.m_stats,
+                   [&](uint32_t a_helper, size_t a_copied,
+                       std::chrono::nanoseconds a_elapsed,
+                       const std::vector<path_entry>&)
+                   {
+                       helper_profile& l_charged =
+                           a_helper == MAIN_HELPER
+                               ? l_profile.m_main
+                               : l_profile.m_helpers[a_helper];
+                       ++l_charged.m_steps;
+                       l_charged.m_copied_nodes += a_copied;
+                       l_charged.m_elapsed += a_elapsed;
+                   });
+
+    return l_profile;
+}
+
+void print_profile(std::ostream& a_ostream, const program_profile& a_profile)
+{
+    // (name, profile) of every helper that took a step
+    std::vector<std::pair<std::string, const helper_profile*>> l_rows;
+
+    for(size_t i = 0; i < a_profile.m_helpers.size(); ++i)
+        if(a_profile.m_helpers[i].m_steps > 0)
+            l_rows.emplace_back(std::to_string(i), &a_profile.m_helpers[i]);
+
+    if(a_profile.m_main.m_steps > 0)
+        l_rows.emplace_back("main", &a_profile.m_main);
+
+    std::stable_sort(
+        l_rows.begin(), l_rows.end(), [](const auto& a_lhs, const auto& a_rhs)
+        { return a_lhs.second->m_elapsed > a_rhs.second->m_elapsed; });
+
+    const std::ios_base::fmtflags l_flags = a_ostream.flags();
+    const std::streamsize l_precision = a_ostream.precision();
+
+    a_ostream << std::left << std::setw(8) << "helper" << std::right
+              << std::setw(14) << "steps" << std::setw(16) << "copied nodes"
+              << std::setw(14) << "time (ms)" << '\n';
+
+    for(const auto& [l_name, l_helper] : l_rows)
+        a_ostream << std::left << std::setw(8) << l_name << std::right
+                  << std::setw(14) << l_helper->m_steps << std::setw(16)
+                  << l_helper->m_copied_nodes << std::setw(14) << std::fixed
+                  << std::setprecision(3) << l_helper->m_elapsed.count() / 1e6
+                  << '\n';
+
+    a_ostream.flags(l_flags);
+    a_ostream.precision(l_precision);
+}
+
+static std::string helper_frame(uint32_t a_helper)
+{
+    if(a_helper == MAIN_HELPER)
+        return "main";
+
+    // appended rather than "h" + ..., which GCC 12 at -O3 wrongly reports
+    // under -Wrestrict (GCC bug 105329)
+    std::string l_frame = "h";
+    l_frame += std::to_string(a_helper);
+
+    return l_frame;
+}
+
+// the frames of a redex below a_path that contracts an abstraction of
+// a_helper, joined with ';'.
+static std::string folded_stack(const std::vector<path_entry>& a_path,
+                                uint32_t a_helper, flame_frames a_frames)
+{
+    std::string l_stack;
+    std::string l_last;
+
+    auto l_push = [&](std::string a_frame)
+    {
+        // helper frames merge with the one before
+        if(a_frames == flame_frames::helper && a_frame == l_last)
+            return;
+
+        if(!l_stack.empty())
+            l_stack += ';';
+
+        l_stack += a_frame;
+        l_last = std::move(a_frame);
+    };
+
+    for(const path_entry& l_entry : a_path)
+    {
+        if(a_frames == flame_frames::helper)
+            l_push(helper_frame(l_entry.m_helper));
+        else if(l_entry.m_tag == node_tag::func)
+            l_push("λ");
+        else if(l_entry.m_rhs)
+            l_push("arg");
+    }
+
+    l_push(a_frames == flame_frames::helper ? helper_frame(a_helper)
+                                            : "redex");
+
+    return l_stack;
+}
+
+static flame_graph flame(std::unique_ptr<expr>& a_expr, helper_tags& a_tags,
+                         const flame_options& a_options,
+                         const budget& a_budget)
+{
+    flame_graph l_graph;
+    const size_t l_period = std::max<size_t>(a_options.m_sample_period, 1);
+
+    reduce_sampled(
+        a_expr, a_tags, a_budget, l_period, true, l_graph.m_stats,
+        [&](uint32_t a_helper, size_t a_copied,
+            std::chrono::nanoseconds a_elapsed,
+            const std::vector<path_entry>& a_path)
+        {
+            helper_profile& l_cost = l_graph.m_stacks[folded_stack(
+                a_path, a_helper, a_options.m_frames)];
+            l_cost.m_steps += l_period;
+            l_cost.m_copied_nodes += a_copied * l_period;
+            l_cost.m_elapsed += a_elapsed * l_period;
+        });
+
+    return l_graph;
+}
+
+flame_graph flame_normalize(std::unique_ptr<expr>& a_expr,
+                            const flame_options& a_options,
+                            const budget& a_budget)
+{
+    // nodes that are not tagged belong to main
+    helper_tags l_tags;
+
+    return flame(a_expr, l_tags, a_options, a_budget);
+}
+
+flame_graph flame_program(const std::vector<const expr*>& a_helpers,
+                          const expr& a_main_fn,
+                          std::unique_ptr<expr>& a_result,
+                          const flame_options& a_options,
+                          const budget& a_budget)
+{
+    helper_tags l_tags;
+    a_result = tag_program(a_helpers, a_main_fn, l_tags);
+
+    return flame(a_result, l_tags, a_options, a_budget);
+}
+
+void write_folded(std::ostream& a_ostream, const flame_graph& a_graph,
+                  flame_weight a_weight)
+{
+    for(const auto& [l_stack, l_cost] : a_graph.m_stacks)
+    {
+        uint64_t l_weight = 0;
+
+        switch(a_weight)
+        {
+            case flame_weight::steps:
+                l_weight = l_cost.m_steps;
+                break;
+            case flame_weight::copied_nodes:
+                l_weight = l_cost.m_copied_nodes;
+                break;
+            case flame_weight::time:
+                l_weight = l_cost.m_elapsed.count();
+                break;
+        }
+
+        if(l_weight > 0)
+            a_ostream << l_stack << ' ' << l_weight << '\n';
+    }
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <algorithm>
+#include <list>
+#include <sstream>
+
+using namespace lambda;
+
+void test_profile_program()
+{
+    std::list<std::unique_ptr<expr>> l_helpers;
+
+    auto l = [&l_helpers](size_t a_local_index)
+    { return v(l_helpers.size() + a_local_index); };
+    auto g = [](size_t a_global_index) { return v(a_global_index); };
+
+    // Helper 0: TRUE = λ.λ.0
+    const auto TRUE = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(0))));
+
+    // Helper 1: FALSE = λ.λ.1
+    const auto FALSE = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(1))));
+
+    // Helper 2: NOT = λ.((0 FALSE) TRUE)
+    const auto NOT = g(l_helpers.size());
+    l_helpers.emplace_back(
+        f(a(a(l(0)->clone(), FALSE->clone()), TRUE->clone())));
+
+    // NOT TRUE, step by step:
+    //   binding TRUE copies it into NOT and main: 2 x 3 nodes
+    //   binding FALSE copies it into NOT: 3 nodes
+    //   binding NOT, by now 10 nodes, copies it into main
+    //   NOT TRUE copies TRUE into NOT's body: 3 nodes
+    //   (TRUE FALSE) copies FALSE: 3 nodes
+    //   (λ.FALSE TRUE) copies nothing
+    {
+        auto l_main = a(NOT->clone(), TRUE->clone());
+        std::unique_ptr<expr> l_result;
+        program_profile l_profile = profile_program(
+            l_helpers.begin(), l_helpers.end(), l_main, l_result);
+
+        assert(l_result->equals(f(f(v(1)))));
+        assert(l_profile.m_stats.m_status == normalize_status::normal_form);
+        assert(l_profile.m_stats.m_steps == 6);
+
+        assert(l_profile.m_helpers.size() == 3);
+        assert(l_profile.m_helpers[0].m_steps == 3);
+        assert(l_profile.m_helpers[0].m_copied_nodes == 9);
+        assert(l_profile.m_helpers[1].m_steps == 1);
+        assert(l_profile.m_helpers[1].m_copied_nodes == 3);
+        assert(l_profile.m_helpers[2].m_steps == 2);
+        assert(l_profile.m_helpers[2].m_copied_nodes == 13);
+        assert(l_profile.m_main.m_steps == 0);
+
+        std::ostringstream l_out;
+        print_profile(l_out, l_profile);
+        const std::string l_table = l_out.str();
+
+        // a header and one line per helper that took a step
+        assert(std::count(l_table.begin(), l_table.end(), '\n') == 4);
+        assert(l_table.find("main") == std::string::npos);
+    }
+
+    // abstractions written in main are charged to main
+    {
+        auto l_main = a(f(a(l(0), l(0))), TRUE->clone());
+        std::unique_ptr<expr> l_result;
+        program_profile l_profile = profile_program(
+            l_helpers.begin(), l_helpers.end(), l_main, l_result);
+
+        assert(l_profile.m_main.m_steps == 1);
+        assert(l_profile.m_main.m_copied_nodes == 6);
+        assert(l_profile.m_main.m_elapsed.count() > 0);
+    }
+
+    const auto ZERO = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(1))));
+
+    const auto SUCC = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(f(a(l(1), a(a(l(0), l(1)), l(2)))))));
+
+    const auto MULT = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(f(f(a(a(l(0), a(l(1), l(2))), l(3)))))));
+
+    const auto TWO = a(SUCC->clone(), a(SUCC->clone(), ZERO->clone()));
+    const auto THREE = a(SUCC->clone(), TWO->clone());
+    const auto l_main = a(a(MULT->clone(), THREE->clone()), TWO->clone());
+
+    // the result, the steps and the stopping reason are those of
+    // normalize(), within any budget
+    for(const budget& l_budget :
+        {budget{}, budget{10}, budget{SIZE_MAX, 60}, budget{SIZE_MAX, 1}})
+    {
+        std::unique_ptr<expr> l_result;
+        program_profile l_profile = profile_program(
+            l_helpers.begin(), l_helpers.end(), l_main, l_result, l_budget);
+
+        auto l_expected =
+            construct_program(l_helpers.begin(), l_helpers.end(), l_main);
+        normalize_stats l_stats = normalize(l_expected, l_budget);
+
+        assert(l_result->equals(l_expected));
+        assert(l_result->m_size == l_expected->m_size);
+        assert(l_profile.m_stats.m_status == l_stats.m_status);
+        assert(l_profile.m_stats.m_steps == l_stats.m_steps);
+        assert(l_profile.m_stats.m_max_size == l_stats.m_max_size);
+
+        size_t l_steps = l_profile.m_main.m_steps;
+
+        for(const helper_profile& l_helper : l_profile.m_helpers)
+            l_steps += l_helper.m_steps;
+
+        assert(l_steps == l_stats.m_steps);
+    }
+
+    // helpers keep being charged for copies of copies of themselves long
+    // after their binding step
+    {
+        std::unique_ptr<expr> l_result;
+        program_profile l_profile = profile_program(
+            l_helpers.begin(), l_helpers.end(), l_main, l_result);
+
+        assert(l_result->equals(
+            f(f(a(v(0), a(v(0), a(v(0), a(v(0), a(v(0), a(v(0), v(1)))))))))));
+
+        // MULT: its binding step, then both arguments
+        assert(l_profile.m_helpers[5].m_steps == 3);
+        // SUCC: applied to ZERO, ONE and so on, and each numeral it built
+        // applied again inside MULT
+        assert(l_profile.m_helpers[4].m_steps >
+               l_profile.m_helpers[3].m_steps);
+        assert(l_profile.m_helpers[4].m_steps >
+               l_profile.m_helpers[5].m_steps);
+        assert(l_profile.m_helpers[4].m_copied_nodes >
+               l_profile.m_helpers[5].m_copied_nodes);
+    }
+}
+
+void test_flame_graph()
+{
+    // λ.(0 ((λ.1) 0)): the redex is the argument of an application under
+    // an abstraction
+    {
+        auto l_expr = f(a(v(0), a(f(v(1)), v(0))));
+        flame_graph l_graph = flame_normalize(l_expr);
+
+        assert(l_expr->equals(f(a(v(0), v(0)))));
+        assert(l_graph.m_stats.m_steps == 1);
+        assert(l_graph.m_stacks.size() == 1);
+        assert(l_graph.m_stacks.begin()->first == "λ;arg;redex");
+
+        std::ostringstream l_out;
+        write_folded(l_out, l_graph);
+        assert(l_out.str() == "λ;arg;redex 1\n");
+
+        l_out.str("");
+        write_folded(l_out, l_graph, flame_weight::copied_nodes);
+        assert(l_out.str() == "λ;arg;redex 1\n");
+    }
+
+    std::list<std::unique_ptr<expr>> l_helpers;
+
+    auto l = [&l_helpers](size_t a_local_index)
+    { return v(l_helpers.size() + a_local_index); };
+    auto g = [](size_t a_global_index) { return v(a_global_index); };
+
+    const auto TRUE = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(0))));
+
+    const auto FALSE = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(1))));
+
+    const auto NOT = g(l_helpers.size());
+    l_helpers.emplace_back(
+        f(a(a(l(0)->clone(), FALSE->clone()), TRUE->clone())));
+
+    // NOT TRUE by helper: the three binding steps, NOT applied to TRUE,
+    // then TRUE applied inside the body of NOT and once more at the root
+    {
+        auto l_main = a(NOT->clone(), TRUE->clone());
+        std::unique_ptr<expr> l_result;
+        flame_graph l_graph =
+            flame_program(l_helpers.begin(), l_helpers.end(), l_main,
+                          l_result, {flame_frames::helper});
+
+        assert(l_result->equals(f(f(v(1)))));
+
+        std::ostringstream l_out;
+        write_folded(l_out, l_graph);
+        assert(l_out.str() == "h0 2\nh1 1\nh2 2\nh2;h0 1\n");
+    }
+
+    const auto ZERO = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(l(1))));
+
+    const auto SUCC = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(f(a(l(1), a(a(l(0), l(1)), l(2)))))));
+
+    const auto MULT = g(l_helpers.size());
+    l_helpers.emplace_back(f(f(f(f(a(a(l(0), a(l(1), l(2))), l(3)))))));
+
+    const auto TWO = a(SUCC->clone(), a(SUCC->clone(), ZERO->clone()));
+    const auto THREE = a(SUCC->clone(), TWO->clone());
+    const auto l_main = a(a(MULT->clone(), THREE->clone()), TWO->clone());
+
+    auto l_expected =
+        construct_program(l_helpers.begin(), l_helpers.end(), l_main);
+    const normalize_stats l_stats = normalize(l_expected);
+
+    // sampling changes neither the result nor the steps, and the sampled
+    // steps, scaled up, account for all of them
+    for(flame_frames l_frames : {flame_frames::path, flame_frames::helper})
+        for(size_t l_period : {1, 2, 7})
+        {
+            std::unique_ptr<expr> l_result;
+            flame_graph l_graph =
+                flame_program(l_helpers.begin(), l_helpers.end(), l_main,
+                              l_result, {l_frames, l_period});
+
+            assert(l_result->equals(l_expected));
+            assert(l_graph.m_stats.m_steps == l_stats.m_steps);
+            assert(l_graph.m_stats.m_max_size == l_stats.m_max_size);
+
+            size_t l_steps = 0;
+
+            for(const auto& [l_stack, l_cost] : l_graph.m_stacks)
+            {
+                assert(!l_stack.empty());
+                assert(l_stack.find(' ') == std::string::npos);
+                l_steps += l_cost.m_steps;
+            }
+
+            const size_t l_samples =
+                (l_stats.m_steps + l_period - 1) / l_period;
+            assert(l_steps == l_samples * l_period);
+
+            // every line is a stack and a positive weight
+            std::ostringstream l_out;
+            write_folded(l_out, l_graph, flame_weight::time);
+            std::istringstream l_in(l_out.str());
+            std::string l_line;
+
+            while(std::getline(l_in, l_line))
+            {
+                const size_t l_space = l_line.rfind(' ');
+                assert(l_space != std::string::npos);
+                assert(std::stoull(l_line.substr(l_space + 1)) > 0);
+            }
+        }
+}
+
+void profile_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_profile_program);
+    TEST(test_flame_graph);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include <string>
+
+using namespace lambda;
+
+void bench_profile_program()
+{
+    const size_t l_runs = 3;
+
+    // church numeral a_n as a helper under a_depth binders
+    auto l_numeral = [](size_t a_n, size_t a_depth)
+    {
+        std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(a_depth), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    // church exponentiation through helpers: (SIX THREE), 3^6
+    std::vector<std::unique_ptr<expr>> l_helpers;
+    l_helpers.push_back(l_numeral(3, 0));
+    l_helpers.push_back(l_numeral(6, 1));
+    const auto l_main = a(v(1), v(0));
+
+    std::unique_ptr<expr> l_program;
+    size_t l_steps = 0;
+
+    measurement l_measured = measure_best_of(
+        l_runs,
+        [&]
+        {
+            l_program = construct_program(l_helpers.begin(),
+                                          l_helpers.end(), l_main);
+        },
+        [&] { l_steps = normalize(l_program).m_steps; });
+    report("normalize", l_measured, l_steps);
+
+    l_measured = measure_best_of(
+        l_runs, [] {},
+        [&]
+        {
+            l_steps = profile_program(l_helpers.begin(), l_helpers.end(),
+                                      l_main, l_program)
+                          .m_stats.m_steps;
+        });
+    report("profile_program", l_measured, l_steps);
+
+    for(size_t l_period : {1, 64})
+    {
+        l_measured = measure_best_of(
+            l_runs, [] {},
+            [&]
+            {
+                l_steps = flame_program(l_helpers.begin(), l_helpers.end(),
+                                        l_main, l_program,
+                                        {flame_frames::path, l_period})
+                              .m_stats.m_steps;
+            });
+
+        const std::string l_name =
+            "flame_program, every " + std::to_string(l_period) + " steps";
+        report(l_name.c_str(), l_measured, l_steps);
+    }
+}
+
+void profile_bench_main()
+{
+    BENCH(bench_profile_program);
+}
+
+#endif
@@ -0,0 +1,1252 @@
+#include "../include/serialize.hpp"
+#include "../include/hash.hpp"
+#include "../include/intern.hpp"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace lambda
+{
+
+// TEXT FORMAT
+
+static void skip_whitespace(std::string_view a_text, size_t& a_pos)
+{
+    while(a_pos < a_text.size() &&
+          (a_text[a_pos] == ' ' || a_text[a_pos] == '\t' ||
+           a_text[a_pos] == '\n' || a_text[a_pos] == '\r'))
+        ++a_pos;
+}
+
+static void expect(std::string_view a_text, size_t& a_pos, char a_char)
+{
+    skip_whitespace(a_text, a_pos);
+
+    if(a_pos >= a_text.size() || a_text[a_pos] != a_char)
+        throw std::runtime_error("parse: expected '" + std::string(1, a_char) +
+                                 "' at offset " + std::to_string(a_pos));
+
+    ++a_pos;
+}
+
+// consumes a lambda symbol ("λ" or "\") if one is present at a_pos.
+static bool consume_lambda(std::string_view a_text, size_t& a_pos)
+{
+    static constexpr std::string_view LAMBDA = "λ";
+
+    if(a_text.substr(a_pos, LAMBDA.size()) == LAMBDA)
+    {
+        a_pos += LAMBDA.size();
+        return true;
+    }
+
+    if(a_pos < a_text.size() && a_text[a_pos] == '\\')
+    {
+        ++a_pos;
+        return true;
+    }
+
+    return false;
+}
+
+std::unique_ptr<expr> parse(std::string_view a_text)
+{
+    size_t l_pos = 0;
+
+    auto l_result = parse(a_text, l_pos);
+
+    skip_whitespace(a_text, l_pos);
+
+    if(l_pos != a_text.size())
+        throw std::runtime_error("parse: trailing characters at offset " +
+                                 std::to_string(l_pos));
+
+    return l_result;
+}
+
+std::unique_ptr<expr> parse(std::string_view a_text, size_t& a_pos)
+{
+    // the parser keeps its own stack of partially built nodes instead of
+    // recursing, so that deeply nested input cannot overflow the call stack.
+    enum class pending
+    {
+        func_body,
+        app_lhs,
+        app_rhs,
+    };
+
+    std::vector<std::pair<pending, std::unique_ptr<expr>>> l_stack;
+
+    while(true)
+    {
+        skip_whitespace(a_text, a_pos);
+
+        if(consume_lambda(a_text, a_pos))
+        {
+            expect(a_text, a_pos, '.');
+            expect(a_text, a_pos, '(');
+            l_stack.emplace_back(pending::func_body, nullptr);
+            continue;
+        }
+
+        if(a_pos < a_text.size() && a_text[a_pos] == '(')
+        {
+            ++a_pos;
+            l_stack.emplace_back(pending::app_lhs, nullptr);
+            continue;
+        }
+
+        if(a_pos >= a_text.size() || a_text[a_pos] < '0' || a_text[a_pos] > '9')
+            throw std::runtime_error("parse: unexpected input at offset " +
+                                     std::to_string(a_pos));
+
+        // a var leaf
+        size_t l_index = 0;
+
+        while(a_pos < a_text.size() && a_text[a_pos] >= '0' &&
+              a_text[a_pos] <= '9')
+        {
+            const size_t l_digit = a_text[a_pos] - '0';
+
+            if(l_index > (SIZE_MAX - l_digit) / 10)
+                throw std::runtime_error("parse: variable index overflow");
+
+            l_index = l_index * 10 + l_digit;
+            ++a_pos;
+        }
+
+        std::unique_ptr<expr> l_result = v(l_index);
+
+        // close every node that is now complete
+        while(true)
+        {
+            if(l_stack.empty())
+                return l_result;
+
+            auto& [l_pending, l_partial] = l_stack.back();
+
+            if(l_pending == pending::app_lhs)
+            {
+                // the rhs is parsed by the next iteration of the outer loop
+                l_pending = pending::app_rhs;
+                l_partial = std::move(l_result);
+                break;
+            }
+
+            expect(a_text, a_pos, ')');
+
+            if(l_pending == pending::func_body)
+                l_result = f(std::move(l_result));
+            else
+                l_result = a(std::move(l_partial), std::move(l_result));
+
+            l_stack.pop_back();
+        }
+    }
+}
+
+// BINARY FORMAT
+
+void encode(const expr& a_expr, std::string& a_out)
+{
+    if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+    {
+        a_out.push_back(static_cast<char>(node_tag::var));
+        put_varint(a_out, l_var->m_index);
+        return;
+    }
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+    {
+        a_out.push_back(static_cast<char>(node_tag::func));
+        encode(*l_func->m_body, a_out);
+        return;
+    }
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+    {
+        a_out.push_back(static_cast<char>(node_tag::app));
+        encode(*l_app->m_lhs, a_out);
+        encode(*l_app->m_rhs, a_out);
+        return;
+    }
+
+    // if we get here, error
+    throw std::runtime_error("encode: invalid expression type");
+}
+
+std::unique_ptr<expr> decode(std::string_view a_bytes, size_t& a_pos)
+{
+    // same explicit-stack approach as parse(): a pending func waits for its
+    // body, a pending app waits for its lhs and then its rhs.
+    std::vector<std::pair<node_tag, std::unique_ptr<expr>>> l_stack;
+
+    while(true)
+    {
+        if(a_pos >= a_bytes.size())
+            throw std::runtime_error("decode: truncated input");
+
+        const node_tag l_tag = static_cast<node_tag>(a_bytes[a_pos++]);
+
+        if(l_tag == node_tag::func || l_tag == node_tag::app)
+        {
+            l_stack.emplace_back(l_tag, nullptr);
+            continue;
+        }
+
+        if(l_tag != node_tag::var)
+            throw std::runtime_error("decode: invalid node tag at offset " +
+                                     std::to_string(a_pos - 1));
+
+        std::unique_ptr<expr> l_result = v(get_varint(a_bytes, a_pos));
+
+        while(true)
+        {
+            if(l_stack.empty())
+                return l_result;
+
+            auto& [l_pending, l_partial] = l_stack.back();
+
+            if(l_pending == node_tag::app && !l_partial)
+            {
+                l_partial = std::move(l_result);
+                break;
+            }
+
+            if(l_pending == node_tag::func)
+                l_result = f(std::move(l_result));
+            else
+                l_result = a(std::move(l_partial), std::move(l_result));
+
+            l_stack.pop_back();
+        }
+    }
+}
+
+// SHARED BINARY FORMAT
+
+namespace
+{
+
+// a term as a graph of distinct nodes, children before their parents.
+struct term_graph
+{
+    struct node
+    {
+        node_tag m_tag;
+        // the level of a var
+        uint64_t m_index;
+        // the body of a func, or the lhs of an app
+        size_t m_lhs;
+        // the rhs of an app
+        size_t m_rhs;
+    };
+
+    std::vector<node> m_nodes;
+    size_t m_root = 0;
+};
+
+// what identifies a node among those already in a term_graph.
+struct graph_key
+{
+    node_tag m_tag;
+    uint64_t m_index;
+    size_t m_lhs;
+    size_t m_rhs;
+
+    bool operator==(const graph_key&) const = default;
+};
+
+struct graph_key_hash
+{
+    size_t operator()(const graph_key& a_key) const
+    {
+        return hash_combine(
+            hash_combine(hash_combine(static_cast<uint64_t>(a_key.m_tag),
+                                      a_key.m_index),
+                         a_key.m_lhs),
+            a_key.m_rhs);
+    }
+};
+
+// builds a term_graph, giving equal subterms one node.
+class graph_builder
+{
+  public:
+    size_t add(const expr& a_expr)
+    {
+        if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+            return find_or_add({node_tag::var, l_var->m_index, 0, 0});
+
+        if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+            return find_or_add({node_tag::func, 0, add(*l_func->m_body), 0});
+
+        if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+        {
+            const size_t l_lhs = add(*l_app->m_lhs);
+            return find_or_add({node_tag::app, 0, l_lhs, add(*l_app->m_rhs)});
+        }
+
+        // if we get here, error
+        throw std::runtime_error("encode_shared: invalid expression type");
+    }
+
+    // interned terms are distinct by pointer already
+    size_t add(const interned* a_node)
+    {
+        if(auto l_it = m_interned.find(a_node); l_it != m_interned.end())
+            return l_it->second;
+
+        size_t l_lhs = 0;
+        size_t l_rhs = 0;
+
+        if(a_node->m_tag != node_tag::var)
+            l_lhs = add(a_node->m_lhs);
+
+        if(a_node->m_tag == node_tag::app)
+            l_rhs = add(a_node->m_rhs);
+
+        m_graph.m_nodes.push_back(
+            {a_node->m_tag, a_node->m_index, l_lhs, l_rhs});
+
+        return m_interned[a_node] = m_graph.m_nodes.size() - 1;
+    }
+
+    term_graph& graph()
+    {
+        return m_graph;
+    }
+
+  private:
+    size_t find_or_add(const graph_key& a_key)
+    {
+        auto [l_it, l_added] =
+            m_ids.try_emplace(a_key, m_graph.m_nodes.size());
+
+        if(l_added)
+            m_graph.m_nodes.push_back(
+                {a_key.m_tag, a_key.m_index, a_key.m_lhs, a_key.m_rhs});
+
+        return l_it->second;
+    }
+
+    term_graph m_graph;
+    std::unordered_map<graph_key, size_t, graph_key_hash> m_ids;
+    std::unordered_map<const interned*, size_t> m_interned;
+};
+
+// writes a term_graph, sharing the nodes that would be written more than
+// once.
+class shared_writer
+{
+  public:
+    shared_writer(const term_graph& a_graph, std::string& a_out)
+        : m_graph(a_graph), m_out(a_out),
+          m_number(a_graph.m_nodes.size(), NONE),
+          m_shared(a_graph.m_nodes.size(), false)
+    {
+        // each node is written once per distinct parent, since a parent
+        // written twice is shared itself. A var is no larger than a ref.
+        std::vector<uint8_t> l_uses(a_graph.m_nodes.size(), 0);
+        l_uses[a_graph.m_root] = 1;
+
+        for(const term_graph::node& l_node : a_graph.m_nodes)
+        {
+            if(l_node.m_tag == node_tag::var)
+                continue;
+
+            l_uses[l_node.m_lhs] = std::min(l_uses[l_node.m_lhs] + 1, 2);
+
+            if(l_node.m_tag == node_tag::app)
+                l_uses[l_node.m_rhs] = std::min(l_uses[l_node.m_rhs] + 1, 2);
+        }
+
+        for(size_t i = 0; i < a_graph.m_nodes.size(); ++i)
+            m_shared[i] =
+                l_uses[i] > 1 && a_graph.m_nodes[i].m_tag != node_tag::var;
+    }
+
+    void write(size_t a_id)
+    {
+        if(m_shared[a_id])
+        {
+            if(m_number[a_id] != NONE)
+            {
+                m_out.push_back(static_cast<char>(shared_tag::ref));
+                put_varint(m_out, m_number[a_id]);
+                return;
+            }
+
+            m_number[a_id] = m_next_number++;
+            m_out.push_back(static_cast<char>(shared_tag::share));
+        }
+
+        const term_graph::node& l_node = m_graph.m_nodes[a_id];
+        m_out.push_back(static_cast<char>(l_node.m_tag));
+
+        if(l_node.m_tag == node_tag::var)
+        {
+            put_varint(m_out, l_node.m_index);
+            return;
+        }
+
+        write(l_node.m_lhs);
+
+        if(l_node.m_tag == node_tag::app)
+            write(l_node.m_rhs);
+    }
+
+  private:
+    static constexpr size_t NONE = SIZE_MAX;
+
+    const term_graph& m_graph;
+    std::string& m_out;
+    // the number of each shared node once written
+    std::vector<size_t> m_number;
+    std::vector<bool> m_shared;
+    size_t m_next_number = 0;
+};
+
+// decodes the shared encoding with the node factories of a_builder, as
+// decode() does: a pending func waits for its body, a pending app for its
+// lhs and then its rhs, and a pending share for the node it numbers.
+template <typename BUILDER>
+typename BUILDER::value decode_with(std::string_view a_bytes, size_t& a_pos,
+                                    BUILDER& a_builder)
+{
+    using value = typename BUILDER::value;
+
+    struct pending
+    {
+        shared_tag m_tag;
+        value m_partial;
+        // the number a share gives its node
+        size_t m_number;
+    };
+
+    std::vector<pending> l_stack;
+    // the shared nodes by number, null while still being decoded
+    std::vector<value> l_shared;
+
+    while(true)
+    {
+        if(a_pos >= a_bytes.size())
+            throw std::runtime_error("decode_shared: truncated input");
+
+        const size_t l_offset = a_pos;
+        const shared_tag l_tag = static_cast<shared_tag>(a_bytes[a_pos++]);
+        const bool l_after_share =
+            !l_stack.empty() && l_stack.back().m_tag == shared_tag::share &&
+            !l_stack.back().m_partial;
+
+        if(l_after_share &&
+           (l_tag == shared_tag::share || l_tag == shared_tag::ref))
+            throw std::runtime_error(
+                "decode_shared: share of a non-node at offset " +
+                std::to_string(l_offset));
+
+        if(l_tag == shared_tag::func || l_tag == shared_tag::app)
+        {
+            l_stack.push_back({l_tag, value(), 0});
+            continue;
+        }
+
+        if(l_tag == shared_tag::share)
+        {
+            l_stack.push_back({l_tag, value(), l_shared.size()});
+            l_shared.emplace_back();
+            continue;
+        }
+
+        value l_result;
+
+        if(l_tag == shared_tag::var)
+            l_result = a_builder.make_var(get_varint(a_bytes, a_pos));
+        else if(l_tag == shared_tag::ref)
+        {
+            const uint64_t l_number = get_varint(a_bytes, a_pos);
+
+            if(l_number >= l_shared.size() || !l_shared[l_number])
+                throw std::runtime_error(
+                    "decode_shared: invalid ref at offset " +
+                    std::to_string(l_offset));
+
+            l_result = a_builder.copy(l_shared[l_number]);
+        }
+        else
+            throw std::runtime_error("decode_shared: invalid tag at offset " +
+                                     std::to_string(l_offset));
+
+        while(true)
+        {
+            if(l_stack.empty())
+                return l_result;
+
+            pending& l_pending = l_stack.back();
+
+            if(l_pending.m_tag == shared_tag::app && !l_pending.m_partial)
+            {
+                l_pending.m_partial = std::move(l_result);
+                break;
+            }
+
+            if(l_pending.m_tag == shared_tag::share)
+                l_shared[l_pending.m_number] = a_builder.keep(l_result);
+            else if(l_pending.m_tag == shared_tag::func)
+                l_result = a_builder.make_func(std::move(l_result));
+            else
+                l_result = a_builder.make_app(std::move(l_pending.m_partial),
+                                              std::move(l_result));
+
+            l_stack.pop_back();
+        }
+    }
+}
+
+// builds full trees, refusing to grow past a size limit.
+struct tree_builder
+{
+    using value = std::unique_ptr<expr>;
+
+    value make_var(uint64_t a_index)
+    {
+        return count(v(a_index));
+    }
+
+    value make_func(value&& a_body)
+    {
+        return count(f(std::move(a_body)));
+    }
+
+    value make_app(value&& a_lhs, value&& a_rhs)
+    {
+        return count(a(std::move(a_lhs), std::move(a_rhs)));
+    }
+
+    // a copy to make refs from, which is not part of the tree
+    value keep(const value& a_value)
+    {
+        return a_value->clone();
+    }
+
+    value copy(const value& a_value)
+    {
+        if(a_value->m_size > m_max_size - m_size)
+            throw std::runtime_error("decode_shared: term too large");
+
+        m_size += a_value->m_size;
+
+        return a_value->clone();
+    }
+
+    value count(value&& a_value)
+    {
+        if(++m_size > m_max_size)
+            throw std::runtime_error("decode_shared: term too large");
+
+        return std::move(a_value);
+    }
+
+    size_t m_max_size;
+    // nodes in the tree so far
+    size_t m_size = 0;
+};
+
+// builds interned nodes; refs are the node itself.
+struct dag_builder
+{
+    using value = const interned*;
+
+    value make_var(uint64_t a_index)
+    {
+        return m_table.intern_var(a_index);
+    }
+
+    value make_func(value a_body)
+    {
+        return m_table.intern_func(a_body);
+    }
+
+    value make_app(value a_lhs, value a_rhs)
+    {
+        return m_table.intern_app(a_lhs, a_rhs);
+    }
+
+    value keep(value a_value)
+    {
+        return a_value;
+    }
+
+    value copy(value a_value)
+    {
+        return a_value;
+    }
+
+    intern_table& m_table;
+};
+
+// computes the size of the tree without building it, saturating at
+// SIZE_MAX. Sizes are never 0, so 0 is the null value.
+struct size_builder
+{
+    using value = size_t;
+
+    static size_t add(size_t a_lhs, size_t a_rhs)
+    {
+        return a_lhs > SIZE_MAX - a_rhs ? SIZE_MAX : a_lhs + a_rhs;
+    }
+
+    value make_var(uint64_t)
+    {
+        return 1;
+    }
+
+    value make_func(value a_body)
+    {
+        return add(1, a_body);
+    }
+
+    value make_app(value a_lhs, value a_rhs)
+    {
+        return add(1, add(a_lhs, a_rhs));
+    }
+
+    value keep(value a_value)
+    {
+        return a_value;
+    }
+
+    value copy(value a_value)
+    {
+        return a_value;
+    }
+};
+
+} // namespace
+
+void encode_shared(const expr& a_expr, std::string& a_out)
+{
+    graph_builder l_builder;
+    l_builder.graph().m_root = l_builder.add(a_expr);
+
+    shared_writer(l_builder.graph(), a_out).write(l_builder.graph().m_root);
+}
+
+void encode_shared(const interned* a_root, std::string& a_out)
+{
+    graph_builder l_builder;
+    l_builder.graph().m_root = l_builder.add(a_root);
+
+    shared_writer(l_builder.graph(), a_out).write(l_builder.graph().m_root);
+}
+
+std::unique_ptr<expr> decode_shared(std::string_view a_bytes, size_t& a_pos,
+                                    size_t a_max_size)
+{
+    tree_builder l_builder{a_max_size};
+
+    return decode_with(a_bytes, a_pos, l_builder);
+}
+
+const interned* decode_shared(std::string_view a_bytes, size_t& a_pos,
+                              intern_table& a_table)
+{
+    dag_builder l_builder{a_table};
+
+    return decode_with(a_bytes, a_pos, l_builder);
+}
+
+size_t shared_size(std::string_view a_bytes, size_t& a_pos)
+{
+    size_builder l_builder;
+
+    return decode_with(a_bytes, a_pos, l_builder);
+}
+
+// STREAMS
+
+// bytes read from a binary stream at a time, at least.
+static constexpr size_t READ_CHUNK = 1 << 16;
+
+term_reader::term_reader(std::istream& a_in, term_format a_format,
+                         size_t a_max_size)
+    : m_in(a_in), m_format(a_format), m_max_size(a_max_size), m_pos(0),
+      m_resumable(false)
+{
+}
+
+bool term_reader::resumable() const
+{
+    return m_resumable;
+}
+
+bool term_reader::fill()
+{
+    m_bytes.erase(0, m_pos);
+    m_pos = 0;
+
+    const size_t l_kept = m_bytes.size();
+    const size_t l_wanted = std::max(READ_CHUNK, l_kept);
+
+    m_bytes.resize(l_kept + l_wanted);
+    m_in.read(m_bytes.data() + l_kept, static_cast<std::streamsize>(l_wanted));
+    m_bytes.resize(l_kept + static_cast<size_t>(m_in.gcount()));
+
+    return m_bytes.size() > l_kept;
+}
+
+template <typename DECODE> auto term_reader::decode_buffered(DECODE&& a_decode)
+{
+    while(true)
+    {
+        const size_t l_start = m_pos;
+
+        try
+        {
+            return a_decode(std::string_view(m_bytes), m_pos);
+        }
+        catch(const std::runtime_error&)
+        {
+            // a decoder that stopped short of the end found a real error
+            if(m_pos < m_bytes.size())
+                throw;
+
+            m_pos = l_start;
+
+            if(!fill())
+                throw;
+        }
+    }
+}
+
+bool term_reader::next(std::unique_ptr<expr>& a_expr)
+{
+    m_resumable = false;
+
+    if(m_format != term_format::text)
+    {
+        if(m_pos == m_bytes.size() && !fill())
+            return false;
+
+        if(m_format == term_format::binary)
+        {
+            a_expr = decode_buffered([](std::string_view a_bytes, size_t& a_pos)
+                                     { return decode(a_bytes, a_pos); });
+            return true;
+        }
+
+        // the size of a shared term that is too large, once skipped
+        size_t l_skipped = 0;
+
+        a_expr = decode_buffered(
+            [this, &l_skipped](std::string_view a_bytes,
+                               size_t& a_pos) -> std::unique_ptr<expr>
+            {
+                const size_t l_start = a_pos;
+
+                try
+                {
+                    return decode_shared(a_bytes, a_pos, m_max_size);
+                }
+                catch(const std::runtime_error&)
+                {
+                    // a well-formed term that is only too large is skipped
+                    size_t l_end = l_start;
+
+                    try
+                    {
+                        l_skipped = shared_size(a_bytes, l_end);
+                    }
+                    catch(const std::runtime_error&)
+                    {
+                        a_pos = l_end;
+                        throw;
+                    }
+
+                    if(l_skipped <= m_max_size)
+                        throw;
+
+                    a_pos = l_end;
+
+                    return nullptr;
+                }
+            });
+
+        if(!a_expr)
+        {
+            m_resumable = true;
+            throw std::runtime_error("term_reader: term of " +
+                                     std::to_string(l_skipped) +
+                                     " nodes exceeds the size limit");
+        }
+
+        return true;
+    }
+
+    std::string l_line;
+
+    while(std::getline(m_in, l_line))
+    {
+        // skip blank lines
+        if(l_line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        // a bad line is consumed either way
+        m_resumable = true;
+        a_expr = parse(l_line);
+
+        return true;
+    }
+
+    return false;
+}
+
+void write_term(const expr& a_expr, term_format a_format, std::string& a_out)
+{
+    if(a_format == term_format::binary)
+    {
+        encode(a_expr, a_out);
+        return;
+    }
+
+    if(a_format == term_format::shared)
+    {
+        encode_shared(a_expr, a_out);
+        return;
+    }
+
+    std::ostringstream l_ss;
+    a_expr.print(l_ss);
+    a_out += l_ss.str();
+    a_out += '\n';
+}
+
+// VARINT HELPERS
+
+void put_varint(std::string& a_out, uint64_t a_value)
+{
+    while(a_value >= 0x80)
+    {
+        a_out.push_back(static_cast<char>((a_value & 0x7f) | 0x80));
+        a_value >>= 7;
+    }
+
+    a_out.push_back(static_cast<char>(a_value));
+}
+
+uint64_t get_varint(std::string_view a_bytes, size_t& a_pos)
+{
+    uint64_t l_value = 0;
+
+    for(size_t l_shift = 0; l_shift < 64; l_shift += 7)
+    {
+        if(a_pos >= a_bytes.size())
+            throw std::runtime_error("decode: truncated varint");
+
+        const uint8_t l_byte = static_cast<uint8_t>(a_bytes[a_pos++]);
+
+        l_value |= static_cast<uint64_t>(l_byte & 0x7f) << l_shift;
+
+        if(!(l_byte & 0x80))
+            return l_value;
+    }
+
+    throw std::runtime_error("decode: varint too long");
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <sstream>
+
+using namespace lambda;
+
+void test_parse()
+{
+    // var
+    {
+        assert(parse("0")->equals(v(0)));
+        assert(parse("  42 ")->equals(v(42)));
+    }
+
+    // func
+    {
+        assert(parse("λ.(0)")->equals(f(v(0))));
+        assert(parse("\\.(0)")->equals(f(v(0))));
+        assert(parse("λ . ( λ.(1) )")->equals(f(f(v(1)))));
+    }
+
+    // app
+    {
+        assert(parse("(0 1)")->equals(a(v(0), v(1))));
+        assert(parse("((λ.(0) 5) (2 3))")
+                   ->equals(a(a(f(v(0)), v(5)), a(v(2), v(3)))));
+    }
+
+    // round trip through print()
+    {
+        auto l_expr = f(f(f(a(a(v(0), v(2)), a(v(1), v(2))))));
+        std::stringstream l_ss;
+        l_expr->print(l_ss);
+        assert(parse(l_ss.str())->equals(l_expr));
+    }
+
+    // several expressions in one buffer
+    {
+        const std::string l_text = "λ.(0) (1 2)\n7";
+        size_t l_pos = 0;
+        assert(parse(l_text, l_pos)->equals(f(v(0))));
+        assert(parse(l_text, l_pos)->equals(a(v(1), v(2))));
+        assert(parse(l_text, l_pos)->equals(v(7)));
+    }
+
+    // deep nesting does not recurse
+    {
+        std::string l_text;
+        for(size_t i = 0; i < 10000; ++i)
+            l_text += "λ.(";
+        l_text += "0";
+        l_text += std::string(10000, ')');
+        auto l_expr = parse(l_text);
+        assert(l_expr->m_size == 10001);
+    }
+
+    // malformed input
+    {
+        assert_throws(parse(""), std::runtime_error);
+        assert_throws(parse("λ.0"), std::runtime_error);
+        assert_throws(parse("(0 1"), std::runtime_error);
+        assert_throws(parse("(0)"), std::runtime_error);
+        assert_throws(parse("0 1"), std::runtime_error);
+        assert_throws(parse("x"), std::runtime_error);
+        assert_throws(parse("99999999999999999999999"), std::runtime_error);
+    }
+}
+
+void test_encode_decode()
+{
+    // var encoding is a tag and a varint
+    {
+        std::string l_bytes;
+        encode(*v(300), l_bytes);
+        assert(l_bytes.size() == 3);
+        assert(l_bytes[0] == static_cast<char>(node_tag::var));
+    }
+
+    // round trips
+    {
+        std::vector<std::unique_ptr<expr>> l_exprs;
+        l_exprs.push_back(v(0));
+        l_exprs.push_back(f(v(0)));
+        l_exprs.push_back(a(f(v(0)), v(5)));
+        l_exprs.push_back(f(f(f(a(a(v(0), v(2)), a(v(1), v(2)))))));
+        l_exprs.push_back(a(v(1ull << 40), f(a(v(127), v(128)))));
+
+        std::string l_bytes;
+        for(const auto& l_expr : l_exprs)
+            encode(*l_expr, l_bytes);
+
+        size_t l_pos = 0;
+        for(const auto& l_expr : l_exprs)
+            assert(decode(l_bytes, l_pos)->equals(l_expr));
+        assert(l_pos == l_bytes.size());
+    }
+
+    // malformed input
+    {
+        std::string l_bytes;
+        encode(*a(v(0), v(1)), l_bytes);
+
+        size_t l_pos = 0;
+        assert_throws(decode(std::string_view(l_bytes).substr(0, 3), l_pos),
+                      std::runtime_error);
+
+        l_pos = 0;
+        assert_throws(decode("\x07", l_pos), std::runtime_error);
+
+        l_pos = 0;
+        assert_throws(decode(std::string_view("\x00\x80", 2), l_pos),
+                      std::runtime_error);
+    }
+}
+
+void test_encode_decode_shared()
+{
+    // a term of 174761 nodes with 25 distinct subterms
+    auto l_doubled = v(3);
+
+    for(size_t i = 0; i < 16; ++i)
+        l_doubled = i % 2 ? a(l_doubled->clone(), l_doubled->clone())
+                          : f(a(l_doubled->clone(), l_doubled->clone()));
+
+    // repeats are written once
+    {
+        std::string l_bytes;
+        encode_shared(*l_doubled, l_bytes);
+        assert(l_bytes.size() < 100);
+
+        std::string l_plain;
+        encode(*l_doubled, l_plain);
+        assert(l_plain.size() > 100000);
+
+        size_t l_pos = 0;
+        assert(decode_shared(l_bytes, l_pos)->equals(l_doubled));
+        assert(l_pos == l_bytes.size());
+
+        // or into a table, still shared
+        intern_table l_table;
+        l_pos = 0;
+        const interned* l_root = decode_shared(l_bytes, l_pos, l_table);
+        assert(l_root->m_size == l_doubled->m_size);
+        assert(l_table.size() == 25);
+        assert(materialize(l_root)->equals(l_doubled));
+
+        // and written back from it without expanding it
+        std::string l_again;
+        encode_shared(l_root, l_again);
+        assert(l_again == l_bytes);
+    }
+
+    // a pair of a doubled term: (λ.((0 0) 0) ...) shares the inner app
+    {
+        auto l_expr = a(f(a(a(v(0), v(0)), a(v(0), v(0)))), v(1));
+        std::string l_bytes;
+        encode_shared(*l_expr, l_bytes);
+
+        const std::string l_expected = {
+            char(shared_tag::app),   char(shared_tag::func),
+            char(shared_tag::app),   char(shared_tag::share),
+            char(shared_tag::app),   char(shared_tag::var),
+            0,                       char(shared_tag::var),
+            0,                       char(shared_tag::ref),
+            0,                       char(shared_tag::var),
+            1};
+        assert(l_bytes == l_expected);
+    }
+
+    // terms without repeats are as encode() writes them, and encode()
+    // output is valid shared input
+    {
+        std::vector<std::unique_ptr<expr>> l_exprs;
+        l_exprs.push_back(v(0));
+        l_exprs.push_back(a(f(v(0)), v(5)));
+        l_exprs.push_back(f(f(f(a(a(v(0), v(2)), a(v(1), v(2)))))));
+        l_exprs.push_back(a(v(1ull << 40), f(a(v(127), v(128)))));
+
+        for(const auto& l_expr : l_exprs)
+        {
+            std::string l_shared;
+            std::string l_plain;
+            encode_shared(*l_expr, l_shared);
+            encode(*l_expr, l_plain);
+            assert(l_shared == l_plain);
+
+            size_t l_pos = 0;
+            assert(decode_shared(l_plain, l_pos)->equals(l_expr));
+        }
+    }
+
+    // the size limit
+    {
+        std::string l_bytes;
+        encode_shared(*l_doubled, l_bytes);
+
+        size_t l_pos = 0;
+        assert(decode_shared(l_bytes, l_pos, l_doubled->m_size)
+                   ->equals(l_doubled));
+
+        l_pos = 0;
+        assert_throws(decode_shared(l_bytes, l_pos, l_doubled->m_size - 1),
+                      std::runtime_error);
+    }
+
+    // malformed input
+    {
+        size_t l_pos = 0;
+
+        // ref to nothing
+        assert_throws(decode_shared(std::string_view("\x03\x00", 2), l_pos),
+                      std::runtime_error);
+
+        // ref to the node still being decoded
+        l_pos = 0;
+        assert_throws(
+            decode_shared(std::string_view("\x04\x02\x03\x00\x00\x00", 6),
+                          l_pos),
+            std::runtime_error);
+
+        // share of a ref
+        l_pos = 0;
+        const std::string_view l_share_ref("\x02\x04\x01\x00\x00\x04\x03\x00",
+                                           8);
+        assert_throws(decode_shared(l_share_ref, l_pos), std::runtime_error);
+
+        l_pos = 0;
+        assert_throws(decode_shared("\x07", l_pos), std::runtime_error);
+
+        l_pos = 0;
+        assert_throws(decode_shared(std::string_view("\x04\x02", 2), l_pos),
+                      std::runtime_error);
+    }
+}
+
+void test_term_reader()
+{
+    // text: one term per line, blank lines skipped, bad lines reported
+    {
+        std::istringstream l_in("λ.(0)\n\n  (1 2)\n(3\n4\n");
+        term_reader l_reader(l_in, term_format::text);
+        std::unique_ptr<expr> l_expr;
+
+        assert(l_reader.next(l_expr) && l_expr->equals(f(v(0))));
+        assert(l_reader.next(l_expr) && l_expr->equals(a(v(1), v(2))));
+        assert_throws(l_reader.next(l_expr), std::runtime_error);
+        assert(l_reader.next(l_expr) && l_expr->equals(v(4)));
+        assert(!l_reader.next(l_expr));
+    }
+
+    // binary round trip through write_term
+    {
+        std::string l_bytes;
+        write_term(*f(v(0)), term_format::binary, l_bytes);
+        write_term(*a(v(1), v(2)), term_format::binary, l_bytes);
+
+        std::istringstream l_in(l_bytes);
+        term_reader l_reader(l_in, term_format::binary);
+        std::unique_ptr<expr> l_expr;
+
+        assert(l_reader.next(l_expr) && l_expr->equals(f(v(0))));
+        assert(l_reader.next(l_expr) && l_expr->equals(a(v(1), v(2))));
+        assert(!l_reader.next(l_expr));
+    }
+
+    // shared round trip through write_term; numbers restart with each term
+    {
+        std::string l_bytes;
+        write_term(*a(f(v(0)), f(v(0))), term_format::shared, l_bytes);
+        write_term(*a(f(v(1)), f(v(1))), term_format::shared, l_bytes);
+
+        std::istringstream l_in(l_bytes);
+        term_reader l_reader(l_in, term_format::shared);
+        std::unique_ptr<expr> l_expr;
+
+        assert(l_reader.next(l_expr) && l_expr->equals(a(f(v(0)), f(v(0)))));
+        assert(l_reader.next(l_expr) && l_expr->equals(a(f(v(1)), f(v(1)))));
+        assert(!l_reader.next(l_expr));
+    }
+
+    // terms that straddle refills, and one larger than any single read
+    {
+        std::string l_bytes;
+        // a balanced tree of 2^16 leaves, some 200KB encoded
+        std::vector<std::unique_ptr<expr>> l_level;
+
+        for(size_t i = 0; i < (size_t(1) << 16); ++i)
+            l_level.push_back(v(i % 200));
+
+        while(l_level.size() > 1)
+        {
+            std::vector<std::unique_ptr<expr>> l_next;
+
+            for(size_t i = 0; i < l_level.size(); i += 2)
+                l_next.push_back(
+                    a(std::move(l_level[i]), std::move(l_level[i + 1])));
+
+            l_level = std::move(l_next);
+        }
+
+        const std::unique_ptr<expr> l_large = std::move(l_level[0]);
+
+        for(size_t i = 0; i < 30000; ++i)
+            write_term(*f(v(i)), term_format::binary, l_bytes);
+
+        write_term(*l_large, term_format::binary, l_bytes);
+        write_term(*v(5), term_format::binary, l_bytes);
+
+        std::istringstream l_in(l_bytes);
+        term_reader l_reader(l_in, term_format::binary);
+        std::unique_ptr<expr> l_expr;
+
+        for(size_t i = 0; i < 30000; ++i)
+            assert(l_reader.next(l_expr) && l_expr->equals(f(v(i))));
+
+        assert(l_reader.next(l_expr) && l_expr->equals(l_large));
+        assert(l_reader.next(l_expr) && l_expr->equals(v(5)));
+        assert(!l_reader.next(l_expr));
+    }
+
+    // a term cut short by the end of the stream
+    {
+        std::string l_bytes;
+        write_term(*a(v(1), v(2)), term_format::binary, l_bytes);
+        l_bytes.pop_back();
+
+        std::istringstream l_in(l_bytes);
+        term_reader l_reader(l_in, term_format::binary);
+        std::unique_ptr<expr> l_expr;
+
+        assert_throws(l_reader.next(l_expr), std::runtime_error);
+    }
+
+    // shared terms are not expanded beyond the reader's size limit
+    {
+        std::string l_bytes;
+        write_term(*a(f(v(0)), v(1)), term_format::shared, l_bytes);
+        write_term(*a(f(v(0)), f(v(0))), term_format::shared, l_bytes);
+        write_term(*v(2), term_format::shared, l_bytes);
+
+        std::istringstream l_in(l_bytes);
+        term_reader l_reader(l_in, term_format::shared, 4);
+        std::unique_ptr<expr> l_expr;
+
+        assert(l_reader.next(l_expr) && l_expr->equals(a(f(v(0)), v(1))));
+        // the oversized term is skipped, and reading goes on after it
+        assert_throws(l_reader.next(l_expr), std::runtime_error);
+        assert(l_reader.resumable());
+        assert(l_reader.next(l_expr) && l_expr->equals(v(2)));
+        assert(!l_reader.next(l_expr));
+    }
+
+    // a malformed shared term cannot be skipped
+    {
+        std::istringstream l_in(std::string("\x02\x00\x00\x07", 4));
+        term_reader l_reader(l_in, term_format::shared);
+        std::unique_ptr<expr> l_expr;
+
+        assert_throws(l_reader.next(l_expr), std::runtime_error);
+        assert(!l_reader.resumable());
+    }
+
+    // the size of a shared term without expanding it
+    {
+        std::string l_bytes;
+        encode_shared(*a(a(f(v(0)), f(v(0))), a(f(v(0)), f(v(0)))), l_bytes);
+
+        size_t l_pos = 0;
+        assert(shared_size(l_bytes, l_pos) == 11);
+        assert(l_pos == l_bytes.size());
+    }
+
+    // text output is newline terminated
+    {
+        std::string l_text;
+        write_term(*a(f(v(0)), v(1)), term_format::text, l_text);
+        assert(l_text == "(λ.(0) 1)\n");
+    }
+}
+
+void serialize_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_parse);
+    TEST(test_encode_decode);
+    TEST(test_encode_decode_shared);
+    TEST(test_term_reader);
+}
+
+#endif
@@ -0,0 +1,965 @@
+#include "../include/server.hpp"
+#include "../include/serialize.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace lambda
+{
+
+// PROTOCOL
+
+static void put_u32(std::string& a_out, uint32_t a_value)
+{
+    for(size_t i = 0; i < 4; ++i)
+        a_out.push_back(static_cast<char>(a_value >> (8 * i)));
+}
+
+static void put_u64(std::string& a_out, uint64_t a_value)
+{
+    for(size_t i = 0; i < 8; ++i)
+        a_out.push_back(static_cast<char>(a_value >> (8 * i)));
+}
+
+static uint64_t get_uint(std::string_view a_bytes, size_t& a_pos,
+                         size_t a_width)
+{
+    if(a_bytes.size() - a_pos < a_width)
+        throw std::runtime_error("decode_frame: truncated payload");
+
+    uint64_t l_value = 0;
+
+    for(size_t i = 0; i < a_width; ++i)
+        l_value |= static_cast<uint64_t>(static_cast<uint8_t>(a_bytes[a_pos++]))
+                   << (8 * i);
+
+    return l_value;
+}
+
+// writes the length prefix of the frame whose payload starts at
+// a_payload_begin, once the payload has been appended. A payload over
+// a_max_payload is taken back out before throwing.
+static void finish_frame(std::string& a_out, size_t a_payload_begin,
+                         size_t a_max_payload = MAX_FRAME_SIZE)
+{
+    const size_t l_length = a_out.size() - a_payload_begin;
+
+    if(l_length > a_max_payload)
+    {
+        a_out.resize(a_payload_begin - 4);
+        throw std::runtime_error("encode_frame: payload too large");
+    }
+
+    std::string l_prefix;
+    put_u32(l_prefix, static_cast<uint32_t>(l_length));
+    a_out.replace(a_payload_begin - 4, 4, l_prefix);
+}
+
+// locates the payload of the frame starting at a_pos, if it is complete.
+static bool next_payload(std::string_view a_bytes, size_t& a_pos,
+                         std::string_view& a_payload)
+{
+    if(a_bytes.size() - a_pos < 4)
+        return false;
+
+    size_t l_pos = a_pos;
+    const size_t l_length = get_uint(a_bytes, l_pos, 4);
+
+    if(l_length > MAX_FRAME_SIZE)
+        throw std::runtime_error("decode_frame: payload too large");
+
+    if(a_bytes.size() - l_pos < l_length)
+        return false;
+
+    a_payload = a_bytes.substr(l_pos, l_length);
+    a_pos = l_pos + l_length;
+
+    return true;
+}
+
+void encode_frame(const request& a_request, std::string& a_out)
+{
+    a_out.append(4, '\0');
+    const size_t l_begin = a_out.size();
+
+    put_u64(a_out, a_request.m_id);
+    a_out.push_back(static_cast<char>(a_request.m_format));
+    put_u64(a_out, a_request.m_budget.m_max_steps);
+    put_u64(a_out, a_request.m_budget.m_max_size);
+    put_u64(a_out, a_request.m_budget.m_max_time.count());
+    a_out.append(a_request.m_term);
+
+    finish_frame(a_out, l_begin);
+}
+
+void encode_frame(const response& a_response, std::string& a_out,
+                  size_t a_max_payload)
+{
+    a_out.append(4, '\0');
+    const size_t l_begin = a_out.size();
+
+    put_u64(a_out, a_response.m_id);
+    a_out.push_back(static_cast<char>(a_response.m_status));
+    put_u64(a_out, a_response.m_steps);
+    put_u64(a_out, a_response.m_max_size);
+    put_u64(a_out, a_response.m_size);
+    put_u64(a_out, a_response.m_elapsed.count());
+    a_out.append(a_response.m_term);
+
+    finish_frame(a_out, l_begin, a_max_payload);
+}
+
+bool decode_frame(std::string_view a_bytes, size_t& a_pos,
+                  request& a_request)
+{
+    std::string_view l_payload;
+
+    if(!next_payload(a_bytes, a_pos, l_payload))
+        return false;
+
+    size_t l_pos = 0;
+
+    a_request.m_id = get_uint(l_payload, l_pos, 8);
+
+    const uint64_t l_format = get_uint(l_payload, l_pos, 1);
+
+    if(l_format > static_cast<uint64_t>(term_format::shared))
+        throw std::runtime_error("decode_frame: invalid term format");
+
+    a_request.m_format = static_cast<term_format>(l_format);
+    a_request.m_budget.m_max_steps = get_uint(l_payload, l_pos, 8);
+    a_request.m_budget.m_max_size = get_uint(l_payload, l_pos, 8);
+    a_request.m_budget.m_max_time =
+        std::chrono::nanoseconds(get_uint(l_payload, l_pos, 8));
+    a_request.m_term = l_payload.substr(l_pos);
+
+    return true;
+}
+
+bool decode_frame(std::string_view a_bytes, size_t& a_pos,
+                  response& a_response)
+{
+    std::string_view l_payload;
+
+    if(!next_payload(a_bytes, a_pos, l_payload))
+        return false;
+
+    size_t l_pos = 0;
+
+    a_response.m_id = get_uint(l_payload, l_pos, 8);
+
+    const uint64_t l_status = get_uint(l_payload, l_pos, 1);
+
+    if(l_status > static_cast<uint64_t>(response_status::bad_request))
+        throw std::runtime_error("decode_frame: invalid response status");
+
+    a_response.m_status = static_cast<response_status>(l_status);
+    a_response.m_steps = get_uint(l_payload, l_pos, 8);
+    a_response.m_max_size = get_uint(l_payload, l_pos, 8);
+    a_response.m_size = get_uint(l_payload, l_pos, 8);
+    a_response.m_elapsed =
+        std::chrono::nanoseconds(get_uint(l_payload, l_pos, 8));
+    a_response.m_term = l_payload.substr(l_pos);
+
+    return true;
+}
+
+budget clamp_budget(const budget& a_budget, const budget& a_limit)
+{
+    budget l_result;
+    l_result.m_max_steps = std::min(a_budget.m_max_steps, a_limit.m_max_steps);
+    l_result.m_max_size = std::min(a_budget.m_max_size, a_limit.m_max_size);
+    l_result.m_max_time = std::min(a_budget.m_max_time, a_limit.m_max_time);
+
+    return l_result;
+}
+
+response evaluate(const request& a_request, const budget& a_limit)
+{
+    const budget l_budget = clamp_budget(a_request.m_budget, a_limit);
+
+    response l_response;
+    l_response.m_id = a_request.m_id;
+
+    std::unique_ptr<expr> l_expr;
+
+    try
+    {
+        if(a_request.m_format == term_format::text)
+        {
+            l_expr = parse(a_request.m_term);
+        }
+        else
+        {
+            size_t l_pos = 0;
+            l_expr = a_request.m_format == term_format::binary
+                         ? decode(a_request.m_term, l_pos)
+                         : decode_shared(a_request.m_term, l_pos,
+                                         l_budget.m_max_size);
+
+            if(l_pos != a_request.m_term.size())
+                throw std::runtime_error("decode: trailing bytes");
+        }
+    }
+    catch(const std::runtime_error& l_error)
+    {
+        l_response.m_status = response_status::bad_request;
+        l_response.m_term = l_error.what();
+        return l_response;
+    }
+
+    const normalize_stats l_stats = normalize(l_expr, l_budget);
+
+    l_response.m_status = static_cast<response_status>(l_stats.m_status);
+    l_response.m_steps = l_stats.m_steps;
+    l_response.m_max_size = l_stats.m_max_size;
+    l_response.m_size = l_expr->m_size;
+    l_response.m_elapsed = l_stats.m_elapsed;
+
+    if(a_request.m_format == term_format::text)
+    {
+        std::ostringstream l_ss;
+        l_expr->print(l_ss);
+        l_response.m_term = l_ss.str();
+    }
+    else if(a_request.m_format == term_format::binary)
+    {
+        encode(*l_expr, l_response.m_term);
+    }
+    else
+    {
+        encode_shared(*l_expr, l_response.m_term);
+    }
+
+    return l_response;
+}
+
+std::string respond(const request& a_request, const budget& a_limit,
+                    size_t a_max_payload)
+{
+    std::string l_frame;
+
+    try
+    {
+        encode_frame(evaluate(a_request, a_limit), l_frame, a_max_payload);
+    }
+    catch(const std::exception& l_error)
+    {
+        response l_response;
+        l_response.m_id = a_request.m_id;
+        l_response.m_status = response_status::bad_request;
+        l_response.m_term = l_error.what();
+
+        l_frame.clear();
+        encode_frame(l_response, l_frame);
+    }
+
+    return l_frame;
+}
+
+// SERVER
+
+// bytes requested from the kernel per read().
+static constexpr size_t READ_CHUNK = 1 << 16;
+
+// a connection stops being read while this many of its requests are queued
+// or running, or while this many response bytes wait to be written.
+static constexpr size_t MAX_IN_FLIGHT = 4096;
+static constexpr size_t MAX_PENDING_OUTPUT = 1 << 24;
+
+struct server::connection
+{
+    explicit connection(int a_fd) : m_fd(a_fd)
+    {
+    }
+
+    ~connection()
+    {
+        ::close(m_fd);
+    }
+
+    int m_fd;
+    // bytes received but not yet decoded
+    std::string m_in;
+    // bytes ready to be written
+    std::string m_out;
+    // requests handed to the pool whose responses are not yet in m_out
+    size_t m_in_flight = 0;
+    // the peer has shut down its sending side
+    bool m_peer_closed = false;
+
+    // responses finished by workers, waiting to be moved into m_out
+    std::mutex m_mutex;
+    std::string m_completed;
+    size_t m_completed_count = 0;
+};
+
+static void set_nonblocking(int a_fd)
+{
+    const int l_flags = ::fcntl(a_fd, F_GETFL, 0);
+    ::fcntl(a_fd, F_SETFL, l_flags | O_NONBLOCK);
+}
+
+static sockaddr_un socket_address(const std::string& a_socket_path)
+{
+    sockaddr_un l_address{};
+    l_address.sun_family = AF_UNIX;
+
+    if(a_socket_path.size() >= sizeof(l_address.sun_path))
+        throw std::runtime_error("socket path too long: " + a_socket_path);
+
+    std::memcpy(l_address.sun_path, a_socket_path.c_str(),
+                a_socket_path.size() + 1);
+
+    return l_address;
+}
+
+server::server(const std::string& a_socket_path, size_t a_worker_count,
+               const budget& a_max_budget)
+    : m_socket_path(a_socket_path), m_max_budget(a_max_budget),
+      m_listen_fd(-1), m_wake_fds{-1, -1}, m_stopping(false),
+      m_pool(a_worker_count)
+{
+    const sockaddr_un l_address = socket_address(a_socket_path);
+
+    m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(m_listen_fd < 0)
+        throw std::runtime_error("server: socket() failed: " +
+                                 std::string(std::strerror(errno)));
+
+    ::unlink(a_socket_path.c_str());
+
+    if(::bind(m_listen_fd, reinterpret_cast<const sockaddr*>(&l_address),
+              sizeof(l_address)) < 0 ||
+       ::listen(m_listen_fd, SOMAXCONN) < 0 || ::pipe(m_wake_fds) < 0)
+    {
+        const std::string l_error = std::strerror(errno);
+        ::close(m_listen_fd);
+        throw std::runtime_error("server: cannot listen on " + a_socket_path +
+                                 ": " + l_error);
+    }
+
+    set_nonblocking(m_listen_fd);
+    set_nonblocking(m_wake_fds[0]);
+    set_nonblocking(m_wake_fds[1]);
+}
+
+server::~server()
+{
+    // workers signal the wake pipe when they finish, so it must outlive them
+    m_pool.wait_idle();
+    m_connections.clear();
+
+    ::close(m_listen_fd);
+    ::close(m_wake_fds[0]);
+    ::close(m_wake_fds[1]);
+    ::unlink(m_socket_path.c_str());
+}
+
+void server::run()
+{
+    std::vector<pollfd> l_fds;
+
+    while(!m_stopping)
+    {
+        l_fds.clear();
+        l_fds.push_back({m_wake_fds[0], POLLIN, 0});
+        l_fds.push_back({m_listen_fd, POLLIN, 0});
+
+        for(const auto& l_connection : m_connections)
+        {
+            short l_events = 0;
+
+            // apply back-pressure by not reading from busy connections
+            if(!l_connection->m_peer_closed &&
+               l_connection->m_in_flight < MAX_IN_FLIGHT &&
+               l_connection->m_out.size() < MAX_PENDING_OUTPUT)
+                l_events |= POLLIN;
+
+            if(!l_connection->m_out.empty())
+                l_events |= POLLOUT;
+
+            // a hung-up peer keeps reporting POLLHUP, so only watch it again
+            // once there is something to write
+            const int l_fd =
+                l_connection->m_peer_closed && l_events == 0 ? -1
+                                                             : l_connection->m_fd;
+
+            l_fds.push_back({l_fd, l_events, 0});
+        }
+
+        if(::poll(l_fds.data(), l_fds.size(), -1) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            throw std::runtime_error("server: poll() failed: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        if(l_fds[0].revents & POLLIN)
+        {
+            char l_drain[256];
+            while(::read(m_wake_fds[0], l_drain, sizeof(l_drain)) > 0)
+                ;
+        }
+
+        // every connection is serviced on each wakeup, since finished
+        // responses are announced through the shared wake pipe
+        std::vector<std::shared_ptr<connection>> l_alive;
+
+        for(size_t i = 0; i < m_connections.size(); ++i)
+            if(service(m_connections[i], l_fds[i + 2].revents))
+                l_alive.push_back(std::move(m_connections[i]));
+
+        m_connections = std::move(l_alive);
+
+        if(l_fds[1].revents & POLLIN)
+            accept_connections();
+    }
+}
+
+void server::stop()
+{
+    m_stopping = true;
+    wake();
+}
+
+void server::wake()
+{
+    const char l_byte = 0;
+    // a full pipe already guarantees a wakeup, so the result is ignored
+    [[maybe_unused]] ssize_t l_written = ::write(m_wake_fds[1], &l_byte, 1);
+}
+
+void server::accept_connections()
+{
+    while(true)
+    {
+        const int l_fd = ::accept(m_listen_fd, nullptr, nullptr);
+
+        if(l_fd < 0)
+            return;
+
+        set_nonblocking(l_fd);
+        m_connections.push_back(std::make_shared<connection>(l_fd));
+    }
+}
+
+bool server::service(const std::shared_ptr<connection>& a_connection,
+                     short a_revents)
+{
+    connection& l_connection = *a_connection;
+
+    if(a_revents & (POLLERR | POLLNVAL))
+        return false;
+
+    // read everything available
+    if(a_revents & (POLLIN | POLLHUP))
+    {
+        char l_buffer[READ_CHUNK];
+
+        while(true)
+        {
+            const ssize_t l_read = ::read(l_connection.m_fd, l_buffer,
+                                          sizeof(l_buffer));
+
+            if(l_read > 0)
+            {
+                l_connection.m_in.append(l_buffer, l_read);
+                continue;
+            }
+
+            if(l_read == 0)
+                l_connection.m_peer_closed = true;
+            else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                return false;
+
+            break;
+        }
+    }
+
+    // collect finished responses into a single write
+    {
+        std::lock_guard<std::mutex> l_lock(l_connection.m_mutex);
+        l_connection.m_out.append(l_connection.m_completed);
+        l_connection.m_in_flight -= l_connection.m_completed_count;
+        l_connection.m_completed.clear();
+        l_connection.m_completed_count = 0;
+    }
+
+    // decode complete frames until the connection has its share of the pool;
+    // the rest wait in m_in until responses come back
+    if(l_connection.m_in_flight < MAX_IN_FLIGHT)
+    {
+        size_t l_pos = 0;
+        request l_request;
+
+        try
+        {
+            while(l_connection.m_in_flight < MAX_IN_FLIGHT &&
+                  decode_frame(l_connection.m_in, l_pos, l_request))
+            {
+                ++l_connection.m_in_flight;
+
+                m_pool.submit(
+                    [this, a_connection, l_request = std::move(l_request)]
+                    {
+                        const std::string l_frame =
+                            respond(l_request, m_max_budget);
+
+                        {
+                            std::lock_guard<std::mutex> l_lock(
+                                a_connection->m_mutex);
+                            a_connection->m_completed.append(l_frame);
+                            ++a_connection->m_completed_count;
+                        }
+
+                        wake();
+                    });
+            }
+        }
+        catch(const std::runtime_error&)
+        {
+            // a malformed frame leaves the stream unsynchronized
+            return false;
+        }
+
+        l_connection.m_in.erase(0, l_pos);
+    }
+
+    if(!l_connection.m_out.empty())
+    {
+        const ssize_t l_written =
+            ::send(l_connection.m_fd, l_connection.m_out.data(),
+                   l_connection.m_out.size(), MSG_NOSIGNAL);
+
+        if(l_written > 0)
+            l_connection.m_out.erase(0, l_written);
+        else if(l_written < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                errno != EINTR)
+            return false;
+    }
+
+    // keep half-closed connections until their responses are delivered
+    return !(l_connection.m_peer_closed && l_connection.m_in_flight == 0 &&
+             l_connection.m_out.empty());
+}
+
+// CLIENT
+
+client::client(const std::string& a_socket_path) : m_fd(-1)
+{
+    const sockaddr_un l_address = socket_address(a_socket_path);
+
+    m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(m_fd < 0 ||
+       ::connect(m_fd, reinterpret_cast<const sockaddr*>(&l_address),
+                 sizeof(l_address)) < 0)
+    {
+        const std::string l_error = std::strerror(errno);
+        if(m_fd >= 0)
+            ::close(m_fd);
+        throw std::runtime_error("client: cannot connect to " + a_socket_path +
+                                 ": " + l_error);
+    }
+}
+
+client::~client()
+{
+    ::close(m_fd);
+}
+
+void client::submit(const request& a_request)
+{
+    encode_frame(a_request, m_out);
+}
+
+void client::flush()
+{
+    size_t l_pos = 0;
+
+    while(l_pos < m_out.size())
+    {
+        // keep draining responses while writing, otherwise a large batch
+        // could fill both socket buffers and stall both sides
+        pollfd l_fd{m_fd, POLLIN | POLLOUT, 0};
+
+        if(::poll(&l_fd, 1, -1) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw std::runtime_error("client: poll() failed: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        if((l_fd.revents & POLLIN) && !read_some())
+            throw std::runtime_error("client: connection closed by server");
+
+        if(l_fd.revents & POLLOUT)
+        {
+            const ssize_t l_written =
+                ::send(m_fd, m_out.data() + l_pos, m_out.size() - l_pos,
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+
+            if(l_written > 0)
+                l_pos += l_written;
+            else if(l_written < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                    errno != EINTR)
+                throw std::runtime_error("client: send() failed: " +
+                                         std::string(std::strerror(errno)));
+        }
+    }
+
+    m_out.clear();
+}
+
+response client::receive()
+{
+    flush();
+
+    response l_response;
+
+    while(true)
+    {
+        size_t l_pos = 0;
+
+        if(decode_frame(m_in, l_pos, l_response))
+        {
+            m_in.erase(0, l_pos);
+            return l_response;
+        }
+
+        if(!read_some())
+            throw std::runtime_error("client: connection closed by server");
+    }
+}
+
+bool client::read_some()
+{
+    char l_buffer[READ_CHUNK];
+
+    while(true)
+    {
+        const ssize_t l_read = ::recv(m_fd, l_buffer, sizeof(l_buffer), 0);
+
+        if(l_read > 0)
+        {
+            m_in.append(l_buffer, l_read);
+            return true;
+        }
+
+        if(l_read == 0)
+            return false;
+
+        if(errno != EINTR)
+            throw std::runtime_error("client: recv() failed: " +
+                                     std::string(std::strerror(errno)));
+    }
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../include/serialize.hpp"
+#include "../testing/test_utils.hpp"
+#include <algorithm>
+#include <thread>
+
+using namespace lambda;
+
+void test_protocol_frames()
+{
+    // request round trip, split across two buffers
+    {
+        request l_request;
+        l_request.m_id = 42;
+        l_request.m_format = term_format::binary;
+        l_request.m_budget.m_max_steps = 7;
+        l_request.m_budget.m_max_size = 1000;
+        l_request.m_budget.m_max_time = std::chrono::milliseconds(5);
+        encode(*a(f(v(0)), v(5)), l_request.m_term);
+
+        std::string l_bytes;
+        encode_frame(l_request, l_bytes);
+
+        request l_decoded;
+        size_t l_pos = 0;
+        assert(!decode_frame(std::string_view(l_bytes).substr(0, 10), l_pos,
+                             l_decoded));
+        assert(l_pos == 0);
+        assert(decode_frame(l_bytes, l_pos, l_decoded));
+        assert(l_pos == l_bytes.size());
+        assert(l_decoded.m_id == 42);
+        assert(l_decoded.m_format == term_format::binary);
+        assert(l_decoded.m_budget.m_max_steps == 7);
+        assert(l_decoded.m_budget.m_max_size == 1000);
+        assert(l_decoded.m_budget.m_max_time == std::chrono::milliseconds(5));
+        assert(l_decoded.m_term == l_request.m_term);
+    }
+
+    // several responses in one buffer
+    {
+        std::string l_bytes;
+        for(uint64_t i = 0; i < 3; ++i)
+        {
+            response l_response;
+            l_response.m_id = i;
+            l_response.m_status = response_status::step_limit;
+            l_response.m_steps = 10 * i;
+            l_response.m_term = "λ.(0)";
+            encode_frame(l_response, l_bytes);
+        }
+
+        size_t l_pos = 0;
+        response l_decoded;
+        for(uint64_t i = 0; i < 3; ++i)
+        {
+            assert(decode_frame(l_bytes, l_pos, l_decoded));
+            assert(l_decoded.m_id == i);
+            assert(l_decoded.m_status == response_status::step_limit);
+            assert(l_decoded.m_steps == 10 * i);
+            assert(l_decoded.m_term == "λ.(0)");
+        }
+        assert(!decode_frame(l_bytes, l_pos, l_decoded));
+    }
+}
+
+void test_evaluate()
+{
+    // text
+    {
+        request l_request;
+        l_request.m_term = "((λ.(λ.(0)) 7) 8)";
+        response l_response = evaluate(l_request);
+        assert(l_response.m_status == response_status::normal_form);
+        assert(l_response.m_term == "7");
+        assert(l_response.m_steps == 2);
+        assert(l_response.m_size == 1);
+    }
+
+    // binary
+    {
+        request l_request;
+        l_request.m_format = term_format::binary;
+        encode(*a(f(v(0)), f(v(1))), l_request.m_term);
+        response l_response = evaluate(l_request);
+        assert(l_response.m_status == response_status::normal_form);
+        size_t l_pos = 0;
+        assert(decode(l_response.m_term, l_pos)->equals(f(v(1))));
+    }
+
+    // budget
+    {
+        request l_request;
+        l_request.m_term = "(λ.((0 0)) λ.((0 0)))";
+        l_request.m_budget.m_max_steps = 3;
+        response l_response = evaluate(l_request);
+        assert(l_response.m_status == response_status::step_limit);
+        assert(l_response.m_steps == 3);
+        assert(l_response.m_term == l_request.m_term);
+    }
+
+    // the server's limit, below the request's own budget
+    {
+        request l_request;
+        l_request.m_term = "(λ.((0 0)) λ.((0 0)))";
+        l_request.m_budget.m_max_steps = 30;
+
+        budget l_limit;
+        l_limit.m_max_steps = 5;
+
+        response l_response = evaluate(l_request, l_limit);
+        assert(l_response.m_status == response_status::step_limit);
+        assert(l_response.m_steps == 5);
+
+        const budget l_clamped = clamp_budget(l_request.m_budget, l_limit);
+        assert(l_clamped.m_max_steps == 5);
+        assert(l_clamped.m_max_size == SIZE_MAX);
+        assert(l_clamped.m_max_time == std::chrono::nanoseconds::max());
+    }
+
+    // a shared term is not expanded beyond the server's size limit, even
+    // when the request sets none
+    {
+        request l_request;
+        l_request.m_format = term_format::shared;
+        encode_shared(*a(f(v(0)), f(v(0))), l_request.m_term);
+
+        budget l_limit;
+        l_limit.m_max_size = 4;
+
+        assert(evaluate(l_request, l_limit).m_status ==
+               response_status::bad_request);
+
+        l_limit.m_max_size = 5;
+        assert(evaluate(l_request, l_limit).m_status ==
+               response_status::normal_form);
+    }
+
+    // a result that does not fit in a frame is answered with the error
+    {
+        request l_request;
+        l_request.m_id = 7;
+        l_request.m_term = "(λ.((0 0)) λ.(0))";
+
+        size_t l_pos = 0;
+        response l_response;
+        const std::string l_frame = respond(l_request, {}, 40);
+
+        assert(decode_frame(l_frame, l_pos, l_response));
+        assert(l_pos == l_frame.size());
+        assert(l_response.m_id == 7);
+        assert(l_response.m_status == response_status::bad_request);
+        assert(l_response.m_term == "encode_frame: payload too large");
+
+        l_pos = 0;
+        assert(decode_frame(respond(l_request), l_pos, l_response));
+        assert(l_response.m_status == response_status::normal_form);
+        assert(l_response.m_term == "λ.(0)");
+    }
+
+    // malformed
+    {
+        request l_request;
+        l_request.m_term = "(0 1";
+        assert(evaluate(l_request).m_status == response_status::bad_request);
+
+        l_request.m_format = term_format::binary;
+        l_request.m_term = "\x09";
+        assert(evaluate(l_request).m_status == response_status::bad_request);
+    }
+}
+
+void test_server()
+{
+    const std::string l_path =
+        "/tmp/lc_server_test_" + std::to_string(::getpid()) + ".sock";
+
+    budget l_max_budget = DEFAULT_SERVER_BUDGET;
+    l_max_budget.m_max_steps = 1000;
+
+    server l_server(l_path, 4, l_max_budget);
+    std::thread l_server_thread([&l_server] { l_server.run(); });
+
+    // a pipelined batch on one connection, larger than the requests one
+    // connection may have in flight
+    {
+        client l_client(l_path);
+
+        const size_t l_count = 5000;
+
+        for(uint64_t i = 0; i < l_count; ++i)
+        {
+            request l_request;
+            l_request.m_id = i;
+
+            if(i % 2 == 0)
+            {
+                // K i (i + 1) → i
+                l_request.m_term = "((λ.(λ.(0)) " + std::to_string(i) + ") " +
+                                   std::to_string(i + 1) + ")";
+            }
+            else
+            {
+                l_request.m_format = term_format::binary;
+                l_request.m_budget.m_max_steps = 10;
+                encode(*a(f(a(v(0), v(0))), f(a(v(0), v(0)))),
+                       l_request.m_term);
+            }
+
+            l_client.submit(l_request);
+        }
+
+        std::vector<response> l_responses;
+        for(size_t i = 0; i < l_count; ++i)
+            l_responses.push_back(l_client.receive());
+
+        std::sort(l_responses.begin(), l_responses.end(),
+                  [](const response& a_lhs, const response& a_rhs)
+                  { return a_lhs.m_id < a_rhs.m_id; });
+
+        for(uint64_t i = 0; i < l_count; ++i)
+        {
+            assert(l_responses[i].m_id == i);
+
+            if(i % 2 == 0)
+            {
+                assert(l_responses[i].m_status == response_status::normal_form);
+                assert(l_responses[i].m_term == std::to_string(i));
+                assert(l_responses[i].m_steps == 2);
+            }
+            else
+            {
+                assert(l_responses[i].m_status == response_status::step_limit);
+                assert(l_responses[i].m_steps == 10);
+            }
+        }
+    }
+
+    // a divergent term without limits of its own stops at the server's
+    {
+        client l_client(l_path);
+
+        request l_request;
+        l_request.m_term = "(λ.((0 0)) λ.((0 0)))";
+        l_client.submit(l_request);
+
+        response l_response = l_client.receive();
+        assert(l_response.m_status == response_status::step_limit);
+        assert(l_response.m_steps == 1000);
+    }
+
+    // concurrent connections, including a bad request
+    {
+        std::vector<std::thread> l_threads;
+
+        for(size_t t = 0; t < 4; ++t)
+            l_threads.emplace_back(
+                [&l_path, t]
+                {
+                    client l_client(l_path);
+
+                    request l_request;
+                    l_request.m_id = t;
+                    l_request.m_term = t == 0 ? "(" : "(λ.(0) λ.(0))";
+                    l_client.submit(l_request);
+
+                    response l_response = l_client.receive();
+                    assert(l_response.m_id == t);
+
+                    if(t == 0)
+                        assert(l_response.m_status ==
+                               response_status::bad_request);
+                    else
+                        assert(l_response.m_term == "λ.(0)");
+                });
+
+        for(std::thread& l_thread : l_threads)
+            l_thread.join();
+    }
+
+    l_server.stop();
+    l_server_thread.join();
+}
+
+void server_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_protocol_frames);
+    TEST(test_evaluate);
+    TEST(test_server);
+}
+
+#endif
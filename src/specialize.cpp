@@ -0,0 +1,493 @@
+#include "../include/specialize.hpp"
+#include "../include/hash.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace lambda
+{
+
+// stands for an unknown argument in the hash of a specialization
+static constexpr uint64_t UNKNOWN_SEED = 0x2545f4914f6cdd1dull;
+
+// whether a_expr, at a_depth within a term whose root is at a_root_depth,
+// only uses variables bound within that term.
+static bool is_closed(const expr& a_expr, size_t a_root_depth, size_t a_depth)
+{
+    if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+        return l_var->m_index >= a_root_depth && l_var->m_index < a_depth;
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return is_closed(*l_func->m_body, a_root_depth, a_depth + 1);
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+        return is_closed(*l_app->m_lhs, a_root_depth, a_depth) &&
+               is_closed(*l_app->m_rhs, a_root_depth, a_depth);
+
+    // if we get here, error
+    throw std::runtime_error("specialize: invalid expression type");
+}
+
+// whether a_lhs and a_rhs are the same term.
+static bool same_term(const expr& a_lhs, const expr& a_rhs)
+{
+    if(a_lhs.m_size != a_rhs.m_size)
+        return false;
+
+    if(const var* l_var = dynamic_cast<const var*>(&a_lhs))
+    {
+        const var* l_other = dynamic_cast<const var*>(&a_rhs);
+        return l_other && l_other->m_index == l_var->m_index;
+    }
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_lhs))
+    {
+        const func* l_other = dynamic_cast<const func*>(&a_rhs);
+        return l_other && same_term(*l_func->m_body, *l_other->m_body);
+    }
+
+    const app* l_app = dynamic_cast<const app*>(&a_lhs);
+    const app* l_other = dynamic_cast<const app*>(&a_rhs);
+
+    return l_app && l_other && same_term(*l_app->m_lhs, *l_other->m_lhs) &&
+           same_term(*l_app->m_rhs, *l_other->m_rhs);
+}
+
+// moves a closed term from a_amount binders deep to the root, the inverse
+// of lift(a_amount, 0).
+static void lower(expr& a_expr, size_t a_amount)
+{
+    if(var* l_var = dynamic_cast<var*>(&a_expr))
+    {
+        l_var->m_index -= a_amount;
+        return;
+    }
+
+    if(func* l_func = dynamic_cast<func*>(&a_expr))
+    {
+        lower(*l_func->m_body, a_amount);
+        return;
+    }
+
+    if(app* l_app = dynamic_cast<app*>(&a_expr))
+    {
+        lower(*l_app->m_lhs, a_amount);
+        lower(*l_app->m_rhs, a_amount);
+        return;
+    }
+
+    // if we get here, error
+    throw std::runtime_error("specialize: invalid expression type");
+}
+
+// number of leading abstractions of a_expr.
+static size_t arity(const expr& a_expr)
+{
+    size_t l_result = 0;
+
+    for(const func* l_func = dynamic_cast<const func*>(&a_expr); l_func;
+        l_func = dynamic_cast<const func*>(l_func->m_body.get()))
+        ++l_result;
+
+    return l_result;
+}
+
+specializer::specializer(const budget& a_budget) : m_budget(a_budget)
+{
+}
+
+const expr& specializer::specialize(const expr& a_helper,
+                                    const std::vector<const expr*>& a_arguments)
+{
+    uint64_t l_hash = structural_hash(a_helper);
+
+    for(const expr* l_argument : a_arguments)
+        l_hash = hash_combine(l_hash, l_argument ? structural_hash(*l_argument)
+                                                 : UNKNOWN_SEED);
+
+    std::vector<entry>& l_bucket = m_cache[l_hash];
+
+    for(const entry& l_entry : l_bucket)
+    {
+        if(l_entry.m_arguments.size() != a_arguments.size() ||
+           !same_term(*l_entry.m_helper, a_helper))
+            continue;
+
+        bool l_equal = true;
+
+        for(size_t i = 0; l_equal && i < a_arguments.size(); ++i)
+            l_equal = a_arguments[i] && l_entry.m_arguments[i]
+                          ? same_term(*l_entry.m_arguments[i], *a_arguments[i])
+                          : !a_arguments[i] && !l_entry.m_arguments[i];
+
+        if(l_equal)
+        {
+            ++m_hits;
+            return *l_entry.m_residual;
+        }
+    }
+
+    size_t l_unknown = 0;
+
+    for(const expr* l_argument : a_arguments)
+        l_unknown += !l_argument;
+
+    // the call under one binder per unknown argument, which it takes in
+    // order
+    std::unique_ptr<expr> l_residual = a_helper.clone();
+    l_residual->lift(l_unknown, 0);
+    size_t l_next_unknown = 0;
+
+    for(const expr* l_argument : a_arguments)
+    {
+        if(!l_argument)
+        {
+            l_residual = a(std::move(l_residual), v(l_next_unknown++));
+            continue;
+        }
+
+        std::unique_ptr<expr> l_known = l_argument->clone();
+        l_known->lift(l_unknown, 0);
+        l_residual = a(std::move(l_residual), std::move(l_known));
+    }
+
+    for(size_t i = 0; i < l_unknown; ++i)
+        l_residual = f(std::move(l_residual));
+
+    std::unique_ptr<expr> l_reduced = l_residual->clone();
+
+    if(normalize(l_reduced, m_budget).m_status ==
+       normalize_status::normal_form)
+        l_residual = std::move(l_reduced);
+
+    entry l_entry;
+    l_entry.m_helper = a_helper.clone();
+
+    for(const expr* l_argument : a_arguments)
+        l_entry.m_arguments.push_back(l_argument ? l_argument->clone()
+                                                 : nullptr);
+
+    l_entry.m_residual = std::move(l_residual);
+    l_bucket.push_back(std::move(l_entry));
+    ++m_size;
+
+    return *l_bucket.back().m_residual;
+}
+
+size_t specializer::rewrite_calls(std::unique_ptr<expr>& a_expr,
+                                  size_t a_helper_level, const expr& a_helper,
+                                  size_t a_depth)
+{
+    if(a_helper_level >= a_depth)
+        throw std::runtime_error(
+            "rewrite_calls: helper must be bound outside the expression");
+
+    if(func* l_func = dynamic_cast<func*>(a_expr.get()))
+    {
+        const size_t l_result = rewrite_calls(l_func->m_body, a_helper_level,
+                                              a_helper, a_depth + 1);
+        l_func->update_size();
+
+        return l_result;
+    }
+
+    if(!dynamic_cast<app*>(a_expr.get()))
+        return 0;
+
+    // the applications of the call and their arguments, last first, and its
+    // head
+    std::vector<app*> l_calls;
+    std::vector<std::unique_ptr<expr>*> l_spine;
+    std::unique_ptr<expr>* l_head = &a_expr;
+
+    while(app* l_call = dynamic_cast<app*>(l_head->get()))
+    {
+        l_calls.push_back(l_call);
+        l_spine.push_back(&l_call->m_rhs);
+        l_head = &l_call->m_lhs;
+    }
+
+    // sizes from the innermost application out, once arguments changed
+    auto l_update_sizes = [&l_calls]
+    {
+        for(auto l_it = l_calls.rbegin(); l_it != l_calls.rend(); ++l_it)
+            (*l_it)->update_size();
+    };
+
+    size_t l_result = 0;
+    const var* l_var = dynamic_cast<const var*>(l_head->get());
+
+    if(!l_var || l_var->m_index != a_helper_level)
+    {
+        l_result += rewrite_calls(*l_head, a_helper_level, a_helper, a_depth);
+
+        for(std::unique_ptr<expr>* l_argument : l_spine)
+            l_result +=
+                rewrite_calls(*l_argument, a_helper_level, a_helper, a_depth);
+
+        l_update_sizes();
+
+        return l_result;
+    }
+
+    const size_t l_count = std::min(arity(a_helper), l_spine.size());
+    std::vector<std::unique_ptr<expr>> l_known(l_count);
+    std::vector<const expr*> l_arguments(l_count, nullptr);
+    bool l_any_known = false;
+
+    for(size_t i = 0; i < l_count; ++i)
+    {
+        std::unique_ptr<expr>& l_argument = *l_spine[l_spine.size() - 1 - i];
+
+        if(!is_closed(*l_argument, a_depth, a_depth))
+            continue;
+
+        l_known[i] = l_argument->clone();
+        lower(*l_known[i], a_depth);
+        l_arguments[i] = l_known[i].get();
+        l_any_known = true;
+    }
+
+    // the other arguments may hold calls of their own
+    for(size_t i = 0; i < l_spine.size(); ++i)
+        if(i >= l_count || !l_arguments[i])
+            l_result += rewrite_calls(*l_spine[l_spine.size() - 1 - i],
+                                      a_helper_level, a_helper, a_depth);
+
+    if(!l_any_known)
+    {
+        l_update_sizes();
+
+        return l_result;
+    }
+
+    std::unique_ptr<expr> l_call = specialize(a_helper, l_arguments).clone();
+    l_call->lift(a_depth, 0);
+
+    for(size_t i = 0; i < l_spine.size(); ++i)
+        if(i >= l_count || !l_arguments[i])
+            l_call = a(std::move(l_call),
+                       std::move(*l_spine[l_spine.size() - 1 - i]));
+
+    a_expr = std::move(l_call);
+
+    return l_result + 1;
+}
+
+size_t specializer::size() const
+{
+    return m_size;
+}
+
+size_t specializer::hits() const
+{
+    return m_hits;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+// church numeral a_n under a_depth binders
+static std::unique_ptr<expr> specialize_numeral(size_t a_n, size_t a_depth)
+{
+    std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+    for(size_t i = 0; i < a_n; ++i)
+        l_body = a(v(a_depth), std::move(l_body));
+
+    return f(f(std::move(l_body)));
+}
+
+void test_specialize()
+{
+    // ADD = λm.λn.λs.λz.((m s) ((n s) z))
+    const auto ADD = f(f(f(f(a(a(v(0), v(2)), a(a(v(1), v(2)), v(3)))))));
+
+    // ADD THREE leaves λn.λs.λz.(s (s (s ((n s) z))))
+    {
+        specializer l_specializer;
+        const auto l_three = specialize_numeral(3, 0);
+        const expr& l_residual =
+            l_specializer.specialize(*ADD, {l_three.get(), nullptr});
+
+        const auto l_expected =
+            f(f(f(a(v(1), a(v(1), a(v(1), a(a(v(0), v(1)), v(2))))))));
+        assert(l_residual.clone()->equals(l_expected));
+        assert(is_normal(l_residual));
+        assert(l_specializer.size() == 1);
+        assert(l_specializer.hits() == 0);
+
+        // the same known arguments share the specialization
+        const auto l_again = specialize_numeral(3, 0);
+        assert(&l_specializer.specialize(*ADD, {l_again.get(), nullptr}) ==
+               &l_residual);
+        assert(l_specializer.hits() == 1);
+
+        // others do not
+        l_specializer.specialize(*ADD, {nullptr, l_three.get()});
+        const auto l_two = specialize_numeral(2, 0);
+        const expr& l_five = l_specializer.specialize(
+            *ADD, {l_two.get(), l_three.get()});
+        assert(l_five.clone()->equals(specialize_numeral(5, 0)));
+        assert(l_specializer.size() == 3);
+        assert(l_specializer.hits() == 1);
+    }
+
+    // a residual without a normal form in the budget is left unreduced
+    {
+        budget l_budget;
+        l_budget.m_max_steps = 20;
+        specializer l_specializer(l_budget);
+
+        // λx.λy.(x x), with x = λz.(z z)
+        const auto l_helper = f(f(a(v(0), v(0))));
+        const auto l_self = f(a(v(0), v(0)));
+        const expr& l_residual =
+            l_specializer.specialize(*l_helper, {l_self.get(), nullptr});
+
+        assert(l_residual.clone()->equals(
+            f(a(a(f(f(a(v(1), v(1)))), f(a(v(1), v(1)))), v(0)))));
+    }
+}
+
+void test_rewrite_calls()
+{
+    const auto ADD = f(f(f(f(a(a(v(0), v(2)), a(a(v(1), v(2)), v(3)))))));
+
+    std::vector<std::unique_ptr<expr>> l_helpers;
+    l_helpers.push_back(ADD->clone());
+
+    // main, under the helper's binder: λx.((ADD THREE) ((ADD x) TWO))
+    auto l_main = f(a(a(v(0), specialize_numeral(3, 2)),
+                      a(a(v(0), v(1)), specialize_numeral(2, 2))));
+
+    specializer l_specializer;
+    auto l_rewritten = l_main->clone();
+    assert(l_specializer.rewrite_calls(l_rewritten, 0, *ADD, 1) == 2);
+    assert(l_specializer.size() == 2);
+    assert(l_rewritten->m_size == l_rewritten->clone()->m_size);
+
+    // the helper is no longer called, and the program means the same
+    {
+        auto l_expected =
+            construct_program(l_helpers.begin(), l_helpers.end(), l_main);
+        const normalize_stats l_expected_stats = normalize(l_expected);
+
+        auto l_program = construct_program(l_helpers.begin(), l_helpers.end(),
+                                           l_rewritten);
+        const normalize_stats l_stats = normalize(l_program);
+
+        assert(l_program->equals(l_expected));
+        assert(l_stats.m_steps < l_expected_stats.m_steps);
+    }
+
+    // calls without closed arguments, and other heads, are left alone
+    {
+        auto l_expr = f(a(a(v(0), v(1)), v(1)));
+        assert(l_specializer.rewrite_calls(l_expr, 0, *ADD, 1) == 0);
+        assert(l_expr->equals(f(a(a(v(0), v(1)), v(1)))));
+
+        auto l_other = a(a(f(v(1)), specialize_numeral(3, 1)), v(0));
+        assert(l_specializer.rewrite_calls(l_other, 0, *ADD, 1) == 0);
+    }
+
+    // the helper must be bound outside
+    {
+        auto l_expr = v(0);
+        assert_throws(l_specializer.rewrite_calls(l_expr, 0, *ADD, 0),
+                      std::runtime_error);
+    }
+}
+
+void specialize_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_specialize);
+    TEST(test_rewrite_calls);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+
+using namespace lambda;
+
+void bench_rewrite_calls()
+{
+    const size_t l_runs = 5;
+    const size_t l_calls = 32;
+
+    // church numeral a_n under a_depth binders
+    auto l_numeral = [](size_t a_n, size_t a_depth)
+    {
+        std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(a_depth), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    // ADD = λm.λn.λs.λz.((m s) ((n s) z))
+    const auto ADD = f(f(f(f(a(a(v(0), v(2)), a(a(v(1), v(2)), v(3)))))));
+    std::vector<std::unique_ptr<expr>> l_helpers;
+    l_helpers.push_back(ADD->clone());
+
+    // λx.(ADD TEN (ADD TEN (... x))), l_calls deep
+    std::unique_ptr<expr> l_body = v(1);
+
+    for(size_t i = 0; i < l_calls; ++i)
+        l_body = a(a(v(0), l_numeral(10, 2)), std::move(l_body));
+
+    const auto l_main = f(std::move(l_body));
+
+    std::unique_ptr<expr> l_program;
+    size_t l_steps = 0;
+
+    measurement l_measured = measure_best_of(
+        l_runs,
+        [&]
+        {
+            l_program = construct_program(l_helpers.begin(),
+                                          l_helpers.end(), l_main);
+        },
+        [&] { l_steps = normalize(l_program).m_steps; });
+    report("normalize, generic calls", l_measured, l_steps);
+
+    l_measured = measure_best_of(
+        l_runs, [&] { l_program = l_main->clone(); },
+        [&]
+        {
+            specializer l_specializer;
+            l_specializer.rewrite_calls(l_program, 0, *ADD, 1);
+        });
+    report("rewrite_calls", l_measured, l_calls);
+
+    specializer l_specializer;
+    auto l_rewritten = l_main->clone();
+    l_specializer.rewrite_calls(l_rewritten, 0, *ADD, 1);
+
+    l_measured = measure_best_of(
+        l_runs,
+        [&]
+        {
+            l_program = construct_program(l_helpers.begin(),
+                                          l_helpers.end(), l_rewritten);
+        },
+        [&] { l_steps = normalize(l_program).m_steps; });
+    report("normalize, specialized calls", l_measured, l_steps);
+}
+
+void specialize_bench_main()
+{
+    BENCH(bench_rewrite_calls);
+}
+
+#endif
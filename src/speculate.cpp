@@ -0,0 +1,564 @@
+#include "../include/speculate.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace lambda
+{
+
+// one speculative normalization. The worker owns m_result, m_steps and
+// m_normal until it sets m_done.
+struct speculation
+{
+    // the argument this was started for. Only compared, never dereferenced,
+    // since the argument may be gone by the time the result is ready.
+    const expr* m_origin;
+    size_t m_depth;
+    std::unique_ptr<expr> m_snapshot;
+    std::unique_ptr<expr> m_result;
+    size_t m_steps = 0;
+    bool m_normal = false;
+    std::atomic<bool> m_done = false;
+};
+
+// state shared by the caller and its speculations.
+struct speculation_control
+{
+    std::atomic<bool> m_cancelled = false;
+    std::atomic<size_t> m_in_flight = 0;
+    // beta-reductions left for all speculations together
+    std::atomic<size_t> m_remaining_steps;
+};
+
+// takes one step from the shared allowance; false once it is used up.
+static bool take_step(std::atomic<size_t>& a_remaining)
+{
+    size_t l_remaining = a_remaining.load(std::memory_order_relaxed);
+
+    do
+    {
+        if(l_remaining == 0)
+            return false;
+    } while(!a_remaining.compare_exchange_weak(l_remaining, l_remaining - 1,
+                                               std::memory_order_relaxed));
+
+    return true;
+}
+
+// marks a speculation done and no longer in flight however it ends, so that
+// the caller never waits for one that threw.
+struct speculation_finisher
+{
+    speculation& m_speculation;
+    speculation_control& m_control;
+
+    ~speculation_finisher()
+    {
+        m_speculation.m_done.store(true, std::memory_order_release);
+        m_control.m_in_flight.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+static void run_speculation(speculation& a_speculation, const budget& a_budget,
+                            speculation_control& a_control)
+{
+    using clock = std::chrono::steady_clock;
+
+    speculation_finisher l_finisher{a_speculation, a_control};
+
+    const clock::time_point l_start = clock::now();
+    const bool l_timed =
+        a_budget.m_max_time != std::chrono::nanoseconds::max();
+
+    a_speculation.m_result = a_speculation.m_snapshot->clone();
+    std::unique_ptr<expr>& l_expr = a_speculation.m_result;
+
+    // the checks of normalize(), plus cancellation and the shared allowance
+    while(!a_control.m_cancelled.load(std::memory_order_relaxed))
+    {
+        if(l_expr->m_size > a_budget.m_max_size)
+            break;
+
+        if(l_timed && clock::now() - l_start >= a_budget.m_max_time)
+            break;
+
+        if(a_speculation.m_steps >= a_budget.m_max_steps)
+        {
+            a_speculation.m_normal = is_normal(*l_expr);
+            break;
+        }
+
+        if(!take_step(a_control.m_remaining_steps))
+            break;
+
+        if(!reduce_one_step(l_expr, a_speculation.m_depth))
+        {
+            a_speculation.m_normal = true;
+            break;
+        }
+
+        ++a_speculation.m_steps;
+    }
+}
+
+// the spine of an expression: the binders at its root, then the chain of
+// applications down the lhs to the head.
+struct spine
+{
+    // every func and app on the spine, from the root down
+    std::vector<expr*> m_nodes;
+    // the rhs of every app, leftmost argument first, with its depth
+    std::vector<std::pair<std::unique_ptr<expr>*, size_t>> m_args;
+    // whether the head is a var. A stuck spine never changes again except
+    // inside its arguments, which normal order reduces left to right.
+    bool m_stuck = false;
+};
+
+static void walk_spine(std::unique_ptr<expr>& a_expr, size_t a_depth,
+                       spine& a_spine)
+{
+    a_spine.m_nodes.clear();
+    a_spine.m_args.clear();
+
+    std::unique_ptr<expr>* l_node = &a_expr;
+
+    while(func* l_func = dynamic_cast<func*>(l_node->get()))
+    {
+        a_spine.m_nodes.push_back(l_func);
+        l_node = &l_func->m_body;
+        ++a_depth;
+    }
+
+    while(app* l_app = dynamic_cast<app*>(l_node->get()))
+    {
+        a_spine.m_nodes.push_back(l_app);
+        a_spine.m_args.emplace_back(&l_app->m_rhs, a_depth);
+        l_node = &l_app->m_lhs;
+    }
+
+    a_spine.m_stuck = dynamic_cast<var*>(l_node->get()) != nullptr;
+
+    std::reverse(a_spine.m_args.begin(), a_spine.m_args.end());
+}
+
+normalize_stats normalize_speculative(std::unique_ptr<expr>& a_expr,
+                                      thread_pool& a_pool,
+                                      const budget& a_budget,
+                                      const speculation_options& a_options,
+                                      speculation_stats* a_stats,
+                                      size_t a_depth)
+{
+    using clock = std::chrono::steady_clock;
+
+    const clock::time_point l_start = clock::now();
+    const bool l_timed =
+        a_budget.m_max_time != std::chrono::nanoseconds::max();
+
+    normalize_stats l_stats;
+    l_stats.m_max_size = a_expr->m_size;
+
+    speculation_stats l_speculation_stats;
+    speculation_control l_control;
+    l_control.m_remaining_steps = a_options.m_max_total_steps;
+
+    std::vector<std::unique_ptr<speculation>> l_pending;
+    // arguments speculated on before, so that none is started twice
+    std::unordered_set<const expr*> l_tried;
+    spine l_spine;
+    // on a stuck spine, the arguments before this one are being or have been
+    // reduced by the caller. Otherwise the leftmost argument is about to be
+    // consumed by the head.
+    size_t l_first_free = 1;
+    // the arguments as they were before the last step
+    std::vector<std::pair<const expr*, size_t>> l_before;
+
+    // adopts or discards every finished speculation
+    auto l_settle = [&]
+    {
+        bool l_adopted = false;
+
+        for(auto l_it = l_pending.begin(); l_it != l_pending.end();)
+        {
+            speculation& l_speculation = **l_it;
+
+            if(!l_speculation.m_done.load(std::memory_order_acquire))
+            {
+                ++l_it;
+                continue;
+            }
+
+            l_speculation_stats.m_speculative_steps += l_speculation.m_steps;
+
+            std::unique_ptr<expr>* l_slot = nullptr;
+
+            if(l_speculation.m_normal && l_speculation.m_steps > 0)
+                for(auto& [l_arg, l_depth] : l_spine.m_args)
+                    if(l_arg->get() == l_speculation.m_origin &&
+                       l_depth == l_speculation.m_depth)
+                        l_slot = l_arg;
+
+            // the argument must still be the one that was copied
+            if(l_slot && (*l_slot)->equals(l_speculation.m_snapshot))
+            {
+                *l_slot = std::move(l_speculation.m_result);
+                // a normal form has nothing left to speculate on
+                l_tried.insert(l_slot->get());
+                l_adopted = true;
+                ++l_speculation_stats.m_adopted;
+                l_speculation_stats.m_adopted_steps += l_speculation.m_steps;
+            }
+            else
+            {
+                ++l_speculation_stats.m_discarded;
+            }
+
+            l_it = l_pending.erase(l_it);
+        }
+
+        if(!l_adopted)
+            return;
+
+        // sizes along the spine, bottom up
+        for(auto l_it = l_spine.m_nodes.rbegin();
+            l_it != l_spine.m_nodes.rend(); ++l_it)
+            (*l_it)->update_size();
+
+        l_stats.m_max_size = std::max(l_stats.m_max_size, a_expr->m_size);
+    };
+
+    // starts speculations on spine arguments while workers are idle
+    auto l_launch = [&]
+    {
+        for(size_t i = l_first_free; i < l_spine.m_args.size(); ++i)
+        {
+            if(l_control.m_in_flight.load(std::memory_order_acquire) >=
+               a_pool.size())
+                return;
+
+            const auto& [l_arg, l_depth] = l_spine.m_args[i];
+
+            if((*l_arg)->m_size < a_options.m_min_size ||
+               !l_tried.insert(l_arg->get()).second)
+                continue;
+
+            auto l_speculation = std::make_unique<speculation>();
+            l_speculation->m_origin = l_arg->get();
+            l_speculation->m_depth = l_depth;
+            l_speculation->m_snapshot = (*l_arg)->clone();
+
+            speculation* l_raw = l_speculation.get();
+            l_pending.push_back(std::move(l_speculation));
+
+            l_control.m_in_flight.fetch_add(1, std::memory_order_relaxed);
+            ++l_speculation_stats.m_started;
+
+            a_pool.submit(
+                [l_raw, &a_options, &l_control]
+                {
+                    run_speculation(*l_raw, a_options.m_task_budget,
+                                    l_control);
+                });
+        }
+    };
+
+    while(true)
+    {
+        walk_spine(a_expr, a_depth, l_spine);
+        l_settle();
+
+        if(a_expr->m_size > a_budget.m_max_size)
+        {
+            l_stats.m_status = normalize_status::size_limit;
+            break;
+        }
+
+        if(l_timed && clock::now() - l_start >= a_budget.m_max_time)
+        {
+            l_stats.m_status = is_normal(*a_expr)
+                                   ? normalize_status::normal_form
+                                   : normalize_status::time_limit;
+            break;
+        }
+
+        if(l_stats.m_steps >= a_budget.m_max_steps)
+        {
+            // only report the limit if another step was actually possible
+            l_stats.m_status = is_normal(*a_expr)
+                                   ? normalize_status::normal_form
+                                   : normalize_status::step_limit;
+            break;
+        }
+
+        if(!l_spine.m_stuck)
+            l_first_free = 1;
+
+        l_launch();
+
+        l_before.clear();
+
+        for(const auto& [l_arg, l_depth] : l_spine.m_args)
+            l_before.emplace_back(l_arg->get(), (*l_arg)->m_size);
+
+        if(!reduce_one_step(a_expr, a_depth))
+        {
+            l_stats.m_status = normalize_status::normal_form;
+            break;
+        }
+
+        // on a stuck spine the step happened inside the first argument that
+        // changed, so the caller now owns everything up to it
+        if(l_spine.m_stuck)
+            for(size_t i = 0; i < l_spine.m_args.size(); ++i)
+            {
+                const auto& [l_arg, l_depth] = l_spine.m_args[i];
+
+                if(l_arg->get() != l_before[i].first ||
+                   (*l_arg)->m_size != l_before[i].second)
+                {
+                    l_first_free = std::max(l_first_free, i + 1);
+                    break;
+                }
+            }
+
+        ++l_stats.m_steps;
+        l_stats.m_max_size = std::max(l_stats.m_max_size, a_expr->m_size);
+    }
+
+    // stop the speculations still running; their results are of no use.
+    // Those still queued are run here, where they stop at once: when the
+    // caller is itself a worker of a_pool, no other worker may be free.
+    l_control.m_cancelled = true;
+
+    while(l_control.m_in_flight.load(std::memory_order_acquire) > 0)
+        if(!a_pool.run_pending_task())
+            std::this_thread::yield();
+
+    for(const auto& l_speculation : l_pending)
+    {
+        l_speculation_stats.m_speculative_steps += l_speculation->m_steps;
+        ++l_speculation_stats.m_discarded;
+    }
+
+    l_stats.m_elapsed = clock::now() - l_start;
+
+    if(a_stats)
+        *a_stats = l_speculation_stats;
+
+    return l_stats;
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+// church numeral a_n, closed, at any depth.
+static std::unique_ptr<expr> church(size_t a_n, size_t a_depth)
+{
+    std::unique_ptr<expr> l_body = v(a_depth + 1);
+
+    for(size_t i = 0; i < a_n; ++i)
+        l_body = a(v(a_depth), std::move(l_body));
+
+    return f(f(std::move(l_body)));
+}
+
+// a_base raised to a_exponent: (a_exponent a_base), which takes a few
+// hundred steps to normalize for small numerals.
+static std::unique_ptr<expr> power(size_t a_base, size_t a_exponent,
+                                   size_t a_depth)
+{
+    return a(church(a_exponent, a_depth), church(a_base, a_depth));
+}
+
+void test_normalize_speculative()
+{
+    thread_pool l_pool(2);
+    speculation_options l_options;
+    l_options.m_min_size = 0;
+
+    // a stuck head: every argument is reduced, in place or speculatively
+    {
+        auto l_expr = a(a(a(v(0), power(3, 3, 0)), power(2, 4, 0)),
+                        power(3, 2, 0));
+        auto l_expected = l_expr->clone();
+        auto l_expected_stats = normalize(l_expected);
+
+        speculation_stats l_speculation;
+        auto l_stats = normalize_speculative(l_expr, l_pool, {}, l_options,
+                                             &l_speculation);
+
+        assert(l_stats.m_status == normalize_status::normal_form);
+        assert(l_expr->equals(l_expected));
+        // the leftmost argument is the caller's own
+        assert(l_speculation.m_started == 2);
+        assert(l_speculation.m_adopted + l_speculation.m_discarded == 2);
+        // adopted work is work the caller did not have to do
+        assert(l_stats.m_steps + l_speculation.m_adopted_steps ==
+               l_expected_stats.m_steps);
+    }
+
+    // under binders
+    {
+        auto l_expr = f(f(a(a(v(1), power(2, 3, 2)), power(3, 2, 2))));
+        auto l_expected = l_expr->clone();
+        normalize(l_expected);
+
+        normalize_speculative(l_expr, l_pool, {}, l_options);
+        assert(l_expr->equals(l_expected));
+    }
+
+    // an argument that is thrown away does not change the result, whether
+    // or not its speculation finished first
+    {
+        auto K = f(f(v(0)));
+        auto l_expr = a(a(K->clone(), v(5)), power(3, 3, 0));
+
+        speculation_stats l_speculation;
+        normalize_speculative(l_expr, l_pool, {}, l_options, &l_speculation);
+
+        assert(l_expr->equals(v(5)));
+        assert(l_speculation.m_started == 1);
+        assert(l_speculation.m_adopted + l_speculation.m_discarded == 1);
+    }
+
+    // without any speculative allowance nothing is adopted
+    {
+        auto l_expr = a(a(v(0), power(3, 3, 0)), power(2, 4, 0));
+        auto l_expected = l_expr->clone();
+        normalize(l_expected);
+
+        speculation_options l_none = l_options;
+        l_none.m_max_total_steps = 0;
+
+        speculation_stats l_speculation;
+        normalize_speculative(l_expr, l_pool, {}, l_none, &l_speculation);
+
+        assert(l_expr->equals(l_expected));
+        assert(l_speculation.m_adopted == 0);
+        assert(l_speculation.m_speculative_steps == 0);
+    }
+
+    // the caller's budget still applies, and no speculation outlives the call
+    {
+        auto l_omega = a(f(a(v(0), v(0))), f(a(v(0), v(0))));
+        auto l_expr = a(a(v(0), l_omega->clone()), l_omega->clone());
+
+        budget l_budget;
+        l_budget.m_max_steps = 100;
+        speculation_options l_limited = l_options;
+        l_limited.m_task_budget.m_max_steps = 1000;
+
+        speculation_stats l_speculation;
+        auto l_stats = normalize_speculative(l_expr, l_pool, l_budget,
+                                             l_limited, &l_speculation);
+
+        assert(l_stats.m_status == normalize_status::step_limit);
+        assert(l_stats.m_steps == 100);
+        assert(l_speculation.m_adopted == 0);
+    }
+
+    // called from the only worker of its pool: the queued speculation can
+    // only run once the caller is done, and the caller runs it itself
+    {
+        thread_pool l_single(1);
+
+        auto l_expr = a(a(v(0), power(3, 3, 0)), power(2, 4, 0));
+        auto l_expected = l_expr->clone();
+        normalize(l_expected);
+
+        speculation_stats l_speculation;
+        l_single.submit(
+            [&]
+            {
+                normalize_speculative(l_expr, l_single, {}, l_options,
+                                      &l_speculation);
+            });
+        l_single.wait_idle();
+
+        assert(l_expr->equals(l_expected));
+        assert(l_speculation.m_started == 1);
+        assert(l_speculation.m_discarded == 1);
+    }
+}
+
+void speculate_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_normalize_speculative);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+
+using namespace lambda;
+
+void bench_normalize_speculative()
+{
+    const size_t l_runs = 3;
+    const size_t l_arguments = 8;
+
+    // a stuck head applied to independent numerals raised to a power: normal
+    // order reduces the arguments one after another
+    auto l_church = [](size_t a_n)
+    {
+        std::unique_ptr<expr> l_body = v(1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(0), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    std::unique_ptr<expr> l_program = v(0);
+
+    for(size_t i = 0; i < l_arguments; ++i)
+        l_program = a(std::move(l_program), a(l_church(4), l_church(5)));
+
+    std::unique_ptr<expr> l_expr;
+    size_t l_steps = 0;
+
+    measurement l_measured = measure_best_of(
+        l_runs, [&] { l_expr = l_program->clone(); },
+        [&] { l_steps = normalize(l_expr).m_steps; });
+    report("normalize", l_measured, l_steps);
+
+    const size_t l_threads =
+        std::max<size_t>(1, std::thread::hardware_concurrency());
+    thread_pool l_pool(l_threads);
+    // the arguments are small until reduced
+    speculation_options l_options;
+    l_options.m_min_size = 0;
+    speculation_stats l_speculation;
+
+    l_measured = measure_best_of(
+        l_runs, [&] { l_expr = l_program->clone(); },
+        [&]
+        {
+            normalize_speculative(l_expr, l_pool, {}, l_options,
+                                  &l_speculation);
+        });
+    report("normalize_speculative", l_measured, l_steps);
+
+    std::cout << "    threads=" << l_threads
+              << " started=" << l_speculation.m_started
+              << " adopted=" << l_speculation.m_adopted
+              << " adopted_steps=" << l_speculation.m_adopted_steps
+              << std::endl;
+}
+
+void speculate_bench_main()
+{
+    BENCH(bench_normalize_speculative);
+}
+
+#endif
@@ -0,0 +1,450 @@
+#include "../include/strictness.hpp"
+#include "../include/probes.hpp"
+#include <stdexcept>
+
+namespace lambda
+{
+
+// a_count arguments and a_amount more, where SIZE_MAX stands for any number.
+static size_t add_arguments(size_t a_count, size_t a_amount)
+{
+    return a_count > SIZE_MAX - a_amount ? SIZE_MAX : a_count + a_amount;
+}
+
+// occurrences of the variable with level a_level in a_expr.
+static size_t count_uses(const expr& a_expr, size_t a_level)
+{
+    if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+        return l_var->m_index == a_level;
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        return count_uses(*l_func->m_body, a_level);
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+        return count_uses(*l_app->m_lhs, a_level) +
+               count_uses(*l_app->m_rhs, a_level);
+
+    // if we get here, error
+    throw std::runtime_error("analyze_binder: invalid expression type");
+}
+
+namespace
+{
+
+// a search for needed occurrences of one variable.
+struct needed_search
+{
+    // level of the variable
+    size_t m_level;
+    // for each binder below it, from level m_level + 1, whether it is never
+    // applied
+    std::vector<bool> m_fixed;
+
+    // whether the variable with level a_level is never substituted.
+    bool fixed(size_t a_level) const
+    {
+        if(a_level < m_level)
+            return true;
+
+        const size_t l_offset = a_level - m_level - 1;
+
+        // levels beyond the binders are free
+        return l_offset >= m_fixed.size() || m_fixed[l_offset];
+    }
+
+    // whether the variable has a needed occurrence in a_expr, at depth
+    // a_depth, once a_expr is applied to a_arguments arguments.
+    bool needed(const expr& a_expr, size_t a_depth, size_t a_arguments)
+    {
+        if(const var* l_var = dynamic_cast<const var*>(&a_expr))
+            return l_var->m_index == m_level && a_arguments == 0;
+
+        if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+        {
+            // an abstraction that is applied consumes an argument, and its
+            // variable becomes unknown
+            m_fixed.push_back(a_arguments == 0);
+            const bool l_needed = needed(
+                *l_func->m_body, a_depth + 1,
+                a_arguments == 0 || a_arguments == SIZE_MAX ? a_arguments
+                                                            : a_arguments - 1);
+            m_fixed.pop_back();
+
+            return l_needed;
+        }
+
+        if(!dynamic_cast<const app*>(&a_expr))
+            // if we get here, error
+            throw std::runtime_error("analyze_binder: invalid expression type");
+
+        // the head of the application spine
+        const expr* l_head = &a_expr;
+        size_t l_count = 0;
+
+        while(const app* l_app = dynamic_cast<const app*>(l_head))
+        {
+            l_head = l_app->m_lhs.get();
+            ++l_count;
+        }
+
+        const var* l_var = dynamic_cast<const var*>(l_head);
+
+        // a redex: its arguments may be dropped, but its abstraction's body
+        // is reached
+        if(!l_var)
+            return needed(*l_head, a_depth,
+                          add_arguments(a_arguments, l_count));
+
+        // the arguments of a head that is never substituted reach the normal
+        // form; those of any other head may be dropped
+        if(l_var->m_index == m_level || !fixed(l_var->m_index))
+            return false;
+
+        for(const expr* l_spine = &a_expr; l_spine != l_head;)
+        {
+            const app* l_app = static_cast<const app*>(l_spine);
+
+            if(needed(*l_app->m_rhs, a_depth, 0))
+                return true;
+
+            l_spine = l_app->m_lhs.get();
+        }
+
+        return false;
+    }
+};
+
+} // namespace
+
+binder_usage analyze_binder(const func& a_func, size_t a_depth,
+                            size_t a_extra_arguments)
+{
+    binder_usage l_usage;
+    l_usage.m_uses = count_uses(*a_func.m_body, a_depth);
+
+    if(l_usage.m_uses > 0)
+    {
+        needed_search l_search{a_depth, {}};
+        l_usage.m_strict =
+            l_search.needed(*a_func.m_body, a_depth + 1, a_extra_arguments);
+    }
+
+    return l_usage;
+}
+
+// appends the usage of every abstraction in a_expr, at depth a_depth and
+// applied to a_arguments arguments, to a_result in pre-order.
+static void collect_usage(const expr& a_expr, size_t a_depth,
+                          size_t a_arguments,
+                          std::vector<binder_usage>& a_result)
+{
+    if(dynamic_cast<const var*>(&a_expr))
+        return;
+
+    if(const func* l_func = dynamic_cast<const func*>(&a_expr))
+    {
+        a_result.push_back(analyze_binder(
+            *l_func, a_depth, a_arguments == 0 ? SIZE_MAX : a_arguments - 1));
+        collect_usage(*l_func->m_body, a_depth + 1, 0, a_result);
+        return;
+    }
+
+    if(const app* l_app = dynamic_cast<const app*>(&a_expr))
+    {
+        collect_usage(*l_app->m_lhs, a_depth, a_arguments + 1, a_result);
+        collect_usage(*l_app->m_rhs, a_depth, 0, a_result);
+        return;
+    }
+
+    // if we get here, error
+    throw std::runtime_error("analyze_usage: invalid expression type");
+}
+
+std::vector<binder_usage> analyze_usage(const expr& a_expr, size_t a_depth)
+{
+    std::vector<binder_usage> l_result;
+    collect_usage(a_expr, a_depth, 0, l_result);
+
+    return l_result;
+}
+
+// reduce_one_step_strict() on a_expr, which is applied to a_arguments
+// arguments.
+static bool reduce_strict(std::unique_ptr<expr>& a_expr, size_t a_depth,
+                          size_t a_arguments)
+{
+    if(dynamic_cast<var*>(a_expr.get()))
+    {
+        // variables cannot reduce
+        return false;
+    }
+
+    if(func* l_func = dynamic_cast<func*>(a_expr.get()))
+    {
+        if(reduce_strict(l_func->m_body, a_depth + 1, 0))
+        {
+            l_func->update_size();
+
+            return true;
+        }
+
+        return false;
+    }
+
+    if(app* l_app = dynamic_cast<app*>(a_expr.get()))
+    {
+        if(func* l_lhs_func = dynamic_cast<func*>(l_app->m_lhs.get()))
+        {
+            const binder_usage l_usage =
+                analyze_binder(*l_lhs_func, a_depth, a_arguments);
+
+            // reduce a strict argument that would be copied before copying
+            // it, as a term of its own
+            if(l_usage.m_strict && l_usage.m_uses > 1 &&
+               reduce_strict(l_app->m_rhs, a_depth, 0))
+            {
+                l_app->update_size();
+
+                return true;
+            }
+
+            LC_PROBE2(beta, a_depth, l_app->m_rhs->m_size);
+            substitute(l_lhs_func->m_body, 0, a_depth, l_app->m_rhs);
+            a_expr = std::move(l_lhs_func->m_body);
+
+            return true;
+        }
+
+        if(reduce_strict(l_app->m_lhs, a_depth,
+                         add_arguments(a_arguments, 1)) ||
+           reduce_strict(l_app->m_rhs, a_depth, 0))
+        {
+            l_app->update_size();
+
+            return true;
+        }
+
+        return false;
+    }
+
+    // if we get here, error
+    throw std::runtime_error("reduce_one_step_strict: invalid expression type");
+}
+
+bool reduce_one_step_strict(std::unique_ptr<expr>& a_expr, size_t a_depth)
+{
+    return reduce_strict(a_expr, a_depth, 0);
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../include/normalize.hpp"
+#include "../testing/test_utils.hpp"
+
+using namespace lambda;
+
+// λx.λs.((s x) x), a pair of two copies of its argument
+static std::unique_ptr<expr> strictness_pair()
+{
+    return f(f(a(a(v(1), v(0)), v(0))));
+}
+
+void test_analyze_binder()
+{
+    auto l_usage = [](const std::unique_ptr<expr>& a_func, size_t a_depth,
+                      size_t a_extra_arguments)
+    {
+        return analyze_binder(static_cast<const func&>(*a_func), a_depth,
+                              a_extra_arguments);
+    };
+
+    // arguments of a variable bound outside are needed: λ.((0 1) 1) at
+    // depth 1
+    {
+        const binder_usage l_result =
+            l_usage(f(a(a(v(0), v(1)), v(1))), 1, 0);
+        assert(l_result.m_uses == 2);
+        assert(l_result.m_strict);
+    }
+
+    // an applied occurrence is not: λ.((0 0))
+    {
+        const binder_usage l_result = l_usage(f(a(v(0), v(0))), 0, 0);
+        assert(l_result.m_uses == 2);
+        assert(!l_result.m_strict);
+    }
+
+    // nor an unused variable: λ.λ.1
+    {
+        const binder_usage l_result = l_usage(f(f(v(1))), 0, 0);
+        assert(l_result.m_uses == 0);
+        assert(!l_result.m_strict);
+    }
+
+    // the body reaches the normal form unless it is applied further
+    {
+        assert(l_usage(f(v(0)), 0, 0).m_strict);
+        assert(!l_usage(f(v(0)), 0, 1).m_strict);
+        assert(!l_usage(f(v(0)), 0, SIZE_MAX).m_strict);
+
+        // λ.λ.0 consumes one further argument itself
+        assert(l_usage(f(f(v(0))), 0, 1).m_strict);
+        assert(!l_usage(f(f(v(0))), 0, 2).m_strict);
+    }
+
+    // a pair needs its argument until the pair itself is applied, when the
+    // selector may drop it
+    {
+        const binder_usage l_result = l_usage(strictness_pair(), 0, 0);
+        assert(l_result.m_uses == 2);
+        assert(l_result.m_strict);
+        assert(!l_usage(strictness_pair(), 0, 1).m_strict);
+        assert(!l_usage(strictness_pair(), 0, SIZE_MAX).m_strict);
+    }
+
+    // the body of a redex within the body is reached, its argument is not:
+    // λ.((λ.1 0)) and λ.((λ.2 1)) at depth 1
+    {
+        assert(l_usage(f(a(f(v(1)), v(0))), 1, 0).m_strict);
+        assert(!l_usage(f(a(f(v(2)), v(1))), 1, 0).m_strict);
+    }
+}
+
+void test_analyze_usage()
+{
+    // (PAIR λ.0): the pair knows its one argument, the others are open
+    {
+        const std::vector<binder_usage> l_result =
+            analyze_usage(*a(strictness_pair(), f(v(0))));
+
+        assert(l_result.size() == 3);
+        assert(l_result[0].m_uses == 2 && l_result[0].m_strict);
+        // the selector is applied
+        assert(l_result[1].m_uses == 1 && !l_result[1].m_strict);
+        // the identity may be applied
+        assert(l_result[2].m_uses == 1 && !l_result[2].m_strict);
+    }
+
+    assert(analyze_usage(*v(0)).empty());
+}
+
+void test_reduce_one_step_strict()
+{
+    const auto I = f(v(0));
+
+    // a strict argument used twice is reduced before it is copied
+    {
+        auto l_expr = a(strictness_pair(), a(I->clone(), I->clone()));
+        assert(reduce_one_step_strict(l_expr));
+        assert(l_expr->equals(a(strictness_pair(), I->clone())));
+        assert(l_expr->m_size == 10);
+        assert(reduce_one_step_strict(l_expr));
+        assert(l_expr->equals(f(a(a(v(0), f(v(1))), f(v(1))))));
+        assert(!reduce_one_step_strict(l_expr));
+
+        // normal order copies the redex and reduces each copy
+        auto l_strict = a(strictness_pair(), a(I->clone(), I->clone()));
+        auto l_normal = l_strict->clone();
+        assert(normalize(l_strict, {}, strategy::strict_arguments).m_steps ==
+               2);
+        assert(normalize(l_normal).m_steps == 3);
+        assert(l_strict->equals(l_normal));
+    }
+
+    // an argument used once is substituted as it is
+    {
+        auto l_expr = a(f(f(a(v(1), v(0)))), a(I->clone(), I->clone()));
+        assert(reduce_one_step_strict(l_expr));
+        assert(l_expr->equals(f(a(v(0), a(f(v(1)), f(v(1)))))));
+    }
+
+    // an argument the pair's selector drops is not reduced:
+    // ((PAIR OMEGA) λ.λ.λ.2) has the normal form λ.0
+    {
+        auto l_omega = a(f(a(v(0), v(0))), f(a(v(0), v(0))));
+        auto l_expr =
+            a(a(strictness_pair(), std::move(l_omega)), f(f(f(v(2)))));
+
+        budget l_budget;
+        l_budget.m_max_steps = 50;
+        const normalize_stats l_stats =
+            normalize(l_expr, l_budget, strategy::strict_arguments);
+
+        assert(l_stats.m_status == normalize_status::normal_form);
+        assert(l_stats.m_steps == 4);
+        assert(l_expr->equals(f(v(0))));
+    }
+
+    // invalid
+    {
+        std::unique_ptr<expr> l_null;
+        assert_throws(reduce_one_step_strict(l_null), std::runtime_error);
+    }
+}
+
+void strictness_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_analyze_binder);
+    TEST(test_analyze_usage);
+    TEST(test_reduce_one_step_strict);
+}
+
+#endif
+
+#ifdef BENCHMARK
+
+#include "../benchmark/bench_utils.hpp"
+#include "../include/normalize.hpp"
+
+using namespace lambda;
+
+void bench_strict_arguments()
+{
+    const size_t l_runs = 3;
+    const size_t l_levels = 6;
+
+    // church numeral a_n at depth 0
+    auto l_numeral = [](size_t a_n)
+    {
+        std::unique_ptr<expr> l_body = v(1);
+
+        for(size_t i = 0; i < a_n; ++i)
+            l_body = a(v(0), std::move(l_body));
+
+        return f(f(std::move(l_body)));
+    };
+
+    // l_levels nested pairs of two copies, around 3^4: normal order
+    // reduces 2^l_levels copies of the power
+    std::unique_ptr<expr> l_term = a(l_numeral(4), l_numeral(3));
+
+    for(size_t i = 0; i < l_levels; ++i)
+        l_term = a(f(f(a(a(v(1), v(0)), v(0)))), std::move(l_term));
+
+    std::unique_ptr<expr> l_expr;
+    normalize_stats l_stats;
+
+    for(const strategy l_strategy :
+        {strategy::normal_order, strategy::strict_arguments})
+    {
+        measurement l_measured = measure_best_of(
+            l_runs, [&] { l_expr = l_term->clone(); },
+            [&] { l_stats = normalize(l_expr, {}, l_strategy); });
+        report(l_strategy == strategy::normal_order ? "normal order"
+                                                    : "strict arguments",
+               l_measured, l_stats.m_steps);
+        std::cout << "    " << l_stats.m_steps << " steps, result size "
+                  << l_expr->m_size << std::endl;
+    }
+}
+
+void strictness_bench_main()
+{
+    BENCH(bench_strict_arguments);
+}
+
+#endif
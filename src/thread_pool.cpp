@@ -0,0 +1,178 @@
+#include "../include/thread_pool.hpp"
+
+namespace lambda
+{
+
+thread_pool::thread_pool(size_t a_thread_count) : m_running(0), m_stopping(false)
+{
+    if(a_thread_count == 0)
+        a_thread_count = 1;
+
+    m_workers.reserve(a_thread_count);
+
+    for(size_t i = 0; i < a_thread_count; ++i)
+        m_workers.emplace_back([this] { worker_loop(); });
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> l_lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_task_available.notify_all();
+
+    for(std::thread& l_worker : m_workers)
+        l_worker.join();
+}
+
+void thread_pool::submit(std::function<void()> a_task)
+{
+    {
+        std::lock_guard<std::mutex> l_lock(m_mutex);
+        m_tasks.push_back(std::move(a_task));
+    }
+
+    m_task_available.notify_one();
+}
+
+void thread_pool::wait_idle()
+{
+    std::unique_lock<std::mutex> l_lock(m_mutex);
+    m_idle.wait(l_lock, [this] { return m_tasks.empty() && m_running == 0; });
+}
+
+bool thread_pool::run_pending_task()
+{
+    std::unique_lock<std::mutex> l_lock(m_mutex);
+
+    if(m_tasks.empty())
+        return false;
+
+    std::function<void()> l_task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+    ++m_running;
+
+    l_lock.unlock();
+    l_task();
+    l_lock.lock();
+
+    --m_running;
+
+    if(m_tasks.empty() && m_running == 0)
+        m_idle.notify_all();
+
+    return true;
+}
+
+size_t thread_pool::size() const
+{
+    return m_workers.size();
+}
+
+void thread_pool::worker_loop()
+{
+    std::unique_lock<std::mutex> l_lock(m_mutex);
+
+    while(true)
+    {
+        m_task_available.wait(l_lock,
+                              [this] { return m_stopping || !m_tasks.empty(); });
+
+        // drain the queue before honoring a stop request
+        if(m_tasks.empty())
+            return;
+
+        std::function<void()> l_task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+        ++m_running;
+
+        l_lock.unlock();
+        l_task();
+        l_lock.lock();
+
+        --m_running;
+
+        if(m_tasks.empty() && m_running == 0)
+            m_idle.notify_all();
+    }
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <atomic>
+
+using namespace lambda;
+
+void test_thread_pool()
+{
+    // every task runs exactly once
+    {
+        thread_pool l_pool(4);
+        assert(l_pool.size() == 4);
+
+        std::atomic<size_t> l_sum = 0;
+        for(size_t i = 1; i <= 1000; ++i)
+            l_pool.submit([&l_sum, i] { l_sum += i; });
+
+        l_pool.wait_idle();
+        assert(l_sum == 500500);
+    }
+
+    // zero threads still gives a usable pool
+    {
+        thread_pool l_pool(0);
+        assert(l_pool.size() == 1);
+
+        bool l_ran = false;
+        l_pool.submit([&l_ran] { l_ran = true; });
+        l_pool.wait_idle();
+        assert(l_ran);
+    }
+
+    // destruction drains queued tasks
+    {
+        std::atomic<size_t> l_count = 0;
+        {
+            thread_pool l_pool(2);
+            for(size_t i = 0; i < 100; ++i)
+                l_pool.submit([&l_count] { ++l_count; });
+        }
+        assert(l_count == 100);
+    }
+
+    // a waiting thread can run queued tasks itself, even a worker whose
+    // pool has no other thread to run them
+    {
+        thread_pool l_pool(1);
+        assert(!l_pool.run_pending_task());
+
+        std::atomic<size_t> l_count = 0;
+
+        l_pool.submit(
+            [&]
+            {
+                for(size_t i = 0; i < 10; ++i)
+                    l_pool.submit([&l_count] { ++l_count; });
+
+                while(l_count < 10)
+                    l_pool.run_pending_task();
+            });
+
+        l_pool.wait_idle();
+        assert(l_count == 10);
+    }
+}
+
+void thread_pool_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_thread_pool);
+}
+
+#endif
@@ -0,0 +1,263 @@
+#include "../include/work_stealing_pool.hpp"
+#include <chrono>
+#include <exception>
+
+namespace lambda
+{
+
+struct work_stealing_pool::task
+{
+    explicit task(const std::function<void()>& a_fn) : m_fn(a_fn), m_done(false)
+    {
+    }
+
+    void run()
+    {
+        try
+        {
+            m_fn();
+        }
+        catch(...)
+        {
+            m_error = std::current_exception();
+        }
+
+        m_done.store(true, std::memory_order_release);
+    }
+
+    const std::function<void()>& m_fn;
+    std::atomic<bool> m_done;
+    std::exception_ptr m_error;
+};
+
+// the pool and deque index of the current thread, if it is a worker.
+static thread_local const work_stealing_pool* t_pool = nullptr;
+static thread_local size_t t_index = 0;
+
+work_stealing_pool::work_stealing_pool(size_t a_thread_count)
+    : m_queued(0), m_stopping(false)
+{
+    if(a_thread_count == 0)
+        a_thread_count = 1;
+
+    // one deque per worker plus one shared by outside threads
+    for(size_t i = 0; i <= a_thread_count; ++i)
+        m_deques.push_back(std::make_unique<task_deque>());
+
+    for(size_t i = 0; i < a_thread_count; ++i)
+        m_workers.emplace_back([this, i] { worker_loop(i); });
+}
+
+work_stealing_pool::~work_stealing_pool()
+{
+    {
+        std::lock_guard<std::mutex> l_lock(m_sleep_mutex);
+        m_stopping = true;
+    }
+
+    m_work_available.notify_all();
+
+    for(std::thread& l_worker : m_workers)
+        l_worker.join();
+}
+
+void work_stealing_pool::fork_join(const std::function<void()>& a_left,
+                                   const std::function<void()>& a_right)
+{
+    const size_t l_home = home_index();
+    task l_right(a_right);
+
+    // counted before it is visible, so thieves never drive the count below 0
+    m_queued.fetch_add(1, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> l_lock(m_deques[l_home]->m_mutex);
+        m_deques[l_home]->m_tasks.push_back(&l_right);
+    }
+
+    m_work_available.notify_one();
+
+    std::exception_ptr l_left_error;
+
+    try
+    {
+        a_left();
+    }
+    catch(...)
+    {
+        l_left_error = std::current_exception();
+    }
+
+    // take the right task back if nobody stole it in the meantime
+    bool l_reclaimed = false;
+
+    {
+        std::lock_guard<std::mutex> l_lock(m_deques[l_home]->m_mutex);
+        auto& l_tasks = m_deques[l_home]->m_tasks;
+
+        if(!l_tasks.empty() && l_tasks.back() == &l_right)
+        {
+            l_tasks.pop_back();
+            l_reclaimed = true;
+        }
+    }
+
+    if(l_reclaimed)
+    {
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        l_right.run();
+    }
+    else
+    {
+        // help with other work until the thief finishes
+        while(!l_right.m_done.load(std::memory_order_acquire))
+            if(!try_run_one(l_home))
+                std::this_thread::yield();
+    }
+
+    if(l_left_error)
+        std::rethrow_exception(l_left_error);
+
+    if(l_right.m_error)
+        std::rethrow_exception(l_right.m_error);
+}
+
+size_t work_stealing_pool::size() const
+{
+    return m_workers.size();
+}
+
+size_t work_stealing_pool::home_index() const
+{
+    return t_pool == this ? t_index : m_deques.size() - 1;
+}
+
+bool work_stealing_pool::try_run_one(size_t a_home)
+{
+    if(m_queued.load(std::memory_order_acquire) == 0)
+        return false;
+
+    task* l_task = nullptr;
+
+    // newest task from our own deque first, for locality
+    {
+        std::lock_guard<std::mutex> l_lock(m_deques[a_home]->m_mutex);
+        auto& l_tasks = m_deques[a_home]->m_tasks;
+
+        if(!l_tasks.empty())
+        {
+            l_task = l_tasks.back();
+            l_tasks.pop_back();
+        }
+    }
+
+    // otherwise steal the oldest task of another deque
+    for(size_t i = 1; !l_task && i < m_deques.size(); ++i)
+    {
+        task_deque& l_victim = *m_deques[(a_home + i) % m_deques.size()];
+        std::lock_guard<std::mutex> l_lock(l_victim.m_mutex);
+
+        if(!l_victim.m_tasks.empty())
+        {
+            l_task = l_victim.m_tasks.front();
+            l_victim.m_tasks.pop_front();
+        }
+    }
+
+    if(!l_task)
+        return false;
+
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    l_task->run();
+
+    return true;
+}
+
+void work_stealing_pool::worker_loop(size_t a_index)
+{
+    t_pool = this;
+    t_index = a_index;
+
+    while(!m_stopping.load(std::memory_order_relaxed))
+    {
+        if(try_run_one(a_index))
+            continue;
+
+        // the timeout covers notifications sent while we were not waiting
+        std::unique_lock<std::mutex> l_lock(m_sleep_mutex);
+        m_work_available.wait_for(l_lock, std::chrono::milliseconds(1),
+                                  [this] {
+                                      return m_stopping.load() ||
+                                             m_queued.load() > 0;
+                                  });
+    }
+}
+
+} // namespace lambda
+
+#ifdef UNIT_TEST
+
+#include "../testing/test_utils.hpp"
+#include <stdexcept>
+
+using namespace lambda;
+
+// naive fibonacci, forking at every level
+static size_t parallel_fib(work_stealing_pool& a_pool, size_t a_n)
+{
+    if(a_n < 2)
+        return a_n;
+
+    size_t l_left = 0;
+    size_t l_right = 0;
+
+    a_pool.fork_join([&] { l_left = parallel_fib(a_pool, a_n - 1); },
+                     [&] { l_right = parallel_fib(a_pool, a_n - 2); });
+
+    return l_left + l_right;
+}
+
+void test_work_stealing_pool()
+{
+    // nested fork-join from an outside thread
+    {
+        work_stealing_pool l_pool(4);
+        assert(l_pool.size() == 4);
+        assert(parallel_fib(l_pool, 20) == 6765);
+    }
+
+    // several outside threads share one pool
+    {
+        work_stealing_pool l_pool(2);
+        std::vector<std::thread> l_threads;
+        std::atomic<size_t> l_sum = 0;
+
+        for(size_t i = 0; i < 4; ++i)
+            l_threads.emplace_back([&] { l_sum += parallel_fib(l_pool, 15); });
+
+        for(std::thread& l_thread : l_threads)
+            l_thread.join();
+
+        assert(l_sum == 4 * 610);
+    }
+
+    // exceptions reach the caller after both sides finish
+    {
+        work_stealing_pool l_pool(2);
+        bool l_left_ran = false;
+
+        assert_throws(l_pool.fork_join([&] { l_left_ran = true; },
+                                       [] { throw std::runtime_error("x"); }),
+                      std::runtime_error);
+        assert(l_left_ran);
+    }
+}
+
+void work_stealing_pool_test_main()
+{
+    constexpr bool ENABLE_DEBUG_LOGS = true;
+
+    TEST(test_work_stealing_pool);
+}
+
+#endif
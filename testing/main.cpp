@@ -1,12 +1,58 @@
 #include "test_utils.hpp"
 
 extern void lambda_test_main();
+extern void serialize_test_main();
+extern void normalize_test_main();
+extern void thread_pool_test_main();
+extern void server_test_main();
+extern void pipeline_test_main();
+extern void hash_test_main();
+extern void work_stealing_pool_test_main();
+extern void parallel_test_main();
+extern void flat_test_main();
+extern void corpus_test_main();
+extern void lockstep_test_main();
+extern void speculate_test_main();
+extern void intern_test_main();
+extern void epoch_test_main();
+extern void node_pool_test_main();
+extern void profile_test_main();
+extern void probes_test_main();
+extern void metrics_test_main();
+extern void library_test_main();
+extern void specialize_test_main();
+extern void cse_test_main();
+extern void eta_test_main();
+extern void strictness_test_main();
 
 void unit_test_main()
 {
     constexpr bool ENABLE_DEBUG_LOGS = true;
 
     TEST(lambda_test_main);
+    TEST(serialize_test_main);
+    TEST(normalize_test_main);
+    TEST(thread_pool_test_main);
+    TEST(server_test_main);
+    TEST(pipeline_test_main);
+    TEST(hash_test_main);
+    TEST(work_stealing_pool_test_main);
+    TEST(parallel_test_main);
+    TEST(flat_test_main);
+    TEST(corpus_test_main);
+    TEST(lockstep_test_main);
+    TEST(speculate_test_main);
+    TEST(intern_test_main);
+    TEST(epoch_test_main);
+    TEST(node_pool_test_main);
+    TEST(profile_test_main);
+    TEST(probes_test_main);
+    TEST(metrics_test_main);
+    TEST(library_test_main);
+    TEST(specialize_test_main);
+    TEST(cse_test_main);
+    TEST(eta_test_main);
+    TEST(strictness_test_main);
 }
 
 int main()
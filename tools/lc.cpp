@@ -0,0 +1,173 @@
+// lc: normalizes batches of terms from files or stdin.
+//
+// usage: lc [options] [file...]
+//
+// Terms are read from each file in turn ("-" or no file means stdin), one
+// per line in the text format or back to back in the binary formats. Parsing,
+// normalization on a pool of threads and writing overlap (see pipeline.hpp);
+// results are written to stdout in input order.
+
+#include "../include/pipeline.hpp"
+#include "options.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace lambda;
+
+static int usage()
+{
+    std::cerr
+        << "usage: lc [options] [file...]\n"
+           "  -j, --threads N        worker threads (default: all cores)\n"
+           "  --strategy S           normal (default), applicative or strict\n"
+           "  --input F              text (default), binary or shared\n"
+           "  --output F             text (default), binary or shared\n"
+           "  --max-steps N          beta-reductions allowed per term\n"
+           "  --max-size N           largest size allowed per term\n"
+           "  --max-time-ms N        time allowed per term\n"
+           "  --stats                print per-term statistics to stderr\n";
+    return 2;
+}
+
+static bool parse_format(const std::string& a_name, term_format& a_format)
+{
+    if(a_name == "text")
+        a_format = term_format::text;
+    else if(a_name == "binary")
+        a_format = term_format::binary;
+    else if(a_name == "shared")
+        a_format = term_format::shared;
+    else
+        return false;
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    size_t l_threads = std::thread::hardware_concurrency();
+    strategy l_strategy = strategy::normal_order;
+    term_format l_input = term_format::text;
+    term_format l_output = term_format::text;
+    budget l_budget;
+    bool l_stats = false;
+    std::vector<std::string> l_files;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string l_arg = argv[i];
+        const bool l_has_value = i + 1 < argc;
+
+        if((l_arg == "-j" || l_arg == "--threads") && l_has_value)
+        {
+            if(!parse_count(argv[++i], l_threads, false))
+                return usage();
+        }
+        else if(l_arg == "--strategy" && l_has_value)
+        {
+            const std::string l_name = argv[++i];
+            if(l_name == "normal")
+                l_strategy = strategy::normal_order;
+            else if(l_name == "applicative")
+                l_strategy = strategy::applicative_order;
+            else if(l_name == "strict")
+                l_strategy = strategy::strict_arguments;
+            else
+                return usage();
+        }
+        else if(l_arg == "--input" && l_has_value)
+        {
+            if(!parse_format(argv[++i], l_input))
+                return usage();
+        }
+        else if(l_arg == "--output" && l_has_value)
+        {
+            if(!parse_format(argv[++i], l_output))
+                return usage();
+        }
+        else if(l_arg == "--max-steps" && l_has_value)
+        {
+            if(!parse_count(argv[++i], l_budget.m_max_steps))
+                return usage();
+        }
+        else if(l_arg == "--max-size" && l_has_value)
+        {
+            if(!parse_count(argv[++i], l_budget.m_max_size))
+                return usage();
+        }
+        else if(l_arg == "--max-time-ms" && l_has_value)
+        {
+            if(!parse_time_ms(argv[++i], l_budget.m_max_time))
+                return usage();
+        }
+        else if(l_arg == "--stats")
+            l_stats = true;
+        else if(l_arg == "-" || l_arg[0] != '-')
+            l_files.push_back(l_arg);
+        else
+            return usage();
+    }
+
+    if(l_files.empty())
+        l_files.push_back("-");
+
+    pipeline_options l_options;
+    l_options.m_workers = l_threads;
+    l_options.m_input = l_input;
+    l_options.m_output = l_output;
+    l_options.m_budget = l_budget;
+    l_options.m_strategy = l_strategy;
+
+    int l_exit_code = 0;
+
+    // reports unreadable terms and, if asked, per-term statistics
+    auto l_on_written = [&l_exit_code, l_stats](const pipeline_item& a_item)
+    {
+        if(!a_item.m_expr)
+        {
+            std::cerr << "lc: term " << a_item.m_sequence << ": "
+                      << a_item.m_error << "\n";
+            l_exit_code = 1;
+            return;
+        }
+
+        if(l_stats)
+            std::cerr << a_item.m_sequence << "\t"
+                      << to_string(a_item.m_stats.m_status)
+                      << " steps=" << a_item.m_stats.m_steps
+                      << " max_size=" << a_item.m_stats.m_max_size
+                      << " size=" << a_item.m_expr->m_size << " elapsed_us="
+                      << a_item.m_stats.m_elapsed.count() / 1000 << "\n";
+    };
+
+    try
+    {
+        for(const std::string& l_file : l_files)
+        {
+            std::ifstream l_stream;
+
+            if(l_file != "-")
+            {
+                l_stream.open(l_file, std::ios::binary);
+                if(!l_stream)
+                {
+                    std::cerr << "lc: cannot open " << l_file << std::endl;
+                    return 1;
+                }
+            }
+
+            run_pipeline(l_file == "-" ? std::cin : l_stream, std::cout,
+                         l_options, l_on_written);
+        }
+    }
+    catch(const std::runtime_error& l_error)
+    {
+        std::cerr << "lc: " << l_error.what() << std::endl;
+        return 1;
+    }
+
+    return l_exit_code;
+}
@@ -0,0 +1,159 @@
+// lc-client: sends one term per line of stdin to lcd and prints the normal
+// forms in input order. Requests are pipelined over a single connection.
+//
+// usage: lc-client <socket-path> [--binary] [--stats] [--max-steps N]
+//                  [--max-size N] [--max-time-ms N]
+
+#include "../include/serialize.hpp"
+#include "../include/server.hpp"
+#include "options.hpp"
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+using namespace lambda;
+
+// requests allowed in flight before waiting for responses.
+static constexpr size_t WINDOW = 1024;
+
+static int usage()
+{
+    std::cerr << "usage: lc-client <socket-path> [--binary] [--stats] "
+                 "[--max-steps N] [--max-size N] [--max-time-ms N]"
+              << std::endl;
+    return 2;
+}
+
+static void print_response(const response& a_response, bool a_binary,
+                           bool a_stats)
+{
+    if(a_binary && a_response.m_status != response_status::bad_request)
+    {
+        size_t l_pos = 0;
+        std::cout << *decode(a_response.m_term, l_pos);
+    }
+    else
+    {
+        std::cout << a_response.m_term;
+    }
+
+    if(a_stats)
+    {
+        std::cout << "\t"
+                  << (a_response.m_status == response_status::bad_request
+                          ? "bad_request"
+                          : to_string(static_cast<normalize_status>(
+                                a_response.m_status)))
+                  << " steps=" << a_response.m_steps
+                  << " max_size=" << a_response.m_max_size
+                  << " size=" << a_response.m_size << " elapsed_us="
+                  << a_response.m_elapsed.count() / 1000;
+    }
+
+    std::cout << "\n";
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+        return usage();
+
+    const std::string l_socket_path = argv[1];
+    bool l_binary = false;
+    bool l_stats = false;
+    budget l_budget;
+
+    for(int i = 2; i < argc; ++i)
+    {
+        const std::string l_arg = argv[i];
+
+        if(l_arg == "--binary")
+            l_binary = true;
+        else if(l_arg == "--stats")
+            l_stats = true;
+        else if(l_arg == "--max-steps" && i + 1 < argc)
+        {
+            if(!parse_count(argv[++i], l_budget.m_max_steps))
+                return usage();
+        }
+        else if(l_arg == "--max-size" && i + 1 < argc)
+        {
+            if(!parse_count(argv[++i], l_budget.m_max_size))
+                return usage();
+        }
+        else if(l_arg == "--max-time-ms" && i + 1 < argc)
+        {
+            if(!parse_time_ms(argv[++i], l_budget.m_max_time))
+                return usage();
+        }
+        else
+            return usage();
+    }
+
+    try
+    {
+        client l_client(l_socket_path);
+
+        uint64_t l_next_id = 0;
+        uint64_t l_next_to_print = 0;
+        std::map<uint64_t, response> l_pending;
+
+        // prints every response that is next in input order
+        auto l_drain_ready = [&]()
+        {
+            for(auto l_it = l_pending.find(l_next_to_print);
+                l_it != l_pending.end();
+                l_it = l_pending.find(++l_next_to_print))
+            {
+                print_response(l_it->second, l_binary, l_stats);
+                l_pending.erase(l_it);
+            }
+        };
+
+        std::string l_line;
+
+        while(std::getline(std::cin, l_line))
+        {
+            if(l_line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+
+            request l_request;
+            l_request.m_id = l_next_id++;
+            l_request.m_budget = l_budget;
+
+            if(l_binary)
+            {
+                l_request.m_format = term_format::binary;
+                encode(*parse(l_line), l_request.m_term);
+            }
+            else
+            {
+                l_request.m_term = l_line;
+            }
+
+            l_client.submit(l_request);
+
+            if(l_next_id - l_next_to_print >= WINDOW)
+            {
+                response l_response = l_client.receive();
+                l_pending.emplace(l_response.m_id, std::move(l_response));
+                l_drain_ready();
+            }
+        }
+
+        while(l_next_to_print < l_next_id)
+        {
+            response l_response = l_client.receive();
+            l_pending.emplace(l_response.m_id, std::move(l_response));
+            l_drain_ready();
+        }
+    }
+    catch(const std::exception& l_error)
+    {
+        std::cerr << "lc-client: " << l_error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
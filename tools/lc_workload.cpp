@@ -0,0 +1,82 @@
+// lc-workload: times a fixed reduction workload against liblc.
+//
+// usage: lc-workload [runs]
+//
+// Normalizes the same church arithmetic terms in both strategies, then
+// encodes, decodes and compares the results, keeping the best of [runs]
+// (default 5) passes. Prints the best pass in nanoseconds, alone on stdout,
+// so that builds of the library with different flags can be compared (see
+// `make release-report`); the same workload trains the profile-guided
+// build.
+
+#include "../include/normalize.hpp"
+#include "../include/serialize.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace lambda;
+
+// church numeral a_n.
+static std::unique_ptr<expr> numeral(size_t a_n)
+{
+    std::unique_ptr<expr> l_body = v(1);
+
+    for(size_t i = 0; i < a_n; ++i)
+        l_body = a(v(0), std::move(l_body));
+
+    return f(f(std::move(l_body)));
+}
+
+// one pass of the workload.
+static void run_workload()
+{
+    std::string l_bytes;
+
+    // (a_exponent a_base) normalizes to the numeral a_base^a_exponent
+    auto l_power = [&](size_t a_base, size_t a_exponent, strategy a_strategy)
+    {
+        std::unique_ptr<expr> l_expr = a(numeral(a_exponent), numeral(a_base));
+        normalize(l_expr, {}, a_strategy);
+
+        l_bytes.clear();
+        encode(*l_expr, l_bytes);
+        size_t l_pos = 0;
+        size_t l_expected = 1;
+
+        for(size_t i = 0; i < a_exponent; ++i)
+            l_expected *= a_base;
+
+        if(!decode(l_bytes, l_pos)->equals(numeral(l_expected)))
+        {
+            std::cerr << "lc-workload: wrong normal form\n";
+            std::exit(1);
+        }
+    };
+
+    l_power(3, 6, strategy::normal_order);
+    l_power(3, 6, strategy::applicative_order);
+    l_power(2, 10, strategy::normal_order);
+    l_power(5, 4, strategy::applicative_order);
+}
+
+int main(int argc, char** argv)
+{
+    const size_t l_runs = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5;
+    auto l_best = std::chrono::nanoseconds::max();
+
+    for(size_t i = 0; i < l_runs; ++i)
+    {
+        const auto l_start = std::chrono::steady_clock::now();
+        run_workload();
+        const auto l_elapsed = std::chrono::steady_clock::now() - l_start;
+
+        if(l_elapsed < l_best)
+            l_best = l_elapsed;
+    }
+
+    std::cout << l_best.count() << '\n';
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+// lcd: evaluation daemon serving normalization requests on a Unix socket.
+//
+// usage: lcd <socket-path> [--workers N] [--max-steps N] [--max-size N]
+//            [--max-time-ms N]
+//
+// Every request is clamped to the maximum budget, which defaults to
+// DEFAULT_SERVER_BUDGET.
+
+#include "../include/server.hpp"
+#include "options.hpp"
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static lambda::server* g_server = nullptr;
+
+static void handle_signal(int)
+{
+    if(g_server)
+        g_server->stop();
+}
+
+static int usage()
+{
+    std::cerr << "usage: lcd <socket-path> [--workers N] [--max-steps N] "
+                 "[--max-size N] [--max-time-ms N]"
+              << std::endl;
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+        return usage();
+
+    const std::string l_socket_path = argv[1];
+    size_t l_workers = std::thread::hardware_concurrency();
+    lambda::budget l_max_budget = lambda::DEFAULT_SERVER_BUDGET;
+
+    for(int i = 2; i < argc; ++i)
+    {
+        const std::string l_arg = argv[i];
+        const bool l_has_value = i + 1 < argc;
+
+        if(!l_has_value)
+            return usage();
+
+        const char* l_value = argv[++i];
+        bool l_valid = false;
+
+        if(l_arg == "--workers")
+            l_valid = parse_count(l_value, l_workers, false);
+        else if(l_arg == "--max-steps")
+            l_valid = parse_count(l_value, l_max_budget.m_max_steps, false);
+        else if(l_arg == "--max-size")
+            l_valid = parse_count(l_value, l_max_budget.m_max_size, false);
+        else if(l_arg == "--max-time-ms")
+            l_valid = parse_time_ms(l_value, l_max_budget.m_max_time) &&
+                      l_max_budget.m_max_time.count() > 0;
+
+        if(!l_valid)
+            return usage();
+    }
+
+    try
+    {
+        lambda::server l_server(l_socket_path, l_workers, l_max_budget);
+
+        g_server = &l_server;
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+
+        std::cerr << "lcd: listening on " << l_socket_path << " with "
+                  << l_workers << " workers" << std::endl;
+
+        l_server.run();
+
+        g_server = nullptr;
+    }
+    catch(const std::exception& l_error)
+    {
+        std::cerr << "lcd: " << l_error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef TOOLS_OPTIONS_HPP
+#define TOOLS_OPTIONS_HPP
+
+// parsing of the numeric command-line values shared by lc, lcd and
+// lc-client.
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+
+// parses a_text as a decimal count. Rejects anything but digits, values out
+// of range and, unless a_allow_zero, zero.
+inline bool parse_count(const char* a_text, size_t& a_count,
+                        bool a_allow_zero = true)
+{
+    char* l_end = nullptr;
+    errno = 0;
+    const unsigned long long l_value = std::strtoull(a_text, &l_end, 10);
+
+    if(errno != 0 || l_end == a_text || *l_end != '\0' || *a_text == '-' ||
+       (l_value == 0 && !a_allow_zero))
+        return false;
+
+    a_count = l_value;
+
+    return true;
+}
+
+// parses a_text as a count of milliseconds. Durations beyond the range of
+// nanoseconds mean no limit: nanoseconds::max().
+inline bool parse_time_ms(const char* a_text, std::chrono::nanoseconds& a_time)
+{
+    size_t l_milliseconds = 0;
+
+    if(!parse_count(a_text, l_milliseconds))
+        return false;
+
+    const size_t l_max_milliseconds =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::nanoseconds::max())
+            .count();
+
+    a_time = l_milliseconds < l_max_milliseconds
+                 ? std::chrono::nanoseconds(
+                       std::chrono::milliseconds(l_milliseconds))
+                 : std::chrono::nanoseconds::max();
+
+    return true;
+}
+
+#endif